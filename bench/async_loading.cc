@@ -0,0 +1,281 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../lib/headless.hh"
+#include "../lib/shader.hh"
+#include "../lib/state_cache.hh"
+#include "../lib/obj_loader.hh"
+#include "../lib/mesh_file.hh"
+#include "../lib/resource_loader.hh"
+#include "program.hh"
+// a render loop that needs N meshes from disk, loaded three ways:
+//   up front      every mesh loaded on the render thread before frame 1,
+//                 what the samples do today
+//   per frame     one mesh loaded on the render thread at the start of
+//                 each frame until all are in
+//   loader        every mesh queued on a ResourceLoader, each frame draws
+//                 what poll() has handed out so far
+// prints time to first frame, time until every mesh is drawn, the median
+// and worst frame time while loading and the frame time once everything
+// is loaded, files dropped from the page cache before each mode
+//   async_loading [meshes] [triangles] [mesh|obj]
+// obj parses the text on the loading thread, mesh maps a packed mesh file
+
+namespace {
+  typedef std::chrono::steady_clock Clock;
+
+  const GLchar* vertexSource = "#version 330 core\n"
+    "layout (location = 0) in vec3 position;"
+    "uniform vec3 placement;"
+    "void main() {"
+    "gl_Position = vec4(position*placement.z + vec3(placement.xy, 0.0), 1.0);"
+    "}";
+  const GLchar* fragmentSource = "#version 330 core\n"
+    "out vec4 color;"
+    "void main() {"
+    "color = vec4(1.0f, .5f, .2f, 1.0f);"
+    "}";
+
+  void writeSphere(const std::string& path, long triangles) {
+    long rings = std::max(2L, long(std::sqrt(triangles/4.0)));
+    long segments = std::max(3L, triangles/(2*rings));
+    FILE* file = std::fopen(path.c_str(), "w");
+    std::fprintf(file, "o sphere\n");
+    for (long r = 0; r <= rings; ++r)
+      for (long s = 0; s <= segments; ++s) {
+        double theta = M_PI*r/rings, phi = 2*M_PI*s/segments;
+        double x = std::sin(theta)*std::cos(phi), y = std::cos(theta), z = std::sin(theta)*std::sin(phi);
+        std::fprintf(file, "v %f %f %f\nvn %f %f %f\n", x, y, z, x, y, z);
+      }
+    for (long r = 0; r < rings; ++r)
+      for (long s = 0; s < segments; ++s) {
+        long a = r*(segments + 1) + s + 1, b = a + segments + 1;
+        std::fprintf(file, "f %ld//%ld %ld//%ld %ld//%ld %ld//%ld\n", a, a, b, b, b + 1, b + 1, a + 1, a + 1);
+      }
+    std::fclose(file);
+  }
+
+  void evict(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+  }
+
+  double since(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  }
+
+  // what a frame draws of one mesh
+  struct Drawable {
+    GLuint VAO;
+    GLsizei indexCount;
+    GLenum indexType;
+    std::vector<GLuint> buffers;
+  };
+
+  // the synchronous path: map and upload, or parse and upload
+  Drawable loadHere(const std::string& path) {
+    Drawable d;
+    ResourceLoader::Mesh mesh;
+    mesh.valid = false;
+    mesh.vertexBuffer = mesh.indexBuffer = 0;
+    StateCache& state = StateCache::global();
+    if (path.size() > 4 and path.compare(path.size() - 4, 4, ".obj") == 0) {
+      ObjMesh obj;
+      if (loadObj(path, obj)) {
+        glGenBuffers(1, &mesh.vertexBuffer);
+        glGenBuffers(1, &mesh.indexBuffer);
+        state.bindBuffer(GL_ARRAY_BUFFER, mesh.vertexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, obj.vertices.size()*sizeof(GLfloat), obj.vertices.data(), GL_STATIC_DRAW);
+        state.bindBuffer(GL_COPY_WRITE_BUFFER, mesh.indexBuffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, obj.indices.size()*sizeof(GLuint), obj.indices.data(), GL_STATIC_DRAW);
+        VertexAttribute position = { GL_FLOAT, 3, GL_FALSE, false, 0, 12, 4 };
+        mesh.attributes.push_back(position);
+        mesh.stride = obj.stride()*sizeof(GLfloat);
+        mesh.indexCount = obj.indices.size();
+        mesh.indexType = GL_UNSIGNED_INT;
+        mesh.valid = true;
+      }
+    }
+    else {
+      MeshFile file(path);
+      if (file.valid()) {
+        glGenBuffers(1, &mesh.vertexBuffer);
+        glGenBuffers(1, &mesh.indexBuffer);
+        state.bindBuffer(GL_ARRAY_BUFFER, mesh.vertexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, file.vertexBytes(), file.vertices(), GL_STATIC_DRAW);
+        state.bindBuffer(GL_COPY_WRITE_BUFFER, mesh.indexBuffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, file.indexBytes(), file.indices(), GL_STATIC_DRAW);
+        mesh.attributes = file.vertexAttributes();
+        mesh.stride = file.info().vertexSize;
+        mesh.indexCount = file.indexCount();
+        mesh.indexType = file.indexType();
+        mesh.valid = true;
+      }
+    }
+    d.VAO = ResourceLoader::createVertexArray(mesh);
+    d.indexCount = mesh.indexCount;
+    d.indexType = mesh.indexType;
+    d.buffers.push_back(mesh.vertexBuffer);
+    d.buffers.push_back(mesh.indexBuffer);
+    return d;
+  }
+
+  Drawable adopt(const ResourceLoader::Mesh& mesh) {
+    Drawable d;
+    d.VAO = ResourceLoader::createVertexArray(mesh);
+    d.indexCount = mesh.indexCount;
+    d.indexType = mesh.indexType;
+    d.buffers.push_back(mesh.vertexBuffer);
+    d.buffers.push_back(mesh.indexBuffer);
+    return d;
+  }
+
+  void draw(Shader& shader, GLint placement, const std::vector<Drawable>& drawables, int count) {
+    StateCache& state = StateCache::global();
+    int side = std::ceil(std::sqrt(double(count)));
+    glClear(GL_COLOR_BUFFER_BIT);
+    shader.use();
+    for (size_t i = 0; i < drawables.size(); ++i) {
+      if (drawables[i].VAO == 0) continue;
+      GLfloat x = (i % side + .5f)/side*2.0f - 1.0f, y = (i / side + .5f)/side*2.0f - 1.0f;
+      shader.set(placement, x, y, .9f/side);
+      state.bindVertexArray(drawables[i].VAO);
+      glDrawElements(GL_TRIANGLES, drawables[i].indexCount, drawables[i].indexType, 0);
+    }
+    glFinish();
+  }
+
+  enum Mode { UP_FRONT, PER_FRAME, LOADER };
+
+  // of the last frame, every mode must end with the same image
+  unsigned long long checksum(HeadlessContext& context) {
+    std::vector<unsigned char> pixels(context.width*context.height*4);
+    context.readPixels(pixels.data());
+    unsigned long long hash = 14695981039346656037ull;
+    for (size_t i = 0; i < pixels.size(); ++i) hash = (hash ^ pixels[i])*1099511628211ull;
+    return hash;
+  }
+
+  unsigned long long run(Mode mode, const char* name, HeadlessContext& context, Shader& shader, GLint placement,
+                         const std::vector<std::string>& paths) {
+    for (size_t i = 0; i < paths.size(); ++i) evict(paths[i]);
+    int count = paths.size();
+    std::vector<Drawable> drawables;
+    std::vector<double> frames;
+    double firstFrame = 0, allLoaded = 0;
+    ResourceLoader* loader = nullptr;
+
+    Clock::time_point start = Clock::now();
+    if (mode == LOADER) {
+      loader = new ResourceLoader(ResourceLoader::sharedContext(context));
+      for (size_t i = 0; i < paths.size(); ++i) loader->load(paths[i]);
+    }
+    if (mode == UP_FRONT)
+      for (size_t i = 0; i < paths.size(); ++i) drawables.push_back(loadHere(paths[i]));
+    while (true) {
+      Clock::time_point frameStart = Clock::now();
+      if (mode == PER_FRAME and int(drawables.size()) < count)
+        drawables.push_back(loadHere(paths[drawables.size()]));
+      if (mode == LOADER) {
+        ResourceLoader::Mesh mesh;
+        while (loader->poll(mesh)) drawables.push_back(adopt(mesh));
+      }
+      draw(shader, placement, drawables, count);
+      // the up front frame includes every load, as the user sees it
+      frames.push_back(since(frames.empty() ? start : frameStart));
+      if (frames.size() == 1) firstFrame = since(start);
+      if (int(drawables.size()) == count) {
+        allLoaded = since(start);
+        break;
+      }
+    }
+    delete loader;
+
+    std::vector<double> sorted(frames);
+    std::sort(sorted.begin(), sorted.end());
+    // what a frame costs with nothing left to load, the rest of the worst
+    // frame is loading
+    std::vector<double> steady;
+    for (int i = 0; i < 5; ++i) {
+      Clock::time_point frameStart = Clock::now();
+      draw(shader, placement, drawables, count);
+      steady.push_back(since(frameStart));
+    }
+    std::sort(steady.begin(), steady.end());
+    std::printf("%-10s first frame %8.1f ms, all drawn %8.1f ms after %4zu frames, "
+                "frame median %6.1f ms, worst %8.1f ms (%6.1f ms once loaded)\n",
+                name, firstFrame, allLoaded, frames.size(), sorted[sorted.size()/2], sorted.back(),
+                steady[steady.size()/2]);
+
+    unsigned long long image = checksum(context);
+    for (size_t i = 0; i < drawables.size(); ++i) {
+      glDeleteVertexArrays(1, &drawables[i].VAO);
+      glDeleteBuffers(drawables[i].buffers.size(), drawables[i].buffers.data());
+    }
+    StateCache::global().invalidate();
+    return image;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  int meshes = argc > 1 ? std::atoi(argv[1]) : 16;
+  long triangles = argc > 2 ? std::atol(argv[2]) : 200000;
+  std::string format = argc > 3 ? argv[3] : "mesh";
+  if (meshes <= 0 or triangles <= 0 or (format != "mesh" and format != "obj")) {
+    std::cout << "usage: async_loading [meshes] [triangles] [mesh|obj]" << std::endl;
+    return 1;
+  }
+
+  char directory[] = "/tmp/async_loadingXXXXXX";
+  if (mkdtemp(directory) == nullptr) {
+    std::cout << "ERROR::ASYNC_LOADING::NO_TEMPORARY_DIRECTORY" << std::endl;
+    return -1;
+  }
+
+  HeadlessContext context(800, 600);
+  if (not context.valid()) return -1;
+  std::cout << "renderer: " << glGetString(GL_RENDERER) << std::endl;
+
+  // every mesh its own file, so none is in the page cache for another
+  std::string obj = std::string(directory) + "/sphere.obj";
+  ObjMesh sphere;
+  if (format == "mesh") {
+    writeSphere(obj, triangles);
+    if (not loadObj(obj, sphere)) return -1;
+    std::remove(obj.c_str());
+  }
+  std::vector<std::string> paths;
+  for (int i = 0; i < meshes; ++i) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "/%d.%s", i, format.c_str());
+    paths.push_back(std::string(directory) + name);
+    if (format == "obj") writeSphere(paths.back(), triangles);
+    else writeObjAsMeshFile(sphere, paths.back(), true, i == 0);
+  }
+  std::cout << meshes << " x " << triangles << " triangles from ." << format << " files" << std::endl;
+
+  GLuint built = buildProgram(vertexSource, fragmentSource);
+  if (built == 0) return 1;
+  Shader shader(built);
+  GLint placement = shader.uniform("placement");
+
+  unsigned long long image = run(UP_FRONT, "up front", context, shader, placement, paths);
+  if (run(PER_FRAME, "per frame", context, shader, placement, paths) != image
+      or run(LOADER, "loader", context, shader, placement, paths) != image)
+    std::cout << "ERROR::ASYNC_LOADING::IMAGES_DIFFER" << std::endl;
+
+  for (size_t i = 0; i < paths.size(); ++i) std::remove(paths[i].c_str());
+  rmdir(directory);
+  glDeleteProgram(shader.Program);
+  return 0;
+}
@@ -0,0 +1,291 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+#include "../lib/headless.hh"
+#include "../lib/shader.hh"
+#include "../lib/state_cache.hh"
+#include "../lib/thread_pool.hh"
+#include "../lib/command_list.hh"
+#include "program.hh"
+// frame preparation for a generated scene of N objects: animate, build the
+// model-view-projection matrix, cull against the frustum and issue the
+// draw. Done inline on the GL thread, as the samples do, and recorded into
+// CommandLists on 1, 2, 4 ... threads and replayed on the GL thread.
+//   command_lists [objects] [frames] [max threads]
+// prints preparation and replay time per frame, and the GL calls the
+// state filtering let through; every mode must draw the same image
+
+namespace {
+  typedef std::chrono::steady_clock Clock;
+
+  const int PROGRAMS = 8;
+  const int MESHES = 16;
+
+  const GLchar* vertexSource = "#version 330 core\n"
+    "layout (location = 0) in vec2 position;"
+    "uniform mat4 mvp;"
+    "void main() {"
+    "gl_Position = mvp*vec4(position, 0.0, 1.0);"
+    "}";
+  // each program tints the object color differently
+  const char* fragmentFormat = "#version 330 core\n"
+    "uniform vec4 color;"
+    "out vec4 fragment;"
+    "void main() {"
+    "fragment = color*vec4(%f, %f, %f, 1.0);"
+    "}";
+
+  GLuint program(int tint) {
+    char fragmentSource[256];
+    std::snprintf(fragmentSource, sizeof(fragmentSource), fragmentFormat,
+                  .5 + .5*(tint & 1), .5 + .25*((tint >> 1) & 1), .5 + .125*((tint >> 2) & 1));
+    return buildProgram(vertexSource, fragmentSource);
+  }
+
+  struct Mesh {
+    GLuint VAO, VBO, EBO;
+    GLsizei indexCount;
+  };
+
+  // a regular polygon with 3 + index sides, as a fan of indexed triangles
+  Mesh polygon(int index) {
+    int sides = 3 + index;
+    std::vector<GLfloat> vertices(2, 0.0f);
+    std::vector<GLushort> indices;
+    for (int i = 0; i < sides; ++i) {
+      vertices.push_back(std::cos(2*M_PI*i/sides));
+      vertices.push_back(std::sin(2*M_PI*i/sides));
+      indices.push_back(0);
+      indices.push_back(1 + i);
+      indices.push_back(1 + (i + 1) % sides);
+    }
+    StateCache& state = StateCache::global();
+    Mesh mesh;
+    glGenVertexArrays(1, &mesh.VAO);
+    glGenBuffers(1, &mesh.VBO);
+    glGenBuffers(1, &mesh.EBO);
+    state.bindVertexArray(mesh.VAO);
+    state.bindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size()*sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
+    state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size()*sizeof(GLushort), indices.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2*sizeof(GLfloat), (GLvoid *)0);
+    glEnableVertexAttribArray(0);
+    mesh.indexCount = indices.size();
+    return mesh;
+  }
+
+  // An object moving on a circle in a 3D field, spinning and pulsing.
+  // Everything about a frame follows from the time, so every mode sees
+  // the same scene.
+  struct Object {
+    GLfloat center[3];
+    GLfloat radius, speed, phase;
+    GLfloat spin, size;
+    GLfloat color[4];
+    int program, mesh;
+  };
+
+  // objects sorted by program and mesh, like a renderer's draw order
+  std::vector<Object> generate(int count) {
+    std::mt19937 random(42);
+    std::uniform_real_distribution<GLfloat> unit(0.0f, 1.0f);
+    std::vector<Object> objects(count);
+    for (int i = 0; i < count; ++i) {
+      Object& o = objects[i];
+      o.center[0] = 40.0f*unit(random) - 20.0f;
+      o.center[1] = 40.0f*unit(random) - 20.0f;
+      o.center[2] = -5.0f - 60.0f*unit(random);
+      o.radius = 2.0f*unit(random);
+      o.speed = .5f + unit(random);
+      o.phase = 6.28f*unit(random);
+      o.spin = 4.0f*unit(random) - 2.0f;
+      o.size = .1f + .3f*unit(random);
+      for (int c = 0; c < 3; ++c) o.color[c] = .2f + .8f*unit(random);
+      o.color[3] = 1.0f;
+      o.program = random() % PROGRAMS;
+      o.mesh = random() % MESHES;
+    }
+    std::sort(objects.begin(), objects.end(), [](const Object& a, const Object& b) {
+      return a.program != b.program ? a.program < b.program : a.mesh < b.mesh;
+    });
+    return objects;
+  }
+
+  // column major perspective projection times the model matrix of o at
+  // time, false if o is outside the view frustum
+  bool prepare(const Object& o, GLfloat time, GLfloat* mvp) {
+    GLfloat angle = o.phase + o.speed*time;
+    GLfloat x = o.center[0] + o.radius*std::cos(angle);
+    GLfloat y = o.center[1] + o.radius*std::sin(angle);
+    GLfloat z = o.center[2];
+    GLfloat s = o.size*(1.0f + .2f*std::sin(3.0f*time + o.phase));
+    // bounding sphere against the 90 degree frustum, near 0.1 and far 100
+    if (z - s > -.1f or z + s < -100.0f or std::fabs(x) - s > -z or std::fabs(y) - s > -z) return false;
+    GLfloat c = std::cos(o.spin*time)*s, n = std::sin(o.spin*time)*s;
+    const GLfloat model[16] = { c, n, 0, 0,  -n, c, 0, 0,  0, 0, s, 0,  x, y, z, 1 };
+    const GLfloat a = -100.1f/99.9f, b = -20.0f/99.9f;
+    const GLfloat projection[16] = { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, a, -1,  0, 0, b, 0 };
+    for (int col = 0; col < 4; ++col)
+      for (int row = 0; row < 4; ++row) {
+        GLfloat sum = 0;
+        for (int k = 0; k < 4; ++k) sum += projection[k*4 + row]*model[col*4 + k];
+        mvp[col*4 + row] = sum;
+      }
+    return true;
+  }
+
+  struct Renderer {
+    std::vector<Shader*> shaders;
+    std::vector<GLint> mvpHandles, colorHandles;
+    std::vector<Mesh> meshes;
+  };
+
+  // record the draws of objects [begin, end) into list
+  void record(const Renderer& r, const std::vector<Object>& objects, size_t begin, size_t end,
+              GLfloat time, CommandList& list) {
+    GLfloat mvp[16];
+    for (size_t i = begin; i < end; ++i) {
+      const Object& o = objects[i];
+      if (not prepare(o, time, mvp)) continue;
+      const Mesh& mesh = r.meshes[o.mesh];
+      list.use(*r.shaders[o.program]);
+      list.bindVertexArray(mesh.VAO);
+      list.setMatrix4(r.mvpHandles[o.program], mvp);
+      list.set(r.colorHandles[o.program], o.color[0], o.color[1], o.color[2], o.color[3]);
+      list.drawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_SHORT, 0);
+    }
+  }
+
+  // the same frame straight to GL on this thread
+  void direct(const Renderer& r, const std::vector<Object>& objects, GLfloat time) {
+    StateCache& state = StateCache::global();
+    GLfloat mvp[16];
+    for (size_t i = 0; i < objects.size(); ++i) {
+      const Object& o = objects[i];
+      if (not prepare(o, time, mvp)) continue;
+      const Mesh& mesh = r.meshes[o.mesh];
+      Shader& shader = *r.shaders[o.program];
+      shader.use();
+      state.bindVertexArray(mesh.VAO);
+      shader.setMatrix4(r.mvpHandles[o.program], mvp);
+      shader.set(r.colorHandles[o.program], o.color[0], o.color[1], o.color[2], o.color[3]);
+      glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_SHORT, 0);
+    }
+  }
+
+  unsigned long long checksum(HeadlessContext& context) {
+    std::vector<unsigned char> pixels(context.width*context.height*4);
+    context.readPixels(pixels.data());
+    unsigned long long hash = 14695981039346656037ull;
+    for (size_t i = 0; i < pixels.size(); ++i) hash = (hash ^ pixels[i])*1099511628211ull;
+    return hash;
+  }
+
+  double since(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  }
+}
+
+int main(int argc, char* argv[]) {
+  int count = argc > 1 ? std::atoi(argv[1]) : 50000;
+  int frames = argc > 2 ? std::atoi(argv[2]) : 10;
+  int maxThreads = argc > 3 ? std::atoi(argv[3]) : std::max(4u, std::thread::hardware_concurrency());
+  if (count <= 0 or frames <= 0 or maxThreads <= 0) {
+    std::cout << "usage: command_lists [objects] [frames] [max threads]" << std::endl;
+    return 1;
+  }
+
+  HeadlessContext context(800, 600);
+  if (not context.valid()) return -1;
+  std::cout << "renderer: " << glGetString(GL_RENDERER) << ", "
+            << std::thread::hardware_concurrency() << " cores" << std::endl;
+
+  Renderer renderer;
+  for (int i = 0; i < PROGRAMS; ++i) {
+    GLuint built = program(i);
+    if (built == 0) return 1;
+    renderer.shaders.push_back(new Shader(built));
+    renderer.mvpHandles.push_back(renderer.shaders[i]->uniform("mvp"));
+    renderer.colorHandles.push_back(renderer.shaders[i]->uniform("color"));
+  }
+  for (int i = 0; i < MESHES; ++i) renderer.meshes.push_back(polygon(i));
+  std::vector<Object> objects = generate(count);
+  StateCache& state = StateCache::global();
+  state.clearColor(.1f, .1f, .1f, 1.0f);
+
+  // direct first, its last frame is the reference image
+  double prepareMs = 0;
+  unsigned long long reference = 0;
+  StateCache::Counters calls = StateCache::Counters();
+  Shader::UniformCounters uniforms = Shader::UniformCounters();
+  state.endFrame();
+  Shader::endFrame();
+  for (int f = 0; f < frames; ++f) {
+    glClear(GL_COLOR_BUFFER_BIT);
+    Clock::time_point start = Clock::now();
+    direct(renderer, objects, f/60.0f);
+    prepareMs += since(start);
+    glFinish();
+    StateCache::Counters c = state.endFrame();
+    Shader::UniformCounters u = Shader::endFrame();
+    calls.issued += c.issued;
+    calls.skipped += c.skipped;
+    uniforms.issued += u.issued;
+    uniforms.elided += u.elided;
+  }
+  reference = checksum(context);
+  std::printf("%d objects, %d programs, %d meshes\n", count, PROGRAMS, MESHES);
+  std::printf("direct:            prepare + issue %7.2f ms, binds %u/%u, uniforms %u/%u issued/skipped per frame\n",
+              prepareMs/frames, calls.issued/frames, calls.skipped/frames, uniforms.issued/frames, uniforms.elided/frames);
+
+  for (int threads = 1; threads <= maxThreads; threads *= 2) {
+    ThreadPool pool(threads);
+    CommandRecorder recorder(pool);
+    double recordMs = 0, submitMs = 0;
+    calls = StateCache::Counters();
+    uniforms = Shader::UniformCounters();
+    for (int f = 0; f < frames; ++f) {
+      GLfloat time = f/60.0f;
+      glClear(GL_COLOR_BUFFER_BIT);
+      Clock::time_point start = Clock::now();
+      recorder.record(objects.size(), 1024, [&](CommandList& list, size_t begin, size_t end) {
+        record(renderer, objects, begin, end, time, list);
+      });
+      recordMs += since(start);
+      start = Clock::now();
+      recorder.submit();
+      submitMs += since(start);
+      glFinish();
+      StateCache::Counters c = state.endFrame();
+      Shader::UniformCounters u = Shader::endFrame();
+      calls.issued += c.issued;
+      calls.skipped += c.skipped;
+      uniforms.issued += u.issued;
+      uniforms.elided += u.elided;
+    }
+    bool same = checksum(context) == reference;
+    std::printf("%2d thread%s record %7.2f ms, replay %7.2f ms, binds %u/%u, uniforms %u/%u, "
+                "%zu commands in %zu KB%s\n",
+                threads, threads == 1 ? ": " : "s:", recordMs/frames, submitMs/frames,
+                calls.issued/frames, calls.skipped/frames, uniforms.issued/frames, uniforms.elided/frames,
+                recorder.commands(), recorder.bytes()/1024, same ? "" : ", IMAGE DIFFERS");
+  }
+
+  for (int i = 0; i < PROGRAMS; ++i) {
+    glDeleteProgram(renderer.shaders[i]->Program);
+    delete renderer.shaders[i];
+  }
+  for (int i = 0; i < MESHES; ++i) {
+    glDeleteVertexArrays(1, &renderer.meshes[i].VAO);
+    glDeleteBuffers(1, &renderer.meshes[i].VBO);
+    glDeleteBuffers(1, &renderer.meshes[i].EBO);
+  }
+  return 0;
+}
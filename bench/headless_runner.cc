@@ -0,0 +1,98 @@
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "runner.hh"
+#include "../lib/program_cache.hh"
+// run the sample scenes offscreen and report frame time percentiles as JSON
+//   headless_runner [--frames N] [--warmup N] [--size WxH] [--out FILE] [--list] [scene...]
+// run it from the repository root, the scenes load shaders/*
+
+void usage() {
+  std::cout << "usage: headless_runner [--frames N] [--warmup N] [--size WxH] [--out FILE] [--list] [scene...]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  int frames = 500, warmup = 20;
+  int width = 800, height = 600;
+  std::string output;
+  std::vector<const Scene*> selected;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--frames" and hasValue) frames = std::atoi(argv[++i]);
+    else if (arg == "--warmup" and hasValue) warmup = std::atoi(argv[++i]);
+    else if (arg == "--size" and hasValue) {
+      if (std::sscanf(argv[++i], "%dx%d", &width, &height) != 2) {
+        usage();
+        return 1;
+      }
+    }
+    else if (arg == "--out" and hasValue) output = argv[++i];
+    else if (arg == "--list") {
+      for (size_t s = 0; s < scenes().size(); ++s)
+        std::cout << scenes()[s].name << std::endl;
+      return 0;
+    }
+    else if (arg[0] == '-') {
+      usage();
+      return 1;
+    }
+    else {
+      const Scene* scene = findScene(arg);
+      if (scene == nullptr) {
+        std::cout << "Unknown scene " << arg << ", see --list" << std::endl;
+        return 1;
+      }
+      selected.push_back(scene);
+    }
+  }
+  if (selected.empty())
+    for (size_t s = 0; s < scenes().size(); ++s) selected.push_back(&scenes()[s]);
+  if (frames <= 0) {
+    usage();
+    return 1;
+  }
+
+  HeadlessContext context(width, height);
+  if (not context.valid()) return -1;
+
+  std::ofstream file;
+  if (not output.empty()) {
+    file.open(output.c_str());
+    if (not file) {
+      std::cout << "Cannot write " << output << std::endl;
+      return 1;
+    }
+  }
+  std::ostream& os = output.empty() ? std::cout : file;
+
+  os << "{\n  \"renderer\": \"" << glGetString(GL_RENDERER) << "\",\n"
+     << "  \"width\": " << width << ", \"height\": " << height
+     << ", \"frames\": " << frames << ", \"warmup\": " << warmup << ",\n"
+     << "  \"scenes\": [\n";
+  for (size_t s = 0; s < selected.size(); ++s) {
+    FrameTimes times = runScene(*selected[s], context, warmup, frames);
+    os << "    {\"name\": \"" << selected[s]->name << "\",\n"
+       << "     \"cpu_ms\": ";
+    writeJson(os, summarize(times.cpu));
+    os << ",\n     \"gpu_ms\": ";
+    writeJson(os, summarize(times.gpu));
+    os << ",\n     \"state_calls_per_frame\": {\"issued\": " << double(times.stateIssued)/frames
+       << ", \"skipped\": " << double(times.stateSkipped)/frames << "}";
+    os << "}" << (s + 1 < selected.size() ? "," : "") << "\n";
+    if (not output.empty())
+      std::cout << selected[s]->name << " done" << std::endl;
+  }
+  const ProgramCache::Stats& cache = ProgramCache::global().stats;
+  os << "  ],\n  \"program_cache\": {\"hits\": " << cache.hits << ", \"hit_ms\": " << cache.hitSeconds*1000.0
+     << ", \"misses\": " << cache.misses << ", \"miss_ms\": " << cache.missSeconds*1000.0
+     << ", \"rejected\": " << cache.rejected << "}\n}" << std::endl;
+  // stdout is the JSON otherwise
+  if (not output.empty()) ProgramCache::global().report(std::cout);
+  return 0;
+}
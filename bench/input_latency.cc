@@ -0,0 +1,200 @@
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "../lib/headless.hh"
+#include "../lib/shader.hh"
+#include "../lib/state_cache.hh"
+#include "../lib/latency.hh"
+#include "../lib/render_thread.hh"
+#include "program.hh"
+// event to present latency of a synthetic input stream, rendered the way
+// MainLoop does it and on a RenderThread
+//   input_latency [seconds] [events per second] [triangles] [handler us]
+// A thread stands in for the window system and delivers events at random
+// times. In the single threaded loop they wait in an event queue until
+// the next poll, as in glfwPollEvents, and the handler runs in the loop
+// like a key callback. On the render thread the main thread stamps and
+// posts them. Each event costs [handler us] of busy work to handle, and
+// presenting is glFinish.
+
+namespace {
+  const GLchar* vertexSource = "#version 330 core\n"
+    "layout (location = 0) in vec2 position;"
+    "void main() {"
+    "gl_Position = vec4(position, 0.0, 1.0);"
+    "}";
+  const GLchar* fragmentSource = "#version 330 core\n"
+    "out vec4 color;"
+    "void main() {"
+    "color = vec4(1.0f, .5f, .2f, 1.0f);"
+    "}";
+
+  void spin(double microseconds) {
+    uint64_t end = latency::now() + uint64_t(microseconds*1000.0);
+    while (latency::now() < end) {}
+  }
+
+  // delivers cursor events with exponential gaps until stopped
+  class Input {
+    public:
+      Input(double rate, const std::function<void(const InputEvent&)>& deliver)
+        : deliver(deliver), rate(rate), stopping(false) {
+        this->thread = std::thread(&Input::run, this);
+      }
+      ~Input() {
+        this->stopping = true;
+        this->thread.join();
+      }
+
+    private:
+      std::function<void(const InputEvent&)> deliver;
+      double rate;
+      std::atomic<bool> stopping;
+      std::thread thread;
+
+      void run() {
+        std::mt19937 random(7);
+        std::exponential_distribution<double> gap(this->rate);
+        while (not this->stopping) {
+          std::this_thread::sleep_for(std::chrono::duration<double>(gap(random)));
+          InputEvent e;
+          std::memset(&e, 0, sizeof(e));
+          e.type = InputEvent::CURSOR;
+          e.x = random() % 800;
+          e.y = random() % 600;
+          e.time = latency::now();
+          this->deliver(e);
+        }
+      }
+  };
+
+  struct Scene {
+    Shader* shader;
+    GLuint VAO, VBO;
+    GLsizei vertices;
+
+    void render() const {
+      glClear(GL_COLOR_BUFFER_BIT);
+      this->shader->use();
+      StateCache::global().bindVertexArray(this->VAO);
+      glDrawArrays(GL_TRIANGLES, 0, this->vertices);
+    }
+  };
+}
+
+int main(int argc, char* argv[]) {
+  double seconds = argc > 1 ? std::atof(argv[1]) : 5.0;
+  double rate = argc > 2 ? std::atof(argv[2]) : 500.0;
+  int triangles = argc > 3 ? std::atoi(argv[3]) : 10000;
+  double handler = argc > 4 ? std::atof(argv[4]) : 20.0;
+  if (seconds <= 0 or rate <= 0 or triangles <= 0 or handler < 0) {
+    std::cout << "usage: input_latency [seconds] [events per second] [triangles] [handler us]" << std::endl;
+    return 1;
+  }
+
+  HeadlessContext context(800, 600);
+  if (not context.valid()) return -1;
+  std::cout << "renderer: " << glGetString(GL_RENDERER) << std::endl;
+
+  // random small triangles all over the screen
+  std::mt19937 random(1);
+  std::uniform_real_distribution<GLfloat> position(-1.0f, 1.0f), offset(-.05f, .05f);
+  std::vector<GLfloat> vertices(6*triangles);
+  for (int i = 0; i < triangles; ++i) {
+    GLfloat x = position(random), y = position(random);
+    for (int v = 0; v < 3; ++v) {
+      vertices[6*i + 2*v] = x + offset(random);
+      vertices[6*i + 2*v + 1] = y + offset(random);
+    }
+  }
+  GLuint built = buildProgram(vertexSource, fragmentSource);
+  if (built == 0) return 1;
+  Shader shader(built);
+  Scene scene = { &shader, 0, 0, 3*triangles };
+  StateCache& state = StateCache::global();
+  glGenVertexArrays(1, &scene.VAO);
+  glGenBuffers(1, &scene.VBO);
+  state.bindVertexArray(scene.VAO);
+  state.bindBuffer(GL_ARRAY_BUFFER, scene.VBO);
+  glBufferData(GL_ARRAY_BUFFER, vertices.size()*sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2*sizeof(GLfloat), (GLvoid *)0);
+  glEnableVertexAttribArray(0);
+  std::cout << triangles << " triangles, " << rate << " events/s, " << handler << " us per event" << std::endl;
+
+  {
+    // the single threaded loop: poll, handle, render, present
+    std::mutex mutex;
+    std::deque<InputEvent> pending;
+    std::vector<unsigned> sinceArrival, sincePoll;
+    double maxArrival = 0, maxPoll = 0;
+    unsigned frames = 0;
+    Input input(rate, [&](const InputEvent& e) {
+      std::lock_guard<std::mutex> lock(mutex);
+      pending.push_back(e);
+    });
+    std::vector<uint64_t> arrived, polled;
+    uint64_t end = latency::now() + uint64_t(seconds*1e9);
+    while (latency::now() < end) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t now = latency::now();
+        for (size_t i = 0; i < pending.size(); ++i) {
+          arrived.push_back(pending[i].time);
+          polled.push_back(now);
+        }
+        pending.clear();
+      }
+      for (size_t i = 0; i < arrived.size(); ++i) spin(handler);
+      scene.render();
+      glFinish();
+      uint64_t presented = latency::now();
+      for (size_t i = 0; i < arrived.size(); ++i) {
+        double a = (presented - arrived[i])*1e-6, p = (presented - polled[i])*1e-6;
+        latency::add(sinceArrival, a);
+        latency::add(sincePoll, p);
+        maxArrival = std::max(maxArrival, a);
+        maxPoll = std::max(maxPoll, p);
+      }
+      arrived.clear();
+      polled.clear();
+      ++frames;
+    }
+    std::cout << "main loop: " << frames << " frames in " << seconds << " s" << std::endl
+              << "main loop, from arrival: ";
+    latency::report(std::cout, sinceArrival, maxArrival);
+    std::cout << "main loop, from poll as MainLoop sees it: ";
+    latency::report(std::cout, sincePoll, maxPoll);
+  }
+
+  {
+    RenderThread::Context threadContext;
+    threadContext.attach = [&]() { context.makeCurrent(); };
+    threadContext.detach = [&]() { context.makeCurrent(EGL_NO_CONTEXT); };
+    threadContext.present = []() { glFinish(); };
+    RenderThread thread(threadContext);
+    context.makeCurrent(EGL_NO_CONTEXT);
+    thread.start([&](const InputEvent&) { spin(handler); }, [&]() { scene.render(); });
+    {
+      Input input(rate, [&](const InputEvent& e) { thread.post(e); });
+      std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    }
+    thread.stop();
+    context.makeCurrent();
+    thread.report(std::cout);
+  }
+
+  glDeleteVertexArrays(1, &scene.VAO);
+  glDeleteBuffers(1, &scene.VBO);
+  glDeleteProgram(shader.Program);
+  return 0;
+}
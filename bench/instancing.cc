@@ -0,0 +1,137 @@
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include "../lib/headless.hh"
+#include "../lib/shader.hh"
+#include "../lib/instance_buffer.hh"
+#include "../lib/state_cache.hh"
+#include "program.hh"
+// frame time of N copies of a triangle, each with its own offset and color:
+// one instanced draw reading a per instance buffer versus a uniform update
+// and a draw per copy
+//   instancing [max copies]
+// sweeps 1000, 10000, ... up to max copies (1000000 by default), run it
+// from the repository root, it loads instancing/*
+
+namespace {
+  // least measured time per point, in seconds
+  const double MIN_SECONDS = 0.5;
+
+  const GLchar* uniformVertexSource = "#version 330 core\n"
+    "layout (location = 0) in vec3 position;"
+    "uniform float scale;"
+    "uniform vec2 offset;"
+    "uniform vec3 tint;"
+    "out vec3 ourColor;"
+    "void main() {"
+    "gl_Position = vec4(position.xy*scale + offset, position.z, 1.0);"
+    "ourColor = tint;"
+    "}";
+  const GLchar* fragmentSource = "#version 330 core\n"
+    "in vec3 ourColor;"
+    "out vec4 color;"
+    "void main() {"
+    "color = vec4(ourColor, 1.0f);"
+    "}";
+
+  // milliseconds per frame, drawing frame() until MIN_SECONDS have passed
+  template <typename Frame>
+  double frameTime(Frame frame) {
+    frame();
+    glFinish();
+    int frames = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    double seconds = 0;
+    while (seconds < MIN_SECONDS) {
+      frame();
+      glFinish();
+      ++frames;
+      seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return seconds*1000.0/frames;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  int most = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+  HeadlessContext context(800, 600);
+  if (not context.valid()) return -1;
+  std::cout << "renderer: " << glGetString(GL_RENDERER) << std::endl;
+  StateCache& state = StateCache::global();
+
+  Shader instanced("instancing/instancing.vs", "instancing/instancing.frag");
+  GLint instancedScale = instanced.uniform("scale");
+  GLuint built = buildProgram(uniformVertexSource, fragmentSource);
+  if (built == 0) return 1;
+  Shader uniforms(built);
+  GLint uniformScale = uniforms.uniform("scale");
+  GLint uniformOffset = uniforms.uniform("offset");
+  GLint uniformTint = uniforms.uniform("tint");
+
+  const GLfloat triangle[] = { -1.0f, -1.0f, .0f,  1.0f, -1.0f, .0f,  .0f, 1.0f, .0f };
+  GLuint VAO, VBO;
+  glGenVertexArrays(1, &VAO);
+  glGenBuffers(1, &VBO);
+  state.bindVertexArray(VAO);
+  state.bindBuffer(GL_ARRAY_BUFFER, VBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(triangle), triangle, GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(GLfloat), (GLvoid *)0);
+  glEnableVertexAttribArray(0);
+  // the uniform path keeps the divisor attributes disabled in its own VAO
+  GLuint plainVAO;
+  glGenVertexArrays(1, &plainVAO);
+  state.bindVertexArray(plainVAO);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(GLfloat), (GLvoid *)0);
+  glEnableVertexAttribArray(0);
+
+  InstanceBuffer instances(std::vector<GLint>{2, 3}, 1);
+  instances.attach(VAO);
+
+  for (int count = 1000; count <= most; count *= 10) {
+    int side = std::ceil(std::sqrt(double(count)));
+    std::vector<GLfloat> data(5*count);
+    for (int i = 0; i < count; ++i) {
+      GLfloat u = (i % side + .5f)/side, v = (i / side + .5f)/side;
+      GLfloat* instance = &data[5*i];
+      instance[0] = 2.0f*u - 1.0f;
+      instance[1] = 2.0f*v - 1.0f;
+      instance[2] = u;
+      instance[3] = v;
+      instance[4] = 1.0f - u;
+    }
+    GLfloat scale = 0.8f/side;
+
+    // the instance data is uploaded every frame, as if it moved
+    double instancedMs = frameTime([&]() {
+      glClear(GL_COLOR_BUFFER_BIT);
+      instances.upload(data.data(), count);
+      instanced.use();
+      instanced.set(instancedScale, scale);
+      instances.drawArrays(VAO, GL_TRIANGLES, 0, 3);
+    });
+    double uniformMs = frameTime([&]() {
+      glClear(GL_COLOR_BUFFER_BIT);
+      uniforms.use();
+      uniforms.set(uniformScale, scale);
+      state.bindVertexArray(plainVAO);
+      for (int i = 0; i < count; ++i) {
+        const GLfloat* instance = &data[5*i];
+        uniforms.set(uniformOffset, instance[0], instance[1]);
+        uniforms.set(uniformTint, instance[2], instance[3], instance[4]);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+      }
+    });
+    std::cout << count << " copies: instanced " << instancedMs << " ms/frame, uniforms "
+              << uniformMs << " ms/frame (" << uniformMs/instancedMs << "x)" << std::endl;
+  }
+
+  glDeleteVertexArrays(1, &VAO);
+  glDeleteVertexArrays(1, &plainVAO);
+  glDeleteBuffers(1, &VBO);
+  glDeleteProgram(instanced.Program);
+  glDeleteProgram(uniforms.Program);
+  return 0;
+}
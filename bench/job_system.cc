@@ -0,0 +1,187 @@
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <thread>
+#include <vector>
+#include "../lib/job_system.hh"
+// the JobSystem against starting a std::thread per task, on three kinds
+// of per-frame work, at 1, 2, 4 and every thread
+//   job_system [tasks] [runs] [max threads]
+// fan out: [tasks] jobs of about 5 us under one parent, then wait on it.
+// fine grained: parallelFor over 1M cheap items at several grain sizes,
+// the baseline starting a thread per grain. imbalance: [tasks] tasks where
+// one in 16 costs 64 times the others, all at the front, against a static
+// split into one contiguous range per thread. Times are the median of
+// [runs] and every schedule must come to the same checksum.
+
+namespace {
+  // the per-task busy work, a result so it is not optimized out
+  uint32_t work(uint32_t seed, int iterations) {
+    uint32_t x = seed*2654435761u + 1;
+    for (int i = 0; i < iterations; ++i) x = x*1664525u + 1013904223u;
+    return x;
+  }
+
+  double median(std::vector<double> times) {
+    std::sort(times.begin(), times.end());
+    return times[times.size()/2];
+  }
+
+  // runs one schedule runs times, milliseconds of the median run
+  double measure(int runs, const std::function<uint64_t()>& schedule, uint64_t expected, bool& ok) {
+    std::vector<double> times;
+    for (int r = 0; r < runs; ++r) {
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      uint64_t sum = schedule();
+      times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+      if (sum != expected) ok = false;
+    }
+    return median(times);
+  }
+
+  // a thread per task, started all at once and joined
+  uint64_t threadPerTask(size_t tasks, const std::function<uint64_t(size_t)>& task) {
+    std::vector<uint64_t> results(tasks);
+    std::vector<std::thread> threads;
+    threads.reserve(tasks);
+    for (size_t i = 0; i < tasks; ++i) threads.push_back(std::thread([&, i]() { results[i] = task(i); }));
+    for (size_t i = 0; i < tasks; ++i) threads[i].join();
+    uint64_t sum = 0;
+    for (size_t i = 0; i < tasks; ++i) sum += results[i];
+    return sum;
+  }
+
+  const int FAN_OUT_WORK = 2000;    // about 5 us
+  const int CHEAP_WORK = 8;
+  const int LIGHT_WORK = 500, HEAVY_WORK = 64*500;
+  const size_t FINE_ITEMS = 1000000;
+  const size_t MAX_THREADS_PER_TASK = 10000;
+
+  int imbalanced(size_t i, size_t tasks) {
+    return i < tasks/16 ? HEAVY_WORK : LIGHT_WORK;
+  }
+
+  void report(const char* name, double ms) {
+    std::cout << "  " << name << ": " << ms << " ms" << std::endl;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  int tasks = argc > 1 ? std::atoi(argv[1]) : 2000;
+  int runs = argc > 2 ? std::atoi(argv[2]) : 9;
+  unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  unsigned maxThreads = argc > 3 ? std::atoi(argv[3]) : std::max(4u, cores);
+  if (tasks <= 0 or runs <= 0 or maxThreads == 0) {
+    std::cout << "usage: job_system [tasks] [runs] [max threads]" << std::endl;
+    return 1;
+  }
+  std::cout << tasks << " tasks, median of " << runs << " runs, " << cores << " cores" << std::endl;
+  std::vector<unsigned> counts;
+  for (unsigned n = 1; n <= maxThreads; n *= 2) counts.push_back(n);
+  if (counts.back() != maxThreads) counts.push_back(maxThreads);
+
+  // the expected sums, serially
+  uint64_t fanOutSum = 0, fineSum = 0, imbalanceSum = 0;
+  for (int i = 0; i < tasks; ++i) fanOutSum += work(i, FAN_OUT_WORK);
+  for (size_t i = 0; i < FINE_ITEMS; ++i) fineSum += work(i, CHEAP_WORK);
+  for (int i = 0; i < tasks; ++i) imbalanceSum += work(i, imbalanced(i, tasks));
+  bool ok = true;
+
+  std::cout << "fan out / fan in:" << std::endl;
+  report("thread per task", measure(runs, [&]() {
+    return threadPerTask(tasks, [](size_t i) { return uint64_t(work(i, FAN_OUT_WORK)); });
+  }, fanOutSum, ok));
+  for (size_t c = 0; c < counts.size(); ++c) {
+    JobSystem jobs(counts[c]);
+    std::vector<uint32_t> results(tasks);
+    double ms = measure(runs, [&]() {
+      JobSystem::Job* parent = jobs.create([]() {});
+      for (int i = 0; i < tasks; ++i) {
+        uint32_t* result = &results[i];
+        jobs.run(jobs.create([result, i]() { *result = work(i, FAN_OUT_WORK); }, parent));
+      }
+      jobs.run(parent);
+      jobs.wait(parent);
+      uint64_t sum = 0;
+      for (int i = 0; i < tasks; ++i) sum += results[i];
+      return sum;
+    }, fanOutSum, ok);
+    JobSystem::Counters counters = jobs.endFrame();
+    std::cout << "  job system, " << counts[c] << " threads: " << ms << " ms, "
+              << counters.stolen/runs << " of " << counters.executed/runs << " jobs stolen" << std::endl;
+  }
+
+  std::cout << "fine grained, " << FINE_ITEMS << " items:" << std::endl;
+  size_t grains[] = { 16, 256, 4096 };
+  for (int g = 0; g < 3; ++g) {
+    size_t grain = grains[g];
+    size_t chunks = (FINE_ITEMS + grain - 1)/grain;
+    if (chunks > MAX_THREADS_PER_TASK)
+      std::cout << "  thread per task, grain " << grain << ": skipped, " << chunks << " threads" << std::endl;
+    else {
+      std::cout << "  thread per task, grain " << grain << ": " << measure(runs, [&]() {
+        return threadPerTask(chunks, [grain](size_t chunk) {
+          uint64_t sum = 0;
+          for (size_t i = chunk*grain; i < std::min((chunk + 1)*grain, FINE_ITEMS); ++i) sum += work(i, CHEAP_WORK);
+          return sum;
+        });
+      }, fineSum, ok) << " ms" << std::endl;
+    }
+  }
+  for (size_t c = 0; c < counts.size(); ++c) {
+    JobSystem jobs(counts[c]);
+    std::cout << "  job system, " << counts[c] << " threads, grain";
+    for (int g = 0; g < 3; ++g) {
+      size_t grain = grains[g];
+      double ms = measure(runs, [&]() {
+        std::atomic<uint64_t> sum(0);
+        jobs.parallelFor(FINE_ITEMS, grain, [&](size_t begin, size_t end) {
+          uint64_t s = 0;
+          for (size_t i = begin; i < end; ++i) s += work(i, CHEAP_WORK);
+          sum.fetch_add(s, std::memory_order_relaxed);
+        });
+        return sum.load();
+      }, fineSum, ok);
+      std::cout << " " << grain << ": " << ms << " ms" << (g < 2 ? "," : "");
+    }
+    std::cout << std::endl;
+  }
+
+  std::cout << "imbalance, 1 in 16 tasks " << HEAVY_WORK/LIGHT_WORK << "x heavier:" << std::endl;
+  report("thread per task", measure(runs, [&]() {
+    return threadPerTask(tasks, [&](size_t i) { return uint64_t(work(i, imbalanced(i, tasks))); });
+  }, imbalanceSum, ok));
+  for (size_t c = 0; c < counts.size(); ++c) {
+    unsigned n = counts[c];
+    double split = measure(runs, [&]() {
+      // one contiguous range per thread, the first gets every heavy task
+      return threadPerTask(n, [&](size_t t) {
+        uint64_t sum = 0;
+        for (size_t i = t*tasks/n; i < (t + 1)*tasks/n; ++i) sum += work(i, imbalanced(i, tasks));
+        return sum;
+      });
+    }, imbalanceSum, ok);
+    JobSystem jobs(n);
+    double stealing = measure(runs, [&]() {
+      std::atomic<uint64_t> sum(0);
+      jobs.parallelFor(tasks, 1, [&](size_t begin, size_t end) {
+        uint64_t s = 0;
+        for (size_t i = begin; i < end; ++i) s += work(i, imbalanced(i, tasks));
+        sum.fetch_add(s, std::memory_order_relaxed);
+      });
+      return sum.load();
+    }, imbalanceSum, ok);
+    std::cout << "  " << n << " threads: static split " << split << " ms, job system " << stealing << " ms" << std::endl;
+  }
+
+  if (not ok) {
+    std::cout << "ERROR::JOB_SYSTEM::CHECKSUM_MISMATCH" << std::endl;
+    return 1;
+  }
+  std::cout << "checksums match" << std::endl;
+  return 0;
+}
@@ -0,0 +1,148 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../lib/headless.hh"
+#include "../lib/state_cache.hh"
+#include "../lib/obj_loader.hh"
+#include "../lib/mesh_file.hh"
+// time from a file on disk to a mesh in GPU buffers: parsing the OBJ text
+// versus mapping the converted mesh file and uploading straight from it,
+// with the files dropped from the page cache (cold) and read before (warm)
+//   mesh_loading [triangles] [runs] [file.obj]
+// without a file, a sphere with normals and texture coordinates is
+// written to a temporary directory
+
+namespace {
+  void writeSphere(const std::string& path, long triangles) {
+    long rings = std::max(2L, long(std::sqrt(triangles/4.0)));
+    long segments = std::max(3L, triangles/(2*rings));
+    FILE* file = std::fopen(path.c_str(), "w");
+    std::fprintf(file, "# %ld x %ld sphere\no sphere\n", rings, segments);
+    for (long r = 0; r <= rings; ++r)
+      for (long s = 0; s <= segments; ++s) {
+        double theta = M_PI*r/rings, phi = 2*M_PI*s/segments;
+        double x = std::sin(theta)*std::cos(phi), y = std::cos(theta), z = std::sin(theta)*std::sin(phi);
+        std::fprintf(file, "v %f %f %f\nvn %f %f %f\nvt %f %f\n", x, y, z, x, y, z,
+                     double(s)/segments, double(r)/rings);
+      }
+    for (long r = 0; r < rings; ++r)
+      for (long s = 0; s < segments; ++s) {
+        long a = r*(segments + 1) + s + 1, b = a + segments + 1;
+        std::fprintf(file, "f %ld/%ld/%ld %ld/%ld/%ld %ld/%ld/%ld %ld/%ld/%ld\n",
+                     a, a, a, b, b, b, b + 1, b + 1, b + 1, a + 1, a + 1, a + 1);
+      }
+    std::fclose(file);
+  }
+
+  // out of the page cache, so the next load reads the disk
+  void evict(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+  }
+
+  double uploadObj(const std::string& path) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    ObjMesh mesh;
+    if (not loadObj(path, mesh)) return -1;
+    StateCache& state = StateCache::global();
+    GLuint VAO, buffers[2];
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(2, buffers);
+    state.bindVertexArray(VAO);
+    state.bindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size()*sizeof(GLfloat), mesh.vertices.data(), GL_STATIC_DRAW);
+    state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size()*sizeof(GLuint), mesh.indices.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, mesh.stride()*sizeof(GLfloat), (GLvoid *)0);
+    glEnableVertexAttribArray(0);
+    glFinish();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(2, buffers);
+    state.invalidate();
+    return ms;
+  }
+
+  double uploadMesh(const std::string& path) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    MeshFile file(path);
+    if (file.upload() == 0) return -1;
+    glFinish();
+    file.unmap();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  double median(std::vector<double> times) {
+    std::sort(times.begin(), times.end());
+    return times[times.size()/2];
+  }
+
+  long fileSize(const std::string& path) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) return 0;
+    std::fseek(file, 0, SEEK_END);
+    long size = std::ftell(file);
+    std::fclose(file);
+    return size;
+  }
+
+  void measure(const char* name, const std::string& path, double (*load)(const std::string&), int runs) {
+    std::vector<double> cold, warm;
+    for (int i = 0; i < runs; ++i) {
+      evict(path);
+      cold.push_back(load(path));
+      warm.push_back(load(path));
+    }
+    std::cout << name << fileSize(path)/(1024.0*1024.0) << " MB, cold " << median(cold)
+              << " ms, warm " << median(warm) << " ms" << std::endl;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  long triangles = argc > 1 ? std::atol(argv[1]) : 1000000;
+  int runs = argc > 2 ? std::atoi(argv[2]) : 5;
+  if (triangles <= 0 or runs <= 0) {
+    std::cout << "usage: mesh_loading [triangles] [runs] [file.obj]" << std::endl;
+    return 1;
+  }
+
+  char directory[] = "/tmp/mesh_loadingXXXXXX";
+  if (mkdtemp(directory) == nullptr) {
+    std::cout << "ERROR::MESH_LOADING::NO_TEMPORARY_DIRECTORY" << std::endl;
+    return -1;
+  }
+  std::string obj = argc > 3 ? argv[3] : std::string(directory) + "/sphere.obj";
+  std::string fp32 = std::string(directory) + "/fp32.mesh";
+  std::string packed = std::string(directory) + "/packed.mesh";
+  if (argc <= 3) writeSphere(obj, triangles);
+
+  HeadlessContext context(800, 600);
+  if (not context.valid()) return -1;
+  std::cout << "renderer: " << glGetString(GL_RENDERER) << std::endl;
+
+  ObjMesh mesh;
+  if (not loadObj(obj, mesh)) return -1;
+  std::cout << mesh.indices.size()/3 << " triangles, " << mesh.vertexCount() << " vertices" << std::endl;
+  writeObjAsMeshFile(mesh, fp32, false);
+  writeObjAsMeshFile(mesh, packed, true);
+
+  measure("obj parse + upload:       ", obj, uploadObj, runs);
+  measure("fp32 mesh map + upload:   ", fp32, uploadMesh, runs);
+  measure("packed mesh map + upload: ", packed, uploadMesh, runs);
+
+  if (argc <= 3) std::remove(obj.c_str());
+  std::remove(fp32.c_str());
+  std::remove(packed.c_str());
+  rmdir(directory);
+  return 0;
+}
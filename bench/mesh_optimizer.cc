@@ -0,0 +1,121 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+#include "../lib/mesh_optimizer.hh"
+// A UV sphere with its triangles and vertices shuffled, like a mesh out
+// of an exporter that does not care, run through every optimizer stage:
+// ACMR (vertex shader runs per triangle) and vertex fetch before and
+// after, and the time on one thread and on all of them
+//   mesh_optimizer [triangles] [threads]
+
+namespace {
+  const unsigned CACHE_SIZE = 16;
+
+  struct Mesh {
+    std::vector<GLfloat> positions;  // xyz
+    std::vector<GLuint> indices;
+    size_t vertexCount() const { return positions.size()/3; }
+  };
+
+  Mesh sphere(size_t triangles) {
+    size_t rings = std::max<size_t>(2, std::sqrt(triangles/4.0));
+    size_t segments = std::max<size_t>(3, triangles/(2*rings));
+    Mesh mesh;
+    for (size_t r = 0; r <= rings; ++r) {
+      double theta = M_PI*r/rings;
+      for (size_t s = 0; s <= segments; ++s) {
+        double phi = 2*M_PI*s/segments;
+        mesh.positions.push_back(std::sin(theta)*std::cos(phi));
+        mesh.positions.push_back(std::cos(theta));
+        mesh.positions.push_back(std::sin(theta)*std::sin(phi));
+      }
+    }
+    for (size_t r = 0; r < rings; ++r)
+      for (size_t s = 0; s < segments; ++s) {
+        GLuint a = r*(segments + 1) + s, b = a + segments + 1;
+        const GLuint quad[] = { a, b, a + 1,  a + 1, b, b + 1 };
+        mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+      }
+    return mesh;
+  }
+
+  void shuffle(Mesh& mesh) {
+    std::mt19937 random(42);
+    size_t vertices = mesh.vertexCount(), triangles = mesh.indices.size()/3;
+    std::vector<GLuint> order(vertices);
+    for (size_t v = 0; v < vertices; ++v) order[v] = v;
+    std::shuffle(order.begin(), order.end(), random);
+    std::vector<GLfloat> positions(mesh.positions.size());
+    for (size_t v = 0; v < vertices; ++v)
+      std::copy(&mesh.positions[v*3], &mesh.positions[v*3] + 3, &positions[order[v]*3]);
+    mesh.positions.swap(positions);
+    for (size_t i = 0; i < mesh.indices.size(); ++i) mesh.indices[i] = order[mesh.indices[i]];
+
+    std::vector<GLuint> triangleOrder(triangles);
+    for (size_t t = 0; t < triangles; ++t) triangleOrder[t] = t;
+    std::shuffle(triangleOrder.begin(), triangleOrder.end(), random);
+    std::vector<GLuint> indices(mesh.indices.size());
+    for (size_t t = 0; t < triangles; ++t)
+      std::copy(&mesh.indices[triangleOrder[t]*3], &mesh.indices[triangleOrder[t]*3] + 3, &indices[t*3]);
+    mesh.indices.swap(indices);
+  }
+
+  void report(const char* stage, const Mesh& mesh) {
+    VertexCacheStats stats = analyzeVertexCache(&mesh.indices[0], mesh.indices.size(), mesh.vertexCount(), CACHE_SIZE);
+    double fetch = analyzeVertexFetch(&mesh.indices[0], mesh.indices.size(), mesh.vertexCount(), 3*sizeof(GLfloat));
+    std::cout << stage << "ACMR " << stats.acmr << ", ATVR " << stats.atvr
+              << ", vertex fetch " << fetch << "x" << std::endl;
+  }
+
+  double milliseconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  }
+}
+
+int main(int argc, char* argv[]) {
+  long triangles = argc > 1 ? std::atol(argv[1]) : 2000000;
+  int threads = argc > 2 ? std::atoi(argv[2]) : std::thread::hardware_concurrency();
+  if (triangles <= 0 or threads <= 0) {
+    std::cout << "usage: mesh_optimizer [triangles] [threads]" << std::endl;
+    return 1;
+  }
+
+  Mesh mesh = sphere(triangles);
+  std::cout << mesh.indices.size()/3 << " triangles, " << mesh.vertexCount() << " vertices, "
+            << CACHE_SIZE << " entry cache" << std::endl;
+  report("scan order:    ", mesh);
+  shuffle(mesh);
+  report("shuffled:      ", mesh);
+
+  std::vector<GLuint> single(mesh.indices.size());
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  optimizeVertexCache(&single[0], &mesh.indices[0], mesh.indices.size(), mesh.vertexCount(), CACHE_SIZE, 1);
+  double singleMs = milliseconds(start);
+  start = std::chrono::steady_clock::now();
+  optimizeVertexCache(&mesh.indices[0], &mesh.indices[0], mesh.indices.size(), mesh.vertexCount(), CACHE_SIZE, threads);
+  double parallelMs = milliseconds(start);
+  if (single != mesh.indices) std::cout << "ERROR::MESH_OPTIMIZER::THREADS_CHANGED_THE_RESULT" << std::endl;
+  report("vertex cache:  ", mesh);
+  std::cout << "  " << singleMs << " ms on 1 thread, " << parallelMs << " ms on " << threads << std::endl;
+
+  start = std::chrono::steady_clock::now();
+  optimizeOverdraw(&mesh.indices[0], &mesh.indices[0], mesh.indices.size(),
+                   &mesh.positions[0], 3, mesh.vertexCount(), 1.05f, CACHE_SIZE);
+  double overdrawMs = milliseconds(start);
+  report("overdraw:      ", mesh);
+  std::cout << "  " << overdrawMs << " ms" << std::endl;
+
+  start = std::chrono::steady_clock::now();
+  size_t used = optimizeVertexFetch(&mesh.positions[0], &mesh.indices[0], mesh.indices.size(),
+                                    &mesh.positions[0], mesh.vertexCount(), 3*sizeof(GLfloat));
+  double fetchMs = milliseconds(start);
+  mesh.positions.resize(used*3);
+  report("vertex fetch:  ", mesh);
+  std::cout << "  " << fetchMs << " ms, " << used << " vertices used" << std::endl;
+  return 0;
+}
@@ -0,0 +1,132 @@
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+#include "../lib/headless.hh"
+#include "../lib/mesh_batch.hh"
+#include "../lib/state_cache.hh"
+#include "program.hh"
+// objects drawn per second with one VAO and one draw call per object, the
+// way hello_triangle_ex2 does it, versus one MeshBatch and a multi draw
+//   multi_draw [max objects]
+// sweeps 2, 10, 100, ... up to max objects (100000 by default), for
+// triangles (glMultiDrawArrays) and indexed quads
+// (glMultiDrawElementsBaseVertex)
+
+namespace {
+  // least measured time per point, in seconds
+  const double MIN_SECONDS = 0.25;
+
+  const GLchar* vertexSource = "#version 330 core\n"
+    "layout (location = 0) in vec3 position;"
+    "void main() {"
+    "gl_Position = vec4(position, 1.0);"
+    "}";
+  const GLchar* fragmentSource = "#version 330 core\n"
+    "out vec4 color;"
+    "void main() {"
+    "color = vec4(1.0f, .5f, .2f, 1.0f);"
+    "}";
+
+  // a tiny triangle or quad somewhere on screen, size is a few pixels
+  void object(int index, bool quad, std::vector<GLfloat>& vertices) {
+    GLfloat x = (index % 317)/158.5f - 1.0f;
+    GLfloat y = (index % 251)/125.5f - 1.0f;
+    GLfloat s = 0.01f;
+    GLfloat triangle[] = { x, y, .0f,  x + s, y, .0f,  x, y + s, .0f };
+    GLfloat square[] = { x, y, .0f,  x + s, y, .0f,  x + s, y + s, .0f,  x, y + s, .0f };
+    if (quad) vertices.assign(square, square + 12);
+    else vertices.assign(triangle, triangle + 9);
+  }
+  const GLuint quadIndices[] = { 0, 1, 2, 2, 3, 0 };
+
+  // objects per second, drawing frame() until MIN_SECONDS have passed
+  template <typename Frame>
+  double rate(int objects, Frame frame) {
+    frame();
+    glFinish();
+    int frames = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    double seconds = 0;
+    while (seconds < MIN_SECONDS) {
+      frame();
+      glFinish();
+      ++frames;
+      seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return double(objects)*frames/seconds;
+  }
+
+  void sweep(int objects, bool quad) {
+    StateCache& state = StateCache::global();
+    std::vector<GLfloat> vertices;
+
+    // one VAO per object
+    std::vector<GLuint> vaos(objects), buffers(quad ? 2*objects : objects);
+    glGenVertexArrays(objects, vaos.data());
+    glGenBuffers(buffers.size(), buffers.data());
+    for (int i = 0; i < objects; ++i) {
+      object(i, quad, vertices);
+      state.bindVertexArray(vaos[i]);
+      state.bindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+      glBufferData(GL_ARRAY_BUFFER, vertices.size()*sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
+      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(GLfloat), (GLvoid *)0);
+      glEnableVertexAttribArray(0);
+      if (quad) {
+        state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[objects + i]);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(quadIndices), quadIndices, GL_STATIC_DRAW);
+      }
+    }
+    double separate = rate(objects, [&]() {
+      glClear(GL_COLOR_BUFFER_BIT);
+      for (int i = 0; i < objects; ++i) {
+        state.bindVertexArray(vaos[i]);
+        if (quad) glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        else glDrawArrays(GL_TRIANGLES, 0, 3);
+      }
+    });
+    glDeleteVertexArrays(objects, vaos.data());
+    glDeleteBuffers(buffers.size(), buffers.data());
+    state.invalidate();
+
+    // one batch
+    double batched;
+    {
+      MeshBatch batch(std::vector<GLint>(1, 3));
+      for (int i = 0; i < objects; ++i) {
+        object(i, quad, vertices);
+        if (quad) batch.add(vertices.data(), 4, quadIndices, 6);
+        else batch.add(vertices.data(), 3);
+      }
+      batch.upload();
+      batched = rate(objects, [&]() {
+        glClear(GL_COLOR_BUFFER_BIT);
+        batch.draw();
+      });
+    }
+
+    std::cout << (quad ? "quads     " : "triangles ") << objects << " objects: "
+              << separate/1e6 << " M/s separate, " << batched/1e6 << " M/s batched ("
+              << batched/separate << "x)" << std::endl;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  int most = argc > 1 ? std::atoi(argv[1]) : 100000;
+
+  HeadlessContext context(512, 512);
+  if (not context.valid()) return -1;
+  std::cout << "renderer: " << glGetString(GL_RENDERER) << std::endl;
+
+  GLuint shader = buildProgram(vertexSource, fragmentSource);
+  if (shader == 0) return 1;
+  StateCache::global().useProgram(shader);
+  for (int quad = 0; quad < 2; ++quad) {
+    std::vector<int> counts(1, 2);
+    for (int n = 10; n <= most; n *= 10) counts.push_back(n);
+    if (counts.back() != most and most > 2) counts.push_back(most);
+    for (size_t i = 0; i < counts.size(); ++i) sweep(counts[i], quad == 1);
+  }
+  glDeleteProgram(shader);
+  return 0;
+}
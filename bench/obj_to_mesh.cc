@@ -0,0 +1,56 @@
+#include <iostream>
+#include <chrono>
+#include <string>
+#include "../lib/obj_loader.hh"
+#include "../lib/mesh_file.hh"
+#include "../lib/mesh_optimizer.hh"
+// convert a Wavefront OBJ to the binary mesh format of lib/mesh_file.hh
+//   obj_to_mesh [--packed] [--no-optimize] input.obj output.mesh
+// --packed stores normals as 10:10:10:2 and texture coordinates as half
+// floats; --no-optimize keeps the triangle and vertex order of the file
+
+void usage() {
+  std::cout << "usage: obj_to_mesh [--packed] [--no-optimize] input.obj output.mesh" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  bool packed = false, optimize = true;
+  std::string input, output;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--packed") packed = true;
+    else if (arg == "--no-optimize") optimize = false;
+    else if (input.empty()) input = arg;
+    else if (output.empty()) output = arg;
+    else {
+      usage();
+      return 1;
+    }
+  }
+  if (output.empty()) {
+    usage();
+    return 1;
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  ObjMesh mesh;
+  if (not loadObj(input, mesh)) return -1;
+  double parseMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  size_t vertexCount = mesh.vertexCount();
+  VertexCacheStats before = analyzeVertexCache(&mesh.indices[0], mesh.indices.size(), vertexCount);
+
+  start = std::chrono::steady_clock::now();
+  if (not writeObjAsMeshFile(mesh, output, packed, optimize)) return -1;
+  double writeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  VertexCacheStats after = analyzeVertexCache(&mesh.indices[0], mesh.indices.size(), mesh.vertexCount());
+
+  MeshFile file(output);
+  if (not file.valid()) return -1;
+  std::cout << input << ": " << mesh.indices.size()/3 << " triangles, " << vertexCount << " vertices, "
+            << mesh.groups.size() << " groups, parsed in " << parseMs << " ms" << std::endl;
+  std::cout << output << ": " << file.info().vertexCount << " vertices of " << file.info().vertexSize << " bytes, "
+            << (file.indexType() == GL_UNSIGNED_SHORT ? 16 : 32) << " bit indices, "
+            << file.fileSize() << " bytes, ACMR " << before.acmr << " -> " << after.acmr
+            << ", written in " << writeMs << " ms" << std::endl;
+  return 0;
+}
@@ -0,0 +1,126 @@
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "../lib/headless.hh"
+#include "../lib/shader.hh"
+#include "../lib/shader_library.hh"
+// total wall time to build N programs one Shader at a time versus all at
+// once through ShaderLibrary
+//   parallel_compile [N]
+// every run generates fresh sources so no driver or program cache can hit;
+// on Mesa also set MESA_SHADER_CACHE_DISABLE=true
+
+namespace {
+  // A vertex/fragment pair that is a little more than trivial to compile
+  void writeProgram(const std::string& directory, int index, unsigned salt,
+                    std::string& vertexPath, std::string& fragmentPath) {
+    char name[64];
+    std::snprintf(name, sizeof(name), "/p%d", index);
+    vertexPath = directory + name + ".vs";
+    fragmentPath = directory + name + ".frag";
+
+    FILE* vs = std::fopen(vertexPath.c_str(), "w");
+    std::fprintf(vs,
+      "#version 330 core\n"
+      "layout (location = 0) in vec3 position;\n"
+      "out vec3 ourColor;\n"
+      "void main() {\n"
+      "  vec3 p = position;\n"
+      "  for (int i = 0; i < 8; ++i) p = p*%u.0/%u.0 + sin(p.yzx*%d.0);\n"
+      "  gl_Position = vec4(position, 1.0);\n"
+      "  ourColor = p;\n"
+      "}\n", salt % 97 + 1, salt % 89 + 1, index);
+    std::fclose(vs);
+
+    FILE* fs = std::fopen(fragmentPath.c_str(), "w");
+    std::fprintf(fs,
+      "#version 330 core\n"
+      "in vec3 ourColor;\n"
+      "out vec4 color;\n"
+      "void main() {\n"
+      "  vec3 c = ourColor;\n"
+      "  for (int i = 0; i < 8; ++i) c = fract(c*%d.0 + cos(c.zxy));\n"
+      "  color = vec4(c, 1.0);\n"
+      "}\n", index + (int)(salt % 1000));
+    std::fclose(fs);
+  }
+
+  double seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+}
+
+int main(int argc, char* argv[]) {
+  int count = argc > 1 ? std::atoi(argv[1]) : 64;
+  // measure the compiler, not our binary cache
+  setenv("LEARNOPENGL_SHADER_CACHE", "", 1);
+
+  HeadlessContext context(64, 64);
+  if (not context.valid()) return -1;
+  std::cout << "renderer: " << glGetString(GL_RENDERER) << std::endl;
+  std::cout << "KHR_parallel_shader_compile: " << (GLEW_KHR_parallel_shader_compile ? "yes" : "no") << std::endl;
+
+  char directory[] = "/tmp/parallel_compile.XXXXXX";
+  if (mkdtemp(directory) == nullptr) {
+    std::cout << "Cannot create a temporary directory" << std::endl;
+    return 1;
+  }
+  unsigned salt = std::chrono::steady_clock::now().time_since_epoch().count();
+  std::vector<std::string> vertexPaths(2*count), fragmentPaths(2*count);
+  for (int i = 0; i < 2*count; ++i)
+    writeProgram(directory, i, salt, vertexPaths[i], fragmentPaths[i]);
+
+  // serial: the Shader constructor blocks on each compile status
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::vector<GLuint> programs;
+  for (int i = 0; i < count; ++i) {
+    Shader shader(vertexPaths[i].c_str(), fragmentPaths[i].c_str());
+    programs.push_back(shader.Program);
+  }
+  glFinish();
+  double serial = seconds(start);
+
+  // parallel: submit everything, then keep "rendering" with the fallback
+  start = std::chrono::steady_clock::now();
+  double blocked = 0;
+  int frames = 0;
+  {
+    ShaderLibrary library;
+    for (int i = count; i < 2*count; ++i)
+      library.add(vertexPaths[i].c_str(), fragmentPaths[i].c_str());
+    std::chrono::steady_clock::time_point submitStart = std::chrono::steady_clock::now();
+    library.submit();
+    blocked = seconds(submitStart);
+    for (;;) {
+      std::chrono::steady_clock::time_point pollStart = std::chrono::steady_clock::now();
+      bool done = library.poll();
+      blocked += seconds(pollStart);
+      if (done) break;
+      // a frame drawn with whatever is ready
+      library.get(frames % count).use();
+      glClear(GL_COLOR_BUFFER_BIT);
+      glFlush();
+      ++frames;
+    }
+    glFinish();
+  }
+  double parallel = seconds(start);
+
+  for (size_t i = 0; i < programs.size(); ++i) glDeleteProgram(programs[i]);
+  for (int i = 0; i < 2*count; ++i) {
+    std::remove(vertexPaths[i].c_str());
+    std::remove(fragmentPaths[i].c_str());
+  }
+  rmdir(directory);
+
+  std::cout << count << " programs" << std::endl;
+  std::cout << "serial:   " << serial*1000.0 << " ms" << std::endl;
+  std::cout << "parallel: " << parallel*1000.0 << " ms (calling thread blocked "
+            << blocked*1000.0 << " ms, " << frames << " fallback frames)" << std::endl;
+  std::cout << "speedup:  " << serial/parallel << "x" << std::endl;
+  return 0;
+}
@@ -0,0 +1,49 @@
+#include "program.hh"
+
+#include <iostream>
+
+namespace {
+  // 0 if the stage does not compile
+  GLuint compile(GLenum type, const GLchar* source) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    GLint success;
+    GLchar infoLog[512];
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+      glGetShaderInfoLog(shader, 512, NULL, infoLog);
+      std::cout << "ERROR::SHADER::" << (type == GL_VERTEX_SHADER ? "VERTEX" : "FRAGMENT")
+                << "::COMPILATION_FAILED\n" << infoLog << std::endl;
+      glDeleteShader(shader);
+      return 0;
+    }
+    return shader;
+  }
+}
+
+GLuint buildProgram(const GLchar* vertexSource, const GLchar* fragmentSource) {
+  GLuint vertex = compile(GL_VERTEX_SHADER, vertexSource);
+  GLuint fragment = compile(GL_FRAGMENT_SHADER, fragmentSource);
+  if (vertex == 0 or fragment == 0) {
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+    return 0;
+  }
+  GLuint program = glCreateProgram();
+  glAttachShader(program, vertex);
+  glAttachShader(program, fragment);
+  glLinkProgram(program);
+  glDeleteShader(vertex);
+  glDeleteShader(fragment);
+  GLint success;
+  GLchar infoLog[512];
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (!success) {
+    glGetProgramInfoLog(program, 512, NULL, infoLog);
+    std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+    glDeleteProgram(program);
+    return 0;
+  }
+  return program;
+}
@@ -0,0 +1,11 @@
+#ifndef PROGRAM_H
+#define PROGRAM_H
+
+#include <GL/glew.h>
+
+// Compile and link a vertex and a fragment shader. A stage that does not
+// compile or a program that does not link prints its info log and gives
+// 0, so a bench stops instead of timing a program that draws nothing.
+GLuint buildProgram(const GLchar* vertexSource, const GLchar* fragmentSource);
+
+#endif
@@ -0,0 +1,99 @@
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <ftw.h>
+#include <unistd.h>
+#include "../lib/headless.hh"
+#include "../lib/shader.hh"
+#include "../lib/program_cache.hh"
+// startup time of the sample programs through the program binary cache:
+// a cold run on an empty cache directory, then warm runs that load the
+// binaries it stored
+//   program_cache [runs]
+// run it from the repository root, it builds shaders/* and instancing/*.
+// Mesa's own shader cache goes to an empty directory too, so the cold run
+// compiles (turning it off would also turn off program binaries).
+
+namespace {
+  const char* programs[][2] = {
+    { "shaders/shader4.vs", "shaders/shader4.frag" },
+    { "shaders/shader_ex1.vs", "shaders/shader_ex1.frag" },
+    { "shaders/shader_ex2.vs", "shaders/shader_ex2.frag" },
+    { "shaders/shader_ex3.vs", "shaders/shader_ex3.frag" },
+    { "instancing/instancing.vs", "instancing/instancing.frag" }
+  };
+  const int PROGRAMS = sizeof(programs)/sizeof(programs[0]);
+
+  // Build every program as the samples do at startup, in ms
+  double startup() {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<GLuint> built;
+    for (int i = 0; i < PROGRAMS; ++i) {
+      Shader shader(programs[i][0], programs[i][1]);
+      built.push_back(shader.Program);
+    }
+    glFinish();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    for (size_t i = 0; i < built.size(); ++i) glDeleteProgram(built[i]);
+    return ms;
+  }
+
+  int removeEntry(const char* path, const struct stat*, int, struct FTW*) {
+    std::remove(path);
+    return 0;
+  }
+
+  // rm -r
+  void removeDirectory(const std::string& directory) {
+    nftw(directory.c_str(), removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+  }
+}
+
+int main(int argc, char* argv[]) {
+  int runs = argc > 1 ? std::atoi(argv[1]) : 5;
+  if (runs <= 0) {
+    std::cout << "usage: program_cache [runs]" << std::endl;
+    return 1;
+  }
+  char directory[] = "/tmp/program_cache.XXXXXX";
+  if (mkdtemp(directory) == nullptr) {
+    std::cout << "Cannot create a temporary directory" << std::endl;
+    return 1;
+  }
+  // before the first use of the global cache and the context
+  std::string programsDirectory = std::string(directory) + "/programs";
+  std::string mesaDirectory = std::string(directory) + "/mesa";
+  setenv("LEARNOPENGL_SHADER_CACHE", programsDirectory.c_str(), 1);
+  setenv("MESA_SHADER_CACHE_DIR", mesaDirectory.c_str(), 1);
+  setenv("MESA_GLSL_CACHE_DIR", mesaDirectory.c_str(), 1);
+
+  HeadlessContext context(64, 64);
+  if (not context.valid()) {
+    removeDirectory(directory);
+    return -1;
+  }
+  std::cout << "renderer: " << glGetString(GL_RENDERER) << std::endl;
+  ProgramCache& cache = ProgramCache::global();
+  if (not cache.enabled()) {
+    std::cout << "no program binary formats, nothing to cache" << std::endl;
+    removeDirectory(directory);
+    return 0;
+  }
+
+  double cold = startup();
+  unsigned stored = cache.stats.stores;
+  double warm = 0;
+  for (int r = 0; r < runs; ++r) warm += startup();
+  warm /= runs;
+
+  std::cout << PROGRAMS << " programs" << std::endl;
+  std::cout << "cold: " << cold << " ms, " << stored << " binaries stored" << std::endl;
+  std::cout << "warm: " << warm << " ms, mean of " << runs << " runs" << std::endl;
+  std::cout << "speedup: " << cold/warm << "x" << std::endl;
+  cache.report(std::cout);
+  removeDirectory(directory);
+  return 0;
+}
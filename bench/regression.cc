@@ -0,0 +1,225 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sched.h>
+#include "runner.hh"
+// frame time regression check of the sample scenes against a baseline
+//   regression record [options] BASELINE [scene...]
+//   regression compare [options] BASELINE [scene...]
+// record runs every scene --runs times and stores each run's trimmed mean
+// frame time in BASELINE; compare runs them again and exits with 2 when
+// any scene is slower than its baseline both significantly (one sided
+// Mann-Whitney U over the runs, p < --alpha) and by more than --threshold
+// percent of the median run. Frames of one run are not independent
+// samples, runs are: with the default 10 runs a side a clean separation
+// gives p = 5e-6, while 5 a side could not go below 0.004.
+// options:
+//   --frames N      measured frames per run (300)
+//   --warmup N      frames dropped before each run (60)
+//   --runs N        runs per scene, interleaved across scenes (10)
+//   --trim F        fraction of each run dropped at either end (0.05)
+//   --alpha P       significance level (0.01)
+//   --threshold PCT smallest slowdown of the median run reported (5)
+//   --metric M      cpu, gpu or both (both)
+//   --cpu N[,N..]   pin to these cores
+//   --size WxH      framebuffer size (800x600)
+// run it from the repository root, the scenes load shaders/*
+
+namespace {
+  struct Options {
+    int frames, warmup, runs;
+    double trim, alpha, threshold;
+    bool cpu, gpu;
+    int width, height;
+  };
+
+  // trimmed mean frame time of every run of one scene
+  struct Samples {
+    std::vector<double> cpu, gpu;
+  };
+  typedef std::map<std::string, Samples> Results;
+
+  void usage() {
+    std::cout << "usage: regression record|compare [--frames N] [--warmup N] [--runs N] [--trim F]"
+                 " [--alpha P] [--threshold PCT] [--metric cpu|gpu|both] [--cpu N[,N..]] [--size WxH]"
+                 " BASELINE [scene...]" << std::endl;
+  }
+
+  bool pin(const std::string& list) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    std::istringstream cores(list);
+    std::string core;
+    while (std::getline(cores, core, ',')) CPU_SET(std::atoi(core.c_str()), &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+      std::cout << "ERROR::REGRESSION::CANNOT_PIN " << list << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  // Round robin over the scenes for every run, so slow drift of the host
+  // hits all of them alike instead of whichever ran last
+  Results measure(const std::vector<const Scene*>& selected, const Options& options, HeadlessContext& context) {
+    Results results;
+    for (int run = 0; run < options.runs; ++run)
+      for (size_t s = 0; s < selected.size(); ++s) {
+        FrameTimes times = runScene(*selected[s], context, options.warmup, options.frames);
+        Samples& samples = results[selected[s]->name];
+        samples.cpu.push_back(summarize(trim(times.cpu, options.trim)).mean);
+        samples.gpu.push_back(summarize(trim(times.gpu, options.trim)).mean);
+      }
+    return results;
+  }
+
+  // one "scene NAME cpu|gpu t0 t1 ..." line per scene and metric
+  bool save(const std::string& path, const Results& results, const Options& options) {
+    std::ofstream file(path.c_str());
+    file << "# frame time baseline, trimmed mean milliseconds per frame of each run\n"
+         << "renderer " << glGetString(GL_RENDERER) << "\n"
+         << "size " << options.width << "x" << options.height << "\n";
+    for (Results::const_iterator it = results.begin(); it != results.end(); ++it) {
+      file << "scene " << it->first << " cpu";
+      for (size_t i = 0; i < it->second.cpu.size(); ++i) file << " " << it->second.cpu[i];
+      file << "\nscene " << it->first << " gpu";
+      for (size_t i = 0; i < it->second.gpu.size(); ++i) file << " " << it->second.gpu[i];
+      file << "\n";
+    }
+    file.close();
+    if (not file) std::cout << "ERROR::REGRESSION::CANNOT_WRITE " << path << std::endl;
+    return bool(file);
+  }
+
+  bool load(const std::string& path, Results& results, std::string& renderer, std::string& size) {
+    std::ifstream file(path.c_str());
+    if (not file) {
+      std::cout << "ERROR::REGRESSION::CANNOT_READ " << path << std::endl;
+      return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+      std::istringstream fields(line);
+      std::string kind;
+      fields >> kind;
+      if (kind == "renderer") std::getline(fields >> std::ws, renderer);
+      else if (kind == "size") fields >> size;
+      else if (kind == "scene") {
+        std::string name, metric;
+        fields >> name >> metric;
+        std::vector<double>& samples = metric == "gpu" ? results[name].gpu : results[name].cpu;
+        double sample;
+        while (fields >> sample) samples.push_back(sample);
+      }
+    }
+    return true;
+  }
+
+  // Prints one line, true if the scene regressed
+  bool check(const std::string& name, const char* metric, const std::vector<double>& baseline,
+             const std::vector<double>& current, const Options& options) {
+    if (baseline.empty() or current.empty()) return false;
+    double before = summarize(baseline).p50, after = summarize(current).p50;
+    double change = before > 0 ? 100*(after - before)/before : 0;
+    double p = mannWhitneyGreater(current, baseline);
+    bool regressed = p < options.alpha and change > options.threshold;
+    bool improved = mannWhitneyGreater(baseline, current) < options.alpha and change < -options.threshold;
+    char text[160];
+    std::snprintf(text, sizeof(text), "%-28s %s  %zu -> %zu runs  p50 %8.4f -> %8.4f ms  %+6.1f%%  p=%.2g  %s",
+                  name.c_str(), metric, baseline.size(), current.size(), before, after, change, p,
+                  regressed ? "REGRESSED" : (improved ? "improved" : "ok"));
+    std::cout << text << std::endl;
+    return regressed;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  Options options = { 300, 60, 10, 0.05, 0.01, 5.0, true, true, 800, 600 };
+  std::string command = argc > 1 ? argv[1] : "", baselinePath;
+  std::vector<const Scene*> selected;
+  if (command != "record" and command != "compare") {
+    usage();
+    return 1;
+  }
+  for (int i = 2; i < argc; ++i) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--frames" and hasValue) options.frames = std::atoi(argv[++i]);
+    else if (arg == "--warmup" and hasValue) options.warmup = std::atoi(argv[++i]);
+    else if (arg == "--runs" and hasValue) options.runs = std::atoi(argv[++i]);
+    else if (arg == "--trim" and hasValue) options.trim = std::atof(argv[++i]);
+    else if (arg == "--alpha" and hasValue) options.alpha = std::atof(argv[++i]);
+    else if (arg == "--threshold" and hasValue) options.threshold = std::atof(argv[++i]);
+    else if (arg == "--metric" and hasValue) {
+      std::string metric = argv[++i];
+      options.cpu = metric == "cpu" or metric == "both";
+      options.gpu = metric == "gpu" or metric == "both";
+    }
+    else if (arg == "--cpu" and hasValue) {
+      if (not pin(argv[++i])) return 1;
+    }
+    else if (arg == "--size" and hasValue) {
+      if (std::sscanf(argv[++i], "%dx%d", &options.width, &options.height) != 2) {
+        usage();
+        return 1;
+      }
+    }
+    else if (arg[0] == '-') {
+      usage();
+      return 1;
+    }
+    else if (baselinePath.empty()) baselinePath = arg;
+    else {
+      const Scene* scene = findScene(arg);
+      if (scene == nullptr) {
+        std::cout << "Unknown scene " << arg << std::endl;
+        return 1;
+      }
+      selected.push_back(scene);
+    }
+  }
+  if (baselinePath.empty() or options.frames <= 0 or options.runs <= 0 or (not options.cpu and not options.gpu)) {
+    usage();
+    return 1;
+  }
+
+  Results baseline;
+  std::string renderer, size;
+  if (command == "compare" and not load(baselinePath, baseline, renderer, size)) return 1;
+  if (selected.empty()) {
+    for (size_t s = 0; s < scenes().size(); ++s)
+      if (command == "record" or baseline.count(scenes()[s].name) > 0) selected.push_back(&scenes()[s]);
+  }
+
+  HeadlessContext context(options.width, options.height);
+  if (not context.valid()) return -1;
+  std::ostringstream currentSize;
+  currentSize << options.width << "x" << options.height;
+  if (command == "compare" and (renderer != (const char*)glGetString(GL_RENDERER) or size != currentSize.str()))
+    std::cout << "warning: baseline is from " << renderer << " at " << size << std::endl;
+
+  Results current = measure(selected, options, context);
+  if (command == "record") {
+    if (not save(baselinePath, current, options)) return 1;
+    for (Results::const_iterator it = current.begin(); it != current.end(); ++it)
+      std::cout << it->first << ": median run cpu " << summarize(it->second.cpu).p50
+                << " ms, gpu " << summarize(it->second.gpu).p50 << " ms" << std::endl;
+    return 0;
+  }
+
+  int regressions = 0;
+  for (Results::const_iterator it = current.begin(); it != current.end(); ++it) {
+    const Samples& before = baseline[it->first];
+    if (options.cpu) regressions += check(it->first, "cpu", before.cpu, it->second.cpu, options);
+    if (options.gpu) regressions += check(it->first, "gpu", before.gpu, it->second.gpu, options);
+  }
+  if (regressions > 0) {
+    std::cout << regressions << " regression" << (regressions > 1 ? "s" : "") << std::endl;
+    return 2;
+  }
+  return 0;
+}
@@ -0,0 +1,231 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "../lib/headless.hh"
+#include "../lib/shader.hh"
+#include "../lib/state_cache.hh"
+#include "../lib/uniform_buffer.hh"
+#include "../lib/render_queue.hh"
+#include "program.hh"
+// draw order for 10k, 100k and 1M random draws, each with a program, a
+// material block and a vertex array out of a few, in the order they were
+// made and sorted by a RenderQueue
+//   render_queue [max draws] [frames]
+// prints the cost of building the keys and of the radix sort, next to
+// std::stable_sort of the same keys, then the state switches along each
+// order and what reaches GL through the StateCache and Shader shadows.
+// One draw in eight is in a second layer sorted back to front.
+
+namespace {
+  const int PROGRAMS = 16;
+  const int MATERIALS = 1024;
+  const int MESHES = 64;
+  const GLuint MATERIAL_BINDING = 0;
+
+  // mirrors the Material block of vertexSource
+  struct Material {
+    std140::vec4 color;
+  };
+  STD140_SIZE(Material, 16);
+
+  const GLchar* vertexSource = "#version 330 core\n"
+    "layout (location = 0) in vec2 position;"
+    "layout (std140) uniform Material {"
+    "  vec4 color;"
+    "};"
+    "uniform vec2 offset;"
+    "out vec4 ourColor;"
+    "void main() {"
+    "gl_Position = vec4(position + offset, 0.0, 1.0);"
+    "ourColor = color;"
+    "}";
+  const GLchar* fragmentSource = "#version 330 core\n"
+    "in vec4 ourColor;"
+    "out vec4 color;"
+    "void main() {"
+    "color = ourColor;"
+    "}";
+
+  struct Draw {
+    int layer, program, material, mesh;
+    GLfloat depth;
+    GLfloat x, y;
+  };
+
+  struct Scene {
+    std::vector<Shader*> shaders;
+    std::vector<GLint> offsetHandles;
+    std::vector<GLuint> vaos, vbos;
+    std::vector<GLintptr> materials;
+    UniformBuffer* buffer;
+  };
+
+  std::vector<Draw> generate(int count) {
+    std::mt19937 random(3);
+    std::uniform_real_distribution<GLfloat> unit(0.0f, 1.0f);
+    std::vector<Draw> draws(count);
+    for (int i = 0; i < count; ++i) {
+      Draw& d = draws[i];
+      d.layer = random() % 8 == 0 ? 1 : 0;
+      d.program = random() % PROGRAMS;
+      d.material = random() % MATERIALS;
+      d.mesh = random() % MESHES;
+      d.depth = unit(random);
+      d.x = 2.0f*unit(random) - 1.0f;
+      d.y = 2.0f*unit(random) - 1.0f;
+    }
+    return draws;
+  }
+
+  void build(const std::vector<Draw>& draws, RenderQueue& queue) {
+    queue.clear();
+    for (size_t i = 0; i < draws.size(); ++i) {
+      const Draw& d = draws[i];
+      GLfloat depth = d.layer == 0 ? d.depth : 1.0f - d.depth;
+      queue.push(RenderQueue::key(d.layer, d.program, d.material, d.mesh, depth), i);
+    }
+  }
+
+  void submit(const Scene& s, const std::vector<Draw>& draws, const RenderQueue* queue) {
+    StateCache& state = StateCache::global();
+    for (size_t i = 0; i < draws.size(); ++i) {
+      const Draw& d = draws[queue != nullptr ? (*queue)[i].index : i];
+      Shader& shader = *s.shaders[d.program];
+      shader.use();
+      state.bindVertexArray(s.vaos[d.mesh]);
+      s.buffer->bind<Material>(MATERIAL_BINDING, s.materials[d.material]);
+      shader.set(s.offsetHandles[d.program], d.x, d.y);
+      glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+  }
+
+  typedef std::chrono::steady_clock Clock;
+  double since(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  }
+
+  double median(std::vector<double> times) {
+    std::sort(times.begin(), times.end());
+    return times[times.size()/2];
+  }
+}
+
+int main(int argc, char* argv[]) {
+  int maxDraws = argc > 1 ? std::atoi(argv[1]) : 1000000;
+  int frames = argc > 2 ? std::atoi(argv[2]) : 3;
+  if (maxDraws <= 0 or frames <= 0) {
+    std::cout << "usage: render_queue [max draws] [frames]" << std::endl;
+    return 1;
+  }
+
+  HeadlessContext context(256, 256);
+  if (not context.valid()) return -1;
+  std::cout << "renderer: " << glGetString(GL_RENDERER) << std::endl;
+  StateCache& state = StateCache::global();
+
+  Scene scene;
+  Shader::bindBlock("Material", MATERIAL_BINDING);
+  for (int p = 0; p < PROGRAMS; ++p) {
+    GLuint built = buildProgram(vertexSource, fragmentSource);
+    if (built == 0) return 1;
+    scene.shaders.push_back(new Shader(built));
+    scene.offsetHandles.push_back(scene.shaders[p]->uniform("offset"));
+  }
+  scene.vaos.resize(MESHES);
+  scene.vbos.resize(MESHES);
+  glGenVertexArrays(MESHES, scene.vaos.data());
+  glGenBuffers(MESHES, scene.vbos.data());
+  for (int m = 0; m < MESHES; ++m) {
+    GLfloat s = .01f + .0005f*m;
+    const GLfloat triangle[] = { -s, -s,  s, -s,  0, s };
+    state.bindVertexArray(scene.vaos[m]);
+    state.bindBuffer(GL_ARRAY_BUFFER, scene.vbos[m]);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(triangle), triangle, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2*sizeof(GLfloat), (GLvoid *)0);
+    glEnableVertexAttribArray(0);
+  }
+  UniformBuffer buffer(GLsizeiptr(MATERIALS)*256);
+  scene.buffer = &buffer;
+  for (int i = 0; i < MATERIALS; ++i) {
+    Material material;
+    material.color.x = (i % 8)/7.0f;
+    material.color.y = (i/8 % 8)/7.0f;
+    material.color.z = (i/64 % 16)/15.0f;
+    material.color.w = 1.0f;
+    scene.materials.push_back(buffer.add(material));
+  }
+  buffer.upload();
+  std::printf("%d programs, %d materials, %d meshes, median of %d frames\n", PROGRAMS, MATERIALS, MESHES, frames);
+
+  for (int count = 10000; count <= maxDraws; count *= 10) {
+    std::vector<Draw> draws = generate(count);
+    RenderQueue queue;
+    queue.reserve(count);
+
+    // sort cost, the radix sort against std::stable_sort of the same keys
+    std::vector<double> keyTimes, radixTimes, stdTimes;
+    bool same = true;
+    for (int f = 0; f < frames; ++f) {
+      Clock::time_point start = Clock::now();
+      build(draws, queue);
+      keyTimes.push_back(since(start));
+      std::vector<RenderQueue::Entry> entries(count);
+      for (int i = 0; i < count; ++i) entries[i] = queue[i];
+      start = Clock::now();
+      queue.sort();
+      radixTimes.push_back(since(start));
+      start = Clock::now();
+      std::stable_sort(entries.begin(), entries.end(), [](const RenderQueue::Entry& a, const RenderQueue::Entry& b) {
+        return a.key < b.key;
+      });
+      stdTimes.push_back(since(start));
+      for (int i = 0; i < count; ++i) same = same and entries[i].index == queue[i].index;
+    }
+    std::printf("%d draws: keys %.2f ms, radix sort %.2f ms, std::stable_sort %.2f ms%s\n",
+                count, median(keyTimes), median(radixTimes), median(stdTimes), same ? "" : ", ORDER DIFFERS");
+
+    // switches along the order the draws were made in, then sorted
+    for (int pass = 0; pass < 2; ++pass) {
+      bool sorted = pass == 1;
+      build(draws, queue);
+      if (sorted) queue.sort();
+      RenderQueue::Changes changes = queue.changes();
+      std::vector<double> times;
+      StateCache::Counters calls = StateCache::Counters();
+      Shader::UniformCounters uniforms = Shader::UniformCounters();
+      state.invalidate();
+      state.endFrame();
+      Shader::endFrame();
+      for (int f = 0; f < frames; ++f) {
+        glClear(GL_COLOR_BUFFER_BIT);
+        Clock::time_point start = Clock::now();
+        submit(scene, draws, sorted ? &queue : nullptr);
+        glFinish();
+        times.push_back(since(start));
+        StateCache::Counters c = state.endFrame();
+        Shader::UniformCounters u = Shader::endFrame();
+        calls.issued += c.issued;
+        calls.skipped += c.skipped;
+        uniforms.issued += u.issued;
+        uniforms.elided += u.elided;
+      }
+      std::printf("  %s %u program, %u material, %u vao switches; binds %u/%u, uniforms %u/%u issued/skipped, "
+                  "submit %.2f ms per frame\n",
+                  sorted ? "sorted:  " : "unsorted:", changes.program, changes.material, changes.vao,
+                  calls.issued/frames, calls.skipped/frames, uniforms.issued/frames, uniforms.elided/frames,
+                  median(times));
+    }
+  }
+
+  for (int p = 0; p < PROGRAMS; ++p) {
+    glDeleteProgram(scene.shaders[p]->Program);
+    delete scene.shaders[p];
+  }
+  glDeleteVertexArrays(MESHES, scene.vaos.data());
+  glDeleteBuffers(MESHES, scene.vbos.data());
+  return 0;
+}
@@ -0,0 +1,144 @@
+#include "runner.hh"
+#include "../lib/state_cache.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace {
+  // frames between a query being issued and its result being read
+  const int QUERY_DEPTH = 4;
+  // simulated time step, the samples animate with glfwGetTime()
+  const GLfloat FRAME_TIME = 1.0f/60.0f;
+
+  // P(U >= u) when all orders of n1 and n2 samples are equally likely.
+  // counts[j][v] is the number of orders of i a's and j b's where v pairs
+  // have the a above the b; the largest sample is either an a, above all
+  // j b's, or a b.
+  double exactUpperTail(size_t n1, size_t n2, double u) {
+    size_t most = n1*n2;
+    std::vector<std::vector<double> > counts(n2 + 1, std::vector<double>(most + 1, 0.0)), next = counts;
+    for (size_t j = 0; j <= n2; ++j) counts[j][0] = 1;  // no a's
+    for (size_t i = 1; i <= n1; ++i) {
+      next[0].assign(most + 1, 0.0);
+      next[0][0] = 1;
+      for (size_t j = 1; j <= n2; ++j)
+        for (size_t v = 0; v <= i*j; ++v)
+          next[j][v] = (v >= j ? counts[j][v - j] : 0.0) + next[j - 1][v];
+      counts.swap(next);
+    }
+    double total = 0, tail = 0;
+    for (size_t v = 0; v <= most; ++v) {
+      total += counts[n2][v];
+      if (v >= u) tail += counts[n2][v];
+    }
+    return tail/total;
+  }
+}
+
+FrameTimes runScene(const Scene& scene, HeadlessContext& context, int warmup, int frames) {
+  FrameTimes times;
+  times.stateIssued = times.stateSkipped = 0;
+  times.cpu.reserve(frames);
+  times.gpu.reserve(frames);
+
+  context.makeCurrent();
+  scene.setup();
+  // setup binds are not part of any frame
+  StateCache::global().endFrame();
+
+  GLuint queries[QUERY_DEPTH];
+  glGenQueries(QUERY_DEPTH, queries);
+
+  int total = warmup + frames;
+  for (int i = 0; i < total; ++i) {
+    GLuint query = queries[i % QUERY_DEPTH];
+    // collect the result of the frame that used this query last
+    if (i >= QUERY_DEPTH) {
+      GLuint64 elapsed;
+      glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+      if (i - QUERY_DEPTH >= warmup) times.gpu.push_back(elapsed/1e6);
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    scene.draw(i*FRAME_TIME);
+    glEndQuery(GL_TIME_ELAPSED);
+    glFlush();
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    StateCache::Counters state = StateCache::global().endFrame();
+    if (i >= warmup) {
+      times.cpu.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+      times.stateIssued += state.issued;
+      times.stateSkipped += state.skipped;
+    }
+  }
+  // drain the queries still in flight
+  for (int i = std::max(total - QUERY_DEPTH, 0); i < total; ++i) {
+    GLuint64 elapsed;
+    glGetQueryObjectui64v(queries[i % QUERY_DEPTH], GL_QUERY_RESULT, &elapsed);
+    if (i >= warmup) times.gpu.push_back(elapsed/1e6);
+  }
+
+  glDeleteQueries(QUERY_DEPTH, queries);
+  scene.teardown();
+  return times;
+}
+
+Distribution summarize(std::vector<double> samples) {
+  Distribution d = { 0, 0, 0, 0, 0, 0 };
+  if (samples.empty()) return d;
+  std::sort(samples.begin(), samples.end());
+  double sum = 0;
+  for (size_t i = 0; i < samples.size(); ++i) sum += samples[i];
+  d.mean = sum/samples.size();
+  d.min = samples.front();
+  d.max = samples.back();
+  // nearest rank: smallest sample with at least p% of samples at or below it
+  size_t n = samples.size();
+  d.p50 = samples[std::max<size_t>(std::ceil(0.50*n), 1) - 1];
+  d.p95 = samples[std::max<size_t>(std::ceil(0.95*n), 1) - 1];
+  d.p99 = samples[std::max<size_t>(std::ceil(0.99*n), 1) - 1];
+  return d;
+}
+
+void writeJson(std::ostream& os, const Distribution& d) {
+  os << "{\"mean\": " << d.mean << ", \"min\": " << d.min << ", \"max\": " << d.max
+     << ", \"p50\": " << d.p50 << ", \"p95\": " << d.p95 << ", \"p99\": " << d.p99 << "}";
+}
+
+std::vector<double> trim(std::vector<double> samples, double fraction) {
+  std::sort(samples.begin(), samples.end());
+  size_t drop = size_t(samples.size()*fraction);
+  if (2*drop >= samples.size()) return samples;
+  return std::vector<double>(samples.begin() + drop, samples.end() - drop);
+}
+
+double mannWhitneyGreater(const std::vector<double>& a, const std::vector<double>& b) {
+  size_t n1 = a.size(), n2 = b.size(), n = n1 + n2;
+  if (n1 == 0 or n2 == 0) return 1.0;
+  // rank everything together, ties get the mean of their ranks
+  std::vector<std::pair<double, bool> > all;
+  all.reserve(n);
+  for (size_t i = 0; i < n1; ++i) all.push_back(std::make_pair(a[i], true));
+  for (size_t i = 0; i < n2; ++i) all.push_back(std::make_pair(b[i], false));
+  std::sort(all.begin(), all.end());
+  double rankSum = 0, ties = 0;
+  for (size_t i = 0; i < n;) {
+    size_t j = i;
+    while (j < n and all[j].first == all[i].first) ++j;
+    double rank = (i + 1 + j)/2.0;
+    for (size_t k = i; k < j; ++k) if (all[k].second) rankSum += rank;
+    double t = j - i;
+    ties += t*t*t - t;
+    i = j;
+  }
+  double u = rankSum - n1*(n1 + 1)/2.0;
+  if (ties == 0 and n1 <= 30 and n2 <= 30) return exactUpperTail(n1, n2, u);
+  double mean = n1*double(n2)/2;
+  double variance = n1*double(n2)/12*((n + 1) - ties/(double(n)*(n - 1)));
+  if (variance <= 0) return 1.0;
+  // continuity correction towards the mean
+  double z = (u - mean - 0.5)/std::sqrt(variance);
+  return 0.5*std::erfc(z/std::sqrt(2.0));
+}
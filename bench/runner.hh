@@ -0,0 +1,43 @@
+#ifndef RUNNER_H
+#define RUNNER_H
+
+#include <vector>
+#include <iostream>
+
+#include "scenes.hh"
+#include "../lib/headless.hh"
+
+// Per frame timings of one scene, in milliseconds
+struct FrameTimes {
+  std::vector<double> cpu;  // wall time to submit the frame
+  std::vector<double> gpu;  // GL_TIME_ELAPSED of the frame
+  // StateCache calls over the measured frames
+  unsigned stateIssued, stateSkipped;
+};
+
+struct Distribution {
+  double mean, min, max;
+  double p50, p95, p99;
+};
+
+// Render warmup + frames frames of scene into the context framebuffer.
+// GPU times are read back through a ring of queries a few frames deep so
+// the measurement never waits on the frame it just submitted.
+FrameTimes runScene(const Scene& scene, HeadlessContext& context, int warmup, int frames);
+
+// Nearest rank percentiles, samples is taken by value because it is sorted
+Distribution summarize(std::vector<double> samples);
+// {"mean": .., "min": .., "max": .., "p50": .., "p95": .., "p99": ..}
+void writeJson(std::ostream& os, const Distribution& d);
+
+// samples without the fraction lowest and the fraction highest of them,
+// sorted
+std::vector<double> trim(std::vector<double> samples, double fraction);
+// One sided Mann-Whitney U test: the p-value of samples of a being no
+// larger than samples of b. Small means a is very likely slower. The
+// samples must be independent, so one value per run, not frame times of
+// the same run. Exact for up to 30 samples a side without ties, otherwise
+// the normal approximation with tie correction.
+double mannWhitneyGreater(const std::vector<double>& a, const std::vector<double>& b);
+
+#endif
@@ -0,0 +1,386 @@
+#include "scenes.hh"
+#include "program.hh"
+#include "../lib/shader.hh"
+#include "../lib/state_cache.hh"
+#include "../lib/mesh_batch.hh"
+#include "../lib/instance_buffer.hh"
+
+#include <cmath>
+#include <iostream>
+
+namespace {
+  // objects created by the current scene
+  std::vector<GLuint> programs, vaos, buffers;
+  Shader* shader = nullptr;
+  MeshBatch* batch = nullptr;
+  InstanceBuffer* instances = nullptr;
+  GLfloat instanceScale = 1.0f;
+  GLint uniform = -1;
+
+  const GLchar* orangeVS = "#version 330 core\n"
+    "layout (location = 0) in vec3 position;"
+    "void main() {"
+    "gl_Position = vec4(position.x, position.y, position.z, 1.0);"
+    "}";
+  const GLchar* orangeFS = "#version 330 core\n"
+    "out vec4 color;"
+    "void main() {"
+    "color = vec4(1.0f, .5f, .2f, 1.0f);"
+    "}";
+  const GLchar* greenFS = "#version 330 core\n"
+    "out vec4 color;"
+    "void main() {"
+    "color = vec4(.2f, 1.0f, .5f, 1.0f);"
+    "}";
+  const GLchar* vertexColorVS = "#version 330 core\n"
+    "layout (location = 0) in vec3 position;"
+    "out vec4 vertexColor;"
+    "void main() {"
+    "gl_Position = vec4(position, 1.0);"
+    "vertexColor = vec4(.5f, .0f, .0f, 1.0f);"
+    "}";
+  const GLchar* vertexColorFS = "#version 330 core\n"
+    "in vec4 vertexColor;"
+    "out vec4 color;"
+    "void main() {"
+    "color = vertexColor;"
+    "}";
+  const GLchar* uniformColorFS = "#version 330 core\n"
+    "out vec4 color;"
+    "uniform vec4 ourColor;"
+    "void main() {"
+    "color = ourColor;"
+    "}";
+  const GLchar* attributeColorVS = "#version 330 core\n"
+    "layout (location = 0) in vec3 position;"
+    "layout (location = 1) in vec3 color;"
+    "out vec3 ourColor;"
+    "void main() {"
+    "gl_Position = vec4(position, 1.0);"
+    "ourColor = color;"
+    "}";
+  const GLchar* attributeColorFS = "#version 330 core\n"
+    "out vec4 color;"
+    "in vec3 ourColor;"
+    "void main() {"
+    "color = vec4(ourColor, 1.0f);"
+    "}";
+
+  const GLfloat triangle[] = {
+    -.5f, -.5f, .0f,
+    .5f, -.5f, .0f,
+    .0f, .5f, .0f
+  };
+  const GLfloat centered[] = {
+    -.5f, -.5f, .0f,
+    .0f, .5f, .0f,
+    .5f, -.5f, .0f
+  };
+  const GLfloat coloured[] = { // {position, color} x 3
+    -.5f, -.5f, .0f,  1.0f,  0.0f,  0.0f,
+     .0f,  .5f, .0f,  0.0f,  1.0f,  0.0f,
+     .5f, -.5f, .0f,  0.0f,  0.0f,  1.0f
+  };
+  const GLfloat rectangle[] = {
+    -.5f, -.5f, .0f,
+    -.5f, .5f, .0f,
+    .5f, .5f, .0f,
+    .5f, -.5f, .0f
+  };
+  const GLuint rectangleIndices[] = {
+    0,1,2,
+    2,3,0
+  };
+  const GLfloat twoTriangles[] = {
+    -.6f, -.5f, .0f,
+    -.6f, .5f, .0f,
+    -.1f, .0f, .0f,
+    .1f, .0f, .0f,
+    .6f, .5f, .0f,
+    .6f, -.5f, .0f
+  };
+
+  GLuint program(const GLchar* vertexSource, const GLchar* fragmentSource) {
+    GLuint program = buildProgram(vertexSource, fragmentSource);
+    if (program != 0) programs.push_back(program);
+    return program;
+  }
+
+  // VAO over a position (and optionally color) vertex buffer, with an
+  // optional element buffer
+  GLuint mesh(const GLfloat* vertices, GLsizeiptr size, bool color,
+              const GLuint* indices = nullptr, GLsizeiptr indicesSize = 0) {
+    GLuint VAO, VBO;
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    StateCache::global().bindVertexArray(VAO);
+    StateCache::global().bindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, size, vertices, GL_STATIC_DRAW);
+    GLsizei stride = (color ? 6 : 3)*sizeof(GLfloat);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid *)0);
+    glEnableVertexAttribArray(0);
+    if (color) {
+      glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid *)(3*sizeof(GLfloat)));
+      glEnableVertexAttribArray(1);
+    }
+    buffers.push_back(VBO);
+    if (indices != nullptr) {
+      GLuint EBO;
+      glGenBuffers(1, &EBO);
+      StateCache::global().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+      glBufferData(GL_ELEMENT_ARRAY_BUFFER, indicesSize, indices, GL_STATIC_DRAW);
+      buffers.push_back(EBO);
+    }
+    StateCache::global().bindVertexArray(0);
+    vaos.push_back(VAO);
+    return VAO;
+  }
+
+  void clear(GLfloat r, GLfloat g, GLfloat b) {
+    StateCache::global().clearColor(r, g, b, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+  }
+
+  void teardown() {
+    if (shader != nullptr) {
+      glDeleteProgram(shader->Program);
+      delete shader;
+      shader = nullptr;
+    }
+    delete batch;
+    batch = nullptr;
+    delete instances;
+    instances = nullptr;
+    for (size_t i = 0; i < programs.size(); ++i) glDeleteProgram(programs[i]);
+    if (not vaos.empty()) glDeleteVertexArrays(vaos.size(), vaos.data());
+    if (not buffers.empty()) glDeleteBuffers(buffers.size(), buffers.data());
+    programs.clear();
+    vaos.clear();
+    buffers.clear();
+    uniform = -1;
+    // deleted names may come back for the next scene
+    StateCache::global().invalidate();
+  }
+
+  // hello_window
+  void windowSetup() {}
+  void windowDraw(GLfloat) {
+    clear(0.2f, 0.3f, 0.3f);
+  }
+
+  // hello_triangle
+  void triangleSetup() {
+    program(orangeVS, orangeFS);
+    mesh(triangle, sizeof(triangle), false);
+  }
+  void triangleDraw(GLfloat) {
+    clear(0.0f, 0.0f, 0.4f);
+    StateCache::global().useProgram(programs[0]);
+    StateCache::global().bindVertexArray(vaos[0]);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+  }
+
+  // hello_rectangle
+  void rectangleSetup() {
+    program(orangeVS, orangeFS);
+    mesh(rectangle, sizeof(rectangle), false, rectangleIndices, sizeof(rectangleIndices));
+  }
+  void rectangleDraw(GLfloat) {
+    clear(0.2f, 0.3f, 0.3f);
+    StateCache::global().useProgram(programs[0]);
+    StateCache::global().bindVertexArray(vaos[0]);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+  }
+
+  // hello_triangle_ex1
+  void triangleEx1Setup() {
+    program(orangeVS, orangeFS);
+    mesh(twoTriangles, sizeof(twoTriangles), false);
+  }
+  void triangleEx1Draw(GLfloat) {
+    clear(0.2f, 0.3f, 0.3f);
+    StateCache::global().useProgram(programs[0]);
+    StateCache::global().bindVertexArray(vaos[0]);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+  }
+
+  // hello_triangle_ex2
+  void triangleEx2Setup() {
+    program(orangeVS, orangeFS);
+    mesh(twoTriangles, sizeof(twoTriangles)/2, false);
+    mesh(twoTriangles + 9, sizeof(twoTriangles)/2, false);
+  }
+  void triangleEx2Draw(GLfloat) {
+    clear(0.2f, 0.3f, 0.3f);
+    StateCache::global().useProgram(programs[0]);
+    StateCache::global().bindVertexArray(vaos[0]);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    StateCache::global().bindVertexArray(vaos[1]);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+  }
+
+  // hello_triangle_ex2 with both triangles in one MeshBatch
+  void triangleEx2BatchedSetup() {
+    program(orangeVS, orangeFS);
+    batch = new MeshBatch(std::vector<GLint>(1, 3));
+    batch->add(twoTriangles, 3);
+    batch->add(twoTriangles + 9, 3);
+    batch->upload();
+  }
+  void triangleEx2BatchedDraw(GLfloat) {
+    clear(0.2f, 0.3f, 0.3f);
+    StateCache::global().useProgram(programs[0]);
+    batch->draw();
+  }
+
+  // hello_triangle_ex3
+  void triangleEx3Setup() {
+    program(orangeVS, orangeFS);
+    program(orangeVS, greenFS);
+    mesh(twoTriangles, sizeof(twoTriangles), false);
+  }
+  void triangleEx3Draw(GLfloat) {
+    clear(0.2f, 0.3f, 0.3f);
+    StateCache::global().useProgram(programs[0]);
+    StateCache::global().bindVertexArray(vaos[0]);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    StateCache::global().useProgram(programs[1]);
+    glDrawArrays(GL_TRIANGLES, 3, 3);
+  }
+
+  // shaders1
+  void shaders1Setup() {
+    program(vertexColorVS, vertexColorFS);
+    mesh(centered, sizeof(centered), false);
+  }
+  void shaders1Draw(GLfloat) {
+    clear(0.2f, 0.3f, 0.3f);
+    StateCache::global().useProgram(programs[0]);
+    StateCache::global().bindVertexArray(vaos[0]);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+  }
+
+  // shaders2
+  void shaders2Setup() {
+    program(vertexColorVS, uniformColorFS);
+    mesh(centered, sizeof(centered), false);
+    uniform = glGetUniformLocation(programs[0], "ourColor");
+  }
+  void shaders2Draw(GLfloat time) {
+    clear(0.2f, 0.3f, 0.3f);
+    StateCache::global().useProgram(programs[0]);
+    GLfloat greenValue = (sin(time*2)/2) + 0.5;
+    glUniform4f(uniform, 0.0f, greenValue, 0.0f, 1.0f);
+    StateCache::global().bindVertexArray(vaos[0]);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+  }
+
+  // shaders3
+  void shaders3Setup() {
+    program(attributeColorVS, attributeColorFS);
+    mesh(coloured, sizeof(coloured), true);
+    uniform = glGetUniformLocation(programs[0], "ourColor");
+  }
+  void shaders3Draw(GLfloat time) {
+    clear(0.2f, 0.3f, 0.3f);
+    StateCache::global().useProgram(programs[0]);
+    GLfloat greenValue = (sin(time*2)/2) + 0.5;
+    glUniform4f(uniform, 0.0f, greenValue, 0.0f, 1.0f);
+    StateCache::global().bindVertexArray(vaos[0]);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+  }
+
+  // shaders4 and the exercises load their programs from shaders/
+  void shaders4Setup() {
+    shader = new Shader("shaders/shader4.vs", "shaders/shader4.frag");
+    mesh(coloured, sizeof(coloured), true);
+    uniform = shader->uniform("ourColor");
+  }
+  void shaders4Draw(GLfloat time) {
+    clear(0.2f, 0.3f, 0.3f);
+    shader->use();
+    GLfloat greenValue = (sin(time*2)/2) + 0.5;
+    shader->set(uniform, 0.0f, greenValue, 0.0f, 1.0f);
+    StateCache::global().bindVertexArray(vaos[0]);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+  }
+
+  void shadersEx1Setup() {
+    shader = new Shader("shaders/shader_ex1.vs", "shaders/shader_ex1.frag");
+    mesh(coloured, sizeof(coloured), true);
+  }
+  void shadersEx2Setup() {
+    shader = new Shader("shaders/shader_ex2.vs", "shaders/shader_ex2.frag");
+    mesh(coloured, sizeof(coloured), true);
+    uniform = shader->uniform("offset");
+  }
+  void shadersEx3Setup() {
+    shader = new Shader("shaders/shader_ex3.vs", "shaders/shader_ex3.frag");
+    mesh(centered, sizeof(centered), false);
+  }
+  void shadersExDraw(GLfloat) {
+    clear(0.2f, 0.3f, 0.3f);
+    shader->use();
+    shader->set(uniform, 0.5f);
+    StateCache::global().bindVertexArray(vaos[0]);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+  }
+
+  // instancing: a million triangles in one instanced draw
+  void instancingSetup() {
+    const int count = 1000000;
+    const int side = 1000;
+    shader = new Shader("instancing/instancing.vs", "instancing/instancing.frag");
+    mesh(triangle, sizeof(triangle), false);
+    uniform = shader->uniform("scale");
+    instanceScale = 2.0f/side;
+    std::vector<GLfloat> data(5*count);
+    for (int i = 0; i < count; ++i) {
+      GLfloat u = (i % side + .5f)/side, v = (i / side + .5f)/side;
+      GLfloat* instance = &data[5*i];
+      instance[0] = 2.0f*u - 1.0f;
+      instance[1] = 2.0f*v - 1.0f;
+      instance[2] = u;
+      instance[3] = v;
+      instance[4] = 1.0f - u;
+    }
+    instances = new InstanceBuffer(std::vector<GLint>{2, 3}, 1);
+    instances->upload(data.data(), count);
+    instances->attach(vaos[0]);
+  }
+  void instancingDraw(GLfloat) {
+    clear(0.2f, 0.3f, 0.3f);
+    shader->use();
+    shader->set(uniform, instanceScale);
+    instances->drawArrays(vaos[0], GL_TRIANGLES, 0, 3);
+  }
+}
+
+const std::vector<Scene>& scenes() {
+  static const Scene all[] = {
+    { "hello_window", windowSetup, windowDraw, teardown },
+    { "hello_triangle", triangleSetup, triangleDraw, teardown },
+    { "hello_rectangle", rectangleSetup, rectangleDraw, teardown },
+    { "hello_triangle_ex1", triangleEx1Setup, triangleEx1Draw, teardown },
+    { "hello_triangle_ex2", triangleEx2Setup, triangleEx2Draw, teardown },
+    { "hello_triangle_ex2_batched", triangleEx2BatchedSetup, triangleEx2BatchedDraw, teardown },
+    { "hello_triangle_ex3", triangleEx3Setup, triangleEx3Draw, teardown },
+    { "shaders1", shaders1Setup, shaders1Draw, teardown },
+    { "shaders2", shaders2Setup, shaders2Draw, teardown },
+    { "shaders3", shaders3Setup, shaders3Draw, teardown },
+    { "shaders4", shaders4Setup, shaders4Draw, teardown },
+    { "shaders_ex1", shadersEx1Setup, shadersExDraw, teardown },
+    { "shaders_ex2", shadersEx2Setup, shadersExDraw, teardown },
+    { "shaders_ex3", shadersEx3Setup, shadersExDraw, teardown },
+    { "instancing", instancingSetup, instancingDraw, teardown },
+  };
+  static const std::vector<Scene> list(all, all + sizeof(all)/sizeof(all[0]));
+  return list;
+}
+
+const Scene* findScene(const std::string& name) {
+  const std::vector<Scene>& list = scenes();
+  for (size_t i = 0; i < list.size(); ++i)
+    if (name == list[i].name) return &list[i];
+  return nullptr;
+}
@@ -0,0 +1,25 @@
+#ifndef SCENES_H
+#define SCENES_H
+
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+// The scene of each sample program, without its window and event loop.
+// setup() uploads geometry and builds programs on the current context,
+// draw() renders one frame into the bound framebuffer, teardown() frees
+// everything setup() created.
+struct Scene {
+  const char* name;
+  void (*setup)();
+  void (*draw)(GLfloat time);
+  void (*teardown)();
+};
+
+// Every scene, named after the sample it reproduces
+const std::vector<Scene>& scenes();
+// nullptr if there is no such scene
+const Scene* findScene(const std::string& name);
+
+#endif
@@ -0,0 +1,141 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <vector>
+#include "../lib/simd_math.hh"
+// throughput of the math kernels per SIMD version the CPU runs, on N
+// random points and N matrices
+//   simd_math [count] [runs]
+// transform: count points through an affine matrix, as x, y, z arrays,
+// and one at a time through the vec3/mat4 types for comparison. multiply:
+// a view-projection times count model matrices. chain: a hierarchy of
+// count nodes, each one's parent picked at random among the ones before.
+// bounds: box and sphere around the points. Every version is checked
+// against the scalar results; times are the median of [runs].
+
+namespace {
+  typedef std::chrono::steady_clock Clock;
+
+  double median(int runs, const std::function<void()>& work) {
+    std::vector<double> times;
+    for (int r = 0; r < runs; ++r) {
+      Clock::time_point start = Clock::now();
+      work();
+      times.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size()/2];
+  }
+
+  // largest difference relative to the magnitude of the values
+  float difference(const float* a, const float* b, size_t count) {
+    float worst = 0;
+    for (size_t i = 0; i < count; ++i)
+      worst = std::max(worst, std::fabs(a[i] - b[i])/std::max(1.0f, std::fabs(a[i])));
+    return worst;
+  }
+
+  math::mat4 randomTransform(std::mt19937& random) {
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    math::vec3 axis(unit(random), unit(random), unit(random) + 2.0f);
+    return math::translation(math::vec3(unit(random), unit(random), unit(random)))
+         * math::rotation(math::quat::axisAngle(axis, 3.0f*unit(random)))
+         * math::scaling(math::vec3(1.0f + .01f*unit(random), 1.0f, 1.0f - .01f*unit(random)));
+  }
+}
+
+int main(int argc, char* argv[]) {
+  int count = argc > 1 ? std::atoi(argv[1]) : 1000000;
+  int runs = argc > 2 ? std::atoi(argv[2]) : 11;
+  if (count <= 0 or runs <= 0) {
+    std::cout << "usage: simd_math [count] [runs]" << std::endl;
+    return 1;
+  }
+  const char* names[] = { "scalar", "sse2", "avx2" };
+#ifdef LEARNOPENGL_SSE_MATH
+  const char* types = "sse";
+#else
+  const char* types = "scalar";
+#endif
+  std::printf("%d points and matrices, median of %d runs, types on %s, best kernels %s\n",
+              count, runs, types, names[math::best()]);
+
+  std::mt19937 random(5);
+  std::uniform_real_distribution<float> unit(-100.0f, 100.0f);
+  std::vector<float> x(count), y(count), z(count);
+  for (int i = 0; i < count; ++i) {
+    x[i] = unit(random);
+    y[i] = unit(random);
+    z[i] = unit(random);
+  }
+  math::mat4 m = randomTransform(random);
+  math::mat4 viewProjection = math::perspective(1.0f, 4.0f/3.0f, .1f, 100.0f)
+                            * math::lookAt(math::vec3(0, 2, 5), math::vec3(0, 0, 0), math::vec3(0, 1, 0));
+  std::vector<math::mat4> models(count), local(count);
+  std::vector<int> parents(count);
+  for (int i = 0; i < count; ++i) {
+    models[i] = randomTransform(random);
+    local[i] = randomTransform(random);
+    // shallow trees, a root every 64 nodes
+    parents[i] = i % 64 == 0 ? -1 : i - 1 - int(random() % std::min(i % 64, 8));
+  }
+
+  // scalar references
+  std::vector<float> refX(count), refY(count), refZ(count);
+  math::transformPoints(m, x.data(), y.data(), z.data(), refX.data(), refY.data(), refZ.data(), count, math::SCALAR);
+  std::vector<math::mat4> refProducts(count), refWorld(count);
+  math::multiply(viewProjection, models.data(), refProducts.data(), count, math::SCALAR);
+  math::chain(local.data(), parents.data(), refWorld.data(), count, math::SCALAR);
+  math::Box refBox = math::bounds(x.data(), y.data(), z.data(), count, math::SCALAR);
+  math::Sphere refSphere = math::boundingSphere(x.data(), y.data(), z.data(), count, math::SCALAR);
+
+  std::vector<float> outX(count), outY(count), outZ(count);
+  double ms = median(runs, [&]() {
+    for (int i = 0; i < count; ++i) {
+      math::vec3 p = math::transformPoint(m, math::vec3(x[i], y[i], z[i]));
+      outX[i] = p.x();
+      outY[i] = p.y();
+      outZ[i] = p.z();
+    }
+  });
+  std::printf("one at a time:  transform %7.1f Mpoints/s, max difference %g\n", count/ms/1e3,
+              std::max(difference(refX.data(), outX.data(), count), difference(refZ.data(), outZ.data(), count)));
+
+  std::vector<math::mat4> products(count), world(count);
+  for (int simd = math::SCALAR; simd <= math::best(); ++simd) {
+    math::Simd s = math::Simd(simd);
+    double transformMs = median(runs, [&]() {
+      math::transformPoints(m, x.data(), y.data(), z.data(), outX.data(), outY.data(), outZ.data(), count, s);
+    });
+    float transformError = std::max(difference(refX.data(), outX.data(), count),
+                                    std::max(difference(refY.data(), outY.data(), count),
+                                             difference(refZ.data(), outZ.data(), count)));
+    double multiplyMs = median(runs, [&]() {
+      math::multiply(viewProjection, models.data(), products.data(), count, s);
+    });
+    double chainMs = median(runs, [&]() {
+      math::chain(local.data(), parents.data(), world.data(), count, s);
+    });
+    float matrixError = std::max(difference(refProducts[0].data(), products[0].data(), 16*size_t(count)),
+                                 difference(refWorld[0].data(), world[0].data(), 16*size_t(count)));
+    math::Box box;
+    double boundsMs = median(runs, [&]() { box = math::bounds(x.data(), y.data(), z.data(), count, s); });
+    math::Sphere sphere;
+    double sphereMs = median(runs, [&]() { sphere = math::boundingSphere(x.data(), y.data(), z.data(), count, s); });
+    bool sameBounds = box.min.x() == refBox.min.x() and box.max.z() == refBox.max.z()
+                      and std::fabs(sphere.radius - refSphere.radius) <= 1e-4f*refSphere.radius;
+    std::printf("%-6s kernels: transform %7.1f Mpoints/s, multiply %6.1f M/s, chain %6.1f M/s, "
+                "bounds %7.1f Mpoints/s, sphere %7.1f Mpoints/s, max difference %g%s\n",
+                names[simd], count/transformMs/1e3, count/multiplyMs/1e3, count/chainMs/1e3,
+                count/boundsMs/1e3, count/sphereMs/1e3, std::max(transformError, matrixError),
+                sameBounds ? "" : ", BOUNDS DIFFER");
+  }
+  std::printf("box (%g %g %g) - (%g %g %g), sphere radius %g\n", refBox.min.x(), refBox.min.y(), refBox.min.z(),
+              refBox.max.x(), refBox.max.y(), refBox.max.z(), refSphere.radius);
+  return 0;
+}
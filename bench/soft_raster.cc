@@ -0,0 +1,239 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+#include "../lib/headless.hh"
+#include "../lib/shader.hh"
+#include "../lib/state_cache.hh"
+#include "../lib/vertex_format.hh"
+#include "../lib/soft_raster.hh"
+// the software rasterizer against GL on the shaders4 triangle, its SIMD
+// paths against the scalar one on right triangles, then its throughput on N random perspective triangles at 1, 2, 4 and every
+// thread, and per SIMD path on every thread
+//   soft_raster [triangles] [frames]
+// run it from the repository root, the GL reference loads shaders/*
+
+// the vertex of shaders/shaders4.cc
+struct ColoredVertex {
+  vertex::vec3 position;
+  vertex::ubyte4n color;
+};
+VERTEX_FORMAT(ColoredVertex,
+  VERTEX_ATTRIBUTE(ColoredVertex, position),
+  VERTEX_ATTRIBUTE(ColoredVertex, color));
+
+namespace {
+  const int WIDTH = 800, HEIGHT = 600;
+
+  // shaders/shader4.vs
+  void shader4(const void* in, const void*, SoftRasterizer::Vertex& out) {
+    const ColoredVertex& v = *static_cast<const ColoredVertex*>(in);
+    out.position[0] = v.position.x;
+    out.position[1] = v.position.y;
+    out.position[2] = v.position.z;
+    out.position[3] = 1.0f;
+    out.varyings[0] = v.color.x/255.0f;
+    out.varyings[1] = v.color.y/255.0f;
+    out.varyings[2] = v.color.z/255.0f;
+  }
+
+  // clip space position and color, passed through
+  struct ClipVertex {
+    GLfloat position[4];
+    GLfloat color[3];
+  };
+  void passThrough(const void* in, const void*, SoftRasterizer::Vertex& out) {
+    const ClipVertex& v = *static_cast<const ClipVertex*>(in);
+    std::copy(v.position, v.position + 4, out.position);
+    std::copy(v.color, v.color + 3, out.varyings);
+  }
+
+  // The shaders4 triangle through GL and through the rasterizer
+  void compare() {
+    HeadlessContext context(WIDTH, HEIGHT);
+    if (not context.valid()) {
+      std::cout << "no GL context, skipping the reference image" << std::endl;
+      return;
+    }
+    const ColoredVertex vertices[] = {
+      { { -.5f, -.5f, .0f }, vertex::unorm8(1.0f, 0.0f, 0.0f) },
+      { {  .0f,  .5f, .0f }, vertex::unorm8(0.0f, 1.0f, 0.0f) },
+      { {  .5f, -.5f, .0f }, vertex::unorm8(0.0f, 0.0f, 1.0f) }
+    };
+    Shader shader("shaders/shader4.vs", "shaders/shader4.frag");
+    StateCache& state = StateCache::global();
+    GLuint VAO, VBO;
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    state.bindVertexArray(VAO);
+    state.bindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    setVertexFormat<ColoredVertex>();
+    state.clearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    shader.use();
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    std::vector<unsigned char> gl(WIDTH*HEIGHT*4), soft(gl.size());
+    context.readPixels(&gl[0]);
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteProgram(shader.Program);
+    state.invalidate();
+
+    SoftRasterizer raster(WIDTH, HEIGHT);
+    raster.clear(0.2f, 0.3f, 0.3f, 1.0f);
+    SoftRasterizer::Program program = { shader4, nullptr, 3 };
+    raster.draw(program, vertices, sizeof(ColoredVertex), 3);
+    raster.readPixels(&soft[0]);
+
+    // the corner is background in both
+    int covered = 0, coverage = 0, off = 0, worst = 0;
+    for (int i = 0; i < WIDTH*HEIGHT; ++i) {
+      const unsigned char* a = &gl[i*4];
+      const unsigned char* b = &soft[i*4];
+      bool inGL = a[0] != gl[0] or a[1] != gl[1] or a[2] != gl[2];
+      bool inSoft = b[0] != soft[0] or b[1] != soft[1] or b[2] != soft[2];
+      covered += inGL;
+      if (inGL != inSoft) ++coverage;
+      else {
+        int diff = 0;
+        for (int c = 0; c < 4; ++c) diff = std::max(diff, std::abs(a[c] - b[c]));
+        worst = std::max(worst, diff);
+        off += diff > 1;
+      }
+    }
+    std::cout << "shaders4 against " << glGetString(GL_RENDERER) << ": " << covered << " pixels, "
+              << coverage << " covered by one only, " << off << " off by more than 1, worst " << worst << std::endl;
+  }
+
+  // A flat colored corner of a size x size square at pixel (x, y), with
+  // the right angle at corner 0 to 3
+  void corner(std::vector<ClipVertex>& vertices, GLfloat x, GLfloat y, GLfloat size, int right, GLfloat shade) {
+    GLfloat xs[] = { x, x + size, x + size, x }, ys[] = { y, y, y + size, y + size };
+    for (int i = 0; i < 3; ++i) {
+      int k = (right + 3 + i) % 4;
+      ClipVertex v;
+      v.position[0] = xs[k]/WIDTH*2 - 1;
+      v.position[1] = ys[k]/HEIGHT*2 - 1;
+      v.position[2] = 0;
+      v.position[3] = 1;
+      v.color[0] = shade;
+      v.color[1] = 1 - shade;
+      v.color[2] = .5f;
+      vertices.push_back(v);
+    }
+  }
+
+  // Every SIMD path against the scalar one on triangles with axis aligned
+  // edges, off the lane and tile boundaries. Flat colors, so the images
+  // must match exactly.
+  bool compareSimd() {
+    std::vector<ClipVertex> vertices;
+    GLfloat sizes[] = { 3, 17, 70, 128 };
+    int n = 0;
+    for (int right = 0; right < 4; ++right)
+      for (int s = 0; s < 4; ++s) {
+        GLfloat x = 10 + 190*right + (s % 2)*.5f, y = 10 + 140*s + (right % 2)*.25f;
+        corner(vertices, x, y, sizes[s], right, (n++ % 8)/8.0f);
+        // the same corner across a tile corner, from inside the tile
+        corner(vertices, x + 53 + s, y + 61 - s, sizes[s], (right + 2) % 4, (n++ % 8)/8.0f);
+      }
+    SoftRasterizer raster(WIDTH, HEIGHT);
+    SoftRasterizer::Program program = { passThrough, nullptr, 3 };
+    std::vector<unsigned char> reference(WIDTH*HEIGHT*4), image(reference.size());
+    const char* names[] = { "scalar", "sse2", "avx2" };
+    bool same = true;
+    for (int simd = SoftRasterizer::SCALAR; simd <= SoftRasterizer::best(); ++simd) {
+      raster.setSimd(SoftRasterizer::Simd(simd));
+      raster.clear(0, 0, 0, 1);
+      raster.draw(program, &vertices[0], sizeof(ClipVertex), vertices.size());
+      raster.readPixels(simd == SoftRasterizer::SCALAR ? &reference[0] : &image[0]);
+      if (simd == SoftRasterizer::SCALAR) continue;
+      int differ = 0;
+      for (int i = 0; i < WIDTH*HEIGHT; ++i)
+        differ += std::memcmp(&reference[i*4], &image[i*4], 4) != 0;
+      std::cout << names[simd] << " against scalar on " << vertices.size()/3 << " right triangles: "
+                << differ << " pixels differ" << std::endl;
+      if (differ != 0) {
+        std::cout << "ERROR::SOFT_RASTER::IMAGES_DIFFER" << std::endl;
+        same = false;
+      }
+    }
+    return same;
+  }
+
+  // Small triangles, uniform over the screen, 1 <= w <= 3
+  std::vector<ClipVertex> scene(int triangles) {
+    std::mt19937 random(7);
+    std::uniform_real_distribution<GLfloat> unit(0.0f, 1.0f);
+    std::vector<ClipVertex> vertices;
+    for (int t = 0; t < triangles; ++t) {
+      GLfloat x = unit(random)*2 - 1, y = unit(random)*2 - 1;
+      for (int i = 0; i < 3; ++i) {
+        GLfloat w = 1 + 2*unit(random);
+        ClipVertex v;
+        v.position[0] = (x + (unit(random) - .5f)*.1f)*w;
+        v.position[1] = (y + (unit(random) - .5f)*.1f)*w;
+        v.position[2] = unit(random)*w;
+        v.position[3] = w;
+        for (int c = 0; c < 3; ++c) v.color[c] = unit(random);
+        vertices.push_back(v);
+      }
+    }
+    return vertices;
+  }
+
+  double trianglesPerSecond(SoftRasterizer& raster, const std::vector<ClipVertex>& vertices, int frames) {
+    SoftRasterizer::Program program = { passThrough, nullptr, 3 };
+    raster.clear(0, 0, 0, 1);
+    raster.draw(program, &vertices[0], sizeof(ClipVertex), vertices.size());
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; ++f) {
+      raster.clear(0, 0, 0, 1);
+      raster.draw(program, &vertices[0], sizeof(ClipVertex), vertices.size());
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return vertices.size()/3*double(frames)/seconds;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  int triangles = argc > 1 ? std::atoi(argv[1]) : 100000;
+  int frames = argc > 2 ? std::atoi(argv[2]) : 20;
+  if (triangles <= 0 or frames <= 0) {
+    std::cout << "usage: soft_raster [triangles] [frames]" << std::endl;
+    return 1;
+  }
+  compare();
+  if (not compareSimd()) return 1;
+
+  std::vector<ClipVertex> vertices = scene(triangles);
+  SoftRasterizer raster(WIDTH, HEIGHT);
+  const char* names[] = { "scalar", "sse2", "avx2" };
+  unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  std::cout << triangles << " triangles at " << WIDTH << "x" << HEIGHT << ", " << names[raster.simd()] << std::endl;
+  unsigned counts[] = { 1, 2, 4, cores };
+  for (int i = 0; i < 4; ++i) {
+    if (i == 3 and (cores == 1 or cores == 2 or cores == 4)) break;
+    raster.setThreads(counts[i]);
+    std::cout << "  " << counts[i] << " threads: "
+              << trianglesPerSecond(raster, vertices, frames)/1e6 << " Mtris/s" << std::endl;
+  }
+  raster.setThreads(cores);
+  for (int simd = SoftRasterizer::SCALAR; simd <= SoftRasterizer::best(); ++simd) {
+    raster.setSimd(SoftRasterizer::Simd(simd));
+    std::cout << "  " << names[simd] << " on " << cores << " threads: "
+              << trianglesPerSecond(raster, vertices, frames)/1e6 << " Mtris/s" << std::endl;
+  }
+  raster.endFrame();
+  SoftRasterizer::Program program = { passThrough, nullptr, 3 };
+  raster.draw(program, &vertices[0], sizeof(ClipVertex), vertices.size());
+  SoftRasterizer::Counters counters = raster.endFrame();
+  std::cout << "per frame: " << counters.culled << " culled, " << counters.clipped << " clipped, "
+            << counters.binned << " triangle/tile pairs" << std::endl;
+  return 0;
+}
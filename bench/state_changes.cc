@@ -0,0 +1,138 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+#include "../lib/headless.hh"
+#include "../lib/state_cache.hh"
+#include "program.hh"
+// CPU cost of a frame of many small draws, binding state the way the
+// samples do (use, bind, draw, unbind) versus through the StateCache
+//   state_changes [draws] [frames]
+// draws are grouped by program then vertex array, like a sorted render queue
+
+namespace {
+  const int PROGRAMS = 4;
+  const int MESHES = 16;
+
+  const GLchar* vertexSource = "#version 330 core\n"
+    "layout (location = 0) in vec3 position;"
+    "uniform vec2 offset;"
+    "void main() {"
+    "gl_Position = vec4(position.xy*0.01 + offset, position.z, 1.0);"
+    "}";
+  const GLchar* fragmentSource = "#version 330 core\n"
+    "out vec4 color;"
+    "uniform vec4 tint;"
+    "void main() {"
+    "color = tint;"
+    "}";
+
+  GLuint program(int index) {
+    GLuint program = buildProgram(vertexSource, fragmentSource);
+    if (program == 0) return 0;
+    glUseProgram(program);
+    glUniform4f(glGetUniformLocation(program, "tint"), index/GLfloat(PROGRAMS), .5f, .2f, 1.0f);
+    return program;
+  }
+
+  struct Draw {
+    GLuint program;
+    GLuint vao;
+    GLint offset;
+    GLfloat x, y;
+  };
+
+  // one frame, returns CPU milliseconds including the wait for the GPU
+  double frame(const std::vector<Draw>& draws, bool cached) {
+    StateCache& state = StateCache::global();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (cached) state.clearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    else glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    for (size_t i = 0; i < draws.size(); ++i) {
+      const Draw& d = draws[i];
+      if (cached) {
+        state.useProgram(d.program);
+        state.bindVertexArray(d.vao);
+      }
+      else {
+        glUseProgram(d.program);
+        glBindVertexArray(d.vao);
+      }
+      glUniform2f(d.offset, d.x, d.y);
+      glDrawArrays(GL_TRIANGLES, 0, 3);
+      if (not cached) glBindVertexArray(0);
+    }
+    glFinish();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  }
+}
+
+int main(int argc, char* argv[]) {
+  int count = argc > 1 ? std::atoi(argv[1]) : 10000;
+  int frames = argc > 2 ? std::atoi(argv[2]) : 100;
+  if (count <= 0 or frames <= 0) {
+    std::cout << "usage: state_changes [draws] [frames]" << std::endl;
+    return 1;
+  }
+
+  HeadlessContext context(256, 256);
+  if (not context.valid()) return -1;
+  std::cout << "renderer: " << glGetString(GL_RENDERER) << std::endl;
+
+  GLuint programs[PROGRAMS];
+  for (int p = 0; p < PROGRAMS; ++p)
+    if ((programs[p] = program(p)) == 0) return 1;
+
+  const GLfloat triangle[] = { -.5f, -.5f, .0f, .5f, -.5f, .0f, .0f, .5f, .0f };
+  GLuint vaos[MESHES], vbos[MESHES];
+  glGenVertexArrays(MESHES, vaos);
+  glGenBuffers(MESHES, vbos);
+  for (int m = 0; m < MESHES; ++m) {
+    glBindVertexArray(vaos[m]);
+    glBindBuffer(GL_ARRAY_BUFFER, vbos[m]);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(triangle), triangle, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(GLfloat), (GLvoid *)0);
+    glEnableVertexAttribArray(0);
+  }
+  glBindVertexArray(0);
+  // setup went around the cache
+  StateCache::global().invalidate();
+
+  std::vector<Draw> draws(count);
+  for (int i = 0; i < count; ++i) {
+    // runs of consecutive draws share a program and a mesh
+    int p = std::min(i*PROGRAMS/count, PROGRAMS - 1);
+    int m = std::min(i*PROGRAMS*MESHES/count, PROGRAMS*MESHES - 1) % MESHES;
+    draws[i].program = programs[p];
+    draws[i].vao = vaos[m];
+    draws[i].offset = glGetUniformLocation(programs[p], "offset");
+    draws[i].x = (i % 97)/48.5f - 1.0f;
+    draws[i].y = (i % 89)/44.5f - 1.0f;
+  }
+
+  for (int pass = 0; pass < 2; ++pass) {
+    bool cached = pass == 1;
+    StateCache& state = StateCache::global();
+    state.enabled = cached;
+    state.invalidate();
+    // warm up, then measure
+    for (int f = 0; f < 5; ++f) frame(draws, cached);
+    state.endFrame();
+    double total = 0;
+    for (int f = 0; f < frames; ++f) total += frame(draws, cached);
+    StateCache::Counters counters = state.endFrame();
+    // the raw pass calls gl directly, count what it issues by hand
+    unsigned issued = cached ? counters.issued/frames : 1 + 3*count;
+    unsigned skipped = cached ? counters.skipped/frames : 0;
+    std::cout << (cached ? "state cache: " : "direct:      ") << total/frames << " ms/frame, "
+              << issued << " state calls issued, " << skipped << " skipped per frame" << std::endl;
+  }
+
+  glDeleteVertexArrays(MESHES, vaos);
+  glDeleteBuffers(MESHES, vbos);
+  for (int p = 0; p < PROGRAMS; ++p) glDeleteProgram(programs[p]);
+  std::cout << count << " draws, " << PROGRAMS << " programs, " << MESHES << " meshes" << std::endl;
+  return 0;
+}
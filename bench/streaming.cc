@@ -0,0 +1,131 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include "../lib/headless.hh"
+#include "../lib/state_cache.hh"
+#include "../lib/stream_buffer.hh"
+#include "program.hh"
+// N triangles whose vertices are recomputed on the CPU every frame and
+// streamed through a StreamBuffer, persistent mapping versus orphaning.
+// They are drawn in BATCHES draws, each with its color in a uniform block
+// streamed through a second StreamBuffer at the uniform offset alignment.
+//   streaming [triangles] [frames]
+// prints per frame bytes streamed, time blocked on fences and frame time
+
+namespace {
+  const int BATCHES = 16;
+  const GLchar* vertexSource = "#version 330 core\n"
+    "layout (location = 0) in vec2 position;"
+    "void main() {"
+    "gl_Position = vec4(position, 0.0, 1.0);"
+    "}";
+  const GLchar* fragmentSource = "#version 330 core\n"
+    "layout (std140) uniform Batch { vec4 batchColor; };"
+    "out vec4 color;"
+    "void main() {"
+    "color = batchColor;"
+    "}";
+
+  void run(StreamBuffer::Mode mode, int triangles, int frames) {
+    StateCache& state = StateCache::global();
+    GLsizeiptr frameBytes = GLsizeiptr(triangles)*3*2*sizeof(GLfloat);
+    StreamBuffer stream(GL_ARRAY_BUFFER, frameBytes, mode);
+    // one block per batch, the last one unpadded, so the frame size is not
+    // a multiple of the alignment. At least 256 bytes apart, as on most
+    // desktop GPUs, so a smaller driver alignment still tests the offsets.
+    GLint alignment;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    alignment = std::max(alignment, 256);
+    const GLsizeiptr blockBytes = 4*sizeof(GLfloat);
+    GLsizeiptr blockStride = (blockBytes + alignment - 1)/alignment*alignment;
+    StreamBuffer blocks(GL_UNIFORM_BUFFER, (BATCHES - 1)*blockStride + blockBytes, mode);
+    int misaligned = 0;
+
+    GLuint VAO;
+    glGenVertexArrays(1, &VAO);
+
+    double frameMs = 0;
+    for (int f = 0; f < frames; ++f) {
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      stream.beginFrame();
+      GLintptr offset;
+      GLfloat* v = static_cast<GLfloat*>(stream.allocate(frameBytes, sizeof(GLfloat), offset));
+      if (v == nullptr) return;
+      GLfloat time = f/60.0f;
+      int side = std::ceil(std::sqrt(double(triangles)));
+      GLfloat s = 1.0f/side;
+      for (int i = 0; i < triangles; ++i) {
+        GLfloat x = 2.0f*(i % side)*s - 1.0f + s*.5f*std::sin(time + i);
+        GLfloat y = 2.0f*(i / side)*s - 1.0f;
+        v[0] = x; v[1] = y;
+        v[2] = x + s; v[3] = y;
+        v[4] = x; v[5] = y + s;
+        v += 6;
+      }
+      stream.flush();
+      blocks.beginFrame();
+      GLintptr blockOffsets[BATCHES];
+      for (int b = 0; b < BATCHES; ++b) {
+        GLfloat* color = static_cast<GLfloat*>(blocks.allocate(blockBytes, alignment, blockOffsets[b]));
+        if (color == nullptr) return;
+        if (blockOffsets[b] % alignment != 0) ++misaligned;
+        color[0] = 1.0f;
+        color[1] = .5f + .5f*std::sin(time + b);
+        color[2] = b/GLfloat(BATCHES);
+        color[3] = 1.0f;
+      }
+      blocks.flush();
+      glClear(GL_COLOR_BUFFER_BIT);
+      // the region moves every frame, so does the attribute offset
+      state.bindVertexArray(VAO);
+      state.bindBuffer(GL_ARRAY_BUFFER, stream.buffer());
+      glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2*sizeof(GLfloat), (GLvoid *)offset);
+      glEnableVertexAttribArray(0);
+      for (int b = 0; b < BATCHES; ++b) {
+        int first = triangles*b/BATCHES, last = triangles*(b + 1)/BATCHES;
+        state.bindBufferRange(GL_UNIFORM_BUFFER, 0, blocks.buffer(), blockOffsets[b], blockBytes);
+        glDrawArrays(GL_TRIANGLES, 3*first, 3*(last - first));
+      }
+      glFlush();
+      stream.endFrame();
+      blocks.endFrame();
+      frameMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    glFinish();
+    if (misaligned != 0 or glGetError() != GL_NO_ERROR)
+      std::cout << "ERROR::STREAMING::UNIFORM_RANGES " << misaligned << " misaligned" << std::endl;
+
+    std::cout << (stream.mode() == StreamBuffer::PERSISTENT ? "persistent: " : "orphan:     ")
+              << stream.total.bytes/double(frames)/(1 << 20) << " MiB/frame, fence wait "
+              << stream.total.waitMs/frames << " ms/frame in " << stream.total.stalls << " of "
+              << frames << " frames, " << frameMs/frames << " ms/frame" << std::endl;
+    glDeleteVertexArrays(1, &VAO);
+    state.invalidate();
+  }
+}
+
+int main(int argc, char* argv[]) {
+  int triangles = argc > 1 ? std::atoi(argv[1]) : 100000;
+  int frames = argc > 2 ? std::atoi(argv[2]) : 200;
+  if (triangles <= 0 or frames <= 0) {
+    std::cout << "usage: streaming [triangles] [frames]" << std::endl;
+    return 1;
+  }
+
+  HeadlessContext context(800, 600);
+  if (not context.valid()) return -1;
+  std::cout << "renderer: " << glGetString(GL_RENDERER) << std::endl;
+  std::cout << "ARB_buffer_storage: " << (GLEW_ARB_buffer_storage ? "yes" : "no") << std::endl;
+
+  GLuint shader = buildProgram(vertexSource, fragmentSource);
+  if (shader == 0) return 1;
+  glUniformBlockBinding(shader, glGetUniformBlockIndex(shader, "Batch"), 0);
+  StateCache::global().useProgram(shader);
+  run(StreamBuffer::PERSISTENT, triangles, frames);
+  run(StreamBuffer::ORPHAN, triangles, frames);
+  glDeleteProgram(shader);
+  std::cout << triangles << " triangles" << std::endl;
+  return 0;
+}
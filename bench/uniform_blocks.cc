@@ -0,0 +1,171 @@
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include "../lib/headless.hh"
+#include "../lib/shader.hh"
+#include "../lib/state_cache.hh"
+#include "../lib/uniform_buffer.hh"
+#include "program.hh"
+// N objects with their own color, offset and scale, animated every frame:
+// three glUniform calls per object versus every object's block written
+// into one UniformBuffer, uploaded once, and bound per draw with
+// glBindBufferRange. Both paths must end with the same image.
+//   uniform_blocks [objects] [frames]
+
+namespace {
+  // mirrors the Object block of blockVertexSource
+  struct Object {
+    std140::vec4 color;
+    std140::vec2 offset;
+    GLfloat scale;
+  };
+  STD140_OFFSET(Object, color, 0);
+  STD140_OFFSET(Object, offset, 16);
+  STD140_OFFSET(Object, scale, 24);
+  STD140_SIZE(Object, 32);
+
+  const GLuint OBJECT_BINDING = 0;
+
+  const GLchar* blockVertexSource = "#version 330 core\n"
+    "layout (location = 0) in vec3 position;"
+    "layout (std140) uniform Object {"
+    "  vec4 color;"
+    "  vec2 offset;"
+    "  float scale;"
+    "};"
+    "out vec4 ourColor;"
+    "void main() {"
+    "gl_Position = vec4(position.xy*scale + offset, position.z, 1.0);"
+    "ourColor = color;"
+    "}";
+  const GLchar* uniformVertexSource = "#version 330 core\n"
+    "layout (location = 0) in vec3 position;"
+    "uniform vec4 color;"
+    "uniform vec2 offset;"
+    "uniform float scale;"
+    "out vec4 ourColor;"
+    "void main() {"
+    "gl_Position = vec4(position.xy*scale + offset, position.z, 1.0);"
+    "ourColor = color;"
+    "}";
+  const GLchar* fragmentSource = "#version 330 core\n"
+    "in vec4 ourColor;"
+    "out vec4 color;"
+    "void main() {"
+    "color = ourColor;"
+    "}";
+
+  void animate(Object& o, int i, int side, GLfloat time) {
+    GLfloat u = (i % side + .5f)/side, v = (i / side + .5f)/side;
+    o.color.x = u;
+    o.color.y = v;
+    o.color.z = .5f + .5f*std::sin(time + i);
+    o.color.w = 1.0f;
+    o.offset.x = 2.0f*u - 1.0f;
+    o.offset.y = 2.0f*v - 1.0f;
+    o.scale = (.5f + .25f*std::sin(time))/side;
+  }
+
+  // of the last frame, both paths must draw the same image
+  unsigned long long checksum(HeadlessContext& context) {
+    std::vector<unsigned char> pixels(context.width*context.height*4);
+    context.readPixels(pixels.data());
+    unsigned long long hash = 14695981039346656037ull;
+    for (size_t i = 0; i < pixels.size(); ++i) hash = (hash ^ pixels[i])*1099511628211ull;
+    return hash;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  int count = argc > 1 ? std::atoi(argv[1]) : 10000;
+  int frames = argc > 2 ? std::atoi(argv[2]) : 100;
+  if (count <= 0 or frames <= 0) {
+    std::cout << "usage: uniform_blocks [objects] [frames]" << std::endl;
+    return 1;
+  }
+
+  HeadlessContext context(800, 600);
+  if (not context.valid()) return -1;
+  std::cout << "renderer: " << glGetString(GL_RENDERER) << std::endl;
+  StateCache& state = StateCache::global();
+
+  // before the program links, so reflection binds the block
+  Shader::bindBlock("Object", OBJECT_BINDING);
+  GLuint blockProgram = buildProgram(blockVertexSource, fragmentSource);
+  GLuint uniformProgram = buildProgram(uniformVertexSource, fragmentSource);
+  if (blockProgram == 0 or uniformProgram == 0) return 1;
+  Shader blocks(blockProgram);
+  Shader uniforms(uniformProgram);
+  GLint colorHandle = uniforms.uniform("color");
+  GLint offsetHandle = uniforms.uniform("offset");
+  GLint scaleHandle = uniforms.uniform("scale");
+
+  const GLfloat triangle[] = { -1.0f, -1.0f, .0f,  1.0f, -1.0f, .0f,  .0f, 1.0f, .0f };
+  GLuint VAO, VBO;
+  glGenVertexArrays(1, &VAO);
+  glGenBuffers(1, &VBO);
+  state.bindVertexArray(VAO);
+  state.bindBuffer(GL_ARRAY_BUFFER, VBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(triangle), triangle, GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(GLfloat), (GLvoid *)0);
+  glEnableVertexAttribArray(0);
+
+  int side = std::ceil(std::sqrt(double(count)));
+  std::vector<Object> objects(count);
+
+  UniformBuffer buffer(GLsizeiptr(count)*256);
+  std::vector<GLintptr> offsets(count);
+  for (int i = 0; i < count; ++i) offsets[i] = buffer.add(objects[i]);
+
+  unsigned long long images[2];
+  for (int pass = 0; pass < 2; ++pass) {
+    bool useBlocks = pass == 1;
+    double total = 0;
+    unsigned calls = 0;
+    state.endFrame();
+    Shader::endFrame();
+    for (int f = 0; f < frames; ++f) {
+      GLfloat time = f/60.0f;
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      for (int i = 0; i < count; ++i) animate(objects[i], i, side, time);
+      glClear(GL_COLOR_BUFFER_BIT);
+      if (useBlocks) {
+        blocks.use();
+        for (int i = 0; i < count; ++i) buffer.update(offsets[i], objects[i]);
+        buffer.upload();
+        ++calls;
+        for (int i = 0; i < count; ++i) {
+          buffer.bind<Object>(OBJECT_BINDING, offsets[i]);
+          glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+      }
+      else {
+        uniforms.use();
+        for (int i = 0; i < count; ++i) {
+          const Object& o = objects[i];
+          uniforms.set(colorHandle, o.color.x, o.color.y, o.color.z, o.color.w);
+          uniforms.set(offsetHandle, o.offset.x, o.offset.y);
+          uniforms.set(scaleHandle, o.scale);
+          glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+      }
+      glFinish();
+      total += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      calls += useBlocks ? state.endFrame().issued : Shader::endFrame().issued;
+    }
+    images[pass] = checksum(context);
+    std::cout << (useBlocks ? "uniform blocks: " : "glUniform:      ") << total/frames << " ms/frame, "
+              << calls/frames << " uniform/binding calls per frame" << std::endl;
+  }
+  if (images[0] != images[1]) std::cout << "ERROR::UNIFORM_BLOCKS::IMAGES_DIFFER" << std::endl;
+
+  std::cout << count << " objects, " << buffer.size() << " bytes of blocks at "
+            << buffer.alignment() << " byte alignment" << std::endl;
+  glDeleteVertexArrays(1, &VAO);
+  glDeleteBuffers(1, &VBO);
+  glDeleteProgram(blocks.Program);
+  glDeleteProgram(uniforms.Program);
+  return 0;
+}
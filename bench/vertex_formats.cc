@@ -0,0 +1,154 @@
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include "../lib/headless.hh"
+#include "../lib/state_cache.hh"
+#include "../lib/vertex_format.hh"
+#include "program.hh"
+// The same colored triangle soup in three layouts, from 32 bit floats to
+// packed normalized formats: bytes per vertex, buffer size and how fast
+// the vertices go through one draw call a frame
+//   vertex_formats [triangles] [frames]
+
+// the layout every sample used, 24 bytes
+struct FloatVertex {
+  vertex::vec3 position;
+  vertex::vec3 color;
+};
+VERTEX_FORMAT(FloatVertex,
+  VERTEX_ATTRIBUTE(FloatVertex, position),
+  VERTEX_ATTRIBUTE(FloatVertex, color));
+
+// half float position (w unused), 8 bit color, 12 bytes
+struct HalfVertex {
+  vertex::half4 position;
+  vertex::ubyte4n color;
+};
+VERTEX_FORMAT(HalfVertex,
+  VERTEX_ATTRIBUTE(HalfVertex, position),
+  VERTEX_ATTRIBUTE(HalfVertex, color));
+
+// 10 bit normalized position, 8 bit color, 8 bytes
+struct PackedVertex {
+  vertex::int2_10_10_10n position;
+  vertex::ubyte4n color;
+};
+VERTEX_FORMAT(PackedVertex,
+  VERTEX_ATTRIBUTE(PackedVertex, position),
+  VERTEX_ATTRIBUTE(PackedVertex, color));
+
+namespace {
+  // vec3/vec4 inputs read any of the layouts, normalized ones as floats
+  const GLchar* vertexSource = "#version 330 core\n"
+    "layout (location = 0) in vec3 position;"
+    "layout (location = 1) in vec3 color;"
+    "out vec3 ourColor;"
+    "void main() {"
+    "gl_Position = vec4(position, 1.0);"
+    "ourColor = color;"
+    "}";
+  const GLchar* fragmentSource = "#version 330 core\n"
+    "in vec3 ourColor;"
+    "out vec4 color;"
+    "void main() {"
+    "color = vec4(ourColor, 1.0);"
+    "}";
+
+  // small triangles on a grid covering clip space, color from the position
+  struct Soup {
+    std::vector<vertex::vec3> positions, colors;
+    explicit Soup(int triangles) {
+      int side = std::ceil(std::sqrt(double(triangles)));
+      GLfloat size = 2.0f/side;
+      for (int i = 0; i < triangles; ++i) {
+        GLfloat x = -1.0f + (i % side)*size, y = -1.0f + (i / side)*size;
+        const vertex::vec3 corners[] = { { x, y, .0f }, { x + size, y, .0f }, { x, y + size, .0f } };
+        for (int c = 0; c < 3; ++c) {
+          positions.push_back(corners[c]);
+          vertex::vec3 color = { .5f + .5f*corners[c].x, .5f + .5f*corners[c].y, GLfloat(c)/2 };
+          colors.push_back(color);
+        }
+      }
+    }
+  };
+
+  FloatVertex convert(const vertex::vec3& p, const vertex::vec3& c, FloatVertex*) {
+    FloatVertex v = { p, c };
+    return v;
+  }
+  HalfVertex convert(const vertex::vec3& p, const vertex::vec3& c, HalfVertex*) {
+    const vertex::vec4 position = { p.x, p.y, p.z, 1.0f };
+    HalfVertex v = { vertex::pack(position), vertex::unorm8(c.x, c.y, c.z) };
+    return v;
+  }
+  PackedVertex convert(const vertex::vec3& p, const vertex::vec3& c, PackedVertex*) {
+    PackedVertex v = { vertex::snorm10(p.x, p.y, p.z), vertex::unorm8(c.x, c.y, c.z) };
+    return v;
+  }
+
+  template <typename Vertex>
+  void run(const char* name, const Soup& soup, int frames) {
+    std::vector<Vertex> vertices;
+    vertices.reserve(soup.positions.size());
+    for (size_t i = 0; i < soup.positions.size(); ++i)
+      vertices.push_back(convert(soup.positions[i], soup.colors[i], (Vertex*)nullptr));
+
+    StateCache& state = StateCache::global();
+    GLuint VAO, VBO;
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    state.bindVertexArray(VAO);
+    state.bindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size()*sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    setVertexFormat<Vertex>();
+
+    // one untimed frame, so the upload is not counted
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDrawArrays(GL_TRIANGLES, 0, vertices.size());
+    glFinish();
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; ++f) {
+      glClear(GL_COLOR_BUFFER_BIT);
+      glDrawArrays(GL_TRIANGLES, 0, vertices.size());
+      glFinish();
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    double mb = vertices.size()*sizeof(Vertex)/(1024.0*1024.0);
+    std::cout << name << sizeof(Vertex) << " bytes/vertex, " << mb << " MB, "
+              << ms/frames << " ms/frame, "
+              << vertices.size()*double(frames)/(ms*1000.0) << " Mverts/s" << std::endl;
+
+    state.bindVertexArray(0);
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    state.invalidate();
+  }
+}
+
+int main(int argc, char* argv[]) {
+  int triangles = argc > 1 ? std::atoi(argv[1]) : 1000000;
+  int frames = argc > 2 ? std::atoi(argv[2]) : 50;
+  if (triangles <= 0 or frames <= 0) {
+    std::cout << "usage: vertex_formats [triangles] [frames]" << std::endl;
+    return 1;
+  }
+
+  HeadlessContext context(800, 600);
+  if (not context.valid()) return -1;
+  std::cout << "renderer: " << glGetString(GL_RENDERER) << std::endl;
+
+  GLuint shader = buildProgram(vertexSource, fragmentSource);
+  if (shader == 0) return 1;
+  glUseProgram(shader);
+  Soup soup(triangles);
+  std::cout << triangles << " triangles, " << soup.positions.size() << " vertices" << std::endl;
+  run<FloatVertex>("vec3 + vec3:             ", soup, frames);
+  run<HalfVertex>("half4 + ubyte4n:         ", soup, frames);
+  run<PackedVertex>("int2_10_10_10 + ubyte4n: ", soup, frames);
+  glDeleteProgram(shader);
+  return 0;
+}
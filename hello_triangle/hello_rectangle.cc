@@ -1,6 +1,9 @@
 #include <iostream>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include "../lib/main_loop.hh"
+#include "../lib/state_cache.hh"
+#include "../lib/profiler.hh"
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mode);
 
@@ -17,8 +20,14 @@ const GLchar *fragmentShaderSource = "#version 330 core\n"
   "}";
 
 int main() {
+  // startup zones, with -DLEARNOPENGL_PROFILE; F12 or exit writes trace.json
+  Profiler::threadName("main");
+
   // start glfw
-  glfwInit();
+  {
+    PROFILE_ZONE("glfwInit");
+    glfwInit();
+  }
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -37,7 +46,12 @@ int main() {
 
   // start glew
   glewExperimental = GL_TRUE;
-  if (glewInit() != GLEW_OK) {
+  GLenum glew;
+  {
+    PROFILE_ZONE("glewInit");
+    glew = glewInit();
+  }
+  if (glew != GLEW_OK) {
     std::cout << "Failed to initialize GLEW" << std::endl;
     return -1;
   }
@@ -101,44 +115,45 @@ int main() {
 
   // generate VAO
   GLuint VAO, VBO, EBO;
-
-  glGenVertexArrays(1, &VAO);
-  glGenBuffers(1, &VBO);
-  glGenBuffers(1, &EBO);
-
-   // Step 1: bind vertex array object
-  glBindVertexArray(VAO);
-  // Step 2: copy vertices in a buffer
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-  // Step 3: copy index array
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-  // Step 4: set vertex attribute pointers
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(GLfloat), (GLvoid *)0 );
-  glEnableVertexAttribArray(0);
-  glBindBuffer(GL_ARRAY_BUFFER,0); // unbind VBO
-  // Step 5: unbind VAO
-  glBindVertexArray(0);
+  {
+    PROFILE_ZONE("upload");
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+
+     // Step 1: bind vertex array object
+    glBindVertexArray(VAO);
+    // Step 2: copy vertices in a buffer
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    // Step 3: copy index array
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    // Step 4: set vertex attribute pointers
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(GLfloat), (GLvoid *)0 );
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER,0); // unbind VBO
+    // Step 5: unbind VAO
+    glBindVertexArray(0);
+  }
 
   //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-  // event loop
-  while (!glfwWindowShouldClose(window)) {
-    glfwPollEvents();
+  // binds only what changed, see state_cache.hh
+  StateCache& state = StateCache::global();
 
+  // redraw only when something changed, the scene is static
+  MainLoop loop(window, MainLoop::IDLE);
+  loop.run([&]() {
     // Render
-    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    state.clearColor(0.2f, 0.3f, 0.3f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
     // use shader program
-    glUseProgram(shaderProgram);
-    glBindVertexArray(VAO); // use VAO
+    state.useProgram(shaderProgram);
+    state.bindVertexArray(VAO); // use VAO
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
-
-    // refresh
-    glfwSwapBuffers(window);
-  }
+  });
+  loop.report(std::cout);
   glDeleteVertexArrays(1, &VAO);
   glDeleteBuffers(1, &VBO);
   glDeleteBuffers(1, &EBO);
@@ -1,6 +1,8 @@
 #include <iostream>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include "../lib/main_loop.hh"
+#include "../lib/state_cache.hh"
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mode);
 
@@ -92,21 +94,22 @@ int main() {
   glBindVertexArray(0); // Step 4: unbind vertex array object
 
 
-  // event loop
-  while (!glfwWindowShouldClose(window)) {
-    glfwPollEvents();
+  // binds only what changed, see state_cache.hh
+  StateCache& state = StateCache::global();
+
+  // redraw only when something changed, the scene is static
+  MainLoop loop(window, MainLoop::IDLE);
+  loop.run([&]() {
     // rendering
     glClear(GL_COLOR_BUFFER_BIT);
 
     // use shader program
-    glUseProgram(shaderProgram);
+    state.useProgram(shaderProgram);
     // use VBO
-    glBindVertexArray(VAO);
+    state.bindVertexArray(VAO);
     glDrawArrays(GL_TRIANGLES, 0, 3);
-    glBindVertexArray(0);
-    // refresh
-    glfwSwapBuffers(window);
-  }
+  });
+  loop.report(std::cout);
   glfwTerminate();
   return 0;
 }
@@ -1,6 +1,8 @@
 #include <iostream>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include "../lib/main_loop.hh"
+#include "../lib/state_cache.hh"
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mode);
 
@@ -112,23 +114,22 @@ int main() {
   // Step 4: unbind vertex array object
   glBindVertexArray(0);
 
-  // event loop
-  while (!glfwWindowShouldClose(window)) {
-    glfwPollEvents();
+  // binds only what changed, see state_cache.hh
+  StateCache& state = StateCache::global();
 
+  // redraw only when something changed, the scene is static
+  MainLoop loop(window, MainLoop::IDLE);
+  loop.run([&]() {
     // rendering
-    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    state.clearColor(0.2f, 0.3f, 0.3f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
     // use shader program
-    glUseProgram(shaderProgram);
-    glBindVertexArray(VAO); // use VAO
+    state.useProgram(shaderProgram);
+    state.bindVertexArray(VAO); // use VAO
     glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindVertexArray(0);
-
-    // refresh
-    glfwSwapBuffers(window);
-  }
+  });
+  loop.report(std::cout);
   glfwTerminate();
   return 0;
 }
@@ -1,6 +1,9 @@
 #include <iostream>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include "../lib/main_loop.hh"
+#include "../lib/state_cache.hh"
+#include "../lib/gpu_timer.hh"
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mode);
 
@@ -122,25 +125,47 @@ int main() {
   glEnableVertexAttribArray(0);
   glBindVertexArray(0);
 
-  // event loop
-  while (!glfwWindowShouldClose(window)) {
-    glfwPollEvents();
+  // per draw GPU times, with -DLEARNOPENGL_GPU_TIMING
+  GpuTimer timer;
 
+  // binds only what changed, see state_cache.hh
+  StateCache& state = StateCache::global();
+
+  // state calls issued/skipped over the whole run
+  unsigned issued = 0, skipped = 0;
+
+  // redraw only when something changed, the scene is static
+  MainLoop loop(window, MainLoop::IDLE);
+  loop.run([&]() {
+    timer.beginFrame();
     // rendering
-    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+    {
+      GPU_ZONE(timer, "clear");
+      state.clearColor(0.2f, 0.3f, 0.3f, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT);
+    }
 
     // use shader program
-    glUseProgram(shaderProgram);
-    glBindVertexArray(VAO); // use VAO
-    glDrawArrays(GL_TRIANGLES, 0, 3);
-    glBindVertexArray(VAO2);
-    glDrawArrays(GL_TRIANGLES, 0, 3);
-    glBindVertexArray(0);
-
-    // refresh
-    glfwSwapBuffers(window);
-  }
+    state.useProgram(shaderProgram);
+    {
+      GPU_ZONE(timer, "triangle 1");
+      state.bindVertexArray(VAO); // use VAO
+      glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+    {
+      GPU_ZONE(timer, "triangle 2");
+      state.bindVertexArray(VAO2);
+      glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+    StateCache::Counters counters = state.endFrame();
+    issued += counters.issued;
+    skipped += counters.skipped;
+    timer.endFrame();
+  });
+  loop.report(std::cout);
+  timer.report(std::cout);
+  std::cout << loop.stats.frames << " frames, state calls issued " << issued
+            << ", skipped " << skipped << std::endl;
   glfwTerminate();
   return 0;
 }
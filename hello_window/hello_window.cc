@@ -1,6 +1,7 @@
 #include <iostream>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include "../lib/main_loop.hh"
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mode);
 
@@ -37,14 +38,13 @@ int main() {
 
   glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
 
-  // event loop
-  while (!glfwWindowShouldClose(window)) {
-    glfwPollEvents();
+  // redraw only when something changed, the scene is static
+  MainLoop loop(window, MainLoop::IDLE);
+  loop.run([&]() {
     // rendering
     glClear(GL_COLOR_BUFFER_BIT);
-    // refresh
-    glfwSwapBuffers(window);
-  }
+  });
+  loop.report(std::cout);
   glfwTerminate();
   return 0;
 }
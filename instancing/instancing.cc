@@ -0,0 +1,140 @@
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "../lib/shader.hh"
+#include "../lib/program_cache.hh"
+#include "../lib/state_cache.hh"
+#include "../lib/instance_buffer.hh"
+#include "../lib/main_loop.hh"
+#include "../lib/render_thread.hh"
+// one triangle drawn N times in a single call, each copy with its own
+// offset and color from a per instance buffer
+//   instancing [N] [--render-thread]   (1000000 by default)
+// --render-thread renders on a RenderThread instead of the MainLoop,
+// both print the event to present latency of the input they got
+
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mode);
+
+int main(int argc, char* argv[]) {
+  int count = 1000000;
+  bool renderThread = false;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--render-thread") == 0) renderThread = true;
+    else count = std::atoi(argv[i]);
+  }
+  if (count <= 0) count = 1;
+
+  // start glfw
+  glfwInit();
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+
+  // create window
+  GLFWwindow* window = glfwCreateWindow(800, 600, "Learn OpenGL", nullptr, nullptr);
+  if (window == nullptr) {
+    std::cout << "Failed to create GLFW window" << std::endl;
+    glfwTerminate();
+  }
+  glfwMakeContextCurrent(window);
+
+  // escape close
+  glfwSetKeyCallback(window, key_callback);
+
+  // start glew
+  glewExperimental = GL_TRUE;
+  if (glewInit() != GLEW_OK) {
+    std::cout << "Failed to initialize GLEW" << std::endl;
+    return -1;
+  }
+
+  // set viewport
+  int width, height;
+  glfwGetFramebufferSize(window, &width, &height);
+  glViewport(0, 0, width, height);
+
+  Shader ourShader("instancing/instancing.vs", "instancing/instancing.frag");
+  GLint scaleLocation = ourShader.uniform("scale");
+
+  GLfloat vertices[] = {
+    -1.0f, -1.0f, .0f,
+     1.0f, -1.0f, .0f,
+     .0f,  1.0f, .0f
+  };
+  GLuint VAO, VBO;
+  glGenVertexArrays(1, &VAO);
+  glGenBuffers(1, &VBO);
+  glBindVertexArray(VAO);
+  glBindBuffer(GL_ARRAY_BUFFER, VBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(GLfloat), (GLvoid *)0);
+  glEnableVertexAttribArray(0);
+  glBindVertexArray(0);
+
+  // a square grid of {offset, color}, one cell per instance
+  int side = std::ceil(std::sqrt(double(count)));
+  std::vector<GLfloat> instanceData(5*count);
+  for (int i = 0; i < count; ++i) {
+    GLfloat u = (i % side + .5f)/side, v = (i / side + .5f)/side;
+    GLfloat* instance = &instanceData[5*i];
+    instance[0] = 2.0f*u - 1.0f;
+    instance[1] = 2.0f*v - 1.0f;
+    instance[2] = u;
+    instance[3] = v;
+    instance[4] = 1.0f - u;
+  }
+  InstanceBuffer instances(std::vector<GLint>{2, 3}, 1);
+  instances.upload(instanceData.data(), count);
+  instances.attach(VAO);
+
+  // binds only what changed, see state_cache.hh
+  StateCache& state = StateCache::global();
+
+  std::function<void()> render = [&]() {
+    state.clearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    ourShader.use();
+    ourShader.set(scaleLocation, 0.8f/side);
+    instances.drawArrays(VAO, GL_TRIANGLES, 0, 3);
+  };
+
+  unsigned frames;
+  double seconds;
+  if (renderThread) {
+    // this thread only pumps events, escape is handled with the frames
+    RenderThread thread(RenderThread::windowContext(window));
+    thread.run(window, [&](const InputEvent& e) {
+      if (e.type == InputEvent::KEY and e.code == GLFW_KEY_ESCAPE and e.action == GLFW_PRESS)
+        thread.close();
+    }, render);
+    thread.report(std::cout);
+    frames = thread.stats.frames;
+    seconds = thread.stats.seconds;
+  }
+  else {
+    // redraw as fast as possible, the frame time is the point
+    MainLoop loop(window, MainLoop::CONTINUOUS);
+    loop.run(render);
+    loop.report(std::cout);
+    frames = loop.stats.frames;
+    seconds = loop.stats.seconds;
+  }
+  ProgramCache::global().report(std::cout);
+  if (frames > 0)
+    std::cout << count << " instances, " << seconds*1000.0/frames << " ms per frame" << std::endl;
+  glDeleteVertexArrays(1, &VAO);
+  glDeleteBuffers(1, &VBO);
+  glfwTerminate();
+  return 0;
+}
+
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mode) {
+  if (key == GLFW_KEY_ESCAPE and action == GLFW_PRESS)
+    glfwSetWindowShouldClose(window, GL_TRUE);
+}
@@ -0,0 +1,13 @@
+#version 330 core
+layout (location = 0) in vec3 position;
+// per instance, see InstanceBuffer
+layout (location = 1) in vec2 offset;
+layout (location = 2) in vec3 color;
+out vec3 ourColor;
+
+uniform float scale;
+
+void main() {
+  gl_Position = vec4(position.xy*scale + offset, position.z, 1.0);
+  ourColor = color;
+}
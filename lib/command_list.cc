@@ -0,0 +1,317 @@
+#include "command_list.hh"
+#include "shader.hh"
+#include "state_cache.hh"
+#include "thread_pool.hh"
+#include "profiler.hh"
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+LinearArena::LinearArena(size_t blockSize) : blockSize(blockSize), current(0), offset(0) {}
+
+LinearArena::~LinearArena() {
+  for (size_t i = 0; i < this->blocks.size(); ++i) std::free(this->blocks[i].data);
+}
+
+void* LinearArena::allocate(size_t bytes, size_t alignment) {
+  while (true) {
+    if (this->current < this->blocks.size()) {
+      Block& block = this->blocks[this->current];
+      // blocks start 64 byte aligned, so aligning the offset is enough
+      size_t start = (this->offset + alignment - 1) & ~(alignment - 1);
+      if (start + bytes <= block.size) {
+        this->offset = start + bytes;
+        return block.data + start;
+      }
+      ++this->current;
+      this->offset = 0;
+      continue;
+    }
+    Block block;
+    block.size = bytes > this->blockSize ? bytes : this->blockSize;
+    void* data = nullptr;
+    if (posix_memalign(&data, 64, block.size) != 0) throw std::bad_alloc();
+    block.data = static_cast<char*>(data);
+    this->blocks.push_back(block);
+  }
+}
+
+void LinearArena::reset() {
+  this->current = 0;
+  this->offset = 0;
+}
+
+size_t LinearArena::used() const {
+  size_t bytes = this->offset;
+  for (size_t i = 0; i < this->current and i < this->blocks.size(); ++i) bytes += this->blocks[i].size;
+  return bytes;
+}
+
+size_t LinearArena::capacity() const {
+  size_t bytes = 0;
+  for (size_t i = 0; i < this->blocks.size(); ++i) bytes += this->blocks[i].size;
+  return bytes;
+}
+
+// Every command starts with a Header and takes a multiple of 8 bytes.
+// A chunk of the arena always keeps room for a Jump to the next one.
+struct CommandList::Header {
+  enum Op : uint16_t {
+    USE, VERTEX_ARRAY, BUFFER_RANGE, UNIFORM_INT, UNIFORM1, UNIFORM2, UNIFORM3, UNIFORM4,
+    MATRIX4, DRAW_ARRAYS, DRAW_ELEMENTS, JUMP
+  };
+  uint16_t op;
+  uint16_t size;
+};
+
+namespace {
+  typedef CommandList::Header Header;
+  const size_t CHUNK = 4096;
+
+  struct Use { Header h; Shader* shader; };
+  struct VertexArray { Header h; GLuint vao; };
+  struct BufferRange { Header h; GLenum target; GLuint index; GLuint buffer; GLintptr offset; GLsizeiptr size; };
+  struct UniformInt { Header h; GLint handle; GLint x; };
+  struct Uniform { Header h; GLint handle; GLfloat v[4]; };
+  struct Matrix4 { Header h; GLint handle; GLfloat m[16]; };
+  struct DrawArrays { Header h; GLenum mode; GLint first; GLsizei count; GLsizei instances; };
+  struct DrawElements { Header h; GLenum mode; GLsizei count; GLenum type; GLsizei instances; size_t offset; };
+  struct Jump { Header h; char* next; };
+
+  size_t padded(size_t bytes) {
+    return (bytes + 7) & ~size_t(7);
+  }
+}
+
+template <typename T>
+T* CommandList::push() {
+  size_t bytes = padded(sizeof(T));
+  // no pointer arithmetic on a null cursor, before the first chunk
+  if (this->cursor == nullptr or size_t(this->limit - this->cursor) < bytes + padded(sizeof(Jump))) {
+    char* chunk = static_cast<char*>(this->arena->allocate(CHUNK));
+    if (this->cursor != nullptr) {
+      Jump* jump = reinterpret_cast<Jump*>(this->cursor);
+      jump->h.op = Header::JUMP;
+      jump->h.size = padded(sizeof(Jump));
+      jump->next = chunk;
+    }
+    else this->first = chunk;
+    this->cursor = chunk;
+    this->limit = chunk + CHUNK;
+  }
+  T* command = reinterpret_cast<T*>(this->cursor);
+  command->h.size = bytes;
+  this->cursor += bytes;
+  ++this->count;
+  return command;
+}
+
+CommandList::CommandList()
+  : arena(nullptr), first(nullptr), cursor(nullptr), limit(nullptr), count(0), drawCount(0), shader(nullptr), vao(0) {}
+
+void CommandList::begin(LinearArena& arena) {
+  this->arena = &arena;
+  this->first = this->cursor = this->limit = nullptr;
+  this->count = this->drawCount = 0;
+  this->shader = nullptr;
+  this->vao = 0;
+}
+
+void CommandList::use(Shader& shader) {
+  if (this->shader == &shader) return;
+  this->shader = &shader;
+  Use* c = this->push<Use>();
+  c->h.op = Header::USE;
+  c->shader = &shader;
+}
+
+void CommandList::bindVertexArray(GLuint vao) {
+  // vao 0 stands for not known yet, so binding 0 is always recorded
+  if (vao != 0 and this->vao == vao) return;
+  this->vao = vao;
+  VertexArray* c = this->push<VertexArray>();
+  c->h.op = Header::VERTEX_ARRAY;
+  c->vao = vao;
+}
+
+void CommandList::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+  BufferRange* c = this->push<BufferRange>();
+  c->h.op = Header::BUFFER_RANGE;
+  c->target = target;
+  c->index = index;
+  c->buffer = buffer;
+  c->offset = offset;
+  c->size = size;
+}
+
+void CommandList::set(GLint handle, GLint x) {
+  UniformInt* c = this->push<UniformInt>();
+  c->h.op = Header::UNIFORM_INT;
+  c->handle = handle;
+  c->x = x;
+}
+
+void CommandList::set(GLint handle, GLfloat x) {
+  this->uniform(1, handle, x, 0, 0, 0);
+}
+
+void CommandList::set(GLint handle, GLfloat x, GLfloat y) {
+  this->uniform(2, handle, x, y, 0, 0);
+}
+
+void CommandList::set(GLint handle, GLfloat x, GLfloat y, GLfloat z) {
+  this->uniform(3, handle, x, y, z, 0);
+}
+
+void CommandList::set(GLint handle, GLfloat x, GLfloat y, GLfloat z, GLfloat w) {
+  this->uniform(4, handle, x, y, z, w);
+}
+
+void CommandList::uniform(int components, GLint handle, GLfloat x, GLfloat y, GLfloat z, GLfloat w) {
+  Uniform* c = this->push<Uniform>();
+  c->h.op = Header::UNIFORM1 + components - 1;
+  c->handle = handle;
+  c->v[0] = x;
+  c->v[1] = y;
+  c->v[2] = z;
+  c->v[3] = w;
+}
+
+void CommandList::setMatrix4(GLint handle, const GLfloat* m) {
+  Matrix4* c = this->push<Matrix4>();
+  c->h.op = Header::MATRIX4;
+  c->handle = handle;
+  std::memcpy(c->m, m, sizeof(c->m));
+}
+
+void CommandList::drawArrays(GLenum mode, GLint first, GLsizei count, GLsizei instances) {
+  DrawArrays* c = this->push<DrawArrays>();
+  c->h.op = Header::DRAW_ARRAYS;
+  c->mode = mode;
+  c->first = first;
+  c->count = count;
+  c->instances = instances;
+  ++this->drawCount;
+}
+
+void CommandList::drawElements(GLenum mode, GLsizei count, GLenum type, size_t offset, GLsizei instances) {
+  DrawElements* c = this->push<DrawElements>();
+  c->h.op = Header::DRAW_ELEMENTS;
+  c->mode = mode;
+  c->count = count;
+  c->type = type;
+  c->instances = instances;
+  c->offset = offset;
+  ++this->drawCount;
+}
+
+void CommandList::submit() const {
+  StateCache& state = StateCache::global();
+  Shader* shader = nullptr;
+  const char* p = this->first;
+  for (size_t i = 0; i < this->count; ++i) {
+    const Header* h = reinterpret_cast<const Header*>(p);
+    if (h->op == Header::JUMP) {
+      p = reinterpret_cast<const Jump*>(p)->next;
+      h = reinterpret_cast<const Header*>(p);
+    }
+    switch (h->op) {
+      case Header::USE:
+        shader = reinterpret_cast<const Use*>(p)->shader;
+        shader->use();
+        break;
+      case Header::VERTEX_ARRAY:
+        state.bindVertexArray(reinterpret_cast<const VertexArray*>(p)->vao);
+        break;
+      case Header::BUFFER_RANGE: {
+        const BufferRange* c = reinterpret_cast<const BufferRange*>(p);
+        state.bindBufferRange(c->target, c->index, c->buffer, c->offset, c->size);
+        break;
+      }
+      case Header::UNIFORM_INT: {
+        const UniformInt* c = reinterpret_cast<const UniformInt*>(p);
+        if (shader != nullptr) shader->set(c->handle, c->x);
+        break;
+      }
+      case Header::UNIFORM1:
+      case Header::UNIFORM2:
+      case Header::UNIFORM3:
+      case Header::UNIFORM4: {
+        const Uniform* c = reinterpret_cast<const Uniform*>(p);
+        if (shader == nullptr) break;
+        if (h->op == Header::UNIFORM1) shader->set(c->handle, c->v[0]);
+        else if (h->op == Header::UNIFORM2) shader->set(c->handle, c->v[0], c->v[1]);
+        else if (h->op == Header::UNIFORM3) shader->set(c->handle, c->v[0], c->v[1], c->v[2]);
+        else shader->set(c->handle, c->v[0], c->v[1], c->v[2], c->v[3]);
+        break;
+      }
+      case Header::MATRIX4: {
+        const Matrix4* c = reinterpret_cast<const Matrix4*>(p);
+        if (shader != nullptr) shader->setMatrix4(c->handle, c->m);
+        break;
+      }
+      case Header::DRAW_ARRAYS: {
+        const DrawArrays* c = reinterpret_cast<const DrawArrays*>(p);
+        if (c->instances == 1) glDrawArrays(c->mode, c->first, c->count);
+        else glDrawArraysInstanced(c->mode, c->first, c->count, c->instances);
+        break;
+      }
+      case Header::DRAW_ELEMENTS: {
+        const DrawElements* c = reinterpret_cast<const DrawElements*>(p);
+        const GLvoid* indices = (const GLvoid *)c->offset;
+        if (c->instances == 1) glDrawElements(c->mode, c->count, c->type, indices);
+        else glDrawElementsInstanced(c->mode, c->count, c->type, indices, c->instances);
+        break;
+      }
+    }
+    p += h->size;
+  }
+}
+
+CommandRecorder::CommandRecorder(ThreadPool& pool) : pool(pool), recorded(0) {
+  for (unsigned i = 0; i < pool.size(); ++i) this->arenas.push_back(new LinearArena());
+}
+
+CommandRecorder::~CommandRecorder() {
+  for (size_t i = 0; i < this->arenas.size(); ++i) delete this->arenas[i];
+}
+
+void CommandRecorder::record(size_t count, size_t grain,
+                             const std::function<void(CommandList&, size_t, size_t)>& work) {
+  PROFILE_ZONE("CommandRecorder::record");
+  if (grain == 0) grain = 1;
+  for (size_t i = 0; i < this->arenas.size(); ++i) this->arenas[i]->reset();
+  this->recorded = (count + grain - 1)/grain;
+  if (this->commandLists.size() < this->recorded) this->commandLists.resize(this->recorded);
+  // one list per range, taken one at a time by whichever thread is free
+  this->pool.parallel(this->recorded, 1, [&](size_t list, unsigned thread) {
+    CommandList& l = this->commandLists[list];
+    l.begin(*this->arenas[thread]);
+    size_t begin = list*grain;
+    work(l, begin, begin + grain < count ? begin + grain : count);
+  });
+}
+
+void CommandRecorder::submit() const {
+  PROFILE_ZONE("CommandRecorder::submit");
+  for (size_t i = 0; i < this->recorded; ++i) this->commandLists[i].submit();
+}
+
+size_t CommandRecorder::commands() const {
+  size_t n = 0;
+  for (size_t i = 0; i < this->recorded; ++i) n += this->commandLists[i].size();
+  return n;
+}
+
+size_t CommandRecorder::draws() const {
+  size_t n = 0;
+  for (size_t i = 0; i < this->recorded; ++i) n += this->commandLists[i].draws();
+  return n;
+}
+
+size_t CommandRecorder::bytes() const {
+  size_t n = 0;
+  for (size_t i = 0; i < this->arenas.size(); ++i) n += this->arenas[i]->used();
+  return n;
+}
@@ -0,0 +1,138 @@
+#ifndef COMMAND_LIST_H
+#define COMMAND_LIST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <functional>
+
+#include <GL/glew.h>
+
+class Shader;
+class ThreadPool;
+
+// Bump allocator over a list of blocks. reset() keeps the blocks, so after
+// the first frames recording allocates nothing from the heap.
+class LinearArena {
+  public:
+    explicit LinearArena(size_t blockSize = 256*1024);
+    ~LinearArena();
+
+    // bytes aligned to alignment, a power of two up to 64
+    void* allocate(size_t bytes, size_t alignment = 8);
+    void reset();
+    size_t used() const;
+    size_t capacity() const;
+
+  private:
+    struct Block {
+      char* data;
+      size_t size;
+    };
+    std::vector<Block> blocks;
+    size_t blockSize;
+    size_t current;   // block allocate() takes from
+    size_t offset;    // into it
+
+    LinearArena(const LinearArena&);
+    LinearArena& operator=(const LinearArena&);
+};
+
+// Draw calls and the state they need, recorded on any thread without a GL
+// context and replayed later on the GL thread by submit(). Commands are a
+// few bytes each, packed into chunks of a LinearArena. A program or vertex
+// array bound again in the same list is not recorded at all; replay goes
+// through the StateCache and the Shader uniform shadows, so a bind or a
+// uniform equal to what the driver already has is dropped there.
+//
+//   list.begin(arena);
+//   list.use(shader);
+//   list.bindVertexArray(VAO);
+//   list.set(colorHandle, 1.0f, .5f, .2f, 1.0f);
+//   list.drawArrays(GL_TRIANGLES, 0, 3);
+//   ...
+//   list.submit();    // on the GL thread
+class CommandList {
+  public:
+    // What every recorded command starts with, see command_list.cc
+    struct Header;
+
+    CommandList();
+
+    // Start recording into arena, dropping what was recorded before. The
+    // arena must outlive the commands and only be used by one thread.
+    void begin(LinearArena& arena);
+
+    void use(Shader& shader);
+    void bindVertexArray(GLuint vao);
+    void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+    // Through the current program's Shader, like Shader::set
+    void set(GLint handle, GLint x);
+    void set(GLint handle, GLfloat x);
+    // a double literal would be ambiguous between the two above
+    void set(GLint handle, double x) { this->set(handle, GLfloat(x)); }
+    void set(GLint handle, GLfloat x, GLfloat y);
+    void set(GLint handle, GLfloat x, GLfloat y, GLfloat z);
+    void set(GLint handle, GLfloat x, GLfloat y, GLfloat z, GLfloat w);
+    void setMatrix4(GLint handle, const GLfloat* m);
+    void drawArrays(GLenum mode, GLint first, GLsizei count, GLsizei instances = 1);
+    // offset in bytes into the bound element buffer
+    void drawElements(GLenum mode, GLsizei count, GLenum type, size_t offset, GLsizei instances = 1);
+
+    // Issue every command in recording order, on the GL thread
+    void submit() const;
+    size_t size() const { return this->count; }
+    size_t draws() const { return this->drawCount; }
+
+  private:
+    LinearArena* arena;
+    char* first;
+    char* cursor;
+    char* limit;
+    size_t count;
+    size_t drawCount;
+    // the last use() and bindVertexArray(), repeats are not recorded
+    Shader* shader;
+    GLuint vao;
+
+    template <typename T> T* push();
+    void uniform(int components, GLint handle, GLfloat x, GLfloat y, GLfloat z, GLfloat w);
+};
+
+// Frame preparation split across a ThreadPool: record() cuts the objects
+// into grain sized ranges and records each into a CommandList of its own,
+// in the arena of the thread that takes it. submit() replays the lists in
+// range order, so the frame is the same whatever thread recorded what.
+//
+//   CommandRecorder recorder(pool);
+//   recorder.record(objects.size(), 512, [&](CommandList& list, size_t begin, size_t end) {
+//     for (size_t i = begin; i < end; ++i) prepare(objects[i], list);
+//   });
+//   recorder.submit();
+class CommandRecorder {
+  public:
+    explicit CommandRecorder(ThreadPool& pool);
+    ~CommandRecorder();
+
+    // Drops the lists of the previous record() and reuses their memory
+    void record(size_t count, size_t grain,
+                const std::function<void(CommandList& list, size_t begin, size_t end)>& work);
+    void submit() const;
+
+    size_t lists() const { return this->recorded; }
+    size_t commands() const;
+    size_t draws() const;
+    // Arena bytes in use over all threads
+    size_t bytes() const;
+
+  private:
+    ThreadPool& pool;
+    std::vector<LinearArena*> arenas;   // one per pool thread
+    std::vector<CommandList> commandLists;
+    size_t recorded;
+
+    CommandRecorder(const CommandRecorder&);
+    CommandRecorder& operator=(const CommandRecorder&);
+};
+
+#endif
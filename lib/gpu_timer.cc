@@ -0,0 +1,115 @@
+#include "gpu_timer.hh"
+
+#ifdef LEARNOPENGL_GPU_TIMING
+
+#include <chrono>
+#include <iomanip>
+
+namespace {
+  double nowMs() {
+    return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+}
+
+GpuTimer::GpuTimer() : frame(0), dropped(0) {
+  for (int i = 0; i < FRAMES; ++i) this->slots[i].used = 0;
+}
+
+GpuTimer::~GpuTimer() {
+  for (int i = 0; i < FRAMES; ++i)
+    if (not this->slots[i].pool.empty())
+      glDeleteQueries(this->slots[i].pool.size(), this->slots[i].pool.data());
+}
+
+GLuint GpuTimer::query(Slot& slot) {
+  if (slot.used == slot.pool.size()) {
+    GLuint id;
+    glGenQueries(1, &id);
+    slot.pool.push_back(id);
+  }
+  return slot.pool[slot.used++];
+}
+
+void GpuTimer::collect(Slot& slot) {
+  if (slot.records.empty()) return;
+  // timestamps complete in order, the last one issued tells for the whole
+  // frame. With nested zones that is an outer zone's end, not the end of
+  // the last record.
+  GLint available = GL_FALSE;
+  glGetQueryObjectiv(slot.pool[slot.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+  if (not available) {
+    ++this->dropped;
+    return;
+  }
+  this->results.clear();
+  for (size_t i = 0; i < slot.records.size(); ++i) {
+    const Record& r = slot.records[i];
+    GLuint64 begin, end;
+    glGetQueryObjectui64v(r.begin, GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(r.end, GL_QUERY_RESULT, &end);
+    Zone zone = { r.name, r.depth, (end - begin)/1e6, r.cpuEnd - r.cpuBegin };
+    this->results.push_back(zone);
+
+    size_t t = 0;
+    while (t < this->totals.size() and (this->totals[t].name != r.name or this->totals[t].depth != r.depth)) ++t;
+    if (t == this->totals.size()) {
+      Total total = { r.name, r.depth, 0, 0, 0 };
+      this->totals.push_back(total);
+    }
+    this->totals[t].gpuMs += zone.gpuMs;
+    this->totals[t].cpuMs += zone.cpuMs;
+    ++this->totals[t].count;
+  }
+}
+
+void GpuTimer::beginFrame() {
+  Slot& slot = this->slots[this->frame % FRAMES];
+  // this slot was last used FRAMES frames ago
+  this->collect(slot);
+  slot.records.clear();
+  slot.used = 0;
+  this->open.clear();
+}
+
+void GpuTimer::endFrame() {
+  // zones left open by mistake are closed here
+  while (not this->open.empty()) this->end();
+  ++this->frame;
+}
+
+void GpuTimer::begin(const char* name) {
+  Slot& slot = this->slots[this->frame % FRAMES];
+  Record r;
+  r.name = name;
+  r.depth = this->open.size();
+  r.begin = this->query(slot);
+  r.end = 0;
+  glQueryCounter(r.begin, GL_TIMESTAMP);
+  r.cpuBegin = nowMs();
+  r.cpuEnd = r.cpuBegin;
+  this->open.push_back(slot.records.size());
+  slot.records.push_back(r);
+}
+
+void GpuTimer::end() {
+  if (this->open.empty()) return;
+  Slot& slot = this->slots[this->frame % FRAMES];
+  Record& r = slot.records[this->open.back()];
+  this->open.pop_back();
+  r.cpuEnd = nowMs();
+  r.end = this->query(slot);
+  glQueryCounter(r.end, GL_TIMESTAMP);
+}
+
+void GpuTimer::report(std::ostream& os) const {
+  os << "gpu timer: " << this->frame << " frames, " << this->dropped << " not ready in time" << std::endl;
+  for (size_t i = 0; i < this->totals.size(); ++i) {
+    const Total& t = this->totals[i];
+    os << std::string(2 + 2*t.depth, ' ') << std::left << std::setw(24 - 2*t.depth) << t.name
+       << " gpu " << std::fixed << std::setprecision(3) << t.gpuMs/t.count << " ms"
+       << "  cpu " << t.cpuMs/t.count << " ms" << std::defaultfloat << std::right << std::endl;
+  }
+}
+
+#endif
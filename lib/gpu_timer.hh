@@ -0,0 +1,103 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include <GL/glew.h>
+
+// GPU time of named zones in the render loop, next to their CPU time.
+// Each zone brackets its commands with glQueryCounter(GL_TIMESTAMP), so
+// zones may nest. The queries of a frame are read FRAMES frames later,
+// only if the driver already has them, so reading never stalls.
+//
+// Built only with LEARNOPENGL_GPU_TIMING defined; otherwise every call is an
+// empty inline function and GPU_ZONE expands to nothing.
+//
+//   GpuTimer timer;
+//   timer.beginFrame();
+//   { GPU_ZONE(timer, "triangles"); glDrawArrays(...); }
+//   timer.endFrame();
+class GpuTimer {
+  public:
+    // Frames between issuing a query and reading it
+    static const int FRAMES = 4;
+
+    struct Zone {
+      const char* name;
+      int depth;      // nesting level, 0 for top level zones
+      double gpuMs;
+      double cpuMs;
+    };
+
+#ifdef LEARNOPENGL_GPU_TIMING
+    GpuTimer();
+    ~GpuTimer();
+    void beginFrame();
+    void endFrame();
+    // name must outlive the timer, string literals are fine
+    void begin(const char* name);
+    void end();
+    // Zones of the most recent frame whose results came back
+    const std::vector<Zone>& latest() const { return results; }
+    // Average per zone over every frame read back so far
+    void report(std::ostream& os) const;
+
+  private:
+    struct Record {
+      const char* name;
+      int depth;
+      GLuint begin, end;
+      double cpuBegin, cpuEnd;
+    };
+    struct Slot {
+      std::vector<GLuint> pool;
+      size_t used;
+      std::vector<Record> records;
+    };
+    struct Total {
+      const char* name;
+      int depth;
+      double gpuMs, cpuMs;
+      unsigned count;
+    };
+    Slot slots[FRAMES];
+    unsigned frame;
+    unsigned dropped;  // frames whose results were not ready in time
+    std::vector<size_t> open;
+    std::vector<Zone> results;
+    std::vector<Total> totals;
+
+    GLuint query(Slot& slot);
+    void collect(Slot& slot);
+
+    GpuTimer(const GpuTimer&);
+    GpuTimer& operator=(const GpuTimer&);
+#else
+    void beginFrame() {}
+    void endFrame() {}
+    void begin(const char*) {}
+    void end() {}
+    const std::vector<Zone>& latest() const { static const std::vector<Zone> none; return none; }
+    void report(std::ostream&) const {}
+#endif
+};
+
+#ifdef LEARNOPENGL_GPU_TIMING
+// Times the rest of the enclosing scope
+class GpuZone {
+  public:
+    GpuZone(GpuTimer& timer, const char* name) : timer(timer) { timer.begin(name); }
+    ~GpuZone() { timer.end(); }
+  private:
+    GpuTimer& timer;
+};
+#define GPU_ZONE_CONCAT(a, b) a##b
+#define GPU_ZONE_NAME(line) GPU_ZONE_CONCAT(gpuZone, line)
+#define GPU_ZONE(timer, name) GpuZone GPU_ZONE_NAME(__LINE__)(timer, name)
+#else
+#define GPU_ZONE(timer, name)
+#endif
+
+#endif
@@ -0,0 +1,115 @@
+#include "headless.hh"
+#include "state_cache.hh"
+
+#include <EGL/eglext.h>
+
+namespace {
+  const EGLint contextAttributes[] = {
+    EGL_CONTEXT_MAJOR_VERSION, 3,
+    EGL_CONTEXT_MINOR_VERSION, 3,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+    EGL_NONE
+  };
+}
+
+HeadlessContext::HeadlessContext(int width, int height)
+  : Framebuffer(0), width(width), height(height),
+    display(EGL_NO_DISPLAY), context(EGL_NO_CONTEXT), colorbuffer(0) {
+  // surfaceless platform first, then whatever the default display is
+  PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+    (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+  if (getPlatformDisplay != nullptr)
+    this->display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+  if (this->display == EGL_NO_DISPLAY)
+    this->display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+  EGLint major, minor;
+  if (this->display == EGL_NO_DISPLAY or not eglInitialize(this->display, &major, &minor)) {
+    std::cout << "ERROR::HEADLESS::EGL_INITIALIZE_FAILED" << std::endl;
+    this->display = EGL_NO_DISPLAY;
+    return;
+  }
+  if (not eglBindAPI(EGL_OPENGL_API)) {
+    std::cout << "ERROR::HEADLESS::NO_DESKTOP_GL" << std::endl;
+    return;
+  }
+
+  // EGL_KHR_no_config_context: we never render to an EGL surface
+  this->context = eglCreateContext(this->display, (EGLConfig) 0, EGL_NO_CONTEXT, contextAttributes);
+  if (this->context == EGL_NO_CONTEXT) {
+    std::cout << "ERROR::HEADLESS::CONTEXT_CREATION_FAILED 0x" << std::hex << eglGetError() << std::dec << std::endl;
+    return;
+  }
+  eglMakeCurrent(this->display, EGL_NO_SURFACE, EGL_NO_SURFACE, this->context);
+
+  // start glew, a GLX-only build complains about the missing display after
+  // having loaded every entry point, which is fine for us
+  glewExperimental = GL_TRUE;
+  GLenum status = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+  if (status == GLEW_ERROR_NO_GLX_DISPLAY) status = GLEW_OK;
+#endif
+  if (status != GLEW_OK) {
+    std::cout << "Failed to initialize GLEW" << std::endl;
+    eglDestroyContext(this->display, this->context);
+    this->context = EGL_NO_CONTEXT;
+    return;
+  }
+
+  glGenRenderbuffers(1, &this->colorbuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, this->colorbuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glGenFramebuffers(1, &this->Framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, this->Framebuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, this->colorbuffer);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    std::cout << "ERROR::HEADLESS::FRAMEBUFFER_INCOMPLETE" << std::endl;
+  StateCache::global().invalidate();
+  StateCache::global().viewport(0, 0, width, height);
+}
+
+HeadlessContext::~HeadlessContext() {
+  if (this->context != EGL_NO_CONTEXT) {
+    eglMakeCurrent(this->display, EGL_NO_SURFACE, EGL_NO_SURFACE, this->context);
+    glDeleteFramebuffers(1, &this->Framebuffer);
+    glDeleteRenderbuffers(1, &this->colorbuffer);
+    eglMakeCurrent(this->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(this->display, this->context);
+  }
+  if (this->display != EGL_NO_DISPLAY)
+    eglTerminate(this->display);
+}
+
+bool HeadlessContext::valid() const {
+  return this->context != EGL_NO_CONTEXT;
+}
+
+void HeadlessContext::makeCurrent() {
+  eglMakeCurrent(this->display, EGL_NO_SURFACE, EGL_NO_SURFACE, this->context);
+  glBindFramebuffer(GL_FRAMEBUFFER, this->Framebuffer);
+  // whatever the cache knew was about the previous context
+  StateCache::global().invalidate();
+  StateCache::global().viewport(0, 0, this->width, this->height);
+}
+
+void HeadlessContext::readPixels(unsigned char* rgba) {
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, this->Framebuffer);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, this->width, this->height, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+}
+
+EGLContext HeadlessContext::createShared() {
+  if (not this->valid()) return EGL_NO_CONTEXT;
+  EGLContext shared = eglCreateContext(this->display, (EGLConfig) 0, this->context, contextAttributes);
+  if (shared == EGL_NO_CONTEXT)
+    std::cout << "ERROR::HEADLESS::SHARED_CONTEXT_CREATION_FAILED 0x" << std::hex << eglGetError() << std::dec << std::endl;
+  return shared;
+}
+
+bool HeadlessContext::makeCurrent(EGLContext shared) {
+  return eglMakeCurrent(this->display, EGL_NO_SURFACE, EGL_NO_SURFACE, shared) == EGL_TRUE;
+}
+
+void HeadlessContext::destroyShared(EGLContext shared) {
+  if (shared != EGL_NO_CONTEXT) eglDestroyContext(this->display, shared);
+}
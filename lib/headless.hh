@@ -0,0 +1,45 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <iostream>
+
+#include <GL/glew.h>
+#include <EGL/egl.h>
+
+// Offscreen GL 3.3 core context without any window system.
+// Uses a surfaceless EGL display (Mesa llvmpipe works), and renders into
+// an RGBA8 framebuffer object of the requested size.
+class HeadlessContext {
+  public:
+    // The framebuffer every frame should be rendered into
+    GLuint Framebuffer;
+    int width, height;
+
+    HeadlessContext(int width, int height);
+    ~HeadlessContext();
+    // False if no context could be created, errors are already printed
+    bool valid() const;
+    // Make the context current on the calling thread and bind the FBO
+    void makeCurrent();
+    // Read back the color buffer as tightly packed RGBA8
+    void readPixels(unsigned char* rgba);
+
+    // A second context sharing buffers, textures and programs with this
+    // one, for another thread. It has no framebuffer and leaves the
+    // StateCache alone. EGL_NO_CONTEXT on failure.
+    EGLContext createShared();
+    // Make a shared context current on the calling thread, EGL_NO_CONTEXT
+    // releases whatever is current there
+    bool makeCurrent(EGLContext shared);
+    void destroyShared(EGLContext shared);
+
+  private:
+    EGLDisplay display;
+    EGLContext context;
+    GLuint colorbuffer;
+
+    HeadlessContext(const HeadlessContext&);
+    HeadlessContext& operator=(const HeadlessContext&);
+};
+
+#endif
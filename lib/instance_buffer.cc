@@ -0,0 +1,57 @@
+#include "instance_buffer.hh"
+#include "state_cache.hh"
+
+InstanceBuffer::InstanceBuffer(const std::vector<GLint>& components, GLuint firstLocation)
+  : components(components), firstLocation(firstLocation), buffer(0), floats(0),
+    instances(0), capacity(0) {
+  for (size_t i = 0; i < components.size(); ++i) this->floats += components[i];
+  glGenBuffers(1, &this->buffer);
+}
+
+InstanceBuffer::~InstanceBuffer() {
+  glDeleteBuffers(1, &this->buffer);
+  StateCache::global().invalidate();
+}
+
+void InstanceBuffer::upload(const GLfloat* data, GLsizei count) {
+  StateCache::global().bindBuffer(GL_ARRAY_BUFFER, this->buffer);
+  GLsizeiptr bytes = GLsizeiptr(count)*this->floats*sizeof(GLfloat);
+  if (count > this->capacity) {
+    glBufferData(GL_ARRAY_BUFFER, bytes, data, GL_STREAM_DRAW);
+    this->capacity = count;
+  }
+  else {
+    // orphan, then fill the fresh storage
+    glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(this->capacity)*this->floats*sizeof(GLfloat), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, data);
+  }
+  this->instances = count;
+}
+
+void InstanceBuffer::attach(GLuint vao) {
+  StateCache& state = StateCache::global();
+  state.bindVertexArray(vao);
+  state.bindBuffer(GL_ARRAY_BUFFER, this->buffer);
+  GLsizei offset = 0;
+  for (size_t i = 0; i < this->components.size(); ++i) {
+    GLuint location = this->firstLocation + i;
+    glVertexAttribPointer(location, this->components[i], GL_FLOAT, GL_FALSE,
+                          this->floats*sizeof(GLfloat), (GLvoid *)(offset*sizeof(GLfloat)));
+    glEnableVertexAttribArray(location);
+    // advance once per instance instead of once per vertex
+    glVertexAttribDivisor(location, 1);
+    offset += this->components[i];
+  }
+}
+
+void InstanceBuffer::drawArrays(GLuint vao, GLenum mode, GLint first, GLsizei vertices) const {
+  if (this->instances == 0) return;
+  StateCache::global().bindVertexArray(vao);
+  glDrawArraysInstanced(mode, first, vertices, this->instances);
+}
+
+void InstanceBuffer::drawElements(GLuint vao, GLenum mode, GLsizei indices, GLenum type, const GLvoid* offset) const {
+  if (this->instances == 0) return;
+  StateCache::global().bindVertexArray(vao);
+  glDrawElementsInstanced(mode, indices, type, offset, this->instances);
+}
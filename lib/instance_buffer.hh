@@ -0,0 +1,49 @@
+#ifndef INSTANCE_BUFFER_H
+#define INSTANCE_BUFFER_H
+
+#include <vector>
+#include <cstddef>
+
+#include <GL/glew.h>
+
+// A stream of per instance float attributes, interleaved in one buffer and
+// read once per instance (glVertexAttribDivisor 1) by the VAOs it is
+// attached to. Attributes take the locations firstLocation, +1, ... with
+// the given component counts.
+//
+//   InstanceBuffer instances({2, 3}, 1);  // vec2 offset, vec3 color
+//   instances.upload(data, count);
+//   instances.attach(VAO);
+//   instances.drawArrays(VAO, GL_TRIANGLES, 0, 3);
+class InstanceBuffer {
+  public:
+    InstanceBuffer(const std::vector<GLint>& components, GLuint firstLocation);
+    ~InstanceBuffer();
+
+    // Replace the instance data with count instances. The storage is
+    // orphaned each time, so a frame still reading the old data never
+    // stalls this call.
+    void upload(const GLfloat* data, GLsizei count);
+    // Point the attributes of vao at this buffer
+    void attach(GLuint vao);
+    // Draw every instance, vao must be attached
+    void drawArrays(GLuint vao, GLenum mode, GLint first, GLsizei vertices) const;
+    void drawElements(GLuint vao, GLenum mode, GLsizei indices, GLenum type, const GLvoid* offset) const;
+
+    GLsizei count() const { return instances; }
+    // floats per instance
+    GLsizei stride() const { return floats; }
+
+  private:
+    std::vector<GLint> components;
+    GLuint firstLocation;
+    GLuint buffer;
+    GLsizei floats;
+    GLsizei instances;
+    GLsizei capacity;
+
+    InstanceBuffer(const InstanceBuffer&);
+    InstanceBuffer& operator=(const InstanceBuffer&);
+};
+
+#endif
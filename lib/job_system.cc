@@ -0,0 +1,221 @@
+#include "job_system.hh"
+#include "profiler.hh"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+  // the JobSystem the calling thread works for, and as which worker
+  thread_local const JobSystem* currentSystem = nullptr;
+  thread_local unsigned currentWorker = 0;
+  // rounds without finding a job before a worker sleeps
+  const int SPINS = 64;
+}
+
+JobSystem::Deque::Deque(size_t capacity) : buffer(capacity), mask(capacity - 1), top(0), bottom(0) {}
+
+bool JobSystem::Deque::push(Job* job) {
+  int64_t b = this->bottom.load(std::memory_order_relaxed);
+  int64_t t = this->top.load(std::memory_order_acquire);
+  if (b - t > this->mask) return false;
+  this->buffer[b & this->mask].store(job, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  this->bottom.store(b + 1, std::memory_order_relaxed);
+  return true;
+}
+
+JobSystem::Job* JobSystem::Deque::pop() {
+  int64_t b = this->bottom.load(std::memory_order_relaxed) - 1;
+  this->bottom.store(b, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t t = this->top.load(std::memory_order_relaxed);
+  if (t > b) {
+    // empty
+    this->bottom.store(b + 1, std::memory_order_relaxed);
+    return nullptr;
+  }
+  Job* job = this->buffer[b & this->mask].load(std::memory_order_relaxed);
+  if (t == b) {
+    // the last one, a thief may be taking it too
+    if (not this->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+      job = nullptr;
+    this->bottom.store(b + 1, std::memory_order_relaxed);
+  }
+  return job;
+}
+
+JobSystem::Job* JobSystem::Deque::steal() {
+  int64_t t = this->top.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t b = this->bottom.load(std::memory_order_acquire);
+  if (t >= b) return nullptr;
+  Job* job = this->buffer[t & this->mask].load(std::memory_order_relaxed);
+  // lost to the owner or another thief
+  if (not this->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+    return nullptr;
+  return job;
+}
+
+JobSystem::JobSystem(unsigned threads) : stopping(false), pushes(0), sleepers(0) {
+  if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned i = 0; i < threads; ++i) {
+    Worker* worker = new Worker;
+    worker->deque = new Deque(JOBS_PER_THREAD);
+    worker->jobs = new Job[JOBS_PER_THREAD];
+    for (size_t j = 0; j < JOBS_PER_THREAD; ++j) worker->jobs[j].unfinished.store(0, std::memory_order_relaxed);
+    worker->next = 0;
+    worker->random = 2654435761u*(i + 1);
+    worker->executed.store(0);
+    worker->stolen.store(0);
+    this->workers.push_back(worker);
+  }
+  currentSystem = this;
+  currentWorker = 0;
+  for (unsigned i = 1; i < threads; ++i) this->threads.push_back(std::thread(&JobSystem::loop, this, i));
+}
+
+JobSystem::~JobSystem() {
+  this->stopping = true;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+  }
+  this->wakeup.notify_all();
+  for (size_t i = 0; i < this->threads.size(); ++i) this->threads[i].join();
+  for (size_t i = 0; i < this->workers.size(); ++i) {
+    delete this->workers[i]->deque;
+    delete[] this->workers[i]->jobs;
+    delete this->workers[i];
+  }
+  if (currentSystem == this) currentSystem = nullptr;
+}
+
+unsigned JobSystem::current() const {
+  if (currentSystem != this) {
+    std::cout << "ERROR::JOB_SYSTEM::NOT_A_WORKER_THREAD" << std::endl;
+    std::abort();
+  }
+  return currentWorker;
+}
+
+JobSystem::Job* JobSystem::allocate() {
+  unsigned worker = this->current();
+  Worker& w = *this->workers[worker];
+  for (;;) {
+    // take the next finished slot in the ring, jobs finish about in order
+    for (size_t i = 0; i < JOBS_PER_THREAD; ++i) {
+      Job* job = &w.jobs[w.next++ & (JOBS_PER_THREAD - 1)];
+      if (this->finished(job)) return job;
+    }
+    // all in flight, help until some finish
+    Job* job = this->find(worker);
+    if (job != nullptr) this->execute(job, worker);
+    else std::this_thread::yield();
+  }
+}
+
+void JobSystem::run(Job* job) {
+  unsigned worker = this->current();
+  if (not this->workers[worker]->deque->push(job)) {
+    // deque full, no use queueing more
+    this->execute(job, worker);
+    return;
+  }
+  this->pushes.fetch_add(1);
+  if (this->sleepers.load() > 0) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->wakeup.notify_one();
+  }
+}
+
+void JobSystem::wait(const Job* job) {
+  unsigned worker = this->current();
+  while (not this->finished(job)) {
+    Job* next = this->find(worker);
+    if (next != nullptr) this->execute(next, worker);
+    else std::this_thread::yield();
+  }
+}
+
+JobSystem::Job* JobSystem::find(unsigned worker) {
+  Worker& w = *this->workers[worker];
+  Job* job = w.deque->pop();
+  if (job != nullptr or this->workers.size() == 1) return job;
+  // a random victim first so thieves spread out, then the others in turn
+  w.random ^= w.random << 13;
+  w.random ^= w.random >> 17;
+  w.random ^= w.random << 5;
+  size_t n = this->workers.size();
+  size_t start = w.random % n;
+  for (size_t i = 0; i < n; ++i) {
+    size_t victim = (start + i) % n;
+    if (victim == worker) continue;
+    job = this->workers[victim]->deque->steal();
+    if (job != nullptr) {
+      w.stolen.fetch_add(1, std::memory_order_relaxed);
+      return job;
+    }
+  }
+  return nullptr;
+}
+
+void JobSystem::execute(Job* job, unsigned worker) {
+  job->function(*job);
+  job->destroy(*job);
+  this->workers[worker]->executed.fetch_add(1, std::memory_order_relaxed);
+  this->finish(job);
+}
+
+void JobSystem::finish(Job* job) {
+  while (job != nullptr) {
+    // read before counting down, a finished job can be reused right away
+    Job* parent = job->parent;
+    if (job->unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+    job = parent;
+  }
+}
+
+void JobSystem::loop(unsigned worker) {
+  currentSystem = this;
+  currentWorker = worker;
+  Profiler::threadName("jobs");
+  int idle = 0;
+  while (not this->stopping.load(std::memory_order_relaxed)) {
+    Job* job = this->find(worker);
+    if (job != nullptr) {
+      this->execute(job, worker);
+      idle = 0;
+      continue;
+    }
+    if (++idle < SPINS) {
+      std::this_thread::yield();
+      continue;
+    }
+    // nothing to steal for a while, sleep until the next push. A push after
+    // reading pushes changes it, and one before is found by the last look.
+    unsigned seen = this->pushes.load();
+    this->sleepers.fetch_add(1);
+    job = this->find(worker);
+    if (job != nullptr) {
+      this->sleepers.fetch_sub(1);
+      this->execute(job, worker);
+      idle = 0;
+      continue;
+    }
+    {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      this->wakeup.wait(lock, [&]() { return this->stopping.load() or this->pushes.load() != seen; });
+    }
+    this->sleepers.fetch_sub(1);
+    idle = 0;
+  }
+}
+
+JobSystem::Counters JobSystem::endFrame() {
+  Counters counters = { 0, 0 };
+  for (size_t i = 0; i < this->workers.size(); ++i) {
+    counters.executed += this->workers[i]->executed.exchange(0, std::memory_order_relaxed);
+    counters.stolen += this->workers[i]->stolen.exchange(0, std::memory_order_relaxed);
+  }
+  return counters;
+}
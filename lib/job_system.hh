@@ -0,0 +1,179 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <utility>
+#include <condition_variable>
+
+// Work stealing scheduler for per-frame CPU work. Every worker owns a
+// Chase-Lev deque: it pushes and pops its own jobs at the bottom, idle
+// workers steal from the top of a random other deque, so new, small work
+// stays on the thread whose caches have its data and old, large work
+// spreads out. The thread that creates the JobSystem is worker 0; call
+// run() and wait() from it or from inside a job.
+//
+// A job counts itself and its unfinished children. It finishes once its
+// function has returned and every child has finished, which is what
+// wait() waits for, running other jobs meanwhile rather than blocking.
+//
+//   JobSystem jobs;
+//   JobSystem::Job* frame = jobs.create([]() {});
+//   jobs.run(jobs.create([&]() { cull(); }, frame));
+//   jobs.run(jobs.create([&]() { animate(); }, frame));
+//   jobs.run(frame);
+//   jobs.wait(frame);
+//
+//   jobs.parallelFor(objects.size(), 256, [&](size_t begin, size_t end) {
+//     for (size_t i = begin; i < end; ++i) update(objects[i]);
+//   });
+class JobSystem {
+  public:
+    // Lambda captures up to this many bytes fit in a job
+    static const size_t JOB_DATA = 88;
+    // Unfinished jobs a thread can have created; past that create() runs
+    // other jobs until one finishes
+    static const size_t JOBS_PER_THREAD = 4096;
+
+    struct Job {
+      void (*function)(Job& job);
+      void (*destroy)(Job& job);
+      Job* parent;
+      std::atomic<int> unfinished;   // itself and its children
+      alignas(8) char data[JOB_DATA];
+    };
+
+    // threads 0 is one per core, the calling thread included
+    explicit JobSystem(unsigned threads = 0);
+    ~JobSystem();
+
+    unsigned size() const { return this->workers.size(); }
+
+    // A job running function() once run(); with a parent, the parent does
+    // not finish before it. Every job created must be run. Once finished
+    // the Job can be reused by the next create() on its thread.
+    template <typename Function>
+    Job* create(Function function, Job* parent = nullptr);
+    void run(Job* job);
+    // Run jobs until job has finished
+    void wait(const Job* job);
+    bool finished(const Job* job) const { return job->unfinished.load(std::memory_order_acquire) == 0; }
+
+    // function(begin, end) over [0, count), split in halves down to at most
+    // grain items, returns when everything is done
+    template <typename Function>
+    void parallelFor(size_t count, size_t grain, const Function& function);
+
+    // Jobs run and taken from another worker's deque, reset by endFrame()
+    struct Counters {
+      unsigned long long executed;
+      unsigned long long stolen;
+    };
+    Counters endFrame();
+
+  private:
+    // Chase-Lev work stealing deque of fixed capacity, after Le, Pop,
+    // Cohen and Zappa Nardelli, "Correct and Efficient Work-Stealing for
+    // Weak Memory Models" (2013)
+    class Deque {
+      public:
+        explicit Deque(size_t capacity);
+        // owner only; false when full
+        bool push(Job* job);
+        Job* pop();
+        // any thread
+        Job* steal();
+
+      private:
+        std::vector<std::atomic<Job*> > buffer;
+        int64_t mask;
+        // thieves write top, the owner bottom, keep them on separate lines
+        char padding0[64];
+        std::atomic<int64_t> top;
+        char padding1[64];
+        std::atomic<int64_t> bottom;
+    };
+
+    struct Worker {
+      Deque* deque;
+      Job* jobs;                  // ring of JOBS_PER_THREAD
+      size_t next;                // in jobs
+      uint32_t random;            // victim choice
+      std::atomic<unsigned long long> executed, stolen;
+      char padding[64];
+    };
+
+    std::vector<Worker*> workers;
+    std::vector<std::thread> threads;
+    std::atomic<bool> stopping;
+    // sleeping when there is nothing to steal
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::atomic<unsigned> pushes;
+    std::atomic<int> sleepers;
+
+    Job* allocate();
+    Job* find(unsigned worker);
+    void execute(Job* job, unsigned worker);
+    void finish(Job* job);
+    void loop(unsigned worker);
+    // index of the calling thread in workers
+    unsigned current() const;
+
+    template <typename Function>
+    static void split(JobSystem* system, Job* root, const Function* function,
+                      size_t begin, size_t end, size_t grain);
+
+    JobSystem(const JobSystem&);
+    JobSystem& operator=(const JobSystem&);
+};
+
+template <typename Function>
+JobSystem::Job* JobSystem::create(Function function, Job* parent) {
+  static_assert(sizeof(Function) <= JOB_DATA, "job function captures too much, capture by reference");
+  static_assert(alignof(Function) <= 8, "job function needs more than 8 byte alignment");
+  Job* job = this->allocate();
+  new (job->data) Function(std::move(function));
+  job->function = [](Job& j) { (*reinterpret_cast<Function*>(j.data))(); };
+  job->destroy = [](Job& j) { reinterpret_cast<Function*>(j.data)->~Function(); };
+  job->parent = parent;
+  job->unfinished.store(1, std::memory_order_relaxed);
+  if (parent != nullptr) parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+  return job;
+}
+
+template <typename Function>
+void JobSystem::split(JobSystem* system, Job* root, const Function* function,
+                      size_t begin, size_t end, size_t grain) {
+  // hand the upper halves to the deque, where thieves take the largest
+  // first, and keep going with the lower ones
+  while (end - begin > grain) {
+    size_t middle = begin + (end - begin)/2;
+    system->run(system->create([system, root, function, middle, end, grain]() {
+      split(system, root, function, middle, end, grain);
+    }, root));
+    end = middle;
+  }
+  (*function)(begin, end);
+}
+
+template <typename Function>
+void JobSystem::parallelFor(size_t count, size_t grain, const Function& function) {
+  if (count == 0) return;
+  if (grain == 0) grain = 1;
+  JobSystem* system = this;
+  const Function* f = &function;
+  Job* root = this->create([]() {});
+  this->run(this->create([system, root, f, count, grain]() {
+    split(system, root, f, 0, count, grain);
+  }, root));
+  this->run(root);
+  this->wait(root);
+}
+
+#endif
@@ -0,0 +1,40 @@
+#include "latency.hh"
+
+#include <ctime>
+
+uint64_t latency::now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return uint64_t(ts.tv_sec)*1000000000ull + ts.tv_nsec;
+}
+
+void latency::add(std::vector<unsigned>& histogram, double ms) {
+  if (histogram.empty()) histogram.resize(BUCKETS);
+  int bucket = ms < 0 ? 0 : int(ms/BUCKET_MS);
+  ++histogram[bucket < BUCKETS ? bucket : BUCKETS - 1];
+}
+
+double latency::percentile(const std::vector<unsigned>& histogram, double p) {
+  unsigned long long total = 0;
+  for (size_t i = 0; i < histogram.size(); ++i) total += histogram[i];
+  if (total == 0) return 0;
+  // the upper edge of the bucket holding the p-th event
+  unsigned long long rank = (unsigned long long)(p/100.0*(total - 1)) + 1, seen = 0;
+  for (size_t i = 0; i < histogram.size(); ++i) {
+    seen += histogram[i];
+    if (seen >= rank) return (i + 1)*BUCKET_MS;
+  }
+  return histogram.size()*BUCKET_MS;
+}
+
+void latency::report(std::ostream& os, const std::vector<unsigned>& histogram, double max) {
+  unsigned long long total = 0;
+  for (size_t i = 0; i < histogram.size(); ++i) total += histogram[i];
+  os << total << " events, event to present";
+  if (total == 0) {
+    os << std::endl;
+    return;
+  }
+  os << " p50 " << percentile(histogram, 50) << " p90 " << percentile(histogram, 90)
+     << " p99 " << percentile(histogram, 99) << " max " << max << " ms" << std::endl;
+}
@@ -0,0 +1,24 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <iostream>
+#include <vector>
+#include <cstdint>
+
+// Event to present latency, shared by MainLoop and RenderThread: a
+// monotonic clock to stamp events with and a histogram of BUCKETS buckets
+// of BUCKET_MS, everything slower going into the last one.
+namespace latency {
+  const int BUCKETS = 10000;
+  const double BUCKET_MS = 0.1;
+
+  // Nanoseconds on CLOCK_MONOTONIC, what InputEvent::time holds
+  uint64_t now();
+
+  void add(std::vector<unsigned>& histogram, double ms);
+  double percentile(const std::vector<unsigned>& histogram, double p);
+  // "n events, event to present p50 .. p90 .. p99 .. max .. ms"
+  void report(std::ostream& os, const std::vector<unsigned>& histogram, double max);
+}
+
+#endif
@@ -0,0 +1,143 @@
+#include "main_loop.hh"
+#include "profiler.hh"
+#include "state_cache.hh"
+#include "latency.hh"
+
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+namespace {
+  double clockSeconds(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+  }
+}
+
+MainLoop::MainLoop(GLFWwindow* window, Mode mode)
+  : idleTimeout(0.1), window(window), mode(mode), dirty(true), maxLatency(0) {
+  std::memset(&this->stats, 0, sizeof(this->stats));
+  const char* env = std::getenv("LEARNOPENGL_LOOP");
+  if (env != nullptr and std::strcmp(env, "continuous") == 0) this->mode = CONTINUOUS;
+  if (env != nullptr and std::strcmp(env, "idle") == 0) this->mode = IDLE;
+
+  glfwSetWindowUserPointer(window, this);
+  this->previousKey = glfwSetKeyCallback(window, keyCallback);
+  this->previousCursor = glfwSetCursorPosCallback(window, cursorCallback);
+  this->previousButton = glfwSetMouseButtonCallback(window, buttonCallback);
+  this->previousResize = glfwSetFramebufferSizeCallback(window, resizeCallback);
+  glfwSetWindowRefreshCallback(window, refreshCallback);
+}
+
+MainLoop::~MainLoop() {
+  glfwSetKeyCallback(this->window, this->previousKey);
+  glfwSetCursorPosCallback(this->window, this->previousCursor);
+  glfwSetMouseButtonCallback(this->window, this->previousButton);
+  glfwSetFramebufferSizeCallback(this->window, this->previousResize);
+  glfwSetWindowRefreshCallback(this->window, nullptr);
+  glfwSetWindowUserPointer(this->window, nullptr);
+}
+
+void MainLoop::run(const std::function<void()>& render) {
+  this->run(std::function<void()>(), render);
+}
+
+void MainLoop::run(const std::function<void()>& update, const std::function<void()>& render) {
+  double wallStart = clockSeconds(CLOCK_MONOTONIC);
+  double cpuStart = clockSeconds(CLOCK_PROCESS_CPUTIME_ID);
+
+  while (!glfwWindowShouldClose(this->window)) {
+    {
+      PROFILE_ZONE("poll events");
+      glfwPollEvents();
+    }
+    // before deciding to sleep, so an animation that invalidates every
+    // frame keeps the loop drawing at full rate
+    if (update) {
+      PROFILE_ZONE("update");
+      update();
+    }
+
+    // nothing to draw: sleep until an event or the timeout, then go round
+    // again so update() still gets to notice things like edited shaders
+    if (this->mode == IDLE and not this->dirty) {
+      PROFILE_ZONE("wait events");
+      glfwWaitEventsTimeout(this->idleTimeout);
+      ++this->stats.skipped;
+      continue;
+    }
+    this->dirty = false;
+    {
+      PROFILE_ZONE("render");
+      render();
+    }
+    {
+      PROFILE_ZONE("swap");
+      // refresh
+      glfwSwapBuffers(this->window);
+    }
+    uint64_t presented = latency::now();
+    for (size_t i = 0; i < this->arrivals.size(); ++i) {
+      double ms = (presented - this->arrivals[i])*1e-6;
+      latency::add(this->histogram, ms);
+      if (ms > this->maxLatency) this->maxLatency = ms;
+    }
+    this->arrivals.clear();
+    ++this->stats.frames;
+  }
+
+  this->stats.seconds += clockSeconds(CLOCK_MONOTONIC) - wallStart;
+  double cpu = clockSeconds(CLOCK_PROCESS_CPUTIME_ID) - cpuStart;
+  if (this->stats.seconds > 0) this->stats.cpu = cpu/this->stats.seconds;
+}
+
+void MainLoop::report(std::ostream& os) const {
+  os << (this->mode == IDLE ? "idle" : "continuous") << " loop: "
+     << this->stats.frames << " frames rendered, " << this->stats.skipped << " skipped in "
+     << this->stats.seconds << " s, CPU " << this->stats.cpu*100.0 << "%" << std::endl;
+  if (not this->histogram.empty()) {
+    os << "main loop: ";
+    latency::report(os, this->histogram, this->maxLatency);
+  }
+}
+
+void MainLoop::input() {
+  this->arrivals.push_back(latency::now());
+  this->invalidate();
+}
+
+MainLoop* MainLoop::of(GLFWwindow* window) {
+  return static_cast<MainLoop*>(glfwGetWindowUserPointer(window));
+}
+
+void MainLoop::keyCallback(GLFWwindow* window, int key, int scancode, int action, int mode) {
+  MainLoop* loop = of(window);
+  // trace hotkey, a no-op unless built with LEARNOPENGL_PROFILE
+  if (key == GLFW_KEY_F12 and action == GLFW_PRESS) Profiler::dump();
+  if (loop->previousKey) loop->previousKey(window, key, scancode, action, mode);
+  loop->input();
+}
+
+void MainLoop::cursorCallback(GLFWwindow* window, double x, double y) {
+  MainLoop* loop = of(window);
+  if (loop->previousCursor) loop->previousCursor(window, x, y);
+  loop->input();
+}
+
+void MainLoop::buttonCallback(GLFWwindow* window, int button, int action, int mods) {
+  MainLoop* loop = of(window);
+  if (loop->previousButton) loop->previousButton(window, button, action, mods);
+  loop->input();
+}
+
+void MainLoop::resizeCallback(GLFWwindow* window, int width, int height) {
+  MainLoop* loop = of(window);
+  if (loop->previousResize) loop->previousResize(window, width, height);
+  else StateCache::global().viewport(0, 0, width, height);
+  loop->invalidate();
+}
+
+void MainLoop::refreshCallback(GLFWwindow* window) {
+  of(window)->invalidate();
+}
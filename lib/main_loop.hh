@@ -0,0 +1,75 @@
+#ifndef MAIN_LOOP_H
+#define MAIN_LOOP_H
+
+#include <iostream>
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+// Event loop shared by the samples: pump events, render, swap.
+// CONTINUOUS redraws as fast as the loop spins, like the original samples.
+// IDLE only redraws after invalidate() and otherwise sleeps in
+// glfwWaitEventsTimeout. Input, resizes and expose events invalidate by
+// themselves; anything else (a shader reload, an animated uniform) calls
+// invalidate() from the update function, which runs before the loop
+// decides to sleep: an update that invalidates every time animates at the
+// full frame rate.
+// LEARNOPENGL_LOOP=continuous or =idle in the environment overrides the mode.
+// F12 writes the profiler trace (see profiler.hh).
+// Every key, button and cursor event's latency until the frame it caused
+// is swapped is recorded like RenderThread does (see latency.hh);
+// here an event is stamped when glfwPollEvents gets to it, which can be a
+// whole frame after it arrived.
+class MainLoop {
+  public:
+    enum Mode { CONTINUOUS, IDLE };
+    struct Stats {
+      unsigned frames;   // frames rendered
+      unsigned skipped;  // iterations that slept instead of drawing
+      double seconds;    // wall time spent in run()
+      double cpu;        // process CPU time over wall time, 1.0 is one core
+    };
+    Stats stats;
+    // Longest sleep between two update() calls in IDLE mode, in seconds
+    double idleTimeout;
+
+    // Installs callbacks on window that chain to the ones already set
+    MainLoop(GLFWwindow* window, Mode mode);
+    ~MainLoop();
+    // Render on the next iteration; callable from callbacks and update
+    void invalidate() { dirty = true; }
+    // Until the window should close: update() every iteration, render()
+    // and swap when the frame is invalid (or always, when CONTINUOUS)
+    void run(const std::function<void()>& render);
+    void run(const std::function<void()>& update, const std::function<void()>& render);
+    void report(std::ostream& os) const;
+
+  private:
+    GLFWwindow* window;
+    Mode mode;
+    bool dirty;
+    GLFWkeyfun previousKey;
+    GLFWcursorposfun previousCursor;
+    GLFWmousebuttonfun previousButton;
+    GLFWframebuffersizefun previousResize;
+    std::vector<uint64_t> arrivals;     // events since the last swap
+    std::vector<unsigned> histogram;    // latency::add
+    double maxLatency;
+
+    void input();
+
+    static MainLoop* of(GLFWwindow* window);
+    static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mode);
+    static void cursorCallback(GLFWwindow* window, double x, double y);
+    static void buttonCallback(GLFWwindow* window, int button, int action, int mods);
+    static void resizeCallback(GLFWwindow* window, int width, int height);
+    static void refreshCallback(GLFWwindow* window);
+
+    MainLoop(const MainLoop&);
+    MainLoop& operator=(const MainLoop&);
+};
+
+#endif
@@ -0,0 +1,109 @@
+#include "mesh_batch.hh"
+#include "state_cache.hh"
+
+#include <iostream>
+
+MeshBatch::MeshBatch(const std::vector<GLint>& components)
+  : components(components), stride(0), VAO(0), VBO(0), EBO(0), vertexTotal(0) {
+  for (size_t i = 0; i < components.size(); ++i) this->stride += components[i];
+}
+
+MeshBatch::~MeshBatch() {
+  if (this->VAO != 0) {
+    glDeleteVertexArrays(1, &this->VAO);
+    // a deleted bound VAO falls back to 0 behind the cache
+    StateCache::global().invalidate();
+  }
+  if (this->VBO != 0) glDeleteBuffers(1, &this->VBO);
+  if (this->EBO != 0) glDeleteBuffers(1, &this->EBO);
+}
+
+size_t MeshBatch::add(const GLfloat* vertices, GLsizei vertexCount,
+                      const GLuint* indices, GLsizei indexCount) {
+  if (this->VAO != 0) {
+    std::cout << "ERROR::MESH_BATCH::ADD_AFTER_UPLOAD" << std::endl;
+    return this->meshes.size();
+  }
+  Mesh mesh;
+  mesh.firstVertex = this->vertexTotal;
+  mesh.vertexCount = vertexCount;
+  mesh.firstIndex = this->indices.size();
+  mesh.indexCount = indices != nullptr ? indexCount : 0;
+  this->vertices.insert(this->vertices.end(), vertices, vertices + vertexCount*this->stride);
+  if (mesh.indexCount > 0)
+    this->indices.insert(this->indices.end(), indices, indices + indexCount);
+  this->vertexTotal += vertexCount;
+  this->meshes.push_back(mesh);
+  return this->meshes.size() - 1;
+}
+
+void MeshBatch::upload() {
+  StateCache& state = StateCache::global();
+  glGenVertexArrays(1, &this->VAO);
+  glGenBuffers(1, &this->VBO);
+  state.bindVertexArray(this->VAO);
+  state.bindBuffer(GL_ARRAY_BUFFER, this->VBO);
+  glBufferData(GL_ARRAY_BUFFER, this->vertices.size()*sizeof(GLfloat), this->vertices.data(), GL_STATIC_DRAW);
+  GLsizei offset = 0;
+  for (size_t i = 0; i < this->components.size(); ++i) {
+    glVertexAttribPointer(i, this->components[i], GL_FLOAT, GL_FALSE,
+                          this->stride*sizeof(GLfloat), (GLvoid *)(offset*sizeof(GLfloat)));
+    glEnableVertexAttribArray(i);
+    offset += this->components[i];
+  }
+  if (not this->indices.empty()) {
+    glGenBuffers(1, &this->EBO);
+    state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->indices.size()*sizeof(GLuint), this->indices.data(), GL_STATIC_DRAW);
+  }
+  state.bindVertexArray(0);
+  // the GPU has them now
+  std::vector<GLfloat>().swap(this->vertices);
+  std::vector<GLuint>().swap(this->indices);
+}
+
+void MeshBatch::draw(GLenum mode) {
+  this->arrayFirsts.clear();
+  this->arrayCounts.clear();
+  this->elementCounts.clear();
+  this->elementOffsets.clear();
+  this->baseVertices.clear();
+  for (size_t i = 0; i < this->meshes.size(); ++i) this->append(this->meshes[i]);
+  this->submit(mode);
+}
+
+void MeshBatch::draw(const std::vector<size_t>& meshes, GLenum mode) {
+  this->arrayFirsts.clear();
+  this->arrayCounts.clear();
+  this->elementCounts.clear();
+  this->elementOffsets.clear();
+  this->baseVertices.clear();
+  for (size_t i = 0; i < meshes.size(); ++i) this->append(this->meshes[meshes[i]]);
+  this->submit(mode);
+}
+
+void MeshBatch::append(const Mesh& mesh) {
+  if (mesh.indexCount == 0) {
+    this->arrayFirsts.push_back(mesh.firstVertex);
+    this->arrayCounts.push_back(mesh.vertexCount);
+  }
+  else {
+    this->elementCounts.push_back(mesh.indexCount);
+    this->elementOffsets.push_back((const GLvoid *)(mesh.firstIndex*sizeof(GLuint)));
+    this->baseVertices.push_back(mesh.firstVertex);
+  }
+}
+
+void MeshBatch::submit(GLenum mode) {
+  if (this->VAO == 0) {
+    std::cout << "ERROR::MESH_BATCH::NOT_UPLOADED" << std::endl;
+    return;
+  }
+  StateCache::global().bindVertexArray(this->VAO);
+  if (not this->arrayCounts.empty())
+    glMultiDrawArrays(mode, this->arrayFirsts.data(), this->arrayCounts.data(), this->arrayCounts.size());
+  if (not this->elementCounts.empty())
+    glMultiDrawElementsBaseVertex(mode, this->elementCounts.data(), GL_UNSIGNED_INT,
+                                  this->elementOffsets.data(),
+                                  this->elementCounts.size(), this->baseVertices.data());
+}
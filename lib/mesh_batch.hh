@@ -0,0 +1,70 @@
+#ifndef MESH_BATCH_H
+#define MESH_BATCH_H
+
+#include <vector>
+#include <cstddef>
+
+#include <GL/glew.h>
+
+// Many small meshes packed into one vertex buffer, one index buffer and a
+// single VAO, drawn with one glMultiDrawArrays call for the non indexed
+// meshes and one glMultiDrawElementsBaseVertex call for the indexed ones.
+// Meshes share a vertex format: float attributes at locations 0, 1, ...
+// with the given component counts, interleaved.
+// Indices are local to their mesh, base vertices take care of the offset.
+//
+//   MeshBatch batch({3});           // position only
+//   batch.add(triangle1, 3);
+//   batch.add(triangle2, 3);
+//   batch.upload();
+//   batch.draw();                   // both triangles, one call
+class MeshBatch {
+  public:
+    explicit MeshBatch(const std::vector<GLint>& components);
+    ~MeshBatch();
+
+    // Append a mesh of vertexCount vertices (and indexCount indices),
+    // returns its index. Copied, the arrays can go once this returns.
+    size_t add(const GLfloat* vertices, GLsizei vertexCount,
+               const GLuint* indices = nullptr, GLsizei indexCount = 0);
+    // Create the buffers from everything added and free the CPU copies.
+    // No add() after this.
+    void upload();
+    // Every mesh, at most two draw calls
+    void draw(GLenum mode = GL_TRIANGLES);
+    // The listed meshes, in that order within each draw call
+    void draw(const std::vector<size_t>& meshes, GLenum mode = GL_TRIANGLES);
+
+    size_t size() const { return meshes.size(); }
+    GLuint vertexArray() const { return VAO; }
+
+  private:
+    struct Mesh {
+      GLint firstVertex;
+      GLsizei vertexCount;
+      GLsizei firstIndex;
+      GLsizei indexCount;  // 0 when not indexed
+    };
+    std::vector<Mesh> meshes;
+    std::vector<GLint> components;
+    GLsizei stride;      // floats per vertex
+    std::vector<GLfloat> vertices;
+    std::vector<GLuint> indices;
+    GLuint VAO, VBO, EBO;
+    GLsizei vertexTotal;
+
+    // argument arrays of the last draw, kept to avoid reallocating
+    std::vector<GLint> arrayFirsts;
+    std::vector<GLsizei> arrayCounts;
+    std::vector<GLsizei> elementCounts;
+    std::vector<const GLvoid*> elementOffsets;
+    std::vector<GLint> baseVertices;
+
+    void append(const Mesh& mesh);
+    void submit(GLenum mode);
+
+    MeshBatch(const MeshBatch&);
+    MeshBatch& operator=(const MeshBatch&);
+};
+
+#endif
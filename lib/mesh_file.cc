@@ -0,0 +1,218 @@
+#include "mesh_file.hh"
+#include "state_cache.hh"
+#include "profiler.hh"
+
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+  uint64_t align(uint64_t offset) {
+    return (offset + MESH_FILE_ALIGNMENT - 1)/MESH_FILE_ALIGNMENT*MESH_FILE_ALIGNMENT;
+  }
+
+  size_t indexSize(uint32_t type) {
+    if (type == GL_UNSIGNED_SHORT) return 2;
+    if (type == GL_UNSIGNED_INT) return 4;
+    return 0;
+  }
+
+  bool pad(FILE* file, uint64_t offset) {
+    static const char zeros[MESH_FILE_ALIGNMENT] = {};
+    uint64_t position = std::ftell(file);
+    return offset == position or std::fwrite(zeros, offset - position, 1, file) == 1;
+  }
+}
+
+bool writeMeshFile(const std::string& path,
+                   const std::vector<MeshFileAttribute>& attributes, uint32_t vertexSize,
+                   const void* vertices, uint64_t vertexCount,
+                   GLenum indexType, const void* indices, uint64_t indexCount,
+                   const std::vector<MeshFileSubmesh>& submeshes) {
+  if (indexSize(indexType) == 0) {
+    std::cout << "ERROR::MESH_FILE::BAD_INDEX_TYPE " << indexType << std::endl;
+    return false;
+  }
+  MeshFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.magic = MESH_FILE_MAGIC;
+  header.version = MESH_FILE_VERSION;
+  header.attributeCount = attributes.size();
+  header.submeshCount = submeshes.size();
+  header.vertexSize = vertexSize;
+  header.indexType = indexType;
+  header.vertexCount = vertexCount;
+  header.indexCount = indexCount;
+  header.vertexOffset = align(sizeof(header) + attributes.size()*sizeof(MeshFileAttribute)
+                              + submeshes.size()*sizeof(MeshFileSubmesh));
+  header.indexOffset = align(header.vertexOffset + vertexCount*vertexSize);
+
+  FILE* file = std::fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    std::cout << "ERROR::MESH_FILE::CANNOT_WRITE " << path << std::endl;
+    return false;
+  }
+  bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+  if (not attributes.empty())
+    ok = ok and std::fwrite(&attributes[0], sizeof(MeshFileAttribute), attributes.size(), file) == attributes.size();
+  if (not submeshes.empty())
+    ok = ok and std::fwrite(&submeshes[0], sizeof(MeshFileSubmesh), submeshes.size(), file) == submeshes.size();
+  ok = ok and pad(file, header.vertexOffset);
+  if (vertexCount > 0) ok = ok and std::fwrite(vertices, vertexCount*vertexSize, 1, file) == 1;
+  ok = ok and pad(file, header.indexOffset);
+  if (indexCount > 0) ok = ok and std::fwrite(indices, indexCount*indexSize(indexType), 1, file) == 1;
+  ok = std::fclose(file) == 0 and ok;
+  if (not ok) std::cout << "ERROR::MESH_FILE::CANNOT_WRITE " << path << std::endl;
+  return ok;
+}
+
+MeshFile::MeshFile(const std::string& path) : data(nullptr), size(0), VAO(0), VBO(0), EBO(0) {
+  PROFILE_ZONE("MeshFile::MeshFile");
+  std::memset(&this->header, 0, sizeof(this->header));
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cout << "ERROR::MESH_FILE::FILE_NOT_READ " << path << std::endl;
+    return;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == 0 and st.st_size > 0) {
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+      this->data = static_cast<const char*>(data);
+      this->size = st.st_size;
+      // read front to back by the upload, start paging in now; advice
+      // values are not flags, each takes a call of its own
+      madvise(data, st.st_size, MADV_SEQUENTIAL);
+      madvise(data, st.st_size, MADV_WILLNEED);
+    }
+  }
+  // the mapping stays valid once the descriptor is closed
+  close(fd);
+  if (this->data == nullptr) {
+    std::cout << "ERROR::MESH_FILE::FILE_NOT_READ " << path << std::endl;
+    return;
+  }
+  if (not this->check(path)) {
+    this->unmap();
+    std::memset(&this->header, 0, sizeof(this->header));
+  }
+}
+
+MeshFile::~MeshFile() {
+  this->unmap();
+  if (this->VAO != 0) {
+    glDeleteVertexArrays(1, &this->VAO);
+    // a deleted bound VAO falls back to 0 behind the cache
+    StateCache::global().invalidate();
+  }
+  if (this->VBO != 0) glDeleteBuffers(1, &this->VBO);
+  if (this->EBO != 0) glDeleteBuffers(1, &this->EBO);
+}
+
+bool MeshFile::check(const std::string& path) {
+  if (this->size < sizeof(MeshFileHeader)) {
+    std::cout << "ERROR::MESH_FILE::TRUNCATED " << path << std::endl;
+    return false;
+  }
+  std::memcpy(&this->header, this->data, sizeof(this->header));
+  const MeshFileHeader& h = this->header;
+  if (h.magic != MESH_FILE_MAGIC or h.version != MESH_FILE_VERSION) {
+    std::cout << "ERROR::MESH_FILE::NOT_A_MESH_FILE " << path << std::endl;
+    return false;
+  }
+  uint64_t tables = sizeof(h) + uint64_t(h.attributeCount)*sizeof(MeshFileAttribute)
+                  + uint64_t(h.submeshCount)*sizeof(MeshFileSubmesh);
+  size_t indexBytes = indexSize(h.indexType);
+  // offsets are checked against the file before anything is added to
+  // them, and counts by dividing the room left, so nothing can wrap
+  if (indexBytes == 0
+      or h.vertexOffset % MESH_FILE_ALIGNMENT != 0 or h.indexOffset % MESH_FILE_ALIGNMENT != 0
+      or tables > h.vertexOffset or h.vertexOffset > h.indexOffset or h.indexOffset > this->size
+      or (h.vertexSize > 0 and h.vertexCount > (h.indexOffset - h.vertexOffset)/h.vertexSize)
+      or h.indexCount > (this->size - h.indexOffset)/indexBytes) {
+    std::cout << "ERROR::MESH_FILE::TRUNCATED " << path << std::endl;
+    return false;
+  }
+  for (uint32_t s = 0; s < h.submeshCount; ++s)
+    if (uint64_t(this->submeshes()[s].firstIndex) + this->submeshes()[s].indexCount > h.indexCount) {
+      std::cout << "ERROR::MESH_FILE::BAD_SUBMESH " << path << " " << s << std::endl;
+      return false;
+    }
+  return true;
+}
+
+void MeshFile::unmap() {
+  if (this->data != nullptr) munmap(const_cast<char*>(this->data), this->size);
+  this->data = nullptr;
+}
+
+const MeshFileAttribute* MeshFile::attributes() const {
+  if (this->data == nullptr) return nullptr;
+  return reinterpret_cast<const MeshFileAttribute*>(this->data + sizeof(MeshFileHeader));
+}
+
+const MeshFileSubmesh* MeshFile::submeshes() const {
+  if (this->data == nullptr) return nullptr;
+  return reinterpret_cast<const MeshFileSubmesh*>(this->data + sizeof(MeshFileHeader)
+                                                  + this->header.attributeCount*sizeof(MeshFileAttribute));
+}
+
+const void* MeshFile::vertices() const {
+  return this->data != nullptr ? this->data + this->header.vertexOffset : nullptr;
+}
+
+const void* MeshFile::indices() const {
+  return this->data != nullptr ? this->data + this->header.indexOffset : nullptr;
+}
+
+GLuint MeshFile::upload(GLenum usage) {
+  PROFILE_ZONE("MeshFile::upload");
+  if (this->VAO != 0) return this->VAO;
+  if (this->data == nullptr) {
+    std::cout << "ERROR::MESH_FILE::NOT_MAPPED" << std::endl;
+    return 0;
+  }
+  StateCache& state = StateCache::global();
+  glGenVertexArrays(1, &this->VAO);
+  glGenBuffers(1, &this->VBO);
+  glGenBuffers(1, &this->EBO);
+  state.bindVertexArray(this->VAO);
+  state.bindBuffer(GL_ARRAY_BUFFER, this->VBO);
+  glBufferData(GL_ARRAY_BUFFER, this->vertexBytes(), this->vertices(), usage);
+  state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->EBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->indexBytes(), this->indices(), usage);
+
+  std::vector<VertexAttribute> attributes = this->vertexAttributes();
+  if (not attributes.empty())
+    setVertexAttributes(&attributes[0], attributes.size(), this->header.vertexSize);
+  return this->VAO;
+}
+
+std::vector<VertexAttribute> MeshFile::vertexAttributes() const {
+  std::vector<VertexAttribute> attributes;
+  if (this->data == nullptr) return attributes;
+  attributes.resize(this->header.attributeCount);
+  for (uint32_t i = 0; i < this->header.attributeCount; ++i) {
+    const MeshFileAttribute& a = this->attributes()[i];
+    VertexAttribute& v = attributes[i];
+    v.type = a.type;
+    v.components = a.components;
+    v.normalized = a.normalized ? GL_TRUE : GL_FALSE;
+    v.integer = false;
+    v.offset = a.offset;
+    v.bytes = v.alignment = 0;
+  }
+  return attributes;
+}
+
+size_t MeshFile::vertexBytes() const {
+  return this->header.vertexCount*this->header.vertexSize;
+}
+
+size_t MeshFile::indexBytes() const {
+  return this->header.indexCount*indexSize(this->header.indexType);
+}
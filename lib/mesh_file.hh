@@ -0,0 +1,110 @@
+#ifndef MESH_FILE_H
+#define MESH_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "vertex_format.hh"
+
+// Binary mesh container, little endian, laid out to be used in place:
+//
+//   MeshFileHeader
+//   MeshFileAttribute  x attributeCount
+//   MeshFileSubmesh    x submeshCount
+//   vertices           at vertexOffset, vertexCount*vertexSize bytes
+//   indices            at indexOffset, indexCount of indexType
+//
+// The vertex and index blocks start on MESH_FILE_ALIGNMENT boundaries.
+// Written by bench/obj_to_mesh.
+const uint32_t MESH_FILE_MAGIC = 0x4d474f4c;  // "LOGM"
+const uint32_t MESH_FILE_VERSION = 1;
+const size_t MESH_FILE_ALIGNMENT = 64;
+
+struct MeshFileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t attributeCount;
+  uint32_t submeshCount;
+  uint32_t vertexSize;      // stride in bytes
+  uint32_t indexType;       // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+  uint64_t vertexCount;
+  uint64_t indexCount;
+  uint64_t vertexOffset;    // from the start of the file
+  uint64_t indexOffset;
+};
+
+// Attribute i goes to location i
+struct MeshFileAttribute {
+  uint32_t type;            // GL_FLOAT, GL_HALF_FLOAT, GL_INT_2_10_10_10_REV, ...
+  uint32_t components;
+  uint32_t normalized;
+  uint32_t offset;          // in the vertex
+};
+
+// A range of the index buffer, indices are into the whole vertex block
+struct MeshFileSubmesh {
+  uint32_t firstIndex;
+  uint32_t indexCount;
+  char name[56];            // zero terminated, cut if longer
+};
+
+// Write a mesh file, false with an ERROR:: message when it cannot
+bool writeMeshFile(const std::string& path,
+                   const std::vector<MeshFileAttribute>& attributes, uint32_t vertexSize,
+                   const void* vertices, uint64_t vertexCount,
+                   GLenum indexType, const void* indices, uint64_t indexCount,
+                   const std::vector<MeshFileSubmesh>& submeshes);
+
+// A mesh file mapped read only. The blocks are used straight from the
+// mapping: upload() hands them to glBufferData without parsing or copying
+// anything, the kernel pages the file in as the driver reads it.
+//
+//   MeshFile file("models/bunny.mesh");
+//   GLuint VAO = file.upload();
+//   glDrawElements(GL_TRIANGLES, file.indexCount(), file.indexType(), 0);
+class MeshFile {
+  public:
+    explicit MeshFile(const std::string& path);
+    ~MeshFile();
+
+    bool valid() const { return header.magic == MESH_FILE_MAGIC; }
+
+    // Create and fill a vertex and an index buffer and a VAO using them,
+    // returns the VAO, 0 if the file is not valid. The objects belong to
+    // this MeshFile and are deleted with it, the mapping can go.
+    GLuint upload(GLenum usage = GL_STATIC_DRAW);
+    // Release the mapping, once uploaded it is not needed anymore.
+    // The header stays, the blocks below are null from then on.
+    void unmap();
+
+    const MeshFileHeader& info() const { return header; }
+    const MeshFileAttribute* attributes() const;
+    const MeshFileSubmesh* submeshes() const;
+    const void* vertices() const;
+    const void* indices() const;
+    // The attribute table as setVertexAttributes() takes it, empty once
+    // unmapped
+    std::vector<VertexAttribute> vertexAttributes() const;
+    size_t vertexBytes() const;
+    size_t indexBytes() const;
+    GLsizei indexCount() const { return header.indexCount; }
+    GLenum indexType() const { return header.indexType; }
+    size_t fileSize() const { return size; }
+
+  private:
+    const char* data;   // null once unmapped
+    size_t size;
+    MeshFileHeader header;
+    GLuint VAO, VBO, EBO;
+
+    bool check(const std::string& path);
+
+    MeshFile(const MeshFile&);
+    MeshFile& operator=(const MeshFile&);
+};
+
+#endif
@@ -0,0 +1,341 @@
+#include "mesh_optimizer.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace {
+  // pieces optimizeVertexCache works on, big enough that the cache reload
+  // at each cut costs nothing measurable
+  const size_t CHUNK_TRIANGLES = 1 << 16;
+
+  // FIFO cache of size entries over ids, a hit when the id went in less
+  // than size misses ago
+  class FifoCache {
+    public:
+      FifoCache(size_t ids, unsigned size) : stamps(ids, 0), time(size + 1), size(size) {}
+      // true on a miss, which also inserts the id
+      bool miss(size_t id) {
+        if (this->time - this->stamps[id] <= this->size) return false;
+        this->stamps[id] = this->time++;
+        return true;
+      }
+      void flush() { this->time += this->size + 1; }
+    private:
+      std::vector<size_t> stamps;
+      size_t time;
+      unsigned size;
+  };
+
+  // Scratch space of one thread, reused across chunks
+  struct Tipsify {
+    std::vector<GLint> local;     // global vertex -> chunk vertex, -1 if unused
+    std::vector<GLuint> globals;  // chunk vertex -> global vertex
+    std::vector<GLuint> corners;  // chunk vertex of every index
+    std::vector<GLuint> live;     // triangles of a vertex not emitted yet
+    std::vector<GLuint> first;    // adjacency, triangles of v in first[v]..first[v+1]
+    std::vector<GLuint> adjacent;
+    std::vector<size_t> stamps;
+    std::vector<bool> emitted;
+    std::vector<GLuint> deadEnds;
+    std::vector<GLuint> candidates;
+
+    explicit Tipsify(size_t vertexCount) : local(vertexCount, -1) {}
+
+    void run(GLuint* destination, const GLuint* indices, size_t triangles, unsigned cacheSize) {
+      size_t indexCount = triangles*3;
+      this->globals.clear();
+      this->corners.resize(indexCount);
+      for (size_t i = 0; i < indexCount; ++i) {
+        GLint& id = this->local[indices[i]];
+        if (id < 0) {
+          id = this->globals.size();
+          this->globals.push_back(indices[i]);
+        }
+        this->corners[i] = id;
+      }
+      size_t vertices = this->globals.size();
+
+      this->live.assign(vertices, 0);
+      for (size_t i = 0; i < indexCount; ++i) ++this->live[this->corners[i]];
+      this->first.assign(vertices + 1, 0);
+      for (size_t v = 0; v < vertices; ++v) this->first[v + 1] = this->first[v] + this->live[v];
+      this->adjacent.resize(indexCount);
+      std::vector<GLuint> fill(this->first.begin(), this->first.end() - 1);
+      for (size_t i = 0; i < indexCount; ++i) this->adjacent[fill[this->corners[i]]++] = i/3;
+
+      this->stamps.assign(vertices, 0);
+      this->emitted.assign(triangles, false);
+      this->deadEnds.clear();
+      size_t time = cacheSize + 1;
+      size_t cursor = 0;
+      size_t written = 0;
+      GLint fanning = 0;
+      while (fanning >= 0) {
+        this->candidates.clear();
+        for (GLuint a = this->first[fanning]; a < this->first[fanning + 1]; ++a) {
+          GLuint t = this->adjacent[a];
+          if (this->emitted[t]) continue;
+          this->emitted[t] = true;
+          for (int c = 0; c < 3; ++c) {
+            GLuint v = this->corners[t*3 + c];
+            destination[written++] = indices[t*3 + c];
+            this->deadEnds.push_back(v);
+            this->candidates.push_back(v);
+            --this->live[v];
+            if (time - this->stamps[v] > cacheSize) this->stamps[v] = time++;
+          }
+        }
+        fanning = this->next(time, cacheSize, cursor);
+      }
+
+      for (size_t v = 0; v < vertices; ++v) this->local[this->globals[v]] = -1;
+    }
+
+    // the candidate that stays in the cache longest while its fan is
+    // emitted, else the latest dead end, else the next vertex left
+    GLint next(size_t time, unsigned cacheSize, size_t& cursor) {
+      GLint best = -1;
+      size_t bestPriority = 0;
+      for (size_t i = 0; i < this->candidates.size(); ++i) {
+        GLuint v = this->candidates[i];
+        if (this->live[v] == 0) continue;
+        size_t priority = 0;
+        if (time - this->stamps[v] + 2*this->live[v] <= cacheSize) priority = time - this->stamps[v];
+        if (best < 0 or priority > bestPriority) {
+          best = v;
+          bestPriority = priority;
+        }
+      }
+      if (best >= 0) return best;
+      while (not this->deadEnds.empty()) {
+        GLuint v = this->deadEnds.back();
+        this->deadEnds.pop_back();
+        if (this->live[v] > 0) return v;
+      }
+      for (; cursor < this->live.size(); ++cursor)
+        if (this->live[cursor] > 0) return cursor;
+      return -1;
+    }
+  };
+
+  // Triangles in breadth first order over shared vertices, so that any
+  // run of them is a connected patch of the surface whatever the input
+  // order was
+  void connectedOrder(GLuint* destination, const GLuint* indices, size_t indexCount, size_t vertexCount) {
+    size_t triangles = indexCount/3;
+    std::vector<GLuint> first(vertexCount + 1, 0);
+    for (size_t i = 0; i < indexCount; ++i) ++first[indices[i] + 1];
+    for (size_t v = 0; v < vertexCount; ++v) first[v + 1] += first[v];
+    std::vector<GLuint> adjacent(indexCount);
+    std::vector<GLuint> fill(first.begin(), first.end() - 1);
+    for (size_t i = 0; i < indexCount; ++i) adjacent[fill[indices[i]]++] = i/3;
+
+    std::vector<bool> queued(triangles, false), expanded(vertexCount, false);
+    std::vector<GLuint> queue;
+    queue.reserve(triangles);
+    size_t head = 0;
+    for (size_t seed = 0; seed < triangles; ++seed) {
+      if (queued[seed]) continue;
+      queued[seed] = true;
+      queue.push_back(seed);
+      for (; head < queue.size(); ++head) {
+        const GLuint* corners = indices + queue[head]*3;
+        for (int c = 0; c < 3; ++c) {
+          if (expanded[corners[c]]) continue;
+          expanded[corners[c]] = true;
+          for (GLuint a = first[corners[c]]; a < first[corners[c] + 1]; ++a)
+            if (not queued[adjacent[a]]) {
+              queued[adjacent[a]] = true;
+              queue.push_back(adjacent[a]);
+            }
+        }
+      }
+    }
+    for (size_t t = 0; t < triangles; ++t)
+      std::memcpy(destination + t*3, indices + queue[t]*3, 3*sizeof(GLuint));
+  }
+
+  struct Cluster {
+    size_t begin, end;  // first and one past the last triangle
+    double key;
+  };
+
+  bool outwardFirst(const Cluster& a, const Cluster& b) {
+    return a.key > b.key;
+  }
+}
+
+VertexCacheStats analyzeVertexCache(const GLuint* indices, size_t indexCount, size_t vertexCount,
+                                    unsigned cacheSize) {
+  FifoCache cache(vertexCount, cacheSize);
+  size_t misses = 0;
+  for (size_t i = 0; i < indexCount; ++i) misses += cache.miss(indices[i]);
+  VertexCacheStats stats;
+  stats.acmr = indexCount > 0 ? double(misses)/(indexCount/3) : 0;
+  stats.atvr = vertexCount > 0 ? double(misses)/vertexCount : 0;
+  return stats;
+}
+
+double analyzeVertexFetch(const GLuint* indices, size_t indexCount, size_t vertexCount, size_t vertexSize) {
+  const size_t LINE = 64;
+  size_t lines = (vertexCount*vertexSize + LINE - 1)/LINE;
+  if (lines == 0) return 0;
+  // a small 4KB fully associative cache, like a vertex fetch cache
+  FifoCache cache(lines, 4096/LINE);
+  size_t fetched = 0;
+  for (size_t i = 0; i < indexCount; ++i) {
+    size_t begin = indices[i]*vertexSize/LINE, end = (indices[i]*vertexSize + vertexSize - 1)/LINE;
+    for (size_t line = begin; line <= end; ++line) fetched += cache.miss(line);
+  }
+  return double(fetched*LINE)/(vertexCount*vertexSize);
+}
+
+void optimizeVertexCache(GLuint* destination, const GLuint* indices, size_t indexCount,
+                         size_t vertexCount, unsigned cacheSize, unsigned threads) {
+  size_t triangles = indexCount/3;
+  if (triangles == 0) return;
+  size_t chunks = (triangles + CHUNK_TRIANGLES - 1)/CHUNK_TRIANGLES;
+  if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = std::min<size_t>(threads, chunks);
+  // cut into connected pieces rather than runs of the input order, which
+  // may jump all over the mesh
+  std::vector<GLuint> connected(indexCount);
+  if (chunks > 1) connectedOrder(&connected[0], indices, indexCount, vertexCount);
+  else connected.assign(indices, indices + indexCount);
+  indices = &connected[0];
+
+  std::atomic<size_t> nextChunk(0);
+  auto work = [&]() {
+    Tipsify tipsify(vertexCount);
+    for (size_t chunk = nextChunk++; chunk < chunks; chunk = nextChunk++) {
+      size_t first = chunk*CHUNK_TRIANGLES;
+      size_t count = std::min(CHUNK_TRIANGLES, triangles - first);
+      tipsify.run(destination + first*3, indices + first*3, count, cacheSize);
+    }
+  };
+  std::vector<std::thread> pool;
+  for (unsigned i = 1; i < threads; ++i) pool.push_back(std::thread(work));
+  work();
+  for (size_t i = 0; i < pool.size(); ++i) pool[i].join();
+}
+
+void optimizeOverdraw(GLuint* destination, const GLuint* indices, size_t indexCount,
+                      const GLfloat* positions, size_t stride, size_t vertexCount,
+                      float threshold, unsigned cacheSize) {
+  if (indexCount < 3) return;
+  std::vector<GLuint> copy;
+  if (destination == indices) {
+    copy.assign(indices, indices + indexCount);
+    indices = &copy[0];
+  }
+  size_t triangles = indexCount/3;
+
+  // hard boundaries where all three vertices miss: the optimizer jumped
+  // to a disconnected part of the mesh
+  std::vector<size_t> hard;
+  FifoCache cache(vertexCount, cacheSize);
+  for (size_t t = 0; t < triangles; ++t) {
+    int misses = cache.miss(indices[t*3]) + cache.miss(indices[t*3 + 1]) + cache.miss(indices[t*3 + 2]);
+    if (misses == 3) hard.push_back(t);
+  }
+  if (hard.empty() or hard[0] != 0) hard.insert(hard.begin(), 0);
+  hard.push_back(triangles);
+
+  // soft boundaries inside them, wherever the piece so far, starting from
+  // an empty cache, is within threshold of the hard cluster's ACMR
+  std::vector<Cluster> clusters;
+  for (size_t h = 0; h + 1 < hard.size(); ++h) {
+    size_t begin = hard[h], end = hard[h + 1];
+    if (begin == end) continue;
+    cache.flush();
+    size_t hardMisses = 0;
+    for (size_t i = begin*3; i < end*3; ++i) hardMisses += cache.miss(indices[i]);
+    double acmr = double(hardMisses)/(end - begin);
+    cache.flush();
+    size_t start = begin, misses = 0;
+    for (size_t t = begin; t < end; ++t) {
+      for (int c = 0; c < 3; ++c) misses += cache.miss(indices[t*3 + c]);
+      if (t + 1 < end and misses <= threshold*acmr*(t + 1 - start)) {
+        Cluster cluster = { start, t + 1, 0 };
+        clusters.push_back(cluster);
+        start = t + 1;
+        misses = 0;
+        cache.flush();
+      }
+    }
+    Cluster cluster = { start, end, 0 };
+    clusters.push_back(cluster);
+  }
+
+  // area weighted centroid and normal of every cluster
+  std::vector<double> centroids(clusters.size()*3), normals(clusters.size()*3);
+  double center[3] = { 0, 0, 0 }, area = 0;
+  for (size_t c = 0; c < clusters.size(); ++c) {
+    double* centroid = &centroids[c*3];
+    double* normal = &normals[c*3];
+    double clusterArea = 0;
+    for (size_t t = clusters[c].begin; t < clusters[c].end; ++t) {
+      const GLfloat* p0 = positions + indices[t*3]*stride;
+      const GLfloat* p1 = positions + indices[t*3 + 1]*stride;
+      const GLfloat* p2 = positions + indices[t*3 + 2]*stride;
+      double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+      double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+      double n[3] = { e1[1]*e2[2] - e1[2]*e2[1], e1[2]*e2[0] - e1[0]*e2[2], e1[0]*e2[1] - e1[1]*e2[0] };
+      double a = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+      for (int i = 0; i < 3; ++i) {
+        centroid[i] += a*(p0[i] + p1[i] + p2[i])/3;
+        normal[i] += n[i];
+      }
+      clusterArea += a;
+    }
+    for (int i = 0; i < 3; ++i) center[i] += centroid[i];
+    area += clusterArea;
+    if (clusterArea > 0) for (int i = 0; i < 3; ++i) centroid[i] /= clusterArea;
+  }
+  if (area > 0) for (int i = 0; i < 3; ++i) center[i] /= area;
+
+  // outward facing first: how far the cluster sits along its own normal
+  for (size_t c = 0; c < clusters.size(); ++c) {
+    const double* centroid = &centroids[c*3];
+    const double* normal = &normals[c*3];
+    double length = std::sqrt(normal[0]*normal[0] + normal[1]*normal[1] + normal[2]*normal[2]);
+    if (length == 0) continue;
+    for (int i = 0; i < 3; ++i) clusters[c].key += (centroid[i] - center[i])*normal[i]/length;
+  }
+  std::stable_sort(clusters.begin(), clusters.end(), outwardFirst);
+
+  GLuint* out = destination;
+  for (size_t c = 0; c < clusters.size(); ++c) {
+    size_t count = (clusters[c].end - clusters[c].begin)*3;
+    std::memcpy(out, indices + clusters[c].begin*3, count*sizeof(GLuint));
+    out += count;
+  }
+}
+
+size_t optimizeVertexFetch(void* destination, GLuint* indices, size_t indexCount,
+                           const void* vertices, size_t vertexCount, size_t vertexSize) {
+  std::vector<char> copy;
+  if (destination == vertices and vertexCount > 0) {
+    const char* bytes = static_cast<const char*>(vertices);
+    copy.assign(bytes, bytes + vertexCount*vertexSize);
+    vertices = &copy[0];
+  }
+  const GLuint UNUSED = GLuint(-1);
+  std::vector<GLuint> remap(vertexCount, UNUSED);
+  char* out = static_cast<char*>(destination);
+  const char* in = static_cast<const char*>(vertices);
+  GLuint used = 0;
+  for (size_t i = 0; i < indexCount; ++i) {
+    GLuint& v = remap[indices[i]];
+    if (v == UNUSED) {
+      std::memcpy(out + size_t(used)*vertexSize, in + size_t(indices[i])*vertexSize, vertexSize);
+      v = used++;
+    }
+    indices[i] = v;
+  }
+  return used;
+}
@@ -0,0 +1,55 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <cstddef>
+
+#include <GL/glew.h>
+
+// Offline reordering of indexed triangle lists (GL_TRIANGLES, GLuint
+// indices) so the GPU runs the vertex shader less often and fetches
+// vertex memory in order. Run once when a mesh is built or converted,
+// in this order:
+//
+//   optimizeVertexCache(indices, indices, count, vertexCount);
+//   optimizeOverdraw(indices, indices, count, positions, 3, vertexCount);
+//   vertexCount = optimizeVertexFetch(vertices, indices, count,
+//                                     vertices, vertexCount, sizeof(Vertex));
+//
+// Every destination may be the same array as the source.
+
+// Simulated FIFO post-transform cache over an index buffer
+struct VertexCacheStats {
+  // vertex shader runs per triangle: 3 is no reuse, ~0.5 is a perfect grid
+  double acmr;
+  // vertex shader runs per vertex, 1 is ideal
+  double atvr;
+};
+VertexCacheStats analyzeVertexCache(const GLuint* indices, size_t indexCount, size_t vertexCount,
+                                    unsigned cacheSize = 16);
+// Bytes read from the vertex buffer in 64 byte lines over the bytes in it,
+// 1 is every line read once
+double analyzeVertexFetch(const GLuint* indices, size_t indexCount, size_t vertexCount, size_t vertexSize);
+
+// Triangle order for a cache of cacheSize vertices, Tipsify (Sander,
+// Nehab and Barczak, "Fast triangle reordering for vertex locality and
+// reduced overdraw", 2007). Linear time; large meshes are cut into fixed
+// size pieces optimized on up to threads threads (0 is one per core), so
+// the result does not depend on the thread count.
+void optimizeVertexCache(GLuint* destination, const GLuint* indices, size_t indexCount,
+                         size_t vertexCount, unsigned cacheSize = 16, unsigned threads = 0);
+// Reorder clusters of a cache optimized index buffer so outward facing
+// parts of the mesh come first and hide what is behind them. Clusters are
+// only cut where the ACMR stays under threshold times the original, so
+// that is the most cache efficiency given up. positions are the first 3
+// floats of every stride floats.
+void optimizeOverdraw(GLuint* destination, const GLuint* indices, size_t indexCount,
+                      const GLfloat* positions, size_t stride, size_t vertexCount,
+                      float threshold = 1.05f, unsigned cacheSize = 16);
+// Write the vertices in the order the indices first use them and rewrite
+// the indices to match. Unused vertices are dropped, returns how many are
+// left. destination has room for vertexCount vertices of vertexSize bytes
+// and may not overlap vertices unless it is the same array.
+size_t optimizeVertexFetch(void* destination, GLuint* indices, size_t indexCount,
+                           const void* vertices, size_t vertexCount, size_t vertexSize);
+
+#endif
@@ -0,0 +1,293 @@
+#include "obj_loader.hh"
+#include "mesh_file.hh"
+#include "mesh_optimizer.hh"
+#include "vertex_format.hh"
+#include "profiler.hh"
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+
+namespace {
+  struct Corner {
+    long v, t, n;
+    bool operator==(const Corner& o) const { return v == o.v and t == o.t and n == o.n; }
+  };
+  struct CornerHash {
+    size_t operator()(const Corner& c) const {
+      return size_t(c.v)*73856093u ^ size_t(c.t)*19349663u ^ size_t(c.n)*83492791u;
+    }
+  };
+
+  bool space(char c) { return c == ' ' or c == '\t' or c == '\r'; }
+
+  const char* skipSpace(const char* p, const char* end) {
+    while (p < end and space(*p)) ++p;
+    return p;
+  }
+
+  // n floats at p, false if the line has fewer than required; the
+  // optional ones past those default to 0
+  bool floats(const char* p, const char* end, GLfloat* out, int n, int required) {
+    for (int i = 0; i < n; ++i) {
+      p = skipSpace(p, end);
+      char* next = const_cast<char*>(p);
+      if (p < end) out[i] = std::strtof(p, &next);
+      if (next == p) {
+        if (i < required) return false;
+        out[i] = 0.0f;
+        continue;
+      }
+      p = next;
+    }
+    return true;
+  }
+
+  // the rest of the line without surrounding blanks, and without the \r
+  // of CRLF files
+  std::string name(const char* p, const char* end) {
+    p = skipSpace(p, end);
+    while (end > p and space(end[-1])) --end;
+    return std::string(p, end);
+  }
+
+  // A 1-based or negative OBJ index into count elements, -1 if absent
+  long resolve(long index, size_t count) {
+    if (index > 0) return index - 1;
+    if (index < 0) return long(count) + index;
+    return -1;
+  }
+
+  // One v, v/t, v//n or v/t/n token, p left after it
+  bool corner(const char*& p, const char* end, Corner& c, size_t positions, size_t texcoords, size_t normals) {
+    char* next;
+    c.v = resolve(std::strtol(p, &next, 10), positions);
+    if (next == p) return false;
+    p = next;
+    c.t = c.n = -1;
+    if (p < end and *p == '/') {
+      ++p;
+      if (p < end and *p != '/') {
+        c.t = resolve(std::strtol(p, &next, 10), texcoords);
+        p = next;
+      }
+      if (p < end and *p == '/') {
+        ++p;
+        c.n = resolve(std::strtol(p, &next, 10), normals);
+        p = next;
+      }
+    }
+    return c.v >= 0 and c.v < long(positions) and c.t < long(texcoords) and c.n < long(normals);
+  }
+}
+
+bool loadObj(const std::string& path, ObjMesh& mesh) {
+  PROFILE_ZONE("loadObj");
+  std::ifstream file(path.c_str(), std::ios::binary);
+  if (not file) {
+    std::cout << "ERROR::OBJ::FILE_NOT_READ " << path << std::endl;
+    return false;
+  }
+  std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+  std::vector<GLfloat> positions, normals, texcoords;
+  std::vector<Corner> corners;
+  // the first pass keeps faces as corners, the stride is only known once
+  // we know whether any face uses normals or texture coordinates
+  std::vector<GLuint> faceSizes;
+  std::vector<ObjMesh::Group> groups;
+  std::vector<size_t> groupFaces;  // first face of every group
+  mesh = ObjMesh();
+
+  const char* p = text.data();
+  const char* end = p + text.size();
+  size_t lineNumber = 0;
+  while (p < end) {
+    const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    if (lineEnd == nullptr) lineEnd = end;
+    ++lineNumber;
+    p = skipSpace(p, lineEnd);
+    bool ok = true;
+    if (lineEnd - p > 2 and p[0] == 'v' and space(p[1])) {
+      GLfloat v[3];
+      ok = floats(p + 2, lineEnd, v, 3, 3);
+      positions.insert(positions.end(), v, v + 3);
+    }
+    else if (lineEnd - p > 3 and p[0] == 'v' and p[1] == 'n' and space(p[2])) {
+      GLfloat n[3];
+      ok = floats(p + 3, lineEnd, n, 3, 3);
+      normals.insert(normals.end(), n, n + 3);
+    }
+    else if (lineEnd - p > 3 and p[0] == 'v' and p[1] == 't' and space(p[2])) {
+      // v is optional, 1D textures only give u
+      GLfloat t[2];
+      ok = floats(p + 3, lineEnd, t, 2, 1);
+      texcoords.insert(texcoords.end(), t, t + 2);
+    }
+    else if (lineEnd - p > 2 and p[0] == 'f' and space(p[1])) {
+      const char* q = p + 2;
+      GLuint count = 0;
+      for (q = skipSpace(q, lineEnd); ok and q < lineEnd; q = skipSpace(q, lineEnd)) {
+        Corner c;
+        ok = corner(q, lineEnd, c, positions.size()/3, texcoords.size()/2, normals.size()/3);
+        corners.push_back(c);
+        ++count;
+      }
+      ok = ok and count >= 3;
+      faceSizes.push_back(count);
+    }
+    else if (lineEnd - p > 2 and (p[0] == 'o' or p[0] == 'g') and space(p[1])) {
+      ObjMesh::Group group = { name(p + 2, lineEnd), 0, 0 };
+      groups.push_back(group);
+      groupFaces.push_back(faceSizes.size());
+    }
+    else if (lineEnd - p > 7 and std::strncmp(p, "usemtl", 6) == 0 and space(p[6])) {
+      ObjMesh::Group group = { name(p + 7, lineEnd), 0, 0 };
+      groups.push_back(group);
+      groupFaces.push_back(faceSizes.size());
+    }
+    // comments, mtllib, s and anything else are ignored
+    if (not ok) {
+      std::cout << "ERROR::OBJ::BAD_LINE " << path << ":" << lineNumber << std::endl;
+      return false;
+    }
+    p = lineEnd + 1;
+  }
+
+  for (size_t i = 0; i < corners.size(); ++i) {
+    mesh.normals = mesh.normals or corners[i].n >= 0;
+    mesh.texcoords = mesh.texcoords or corners[i].t >= 0;
+  }
+  GLsizei stride = mesh.stride();
+
+  std::unordered_map<Corner, GLuint, CornerHash> vertices;
+  vertices.reserve(positions.size()/3);
+  std::vector<GLuint> faceVertices;
+  size_t nextCorner = 0, nextGroup = 0;
+  if (groupFaces.empty() or groupFaces[0] != 0) {
+    ObjMesh::Group group = { "", 0, 0 };
+    groups.insert(groups.begin(), group);
+    groupFaces.insert(groupFaces.begin(), 0);
+  }
+  for (size_t f = 0; f < faceSizes.size(); ++f) {
+    while (nextGroup < groups.size() and groupFaces[nextGroup] == f) {
+      groups[nextGroup].firstIndex = mesh.indices.size();
+      ++nextGroup;
+    }
+    faceVertices.clear();
+    for (GLuint i = 0; i < faceSizes[f]; ++i) {
+      const Corner& c = corners[nextCorner++];
+      std::pair<std::unordered_map<Corner, GLuint, CornerHash>::iterator, bool> found =
+        vertices.insert(std::make_pair(c, GLuint(mesh.vertices.size()/stride)));
+      if (found.second) {
+        mesh.vertices.insert(mesh.vertices.end(), &positions[c.v*3], &positions[c.v*3] + 3);
+        if (mesh.normals) {
+          const GLfloat zero[3] = { 0, 0, 0 };
+          const GLfloat* n = c.n >= 0 ? &normals[c.n*3] : zero;
+          mesh.vertices.insert(mesh.vertices.end(), n, n + 3);
+        }
+        if (mesh.texcoords) {
+          const GLfloat zero[2] = { 0, 0 };
+          const GLfloat* t = c.t >= 0 ? &texcoords[c.t*2] : zero;
+          mesh.vertices.insert(mesh.vertices.end(), t, t + 2);
+        }
+      }
+      faceVertices.push_back(found.first->second);
+    }
+    for (size_t i = 2; i < faceVertices.size(); ++i) {
+      mesh.indices.push_back(faceVertices[0]);
+      mesh.indices.push_back(faceVertices[i - 1]);
+      mesh.indices.push_back(faceVertices[i]);
+    }
+  }
+  for (; nextGroup < groups.size(); ++nextGroup) groups[nextGroup].firstIndex = mesh.indices.size();
+
+  // index counts, dropping groups that ended up without faces
+  for (size_t g = 0; g < groups.size(); ++g) {
+    GLuint next = g + 1 < groups.size() ? groups[g + 1].firstIndex : mesh.indices.size();
+    groups[g].indexCount = next - groups[g].firstIndex;
+    if (groups[g].indexCount > 0) mesh.groups.push_back(groups[g]);
+  }
+  return true;
+}
+
+bool writeObjAsMeshFile(ObjMesh& mesh, const std::string& path, bool packed, bool optimize) {
+  PROFILE_ZONE("writeObjAsMeshFile");
+  GLsizei stride = mesh.stride();
+  size_t vertexCount = mesh.vertexCount();
+  if (optimize and not mesh.indices.empty()) {
+    for (size_t g = 0; g < mesh.groups.size(); ++g) {
+      GLuint* indices = &mesh.indices[mesh.groups[g].firstIndex];
+      optimizeVertexCache(indices, indices, mesh.groups[g].indexCount, vertexCount);
+      optimizeOverdraw(indices, indices, mesh.groups[g].indexCount, &mesh.vertices[0], stride, vertexCount);
+    }
+    vertexCount = optimizeVertexFetch(&mesh.vertices[0], &mesh.indices[0], mesh.indices.size(),
+                                      &mesh.vertices[0], vertexCount, stride*sizeof(GLfloat));
+    mesh.vertices.resize(vertexCount*stride);
+  }
+
+  std::vector<MeshFileAttribute> attributes;
+  uint32_t vertexSize = 0;
+  MeshFileAttribute position = { GL_FLOAT, 3, false, vertexSize };
+  attributes.push_back(position);
+  vertexSize += 3*sizeof(GLfloat);
+  if (mesh.normals) {
+    MeshFileAttribute normal = { packed ? GLenum(GL_INT_2_10_10_10_REV) : GLenum(GL_FLOAT), packed ? 4u : 3u,
+                                 packed, vertexSize };
+    attributes.push_back(normal);
+    vertexSize += packed ? sizeof(vertex::int2_10_10_10n) : 3*sizeof(GLfloat);
+  }
+  if (mesh.texcoords) {
+    MeshFileAttribute texcoord = { packed ? GLenum(GL_HALF_FLOAT) : GLenum(GL_FLOAT), 2, false, vertexSize };
+    attributes.push_back(texcoord);
+    vertexSize += packed ? sizeof(vertex::half2) : 2*sizeof(GLfloat);
+  }
+
+  std::vector<char> vertices(vertexCount*vertexSize);
+  for (size_t v = 0; v < vertexCount; ++v) {
+    const GLfloat* in = &mesh.vertices[v*stride];
+    char* out = &vertices[v*vertexSize];
+    std::memcpy(out, in, 3*sizeof(GLfloat));
+    out += 3*sizeof(GLfloat);
+    in += 3;
+    if (mesh.normals) {
+      if (packed) {
+        vertex::int2_10_10_10n n = vertex::snorm10(in[0], in[1], in[2], 0.0f);
+        std::memcpy(out, &n, sizeof(n));
+        out += sizeof(n);
+      }
+      else {
+        std::memcpy(out, in, 3*sizeof(GLfloat));
+        out += 3*sizeof(GLfloat);
+      }
+      in += 3;
+    }
+    if (mesh.texcoords) {
+      if (packed) {
+        const vertex::vec2 t = { in[0], in[1] };
+        vertex::half2 h = vertex::pack(t);
+        std::memcpy(out, &h, sizeof(h));
+      }
+      else std::memcpy(out, in, 2*sizeof(GLfloat));
+    }
+  }
+
+  std::vector<MeshFileSubmesh> submeshes(mesh.groups.size());
+  for (size_t g = 0; g < mesh.groups.size(); ++g) {
+    std::memset(&submeshes[g], 0, sizeof(MeshFileSubmesh));
+    submeshes[g].firstIndex = mesh.groups[g].firstIndex;
+    submeshes[g].indexCount = mesh.groups[g].indexCount;
+    std::strncpy(submeshes[g].name, mesh.groups[g].name.c_str(), sizeof(submeshes[g].name) - 1);
+  }
+
+  if (vertexCount <= 65536) {
+    std::vector<GLushort> shorts(mesh.indices.begin(), mesh.indices.end());
+    return writeMeshFile(path, attributes, vertexSize, vertices.data(), vertexCount,
+                         GL_UNSIGNED_SHORT, shorts.data(), shorts.size(), submeshes);
+  }
+  return writeMeshFile(path, attributes, vertexSize, vertices.data(), vertexCount,
+                       GL_UNSIGNED_INT, mesh.indices.data(), mesh.indices.size(), submeshes);
+}
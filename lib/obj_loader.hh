@@ -0,0 +1,41 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+// A Wavefront OBJ file as one indexed triangle list. Vertices are
+// interleaved floats: position, then the normal and texture coordinate if
+// the file has them. Every distinct v/vt/vn triple is one vertex, polygons
+// are triangulated as fans and each o, g or usemtl starts a group.
+struct ObjMesh {
+  struct Group {
+    std::string name;
+    GLuint firstIndex;
+    GLuint indexCount;
+  };
+  std::vector<GLfloat> vertices;
+  std::vector<GLuint> indices;
+  std::vector<Group> groups;
+  bool normals;
+  bool texcoords;
+
+  ObjMesh() : normals(false), texcoords(false) {}
+  // floats per vertex
+  GLsizei stride() const { return 3 + (normals ? 3 : 0) + (texcoords ? 2 : 0); }
+  size_t vertexCount() const { return vertices.size()/stride(); }
+};
+
+// Parse path into mesh, false with an ERROR:: message when it cannot
+bool loadObj(const std::string& path, ObjMesh& mesh);
+
+// Write mesh as a mesh file (see mesh_file.hh), one submesh per group.
+// Unless optimize is false mesh is first reordered in place with
+// mesh_optimizer.hh. packed stores normals as 10:10:10:2 and texture coordinates as
+// half floats, positions stay 32 bit floats. Indices are 16 bit when the
+// vertices fit.
+bool writeObjAsMeshFile(ObjMesh& mesh, const std::string& path, bool packed = false, bool optimize = true);
+
+#endif
@@ -0,0 +1,142 @@
+#include "profiler.hh"
+
+#ifdef LEARNOPENGL_PROFILE
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+#include <ctime>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+namespace {
+  // events per thread, 24 bytes each
+  const size_t CAPACITY = 1 << 16;
+
+  struct Event {
+    const char* name;
+    uint64_t start, end;
+  };
+
+  struct ThreadBuffer {
+    long tid;
+    const char* name;
+    std::atomic<uint64_t> written;
+    Event events[CAPACITY];
+  };
+
+  // trace timestamps count from process start up
+  const uint64_t origin = Profiler::now();
+
+  // Buffers outlive their threads so zones of finished threads still export
+  struct Registry {
+    std::mutex mutex;
+    std::vector<ThreadBuffer*> buffers;
+
+    Registry() {
+      std::atexit(dumpAtExit);
+    }
+    static void dumpAtExit() { Profiler::dump(); }
+  };
+
+  // never destroyed: the atexit dump runs after static destructors
+  Registry& registry() {
+    static Registry* instance = new Registry;
+    return *instance;
+  }
+
+  ThreadBuffer* threadBuffer() {
+    static thread_local ThreadBuffer* buffer = nullptr;
+    if (buffer == nullptr) {
+      buffer = new ThreadBuffer;
+      buffer->tid = syscall(SYS_gettid);
+      buffer->name = nullptr;
+      buffer->written.store(0);
+      Registry& r = registry();
+      std::lock_guard<std::mutex> lock(r.mutex);
+      r.buffers.push_back(buffer);
+    }
+    return buffer;
+  }
+
+  void writeName(std::ostream& os, const char* name) {
+    for (const char* c = name; *c; ++c) {
+      if (*c == '"' or *c == '\\') os << '\\';
+      os << *c;
+    }
+  }
+}
+
+uint64_t Profiler::now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return uint64_t(ts.tv_sec)*1000000000ULL + ts.tv_nsec;
+}
+
+void Profiler::record(const char* name, uint64_t start, uint64_t end) {
+  ThreadBuffer* buffer = threadBuffer();
+  // single writer: only this thread ever advances written
+  uint64_t index = buffer->written.load(std::memory_order_relaxed);
+  Event& e = buffer->events[index % CAPACITY];
+  e.name = name;
+  e.start = start;
+  e.end = end;
+  buffer->written.store(index + 1, std::memory_order_release);
+}
+
+void Profiler::threadName(const char* name) {
+  threadBuffer()->name = name;
+}
+
+bool Profiler::dump(const char* path) {
+  if (path == nullptr) {
+    path = std::getenv("LEARNOPENGL_TRACE");
+    if (path == nullptr or *path == '\0') path = "trace.json";
+  }
+  std::ofstream out(path);
+  if (not out) {
+    std::cout << "ERROR::PROFILER::CANNOT_WRITE " << path << std::endl;
+    return false;
+  }
+
+  Registry& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  long pid = getpid();
+  out << std::fixed << std::setprecision(3);
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+  bool first = true;
+  size_t total = 0;
+  for (size_t b = 0; b < r.buffers.size(); ++b) {
+    ThreadBuffer* buffer = r.buffers[b];
+    if (buffer->name != nullptr) {
+      out << (first ? "" : ",\n") << "{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": " << pid
+          << ", \"tid\": " << buffer->tid << ", \"args\": {\"name\": \"";
+      writeName(out, buffer->name);
+      out << "\"}}";
+      first = false;
+    }
+    uint64_t written = buffer->written.load(std::memory_order_acquire);
+    // other threads keep recording while we read: leave their next slots
+    // alone, those may be half overwritten
+    uint64_t margin = 64;
+    uint64_t begin = written > CAPACITY - margin ? written - (CAPACITY - margin) : 0;
+    for (uint64_t i = begin; i < written; ++i) {
+      const Event& e = buffer->events[i % CAPACITY];
+      out << (first ? "" : ",\n") << "{\"ph\": \"X\", \"name\": \"";
+      writeName(out, e.name);
+      out << "\", \"pid\": " << pid << ", \"tid\": " << buffer->tid
+          << ", \"ts\": " << int64_t(e.start - origin)/1000.0
+          << ", \"dur\": " << (e.end - e.start)/1000.0 << "}";
+      first = false;
+      ++total;
+    }
+  }
+  out << "\n]}\n";
+  std::cout << "profiler: " << total << " zones written to " << path << std::endl;
+  return true;
+}
+
+#endif
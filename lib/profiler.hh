@@ -0,0 +1,58 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <string>
+#include <atomic>
+#include <cstdint>
+
+// Scoped CPU zones recorded into per-thread ring buffers, exported as a
+// Chrome trace (chrome://tracing, ui.perfetto.dev).
+// Recording takes two clock_gettime calls and a few stores, with no lock:
+// each thread owns its buffer and publishes events through an atomic index.
+// A full buffer overwrites its oldest events.
+//
+// Built only with LEARNOPENGL_PROFILE defined; otherwise the functions are
+// empty inlines and PROFILE_ZONE expands to nothing. The trace is written
+// to $LEARNOPENGL_TRACE (trace.json by default) at exit, and whenever
+// dump() is called, which MainLoop does on F12.
+//
+//   void upload() {
+//     PROFILE_ZONE("upload");
+//     ...
+//   }
+namespace Profiler {
+#ifdef LEARNOPENGL_PROFILE
+  // Nanoseconds on CLOCK_MONOTONIC
+  uint64_t now();
+  // Record a finished zone on the calling thread, name must stay valid
+  // until the trace is written (string literals are fine)
+  void record(const char* name, uint64_t start, uint64_t end);
+  // Label the calling thread in the trace
+  void threadName(const char* name);
+  // Write every buffered zone as a Chrome trace_event file, path defaults
+  // to $LEARNOPENGL_TRACE or trace.json
+  bool dump(const char* path = nullptr);
+#else
+  inline void threadName(const char*) {}
+  inline bool dump(const char* = nullptr) { return false; }
+#endif
+}
+
+#ifdef LEARNOPENGL_PROFILE
+// Records the rest of the enclosing scope
+class ProfileZone {
+  public:
+    explicit ProfileZone(const char* name) : name(name), start(Profiler::now()) {}
+    ~ProfileZone() { Profiler::record(name, start, Profiler::now()); }
+  private:
+    const char* name;
+    uint64_t start;
+};
+#define PROFILE_ZONE_CONCAT(a, b) a##b
+#define PROFILE_ZONE_NAME(line) PROFILE_ZONE_CONCAT(profileZone, line)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_ZONE_NAME(__LINE__)(name)
+#else
+#define PROFILE_ZONE(name)
+#endif
+
+#endif
@@ -0,0 +1,234 @@
+#include "program_cache.hh"
+#include "profiler.hh"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <utime.h>
+
+namespace {
+  const uint32_t MAGIC = 0x4250474c; // "LGPB"
+  const uint32_t VERSION = 1;
+
+  struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t format;
+    uint32_t length;
+  };
+
+  // 64 bit FNV-1a
+  const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+  const uint64_t FNV_PRIME = 1099511628211ULL;
+
+  uint64_t fnv1a(uint64_t h, const void* data, size_t size) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+      h ^= p[i];
+      h *= FNV_PRIME;
+    }
+    return h;
+  }
+
+  uint64_t hashString(uint64_t h, const char* s) {
+    // hash the terminator too so "ab"+"c" and "a"+"bc" differ
+    if (s == nullptr) s = "";
+    return fnv1a(h, s, std::strlen(s) + 1);
+  }
+
+  // mkdir -p
+  bool makeDirectories(const std::string& dir) {
+    for (size_t pos = 1; pos <= dir.size(); ++pos) {
+      if (pos != dir.size() and dir[pos] != '/') continue;
+      std::string partial = dir.substr(0, pos);
+      if (mkdir(partial.c_str(), 0755) != 0 and errno != EEXIST) return false;
+    }
+    return true;
+  }
+
+  std::string defaultDirectory() {
+    const char* env = std::getenv("LEARNOPENGL_SHADER_CACHE");
+    if (env != nullptr) return env;
+    const char* xdg = std::getenv("XDG_CACHE_HOME");
+    if (xdg != nullptr and *xdg) return std::string(xdg) + "/learnopengl/programs";
+    const char* home = std::getenv("HOME");
+    if (home != nullptr and *home) return std::string(home) + "/.cache/learnopengl/programs";
+    return "";
+  }
+
+  size_t defaultSize() {
+    const char* env = std::getenv("LEARNOPENGL_SHADER_CACHE_SIZE");
+    if (env != nullptr and *env) return std::strtoull(env, nullptr, 10);
+    return 16 << 20;
+  }
+}
+
+ProgramCache::ProgramCache(const std::string& directory, size_t maxBytes)
+  : directory(directory), maxBytes(maxBytes) {
+  std::memset(&this->stats, 0, sizeof(this->stats));
+  if (not this->directory.empty() and not makeDirectories(this->directory)) {
+    std::cout << "ERROR::PROGRAM_CACHE::CANNOT_CREATE_DIRECTORY " << this->directory << std::endl;
+    this->directory.clear();
+  }
+}
+
+ProgramCache& ProgramCache::global() {
+  static ProgramCache cache(defaultDirectory(), defaultSize());
+  return cache;
+}
+
+bool ProgramCache::enabled() const {
+  if (this->directory.empty() or not GLEW_ARB_get_program_binary) return false;
+  GLint formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+  return formats > 0;
+}
+
+uint64_t ProgramCache::key(const std::vector<const ShaderSource*>& stages) const {
+  uint64_t h = FNV_OFFSET;
+  h = hashString(h, reinterpret_cast<const char*>(glGetString(GL_VENDOR)));
+  h = hashString(h, reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+  h = hashString(h, reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+  for (size_t i = 0; i < stages.size(); ++i) {
+    // the same text split differently is the same program, so hash the
+    // total length of a stage and then its bytes
+    uint64_t length = 0;
+    for (GLsizei j = 0; j < stages[i]->count(); ++j) length += stages[i]->lengths[j];
+    h = fnv1a(h, &length, sizeof(length));
+    for (GLsizei j = 0; j < stages[i]->count(); ++j)
+      h = fnv1a(h, stages[i]->strings[j], stages[i]->lengths[j]);
+  }
+  return h;
+}
+
+std::string ProgramCache::path(uint64_t key) const {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+  return this->directory + "/" + name;
+}
+
+bool ProgramCache::load(uint64_t key, GLuint program) {
+  PROFILE_ZONE("ProgramCache::load");
+  if (not this->enabled()) return false;
+  std::string file = this->path(key);
+  std::ifstream in(file.c_str(), std::ios::binary);
+  if (not in) return false;
+
+  in.seekg(0, std::ios::end);
+  std::streamoff size = in.tellg();
+  in.seekg(0, std::ios::beg);
+  Header header;
+  in.read(reinterpret_cast<char*>(&header), sizeof(header));
+  // a length past the end of the file is a corrupt entry, not an allocation
+  if (not in or header.magic != MAGIC or header.version != VERSION
+      or header.length > size - std::streamoff(sizeof(header))) {
+    std::remove(file.c_str());
+    return false;
+  }
+  std::vector<char> binary(header.length);
+  in.read(binary.data(), binary.size());
+  if (not in) {
+    std::remove(file.c_str());
+    return false;
+  }
+
+  glProgramBinary(program, header.format, binary.data(), binary.size());
+  GLint success;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (not success) {
+    // driver changed its mind (e.g. a different build with the same strings)
+    ++this->stats.rejected;
+    std::remove(file.c_str());
+    return false;
+  }
+  // bump mtime, it is our LRU clock
+  utime(file.c_str(), nullptr);
+  return true;
+}
+
+void ProgramCache::store(uint64_t key, GLuint program) {
+  PROFILE_ZONE("ProgramCache::store");
+  if (not this->enabled()) return;
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) return;
+
+  std::vector<char> binary(length);
+  GLenum format;
+  GLsizei written = 0;
+  glGetProgramBinary(program, length, &written, &format, binary.data());
+  if (written <= 0) return;
+
+  Header header = { MAGIC, VERSION, format, static_cast<uint32_t>(written) };
+  // write to a temporary and rename so concurrent readers never see half a file
+  std::string file = this->path(key);
+  std::string tmp = file + ".tmp";
+  {
+    std::ofstream out(tmp.c_str(), std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(binary.data(), written);
+    if (not out) {
+      std::remove(tmp.c_str());
+      return;
+    }
+  }
+  if (std::rename(tmp.c_str(), file.c_str()) != 0) {
+    std::remove(tmp.c_str());
+    return;
+  }
+  ++this->stats.stores;
+  this->evict(file);
+}
+
+void ProgramCache::evict(const std::string& keep) {
+  struct Entry {
+    std::string path;
+    time_t mtime;
+    off_t size;
+    bool operator<(const Entry& o) const { return mtime < o.mtime; }
+  };
+  std::vector<Entry> entries;
+  size_t total = 0;
+
+  DIR* dir = opendir(this->directory.c_str());
+  if (dir == nullptr) return;
+  while (struct dirent* ent = readdir(dir)) {
+    size_t len = std::strlen(ent->d_name);
+    if (len < 4 or std::strcmp(ent->d_name + len - 4, ".bin") != 0) continue;
+    Entry e;
+    e.path = this->directory + "/" + ent->d_name;
+    struct stat st;
+    if (stat(e.path.c_str(), &st) != 0) continue;
+    e.mtime = st.st_mtime;
+    e.size = st.st_size;
+    total += e.size;
+    // mtime has a one second resolution, the entry just stored could sort
+    // first, and may alone be over the budget
+    if (e.path != keep) entries.push_back(e);
+  }
+  closedir(dir);
+
+  if (total <= this->maxBytes) return;
+  std::sort(entries.begin(), entries.end());
+  for (size_t i = 0; i < entries.size() and total > this->maxBytes; ++i) {
+    if (std::remove(entries[i].path.c_str()) == 0) {
+      total -= entries[i].size;
+      ++this->stats.evictions;
+    }
+  }
+}
+
+void ProgramCache::report(std::ostream& os) const {
+  os << "program cache: " << this->stats.hits << " hits ("
+     << this->stats.hitSeconds*1000.0 << " ms), "
+     << this->stats.misses << " misses (" << this->stats.missSeconds*1000.0 << " ms), "
+     << this->stats.rejected << " rejected, "
+     << this->stats.stores << " stored, "
+     << this->stats.evictions << " evicted" << std::endl;
+}
@@ -0,0 +1,59 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstdint>
+#include <cstddef>
+
+#include <GL/glew.h>
+
+#include "shader_source.hh"
+
+// Persistent cache of linked program binaries.
+// Entries are keyed by a hash of the shader sources and the driver
+// vendor/renderer/version strings, so a driver update never reuses a binary.
+// Each entry is one file in the cache directory; the directory is kept under
+// maxBytes by evicting the least recently used entries (by mtime), never
+// the one just stored.
+class ProgramCache {
+  public:
+    struct Stats {
+      unsigned hits;      // binary accepted by the driver
+      unsigned misses;    // no entry, program compiled from source
+      unsigned rejected;  // entry found but refused by glProgramBinary
+      unsigned stores;
+      unsigned evictions;
+      double hitSeconds;  // time spent building programs on hits
+      double missSeconds; // time spent building programs on misses
+    };
+    Stats stats;
+
+    // An empty directory disables the cache
+    ProgramCache(const std::string& directory, size_t maxBytes);
+    // Process wide cache, configured through LEARNOPENGL_SHADER_CACHE
+    // (directory, empty to disable) and LEARNOPENGL_SHADER_CACHE_SIZE (bytes)
+    static ProgramCache& global();
+
+    // Whether the current context can save and restore program binaries
+    bool enabled() const;
+    // Key of a program built from the given stages on the current context
+    uint64_t key(const std::vector<const ShaderSource*>& stages) const;
+    // Try to restore program from the entry for key, true if it is now linked
+    bool load(uint64_t key, GLuint program);
+    // Save the binary of a linked program under key
+    void store(uint64_t key, GLuint program);
+    // Print the counters
+    void report(std::ostream& os) const;
+
+  private:
+    std::string directory;
+    size_t maxBytes;
+
+    std::string path(uint64_t key) const;
+    // Remove the least recently used entries over maxBytes, except keep
+    void evict(const std::string& keep);
+};
+
+#endif
@@ -0,0 +1,65 @@
+#include "render_queue.hh"
+#include "profiler.hh"
+
+
+uint64_t RenderQueue::key(unsigned layer, unsigned program, unsigned material, unsigned vao, float depth) {
+  if (not (depth > 0.0f)) depth = 0.0f;
+  if (depth > 1.0f) depth = 1.0f;
+  uint64_t d = uint64_t(double(depth)*((1u << DEPTH_BITS) - 1) + .5);
+  return uint64_t(layer & ((1u << LAYER_BITS) - 1)) << 60
+       | uint64_t(program & ((1u << PROGRAM_BITS) - 1)) << 50
+       | uint64_t(material & ((1u << MATERIAL_BITS) - 1)) << 36
+       | uint64_t(vao & ((1u << VAO_BITS) - 1)) << 24
+       | d;
+}
+
+void RenderQueue::sort() {
+  PROFILE_ZONE("RenderQueue::sort");
+  size_t n = this->entries.size();
+  if (n < 2) return;
+  this->scratch.resize(n);
+  // 11 bit digits, six passes over 64 bit keys; one pass over the keys
+  // counts all of them
+  static const int BITS = 11, DIGITS = 6, BUCKETS = 1 << BITS;
+  std::vector<uint32_t>& counts = this->counts;
+  counts.assign(DIGITS*BUCKETS, 0);
+  for (size_t i = 0; i < n; ++i) {
+    uint64_t key = this->entries[i].key;
+    for (int d = 0; d < DIGITS; ++d) ++counts[d*BUCKETS + ((key >> (BITS*d)) & (BUCKETS - 1))];
+  }
+  Entry* from = &this->entries[0];
+  Entry* to = &this->scratch[0];
+  for (int d = 0; d < DIGITS; ++d) {
+    int shift = BITS*d;
+    uint32_t* count = &counts[d*BUCKETS];
+    // a digit all keys share leaves the order as it is, typically the
+    // layer and the high bits of the ids
+    if (count[(from[0].key >> shift) & (BUCKETS - 1)] == n) continue;
+    uint32_t sum = 0;
+    for (int b = 0; b < BUCKETS; ++b) {
+      uint32_t c = count[b];
+      count[b] = sum;
+      sum += c;
+    }
+    for (size_t i = 0; i < n; ++i) to[count[(from[i].key >> shift) & (BUCKETS - 1)]++] = from[i];
+    Entry* swap = from;
+    from = to;
+    to = swap;
+  }
+  // an odd number of passes leaves the result in scratch
+  if (from != &this->entries[0]) this->entries.swap(this->scratch);
+}
+
+RenderQueue::Changes RenderQueue::changes() const {
+  Changes changes = { 0, 0, 0, 0 };
+  for (size_t i = 0; i < this->entries.size(); ++i) {
+    uint64_t key = this->entries[i].key;
+    bool first = i == 0;
+    uint64_t last = first ? 0 : this->entries[i - 1].key;
+    if (first or layer(key) != layer(last)) ++changes.layer;
+    if (first or program(key) != program(last)) ++changes.program;
+    if (first or material(key) != material(last)) ++changes.material;
+    if (first or vao(key) != vao(last)) ++changes.vao;
+  }
+  return changes;
+}
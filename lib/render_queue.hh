@@ -0,0 +1,65 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Draws of a frame in the order that switches the least state. Each draw
+// is pushed with a 64 bit key packing, from the most significant bits,
+//   layer 4 | program 10 | material 14 | vertex array 12 | depth 24
+// and the index of the draw in the caller's own array. sort() orders the
+// keys with a least significant digit radix sort, so draws sharing a
+// program end up together, within those the ones sharing a material, and
+// so on, front to back last. Ids are whatever the renderer numbers its
+// programs, materials and vertex arrays with, below 1 << their bits.
+//
+//   queue.clear();
+//   for (size_t i = 0; i < draws.size(); ++i)
+//     queue.push(RenderQueue::key(0, draws[i].program, draws[i].material, draws[i].mesh, depth), i);
+//   queue.sort();
+//   for (size_t i = 0; i < queue.size(); ++i) draw(draws[queue[i].index]);
+class RenderQueue {
+  public:
+    static const int LAYER_BITS = 4;
+    static const int PROGRAM_BITS = 10;
+    static const int MATERIAL_BITS = 14;
+    static const int VAO_BITS = 12;
+    static const int DEPTH_BITS = 24;
+
+    struct Entry {
+      uint64_t key;
+      uint32_t index;
+    };
+    // Draws whose field differs from the draw before, in the current order
+    struct Changes {
+      unsigned layer, program, material, vao;
+    };
+
+    // depth in [0, 1], clamped; pass 1 - depth for back to front layers
+    static uint64_t key(unsigned layer, unsigned program, unsigned material, unsigned vao, float depth);
+    static unsigned layer(uint64_t key) { return key >> 60; }
+    static unsigned program(uint64_t key) { return (key >> 50) & ((1u << PROGRAM_BITS) - 1); }
+    static unsigned material(uint64_t key) { return (key >> 36) & ((1u << MATERIAL_BITS) - 1); }
+    static unsigned vao(uint64_t key) { return (key >> 24) & ((1u << VAO_BITS) - 1); }
+
+    void clear() { this->entries.clear(); }
+    void reserve(size_t draws) { this->entries.reserve(draws); }
+    void push(uint64_t key, uint32_t index) {
+      Entry entry = { key, index };
+      this->entries.push_back(entry);
+    }
+    // Stable, so draws with equal keys keep the order they were pushed in
+    void sort();
+
+    size_t size() const { return this->entries.size(); }
+    const Entry& operator[](size_t i) const { return this->entries[i]; }
+    Changes changes() const;
+
+  private:
+    std::vector<Entry> entries;
+    std::vector<Entry> scratch;   // the other buffer of the sort
+    std::vector<uint32_t> counts; // per digit histograms of the sort
+};
+
+#endif
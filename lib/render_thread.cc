@@ -0,0 +1,95 @@
+#include "render_thread.hh"
+#include "profiler.hh"
+#include "state_cache.hh"
+
+RenderThread::RenderThread(const Context& context, size_t queueCapacity)
+  : context(context), input(queueCapacity), droppedEvents(0), stopping(false), closeRequested(false),
+    maxLatency(0) {
+  this->stats.frames = 0;
+  this->stats.events = this->stats.dropped = 0;
+  this->stats.seconds = 0;
+}
+
+RenderThread::~RenderThread() {
+  this->stop();
+}
+
+void RenderThread::start(const std::function<void(const InputEvent&)>& handle,
+                         const std::function<void()>& render) {
+  if (this->thread.joinable()) return;
+  this->handle = handle;
+  this->render = render;
+  this->stopping = false;
+  this->closeRequested = false;
+  this->thread = std::thread(&RenderThread::loop, this);
+}
+
+void RenderThread::stop() {
+  if (not this->thread.joinable()) return;
+  this->stopping = true;
+  this->thread.join();
+  this->stats.dropped = this->droppedEvents;
+}
+
+void RenderThread::post(const InputEvent& event) {
+  InputEvent e = event;
+  if (e.time == 0) e.time = latency::now();
+  if (not this->input.push(e)) ++this->droppedEvents;
+}
+
+void RenderThread::close() {
+  this->closeRequested = true;
+  if (this->context.wake) this->context.wake();
+}
+
+double RenderThread::latency(double percentile) const {
+  return latency::percentile(this->histogram, percentile);
+}
+
+void RenderThread::report(std::ostream& os) const {
+  os << "render thread: " << this->stats.frames << " frames in " << this->stats.seconds << " s, "
+     << this->stats.dropped << " events dropped" << std::endl << "render thread: ";
+  latency::report(os, this->histogram, this->maxLatency);
+}
+
+void RenderThread::loop() {
+  Profiler::threadName("render");
+  if (this->context.attach) this->context.attach();
+  // whatever the cache knew was about the thread that had the context
+  StateCache::global().invalidate();
+  uint64_t start = latency::now();
+  std::vector<uint64_t> arrivals;
+
+  while (not this->stopping) {
+    {
+      PROFILE_ZONE("handle input");
+      InputEvent event;
+      while (this->input.pop(event)) {
+        if (event.type == InputEvent::RESIZE)
+          StateCache::global().viewport(0, 0, GLsizei(event.x), GLsizei(event.y));
+        if (this->handle) this->handle(event);
+        arrivals.push_back(event.time);
+      }
+    }
+    {
+      PROFILE_ZONE("render");
+      if (this->render) this->render();
+    }
+    {
+      PROFILE_ZONE("present");
+      if (this->context.present) this->context.present();
+    }
+    uint64_t presented = latency::now();
+    for (size_t i = 0; i < arrivals.size(); ++i) {
+      double ms = (presented - arrivals[i])*1e-6;
+      latency::add(this->histogram, ms);
+      if (ms > this->maxLatency) this->maxLatency = ms;
+    }
+    this->stats.events += arrivals.size();
+    arrivals.clear();
+    ++this->stats.frames;
+  }
+
+  this->stats.seconds += (latency::now() - start)*1e-9;
+  if (this->context.detach) this->context.detach();
+}
@@ -0,0 +1,115 @@
+#ifndef RENDER_THREAD_H
+#define RENDER_THREAD_H
+
+#include <iostream>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+#include <GL/glew.h>
+
+#include "spsc_queue.hh"
+#include "latency.hh"
+
+struct GLFWwindow;
+
+// One input event as the main thread received it
+struct InputEvent {
+  enum Type { KEY, BUTTON, CURSOR, SCROLL, RESIZE };
+  Type type;
+  int code;         // key or mouse button
+  int scancode;
+  int action;       // GLFW_PRESS, GLFW_RELEASE or GLFW_REPEAT
+  int mods;
+  double x, y;      // cursor position, scroll offset or framebuffer size
+  uint64_t time;    // latency::now() when it arrived
+};
+
+// Rendering on a thread of its own, so a slow frame or a swap blocked on
+// vsync never holds up the event pump. The main thread only turns window
+// events into timestamped InputEvents and posts them into a lock-free
+// queue; the render thread owns the context and, every frame, hands what
+// is queued to the handle function, renders and presents. Both functions
+// run on the render thread only, so the application state they share
+// needs no lock.
+//
+// Each event's latency, from arrival on the main thread until the frame
+// that handled it has been presented, goes into a histogram that report()
+// prints as percentiles. MainLoop records the same thing for the single
+// threaded loop, so the two can be compared on the same sample.
+//
+//   RenderThread thread(RenderThread::windowContext(window));
+//   thread.run(window, [&](const InputEvent& e) { ... }, [&]() { ... });
+//   thread.report(std::cout);
+class RenderThread {
+  public:
+    // How the render thread gets at the window system. attach() makes the
+    // context current on the render thread, detach() releases it there,
+    // present() swaps, wake() interrupts the main thread's event wait
+    // after close().
+    struct Context {
+      std::function<void()> attach;
+      std::function<void()> detach;
+      std::function<void()> present;
+      std::function<void()> wake;
+    };
+    struct Stats {
+      unsigned frames;
+      unsigned long long events;   // handled
+      unsigned long long dropped;  // posted to a full queue
+      double seconds;              // wall time the thread ran
+    };
+    Stats stats;
+
+    // The window's context, presented with glfwSwapBuffers. In
+    // render_thread_glfw.cc, which only GLFW builds link.
+    static Context windowContext(GLFWwindow* window);
+
+    explicit RenderThread(const Context& context, size_t queueCapacity = 4096);
+    ~RenderThread();
+
+    // Release the context on the calling thread first. handle() gets every
+    // posted event before render(), resizes already set the viewport.
+    void start(const std::function<void(const InputEvent&)>& handle, const std::function<void()>& render);
+    // Finish the current frame and join, the context is not current anywhere
+    void stop();
+    // From the main thread; stamps events with no time, never blocks
+    void post(const InputEvent& event);
+    // From the render thread: ask the main thread to stop
+    void close();
+    bool closing() const { return this->closeRequested; }
+
+    // On the main thread with window's context current: install callbacks
+    // that post, start, pump events until the window should close or close()
+    // is called, stop, and make the context current here again.
+    // In render_thread_glfw.cc.
+    void run(GLFWwindow* window, const std::function<void(const InputEvent&)>& handle,
+             const std::function<void()>& render);
+
+    // Percentile of the event to present latency in milliseconds, once stopped
+    double latency(double percentile) const;
+    void report(std::ostream& os) const;
+
+  private:
+    Context context;
+    SpscQueue<InputEvent> input;
+    std::atomic<unsigned long long> droppedEvents;
+    std::atomic<bool> stopping;
+    std::atomic<bool> closeRequested;
+    std::thread thread;
+    std::function<void(const InputEvent&)> handle;
+    std::function<void()> render;
+
+    // latency histogram, written by the render thread only
+    std::vector<unsigned> histogram;
+    double maxLatency;
+
+    void loop();
+
+    RenderThread(const RenderThread&);
+    RenderThread& operator=(const RenderThread&);
+};
+
+#endif
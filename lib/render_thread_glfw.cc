@@ -0,0 +1,96 @@
+#include "render_thread.hh"
+#include "state_cache.hh"
+
+#include <cstring>
+#include <GLFW/glfw3.h>
+
+// Apart from render_thread.cc, so headless builds do not need GLFW
+namespace {
+  RenderThread* of(GLFWwindow* window) {
+    return static_cast<RenderThread*>(glfwGetWindowUserPointer(window));
+  }
+
+  InputEvent event(InputEvent::Type type) {
+    InputEvent e;
+    std::memset(&e, 0, sizeof(e));
+    e.type = type;
+    e.time = latency::now();
+    return e;
+  }
+
+  void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    InputEvent e = event(InputEvent::KEY);
+    e.code = key;
+    e.scancode = scancode;
+    e.action = action;
+    e.mods = mods;
+    of(window)->post(e);
+  }
+
+  void buttonCallback(GLFWwindow* window, int button, int action, int mods) {
+    InputEvent e = event(InputEvent::BUTTON);
+    e.code = button;
+    e.action = action;
+    e.mods = mods;
+    of(window)->post(e);
+  }
+
+  void cursorCallback(GLFWwindow* window, double x, double y) {
+    InputEvent e = event(InputEvent::CURSOR);
+    e.x = x;
+    e.y = y;
+    of(window)->post(e);
+  }
+
+  void scrollCallback(GLFWwindow* window, double x, double y) {
+    InputEvent e = event(InputEvent::SCROLL);
+    e.x = x;
+    e.y = y;
+    of(window)->post(e);
+  }
+
+  void resizeCallback(GLFWwindow* window, int width, int height) {
+    InputEvent e = event(InputEvent::RESIZE);
+    e.x = width;
+    e.y = height;
+    of(window)->post(e);
+  }
+}
+
+RenderThread::Context RenderThread::windowContext(GLFWwindow* window) {
+  Context context;
+  context.attach = [window]() { glfwMakeContextCurrent(window); };
+  context.detach = []() { glfwMakeContextCurrent(nullptr); };
+  context.present = [window]() { glfwSwapBuffers(window); };
+  context.wake = []() { glfwPostEmptyEvent(); };
+  return context;
+}
+
+void RenderThread::run(GLFWwindow* window, const std::function<void(const InputEvent&)>& handle,
+                       const std::function<void()>& render) {
+  // the samples' own callbacks would run on this thread, next to the
+  // render thread, so they are replaced for the duration
+  void* previousPointer = glfwGetWindowUserPointer(window);
+  glfwSetWindowUserPointer(window, this);
+  GLFWkeyfun previousKey = glfwSetKeyCallback(window, keyCallback);
+  GLFWmousebuttonfun previousButton = glfwSetMouseButtonCallback(window, buttonCallback);
+  GLFWcursorposfun previousCursor = glfwSetCursorPosCallback(window, cursorCallback);
+  GLFWscrollfun previousScroll = glfwSetScrollCallback(window, scrollCallback);
+  GLFWframebuffersizefun previousResize = glfwSetFramebufferSizeCallback(window, resizeCallback);
+
+  glfwMakeContextCurrent(nullptr);
+  this->start(handle, render);
+  // only events here: sleep until the next one
+  while (not glfwWindowShouldClose(window) and not this->closing())
+    glfwWaitEvents();
+  this->stop();
+  glfwMakeContextCurrent(window);
+  StateCache::global().invalidate();
+
+  glfwSetKeyCallback(window, previousKey);
+  glfwSetMouseButtonCallback(window, previousButton);
+  glfwSetCursorPosCallback(window, previousCursor);
+  glfwSetScrollCallback(window, previousScroll);
+  glfwSetFramebufferSizeCallback(window, previousResize);
+  glfwSetWindowUserPointer(window, previousPointer);
+}
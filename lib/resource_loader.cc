@@ -0,0 +1,212 @@
+#include "resource_loader.hh"
+#include "headless.hh"
+#include "obj_loader.hh"
+#include "state_cache.hh"
+#include "profiler.hh"
+
+#include <iostream>
+#include <chrono>
+
+namespace {
+  bool endsWith(const std::string& s, const std::string& suffix) {
+    return s.size() >= suffix.size() and s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+  }
+
+  // the loader context has no StateCache and no VAO, so it binds directly
+  // and to a target that is not vertex array state
+  GLuint createBuffer(size_t size, const void* data, GLenum usage) {
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, size, data, usage);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return buffer;
+  }
+}
+
+ResourceLoader::Context ResourceLoader::sharedContext(HeadlessContext& headless) {
+  HeadlessContext* owner = &headless;
+  EGLContext shared = headless.createShared();
+  Context context;
+  context.attach = [owner, shared]() { return shared != EGL_NO_CONTEXT and owner->makeCurrent(shared); };
+  context.detach = [owner]() { owner->makeCurrent(EGL_NO_CONTEXT); };
+  context.destroy = [owner, shared]() { owner->destroyShared(shared); };
+  return context;
+}
+
+ResourceLoader::ResourceLoader(const Context& context, size_t capacity)
+  : context(context), requests(capacity), results(capacity), nextId(1), inFlight(0),
+    stopping(false), state(STARTING) {
+  this->thread = std::thread(&ResourceLoader::run, this);
+}
+
+ResourceLoader::~ResourceLoader() {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stopping = true;
+  }
+  this->wakeup.notify_all();
+  this->thread.join();
+
+  Request* request;
+  while (this->requests.pop(request)) delete request;
+  Result* result;
+  while (this->results.pop(result)) {
+    if (result->fence != 0) glDeleteSync(result->fence);
+    release(result->mesh);
+    delete result;
+  }
+  if (this->context.destroy) this->context.destroy();
+}
+
+bool ResourceLoader::valid() {
+  std::unique_lock<std::mutex> lock(this->mutex);
+  while (this->state == STARTING) this->wakeup.wait(lock);
+  return this->state == RUNNING;
+}
+
+unsigned ResourceLoader::load(const std::string& path, GLenum usage) {
+  // every load in flight has a slot in both queues
+  if (this->inFlight == this->results.capacity()) {
+    std::cout << "ERROR::RESOURCE_LOADER::QUEUE_FULL " << path << std::endl;
+    return 0;
+  }
+  Request* request = new Request();
+  request->id = this->nextId++;
+  request->path = path;
+  request->usage = usage;
+  this->requests.push(request);
+  ++this->inFlight;
+  {
+    // taken so the loader cannot miss the push between its check and its wait
+    std::lock_guard<std::mutex> lock(this->mutex);
+  }
+  this->wakeup.notify_all();
+  return request->id;
+}
+
+bool ResourceLoader::poll(Mesh& mesh) {
+  Result** front = this->results.front();
+  if (front == nullptr) return false;
+  Result* result = *front;
+  // a zero timeout only asks; failed loads have no fence
+  if (result->fence != 0) {
+    GLenum status = glClientWaitSync(result->fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED and status != GL_CONDITION_SATISFIED) return false;
+    glDeleteSync(result->fence);
+  }
+  this->results.pop(result);
+  --this->inFlight;
+  mesh = result->mesh;
+  delete result;
+  return true;
+}
+
+GLuint ResourceLoader::createVertexArray(const Mesh& mesh) {
+  if (not mesh.valid) return 0;
+  StateCache& state = StateCache::global();
+  GLuint VAO;
+  glGenVertexArrays(1, &VAO);
+  state.bindVertexArray(VAO);
+  state.bindBuffer(GL_ARRAY_BUFFER, mesh.vertexBuffer);
+  state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBuffer);
+  if (not mesh.attributes.empty())
+    setVertexAttributes(&mesh.attributes[0], mesh.attributes.size(), mesh.stride);
+  return VAO;
+}
+
+void ResourceLoader::release(Mesh& mesh) {
+  if (mesh.vertexBuffer != 0) glDeleteBuffers(1, &mesh.vertexBuffer);
+  if (mesh.indexBuffer != 0) glDeleteBuffers(1, &mesh.indexBuffer);
+  mesh.vertexBuffer = mesh.indexBuffer = 0;
+  mesh.valid = false;
+}
+
+void ResourceLoader::run() {
+  Profiler::threadName("loader");
+  bool attached = this->context.attach and this->context.attach();
+  if (not attached) std::cout << "ERROR::RESOURCE_LOADER::NO_CONTEXT" << std::endl;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->state = attached ? RUNNING : FAILED;
+  }
+  this->wakeup.notify_all();
+
+  while (true) {
+    Request* request;
+    if (not this->requests.pop(request)) {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      while (not this->stopping and this->requests.empty()) this->wakeup.wait(lock);
+      if (this->stopping) break;
+      continue;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    Result* result = new Result();
+    Mesh& mesh = result->mesh;
+    mesh.id = request->id;
+    mesh.path = request->path;
+    mesh.valid = false;
+    mesh.vertexBuffer = mesh.indexBuffer = 0;
+    mesh.stride = mesh.indexCount = 0;
+    mesh.indexType = GL_UNSIGNED_INT;
+    if (attached) {
+      if (endsWith(request->path, ".obj")) this->loadObjFile(*request, mesh);
+      else this->loadMeshFile(*request, mesh);
+      result->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      // without the flush the fence may never reach the GPU, and the
+      // render thread would wait on it forever
+      glFlush();
+    }
+    else {
+      std::cout << "ERROR::RESOURCE_LOADER::NO_CONTEXT " << request->path << std::endl;
+      result->fence = 0;
+    }
+    mesh.loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    delete request;
+    this->results.push(result);
+  }
+
+  if (attached and this->context.detach) this->context.detach();
+}
+
+void ResourceLoader::loadMeshFile(const Request& request, Mesh& mesh) {
+  PROFILE_ZONE("ResourceLoader::loadMeshFile");
+  MeshFile file(request.path);
+  if (not file.valid()) return;
+  mesh.vertexBuffer = createBuffer(file.vertexBytes(), file.vertices(), request.usage);
+  mesh.indexBuffer = createBuffer(file.indexBytes(), file.indices(), request.usage);
+  mesh.attributes = file.vertexAttributes();
+  mesh.stride = file.info().vertexSize;
+  mesh.indexCount = file.indexCount();
+  mesh.indexType = file.indexType();
+  mesh.submeshes.assign(file.submeshes(), file.submeshes() + file.info().submeshCount);
+  mesh.valid = true;
+}
+
+void ResourceLoader::loadObjFile(const Request& request, Mesh& mesh) {
+  PROFILE_ZONE("ResourceLoader::loadObjFile");
+  ObjMesh obj;
+  if (not loadObj(request.path, obj)) return;
+  mesh.vertexBuffer = createBuffer(obj.vertices.size()*sizeof(GLfloat), obj.vertices.data(), request.usage);
+  mesh.indexBuffer = createBuffer(obj.indices.size()*sizeof(GLuint), obj.indices.data(), request.usage);
+  // position, then normal and texture coordinate when present
+  GLint components[3] = { 3, obj.normals ? 3 : 0, obj.texcoords ? 2 : 0 };
+  size_t offset = 0;
+  for (int i = 0; i < 3; ++i) {
+    if (components[i] == 0) continue;
+    VertexAttribute a = { GL_FLOAT, components[i], GL_FALSE, false, offset,
+                          components[i]*sizeof(GLfloat), sizeof(GLfloat) };
+    mesh.attributes.push_back(a);
+    offset += a.bytes;
+  }
+  mesh.stride = obj.stride()*sizeof(GLfloat);
+  mesh.indexCount = obj.indices.size();
+  mesh.indexType = GL_UNSIGNED_INT;
+  for (size_t i = 0; i < obj.groups.size(); ++i) {
+    MeshFileSubmesh submesh = { obj.groups[i].firstIndex, obj.groups[i].indexCount, {0} };
+    obj.groups[i].name.copy(submesh.name, sizeof(submesh.name) - 1);
+    mesh.submeshes.push_back(submesh);
+  }
+  mesh.valid = true;
+}
@@ -0,0 +1,128 @@
+#ifndef RESOURCE_LOADER_H
+#define RESOURCE_LOADER_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+
+#include <GL/glew.h>
+
+#include "spsc_queue.hh"
+#include "mesh_file.hh"
+#include "vertex_format.hh"
+
+struct GLFWwindow;
+class HeadlessContext;
+
+// Loads meshes on a thread of its own, so the render thread never waits
+// for the disk, the OBJ parser or glBufferData. The thread owns a second
+// GL context sharing objects with the render context: it reads the file,
+// creates and fills the buffers, fences them and flushes. The finished
+// mesh goes back through a lock-free queue, and poll() on the render
+// thread hands it out once its fence has signaled, which never blocks.
+// Vertex arrays are not shared between contexts, createVertexArray()
+// builds one on the render thread.
+//
+// Loads files ending in .obj with loadObj(), anything else as a mesh file.
+// Requests and results each go through an SpscQueue, so load() and poll()
+// must be called from one thread, the one the render context is current on.
+//
+//   ResourceLoader loader(ResourceLoader::sharedContext(context));
+//   unsigned id = loader.load("models/bunny.mesh");
+//   ...
+//   ResourceLoader::Mesh mesh;          // every frame
+//   while (loader.poll(mesh)) {
+//     GLuint VAO = ResourceLoader::createVertexArray(mesh);
+//     ...
+//   }
+class ResourceLoader {
+  public:
+    // The loader thread's context. attach() runs first on the loader thread
+    // and makes a context sharing objects with the render context current,
+    // detach() releases it before the thread exits, destroy() runs on the
+    // thread destroying the loader.
+    struct Context {
+      std::function<bool()> attach;
+      std::function<void()> detach;
+      std::function<void()> destroy;
+    };
+    // A context sharing with context, or with window's context. Call on
+    // the thread that created them. The GLFW one is in
+    // resource_loader_glfw.cc, which only GLFW builds link.
+    static Context sharedContext(HeadlessContext& context);
+    static Context sharedContext(GLFWwindow* window);
+
+    // A finished load. The buffers belong to the caller from poll() on,
+    // release() deletes them.
+    struct Mesh {
+      unsigned id;            // what load() returned
+      std::string path;
+      bool valid;             // false if the file could not be loaded
+      GLuint vertexBuffer, indexBuffer;
+      std::vector<VertexAttribute> attributes;  // location i
+      GLsizei stride;
+      GLsizei indexCount;
+      GLenum indexType;
+      std::vector<MeshFileSubmesh> submeshes;
+      double loadMs;          // on the loader thread, read to fence
+    };
+
+    // capacity bounds the loads in flight
+    explicit ResourceLoader(const Context& context, size_t capacity = 256);
+    // Drops what is still queued, deletes the buffers of meshes not polled.
+    // Call with the render context current.
+    ~ResourceLoader();
+
+    // False if the loader thread could not attach its context
+    bool valid();
+    // Queue path, returns the id its Mesh will carry, 0 if too many loads
+    // are in flight
+    unsigned load(const std::string& path, GLenum usage = GL_STATIC_DRAW);
+    // The next finished mesh, false when none is ready. Meshes come out
+    // in load() order.
+    bool poll(Mesh& mesh);
+    // Loads queued and not polled yet
+    size_t pending() const { return this->inFlight; }
+
+    // A VAO on the current context pointing at mesh's buffers
+    static GLuint createVertexArray(const Mesh& mesh);
+    static void release(Mesh& mesh);
+
+  private:
+    struct Request {
+      unsigned id;
+      std::string path;
+      GLenum usage;
+    };
+    struct Result {
+      Mesh mesh;
+      GLsync fence;
+    };
+    enum State { STARTING, RUNNING, FAILED };
+
+    Context context;
+    SpscQueue<Request*> requests;
+    SpscQueue<Result*> results;
+    unsigned nextId;
+    size_t inFlight;
+    std::thread thread;
+    std::atomic<bool> stopping;
+    std::atomic<int> state;
+
+    // only to sleep while there is nothing to load, the queues need no lock
+    std::mutex mutex;
+    std::condition_variable wakeup;
+
+    void run();
+    void loadMeshFile(const Request& request, Mesh& mesh);
+    void loadObjFile(const Request& request, Mesh& mesh);
+
+    ResourceLoader(const ResourceLoader&);
+    ResourceLoader& operator=(const ResourceLoader&);
+};
+
+#endif
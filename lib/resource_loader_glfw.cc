@@ -0,0 +1,21 @@
+#include "resource_loader.hh"
+
+#include <GLFW/glfw3.h>
+
+// Apart from resource_loader.cc, so headless builds do not need GLFW.
+// The hidden window takes the hints of the last glfwCreateWindow, so it
+// gets the same context version and profile.
+ResourceLoader::Context ResourceLoader::sharedContext(GLFWwindow* window) {
+  glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+  GLFWwindow* hidden = glfwCreateWindow(1, 1, "loader", nullptr, window);
+  glfwWindowHint(GLFW_VISIBLE, GL_TRUE);
+  Context context;
+  context.attach = [hidden]() {
+    if (hidden == nullptr) return false;
+    glfwMakeContextCurrent(hidden);
+    return true;
+  };
+  context.detach = []() { glfwMakeContextCurrent(nullptr); };
+  context.destroy = [hidden]() { if (hidden != nullptr) glfwDestroyWindow(hidden); };
+  return context;
+}
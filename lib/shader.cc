@@ -1,80 +1,227 @@
 #include "shader.hh"
+#include "program_cache.hh"
+#include "profiler.hh"
+#include "state_cache.hh"
 
-Shader::Shader(const GLchar* vertexPath, const GLchar* fragmentPath) {
-  // 1. Retrieve the vertex/fragment source code from filePath
-  std::string vertexCode;
-  std::string fragmentCode;
-  std::ifstream vShaderFile;
-  std::ifstream fShaderFile;
-  // ensures ifstream objects can throw exceptions:
-  vShaderFile.exceptions(std::ifstream::badbit);
-  fShaderFile.exceptions(std::ifstream::badbit);
-  try
-  {
-      // Open files
-      vShaderFile.open(vertexPath);
-      fShaderFile.open(fragmentPath);
-      std::stringstream vShaderStream, fShaderStream;
-      // Read file's buffer contents into streams
-      vShaderStream << vShaderFile.rdbuf();
-      fShaderStream << fShaderFile.rdbuf();
-      // close file handlers
-      vShaderFile.close();
-      fShaderFile.close();
-      // Convert stream into GLchar array
-      vertexCode = vShaderStream.str();
-      fragmentCode = fShaderStream.str();
+#include <chrono>
+#include <cstring>
+#include <map>
+
+namespace {
+  // registered by Shader::bindBlock
+  std::map<std::string, GLuint>& blockBindings() {
+    static std::map<std::string, GLuint> bindings;
+    return bindings;
   }
-  catch(std::ifstream::failure e)
-  {
+}
+
+Shader::UniformCounters Shader::uniformCounters = { 0, 0 };
+
+Shader::Shader(const GLchar* vertexPath, const GLchar* fragmentPath)
+  : vertexFile(vertexPath), fragmentFile(fragmentPath) {
+  PROFILE_ZONE("Shader::Shader");
+  // 1. Map the vertex/fragment source files and resolve their #includes
+  ShaderSource vertexSource, fragmentSource;
+  if (not vertexSource.load(vertexPath) or not fragmentSource.load(fragmentPath))
       std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+  this->files = vertexSource.files;
+  this->files.insert(this->files.end(), fragmentSource.files.begin(), fragmentSource.files.end());
+
+  // 2. Try to restore a previously linked binary
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  ProgramCache& cache = ProgramCache::global();
+  std::vector<const ShaderSource*> stages;
+  stages.push_back(&vertexSource);
+  stages.push_back(&fragmentSource);
+  uint64_t key = cache.key(stages);
+  this->Program = glCreateProgram();
+  if (cache.load(key, this->Program)) {
+    ++cache.stats.hits;
+    cache.stats.hitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    this->reflect();
+    return;
   }
-  const GLchar* vShaderCode = vertexCode.c_str();
-  const GLchar* fShaderCode = fragmentCode.c_str();
+  ++cache.stats.misses;
 
-  // 2. Compile shaders
+  // 3. Compile shaders
   GLuint vertex, fragment;
   GLint success;
   GLchar infoLog[512];
 
-  // Vertex Shader
-  vertex = glCreateShader(GL_VERTEX_SHADER);
-  glShaderSource(vertex, 1, &vShaderCode, NULL);
-  glCompileShader(vertex);
-  // Print compile errors if any
-  glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-  if(!success) {
-      glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-      std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-  };
-
-  fragment = glCreateShader(GL_FRAGMENT_SHADER);
-  glShaderSource(fragment, 1, &fShaderCode, NULL);
-  glCompileShader(fragment);
-  // Print compile errors if any
-  glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-  if (!success) {
-      glGetShaderInfoLog(fragment, 512, NULL, infoLog);
-      std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
-  };
-
-  // Shader Program
-  this->Program = glCreateProgram();
-  glAttachShader(this->Program, vertex);
-  glAttachShader(this->Program, fragment);
-  glLinkProgram(this->Program);
-  // Print linking errors if any
-  glGetProgramiv(this->Program, GL_LINK_STATUS, &success);
-  if(!success) {
-      glGetProgramInfoLog(this->Program, 512, NULL, infoLog);
-      std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+  {
+    PROFILE_ZONE("compile");
+    // Vertex Shader
+    vertex = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertex, vertexSource.count(), vertexSource.strings.data(), vertexSource.lengths.data());
+    glCompileShader(vertex);
+    // Print compile errors if any
+    glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
+    if(!success) {
+        glGetShaderInfoLog(vertex, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+    };
+
+    fragment = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragment, fragmentSource.count(), fragmentSource.strings.data(), fragmentSource.lengths.data());
+    glCompileShader(fragment);
+    // Print compile errors if any
+    glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(fragment, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+    };
+  }
+
+  {
+    PROFILE_ZONE("link");
+    // Shader Program
+    if (cache.enabled())
+      glProgramParameteri(this->Program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glAttachShader(this->Program, vertex);
+    glAttachShader(this->Program, fragment);
+    glLinkProgram(this->Program);
+    // Print linking errors if any
+    glGetProgramiv(this->Program, GL_LINK_STATUS, &success);
+    if(!success) {
+        glGetProgramInfoLog(this->Program, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+    }
+    else cache.store(key, this->Program);
   }
 
   // Delete the shaders as they're linked into our program now and no longer necessery
   glDeleteShader(vertex);
   glDeleteShader(fragment);
+  cache.stats.missSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  this->reflect();
+}
+
+Shader::Shader(GLuint program) : Program(program) {
+  this->reflect();
 }
 
 void Shader::use() {
-  glUseProgram(this->Program);
+  StateCache::global().useProgram(this->Program);
+}
+
+void Shader::replace(GLuint program, const std::vector<std::string>& files) {
+  glDeleteProgram(this->Program);
+  this->Program = program;
+  if (not files.empty()) this->files = files;
+  this->reflect();
+}
+
+void Shader::bindBlock(const std::string& name, GLuint binding) {
+  blockBindings()[name] = binding;
+}
+
+void Shader::reflect() {
+  PROFILE_ZONE("Shader::reflect");
+  // uniform blocks first, binding points are program state set once
+  GLint blocks = 0, blockLength = 0;
+  glGetProgramiv(this->Program, GL_ACTIVE_UNIFORM_BLOCKS, &blocks);
+  glGetProgramiv(this->Program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &blockLength);
+  std::vector<GLchar> blockName(blockLength + 1);
+  for (GLint i = 0; i < blocks; ++i) {
+    GLsizei length;
+    glGetActiveUniformBlockName(this->Program, i, blockName.size(), &length, blockName.data());
+    std::map<std::string, GLuint>::const_iterator it = blockBindings().find(std::string(blockName.data(), length));
+    if (it != blockBindings().end()) glUniformBlockBinding(this->Program, i, it->second);
+  }
+
+  // forget what the old program had, uniforms that went away stay at -1
+  for (size_t i = 0; i < this->uniforms.size(); ++i) {
+    this->uniforms[i].location = -1;
+    this->uniforms[i].known = false;
+  }
+  GLint count = 0, maxLength = 0;
+  glGetProgramiv(this->Program, GL_ACTIVE_UNIFORMS, &count);
+  glGetProgramiv(this->Program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+  std::vector<GLchar> name(maxLength + 1);
+  for (GLint i = 0; i < count; ++i) {
+    GLsizei length;
+    GLint size;
+    GLenum type;
+    glGetActiveUniform(this->Program, i, name.size(), &length, &size, &type, name.data());
+    GLint location = glGetUniformLocation(this->Program, name.data());
+    // uniforms inside blocks have no location, they are not set through us
+    if (location < 0) continue;
+    std::string plain(name.data(), length);
+    // arrays are reported as "name[0]", keep the plain name
+    if (plain.size() > 3 and plain.compare(plain.size() - 3, 3, "[0]") == 0)
+      plain.resize(plain.size() - 3);
+    GLint handle = this->uniform(plain.c_str());
+    if (handle < 0) {
+      Uniform u;
+      u.name = plain;
+      u.known = false;
+      this->uniforms.push_back(u);
+      handle = this->uniforms.size() - 1;
+    }
+    this->uniforms[handle].location = location;
+    this->uniforms[handle].type = type;
+  }
+}
+
+GLint Shader::uniform(const GLchar* name) const {
+  for (size_t i = 0; i < this->uniforms.size(); ++i)
+    if (this->uniforms[i].name == name) return i;
+  return -1;
+}
+
+bool Shader::changed(GLint handle, const void* value, size_t bytes) {
+  Uniform& u = this->uniforms[handle];
+  if (u.known and std::memcmp(u.value, value, bytes) == 0) {
+    ++uniformCounters.elided;
+    return false;
+  }
+  std::memcpy(u.value, value, bytes);
+  u.known = true;
+  ++uniformCounters.issued;
+  return true;
+}
+
+void Shader::set(GLint handle, GLint x) {
+  if (handle < 0) return;
+  if (this->changed(handle, &x, sizeof(x)))
+    glUniform1i(this->uniforms[handle].location, x);
+}
+
+void Shader::set(GLint handle, GLfloat x) {
+  if (handle < 0) return;
+  if (this->changed(handle, &x, sizeof(x)))
+    glUniform1f(this->uniforms[handle].location, x);
+}
+
+void Shader::set(GLint handle, GLfloat x, GLfloat y) {
+  if (handle < 0) return;
+  GLfloat v[2] = { x, y };
+  if (this->changed(handle, v, sizeof(v)))
+    glUniform2f(this->uniforms[handle].location, x, y);
+}
+
+void Shader::set(GLint handle, GLfloat x, GLfloat y, GLfloat z) {
+  if (handle < 0) return;
+  GLfloat v[3] = { x, y, z };
+  if (this->changed(handle, v, sizeof(v)))
+    glUniform3f(this->uniforms[handle].location, x, y, z);
+}
+
+void Shader::set(GLint handle, GLfloat x, GLfloat y, GLfloat z, GLfloat w) {
+  if (handle < 0) return;
+  GLfloat v[4] = { x, y, z, w };
+  if (this->changed(handle, v, sizeof(v)))
+    glUniform4f(this->uniforms[handle].location, x, y, z, w);
+}
+
+void Shader::setMatrix4(GLint handle, const GLfloat* m) {
+  if (handle < 0) return;
+  if (this->changed(handle, m, 16*sizeof(GLfloat)))
+    glUniformMatrix4fv(this->uniforms[handle].location, 1, GL_FALSE, m);
+}
+
+Shader::UniformCounters Shader::endFrame() {
+  UniformCounters frame = uniformCounters;
+  uniformCounters.issued = uniformCounters.elided = 0;
+  return frame;
 }
@@ -2,20 +2,74 @@
 #define SHADER_H
 
 #include <string>
-#include <fstream>
-#include <sstream>
+#include <vector>
 #include <iostream>
 
 #include <GL/glew.h>
 
 class Shader {
   public:
+    // Uniform calls issued to the driver versus skipped because the value
+    // did not change, reset by endFrame()
+    struct UniformCounters {
+      unsigned issued;
+      unsigned elided;
+    };
+    static UniformCounters uniformCounters;
+
     // The program ID
 	  GLuint Program;
 	  // Constructor reads and builds the shader
     Shader(const GLchar* vertexPath, const GLchar* fragmentPath);
-  	// Use the program
+    // Adopt an already linked program
+    explicit Shader(GLuint program);
+  	// Use the program, through the StateCache
   	void use();
+    // Swap in a new linked program and delete the old one. Uniform handles
+    // stay valid, their values are sent again on the next set().
+    // files, if given, replaces the list of source files.
+    void replace(GLuint program, const std::vector<std::string>& files = std::vector<std::string>());
+    // Files the program was built from, includes too (empty when adopted)
+    const std::vector<std::string>& sourceFiles() const { return files; }
+    const std::string& vertexPath() const { return vertexFile; }
+    const std::string& fragmentPath() const { return fragmentFile; }
+
+    // Handle of an active uniform, -1 if the program has no such uniform.
+    // Look it up once, outside the render loop.
+    GLint uniform(const GLchar* name) const;
+    // Typed setters, the program must be in use. The driver is only called
+    // when the value differs from the last one set through this handle.
+    void set(GLint handle, GLint x);
+    void set(GLint handle, GLfloat x);
+    // a double literal would be ambiguous between the two above
+    void set(GLint handle, double x) { this->set(handle, GLfloat(x)); }
+    void set(GLint handle, GLfloat x, GLfloat y);
+    void set(GLint handle, GLfloat x, GLfloat y, GLfloat z);
+    void set(GLint handle, GLfloat x, GLfloat y, GLfloat z, GLfloat w);
+    void setMatrix4(GLint handle, const GLfloat* m);
+    // Returns this frame's uniform counters and resets them
+    static UniformCounters endFrame();
+    // Bind the uniform block called name to a binding point in every
+    // program linked, adopted or reloaded from now on
+    static void bindBlock(const std::string& name, GLuint binding);
+
+  private:
+    struct Uniform {
+      std::string name;
+      GLint location;
+      GLenum type;
+      bool known;       // shadow holds what the driver has
+      GLfloat value[16];
+    };
+    std::vector<Uniform> uniforms;
+    std::string vertexFile, fragmentFile;
+    std::vector<std::string> files;
+
+    // Fill the uniform table from the linked program, keeping the handles
+    // of uniforms already in the table
+    void reflect();
+    // Shadow compare, true if the call must reach the driver
+    bool changed(GLint handle, const void* value, size_t bytes);
 };
 
 #endif
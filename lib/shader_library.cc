@@ -0,0 +1,182 @@
+#include "shader_library.hh"
+#include "program_cache.hh"
+
+namespace {
+  const GLchar* fallbackVertex = "#version 330 core\n"
+    "layout (location = 0) in vec3 position;"
+    "void main() {"
+    "gl_Position = vec4(position, 1.0);"
+    "}";
+  const GLchar* fallbackFragment = "#version 330 core\n"
+    "out vec4 color;"
+    "void main() {"
+    "color = vec4(.5f, .5f, .5f, 1.0f);"
+    "}";
+
+  GLuint compile(GLenum type, const GLchar* source) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    return shader;
+  }
+
+  // Print the compile log of a shader that failed, true if it compiled
+  bool checkCompile(GLuint shader, const char* stage, const std::string& path) {
+    GLint success;
+    GLchar infoLog[512];
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+      glGetShaderInfoLog(shader, 512, NULL, infoLog);
+      std::cout << "ERROR::SHADER::" << stage << "::COMPILATION_FAILED " << path << "\n" << infoLog << std::endl;
+    }
+    return success;
+  }
+}
+
+ShaderLibrary::ShaderLibrary() {
+  this->parallel = GLEW_KHR_parallel_shader_compile;
+  // let the driver pick as many threads as it likes
+  if (this->parallel) glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+
+  // the fallback is tiny, build it right away
+  GLuint vertex = compile(GL_VERTEX_SHADER, fallbackVertex);
+  GLuint fragment = compile(GL_FRAGMENT_SHADER, fallbackFragment);
+  GLuint program = glCreateProgram();
+  glAttachShader(program, vertex);
+  glAttachShader(program, fragment);
+  glLinkProgram(program);
+  glDeleteShader(vertex);
+  glDeleteShader(fragment);
+  this->fallbackShader = new Shader(program);
+}
+
+ShaderLibrary::~ShaderLibrary() {
+  for (size_t i = 0; i < this->entries.size(); ++i) {
+    Entry* entry = this->entries[i];
+    if (entry->state == BUILDING) {
+      glDeleteShader(entry->vertex);
+      glDeleteShader(entry->fragment);
+    }
+    if (entry->program != 0) glDeleteProgram(entry->program);
+    delete entry->shader;
+    delete entry;
+  }
+  glDeleteProgram(this->fallbackShader->Program);
+  delete this->fallbackShader;
+}
+
+size_t ShaderLibrary::add(const GLchar* vertexPath, const GLchar* fragmentPath) {
+  Entry* entry = new Entry;
+  entry->vertexPath = vertexPath;
+  entry->fragmentPath = fragmentPath;
+  entry->vertex = entry->fragment = entry->program = 0;
+  entry->key = 0;
+  entry->state = QUEUED;
+  entry->shader = nullptr;
+  this->entries.push_back(entry);
+  return this->entries.size() - 1;
+}
+
+void ShaderLibrary::submit() {
+  ProgramCache& cache = ProgramCache::global();
+  // 1. every compile
+  for (size_t i = 0; i < this->entries.size(); ++i) {
+    Entry& entry = *this->entries[i];
+    if (entry.state != QUEUED) continue;
+    if (not entry.vertexSource.load(entry.vertexPath) or not entry.fragmentSource.load(entry.fragmentPath)) {
+      std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << entry.vertexPath
+                << " " << entry.fragmentPath << std::endl;
+      entry.state = FAILED;
+      continue;
+    }
+    std::vector<const ShaderSource*> stages;
+    stages.push_back(&entry.vertexSource);
+    stages.push_back(&entry.fragmentSource);
+    entry.key = cache.key(stages);
+    entry.program = glCreateProgram();
+    if (cache.load(entry.key, entry.program)) {
+      ++cache.stats.hits;
+      entry.shader = new Shader(entry.program);
+      entry.state = READY;
+      continue;
+    }
+    ++cache.stats.misses;
+
+    entry.vertex = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(entry.vertex, entry.vertexSource.count(),
+                   entry.vertexSource.strings.data(), entry.vertexSource.lengths.data());
+    glCompileShader(entry.vertex);
+    entry.fragment = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(entry.fragment, entry.fragmentSource.count(),
+                   entry.fragmentSource.strings.data(), entry.fragmentSource.lengths.data());
+    glCompileShader(entry.fragment);
+    entry.state = BUILDING;
+  }
+  // 2. every link, linking does not wait for the compiles to finish
+  for (size_t i = 0; i < this->entries.size(); ++i) {
+    Entry& entry = *this->entries[i];
+    if (entry.state != BUILDING) continue;
+    if (cache.enabled())
+      glProgramParameteri(entry.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glAttachShader(entry.program, entry.vertex);
+    glAttachShader(entry.program, entry.fragment);
+    glLinkProgram(entry.program);
+  }
+}
+
+bool ShaderLibrary::complete(const Entry& entry) const {
+  if (not this->parallel) return true;
+  GLint done = GL_FALSE;
+  glGetProgramiv(entry.program, GL_COMPLETION_STATUS_KHR, &done);
+  return done;
+}
+
+void ShaderLibrary::finish(Entry& entry) {
+  bool compiled = checkCompile(entry.vertex, "VERTEX", entry.vertexPath);
+  compiled = checkCompile(entry.fragment, "FRAGMENT", entry.fragmentPath) and compiled;
+  glDeleteShader(entry.vertex);
+  glDeleteShader(entry.fragment);
+
+  GLint success;
+  GLchar infoLog[512];
+  glGetProgramiv(entry.program, GL_LINK_STATUS, &success);
+  if (not compiled or not success) {
+    glGetProgramInfoLog(entry.program, 512, NULL, infoLog);
+    std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+    entry.state = FAILED;
+    return;
+  }
+  ProgramCache::global().store(entry.key, entry.program);
+  entry.shader = new Shader(entry.program);
+  entry.state = READY;
+}
+
+bool ShaderLibrary::poll() {
+  bool all = true;
+  for (size_t i = 0; i < this->entries.size(); ++i) {
+    Entry& entry = *this->entries[i];
+    if (entry.state == BUILDING) {
+      if (this->complete(entry)) this->finish(entry);
+      else all = false;
+    }
+    else if (entry.state == QUEUED) all = false;
+  }
+  return all;
+}
+
+void ShaderLibrary::finish() {
+  for (size_t i = 0; i < this->entries.size(); ++i) {
+    Entry& entry = *this->entries[i];
+    // the link status query waits for the driver
+    if (entry.state == BUILDING) this->finish(entry);
+  }
+}
+
+bool ShaderLibrary::ready(size_t index) const {
+  return this->entries[index]->state == READY;
+}
+
+Shader& ShaderLibrary::get(size_t index) {
+  Entry& entry = *this->entries[index];
+  return entry.state == READY ? *entry.shader : *this->fallbackShader;
+}
@@ -0,0 +1,63 @@
+#ifndef SHADER_LIBRARY_H
+#define SHADER_LIBRARY_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <GL/glew.h>
+
+#include "shader.hh"
+#include "shader_source.hh"
+
+// Builds many programs at once without blocking the calling thread.
+// submit() issues every compile and then every link up front; with
+// KHR_parallel_shader_compile the driver works on them in its own threads
+// and poll() only asks GL_COMPLETION_STATUS_KHR, which never waits.
+// Until a program is ready get() returns a cheap flat grey fallback that
+// only reads the position attribute (location 0).
+// Without the extension poll() finishes the programs synchronously.
+// The library owns the programs it builds.
+class ShaderLibrary {
+  public:
+    ShaderLibrary();
+    ~ShaderLibrary();
+
+    // Queue a program, returns its index
+    size_t add(const GLchar* vertexPath, const GLchar* fragmentPath);
+    // Start compiling and linking everything queued so far
+    void submit();
+    // Finish the programs the driver is done with, true once all are ready
+    bool poll();
+    // Block until every submitted program is ready
+    void finish();
+
+    bool ready(size_t index) const;
+    size_t size() const { return entries.size(); }
+    // The program, or the fallback while it is not ready. Uniform handles
+    // belong to one Shader, resolve them again once ready() is true.
+    Shader& get(size_t index);
+    Shader& fallback() { return *fallbackShader; }
+
+  private:
+    enum State { QUEUED, BUILDING, READY, FAILED };
+    struct Entry {
+      std::string vertexPath, fragmentPath;
+      ShaderSource vertexSource, fragmentSource;
+      GLuint vertex, fragment, program;
+      uint64_t key;
+      State state;
+      Shader* shader;
+    };
+    std::vector<Entry*> entries;
+    Shader* fallbackShader;
+    bool parallel;
+
+    bool complete(const Entry& entry) const;
+    void finish(Entry& entry);
+
+    ShaderLibrary(const ShaderLibrary&);
+    ShaderLibrary& operator=(const ShaderLibrary&);
+};
+
+#endif
@@ -0,0 +1,159 @@
+#include "shader_source.hh"
+#include "profiler.hh"
+
+#include <iostream>
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+  // deepest #include chain before we assume a cycle
+  const int MAX_INCLUDE_DEPTH = 16;
+
+  std::string canonical(const std::string& path) {
+    char resolved[PATH_MAX];
+    if (realpath(path.c_str(), resolved) == nullptr) return "";
+    return resolved;
+  }
+
+  std::string directory(const std::string& path) {
+    size_t slash = path.rfind('/');
+    if (slash == std::string::npos) return ".";
+    return path.substr(0, slash);
+  }
+
+  void unmap(MappedFile* file) {
+    if (file->size > 0) munmap(const_cast<char*>(file->data), file->size);
+    delete file;
+  }
+
+  // If [line, end) is an #include "name" directive store name and return true
+  bool parseInclude(const char* line, const char* end, std::string& name) {
+    const char* p = line;
+    while (p < end and (*p == ' ' or *p == '\t')) ++p;
+    static const char directive[] = "#include";
+    size_t length = sizeof(directive) - 1;
+    if (end - p < (ptrdiff_t) length or std::memcmp(p, directive, length) != 0) return false;
+    p += length;
+    while (p < end and (*p == ' ' or *p == '\t')) ++p;
+    if (p == end or *p != '"') return false;
+    const char* close = std::find(p + 1, end, '"');
+    if (close == end) return false;
+    name.assign(p + 1, close);
+    return true;
+  }
+}
+
+SourceCache::SourceCache() : loads(0) {}
+
+SourceCache::~SourceCache() {
+  for (std::map<std::string, MappedFile*>::iterator it = files.begin(); it != files.end(); ++it)
+    unmap(it->second);
+}
+
+SourceCache& SourceCache::global() {
+  static SourceCache cache;
+  return cache;
+}
+
+const MappedFile* SourceCache::get(const std::string& path) {
+  std::string key = canonical(path);
+  if (key.empty()) return nullptr;
+  std::map<std::string, MappedFile*>::iterator it = this->files.find(key);
+  if (it != this->files.end()) return it->second;
+
+  int fd = open(key.c_str(), O_RDONLY);
+  if (fd < 0) return nullptr;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return nullptr;
+  }
+  MappedFile* file = new MappedFile;
+  file->path = key;
+  file->data = nullptr;
+  file->size = st.st_size;
+  if (file->size > 0) {
+    void* data = mmap(nullptr, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      close(fd);
+      delete file;
+      return nullptr;
+    }
+    file->data = static_cast<const char*>(data);
+  }
+  // the mapping stays valid once the descriptor is closed
+  close(fd);
+  ++this->loads;
+  this->files[key] = file;
+  return file;
+}
+
+void SourceCache::invalidate(const std::string& path) {
+  std::string key = canonical(path);
+  std::map<std::string, MappedFile*>::iterator it = this->files.find(key.empty() ? path : key);
+  if (it == this->files.end()) return;
+  unmap(it->second);
+  this->files.erase(it);
+}
+
+bool ShaderSource::load(const std::string& path) {
+  PROFILE_ZONE("ShaderSource::load");
+  this->strings.clear();
+  this->lengths.clear();
+  this->files.clear();
+  this->directives.clear();
+  return this->append(path, 0);
+}
+
+void ShaderSource::span(const char* data, size_t size) {
+  if (size == 0) return;
+  this->strings.push_back(data);
+  this->lengths.push_back(size);
+}
+
+bool ShaderSource::append(const std::string& path, int depth) {
+  if (depth > MAX_INCLUDE_DEPTH) {
+    std::cout << "ERROR::SHADER::INCLUDE_TOO_DEEP " << path << std::endl;
+    return false;
+  }
+  const MappedFile* file = SourceCache::global().get(path);
+  if (file == nullptr) return false;
+  // include once
+  if (std::find(this->files.begin(), this->files.end(), file->path) != this->files.end())
+    return true;
+  this->files.push_back(file->path);
+  if (depth > 0) {
+    this->directives.push_back("#line 1\n");
+    this->span(this->directives.back().data(), this->directives.back().size());
+  }
+
+  const char* end = file->data + file->size;
+  const char* chunk = file->data;
+  int line = 1;
+  for (const char* p = file->data; p < end; ++line) {
+    const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    if (lineEnd == nullptr) lineEnd = end;
+    std::string name;
+    if (parseInclude(p, lineEnd, name)) {
+      this->span(chunk, p - chunk);
+      if (not this->append(directory(file->path) + "/" + name, depth + 1)) {
+        std::cout << "ERROR::SHADER::INCLUDE_NOT_FOUND " << name
+                  << " (" << file->path << ":" << line << ")" << std::endl;
+        return false;
+      }
+      // the included file may not end with a newline
+      this->directives.push_back("\n#line " + std::to_string(line + 1) + "\n");
+      this->span(this->directives.back().data(), this->directives.back().size());
+      chunk = lineEnd < end ? lineEnd + 1 : end;
+    }
+    p = lineEnd + 1;
+  }
+  this->span(chunk, end - chunk);
+  return true;
+}
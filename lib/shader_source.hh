@@ -0,0 +1,69 @@
+#ifndef SHADER_SOURCE_H
+#define SHADER_SOURCE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <cstddef>
+
+#include <GL/glew.h>
+
+// A read-only memory mapping of a whole file
+struct MappedFile {
+  std::string path;   // canonical path
+  const char* data;
+  size_t size;
+};
+
+// Process wide cache of mapped shader files, keyed by canonical path.
+// A file is mapped the first time any program asks for it and then shared.
+class SourceCache {
+  public:
+    // Number of files actually mapped, i.e. cache misses
+    unsigned loads;
+
+    static SourceCache& global();
+    ~SourceCache();
+    // nullptr if the file cannot be read
+    const MappedFile* get(const std::string& path);
+    // Drop a mapping so the next get() sees the file's new contents
+    void invalidate(const std::string& path);
+
+  private:
+    std::map<std::string, MappedFile*> files;
+    SourceCache();
+};
+
+// The source of one shader stage as a list of spans into mapped files,
+// ready for glShaderSource without concatenating anything.
+// Lines of the form
+//   #include "relative/path.glsl"
+// are replaced by the spans of that file (resolved relative to the including
+// file, each file at most once per stage), followed by a #line directive so
+// compiler messages keep the line numbers of the including file.
+class ShaderSource {
+  public:
+    std::vector<const GLchar*> strings;
+    std::vector<GLint> lengths;
+    // Canonical paths of the files this source was built from
+    std::vector<std::string> files;
+
+    ShaderSource() {}
+    // False if path or one of its includes cannot be read
+    bool load(const std::string& path);
+    GLsizei count() const { return strings.size(); }
+
+  private:
+    // generated #line directives, deque keeps pointers stable
+    std::deque<std::string> directives;
+
+    bool append(const std::string& path, int depth);
+    void span(const char* data, size_t size);
+
+    // strings point into directives, copies would dangle
+    ShaderSource(const ShaderSource&);
+    ShaderSource& operator=(const ShaderSource&);
+};
+
+#endif
@@ -0,0 +1,335 @@
+#include "shader_watcher.hh"
+#include "program_cache.hh"
+#include "profiler.hh"
+
+#include <iostream>
+#include <algorithm>
+#include <cerrno>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace {
+  std::string directory(const std::string& path) {
+    size_t slash = path.rfind('/');
+    if (slash == std::string::npos) return ".";
+    return path.substr(0, slash);
+  }
+
+  bool checkCompile(GLuint shader, const char* stage, const std::string& path) {
+    GLint success;
+    GLchar infoLog[512];
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+      glGetShaderInfoLog(shader, 512, NULL, infoLog);
+      std::cout << "ERROR::SHADER::" << stage << "::COMPILATION_FAILED " << path << "\n" << infoLog << std::endl;
+    }
+    return success;
+  }
+
+  GLuint compileStage(GLenum type, GLsizei count, const GLchar* const* strings, const GLint* lengths) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, count, strings, lengths);
+    glCompileShader(shader);
+    return shader;
+  }
+
+  GLuint linkProgram(GLuint vertex, GLuint fragment, bool retrievable) {
+    GLuint program = glCreateProgram();
+    if (retrievable) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glAttachShader(program, vertex);
+    glAttachShader(program, fragment);
+    glLinkProgram(program);
+    return program;
+  }
+
+  std::string join(const ShaderSource& source) {
+    std::string text;
+    for (GLsizei i = 0; i < source.count(); ++i) text.append(source.strings[i], source.lengths[i]);
+    return text;
+  }
+}
+
+ShaderWatcher::ShaderWatcher() : reloads(0), failures(0) {
+  this->init();
+}
+
+ShaderWatcher::ShaderWatcher(const Context& compiler) : reloads(0), failures(0) {
+  this->init();
+  if (this->parallel) {
+    if (compiler.destroy) compiler.destroy();
+    return;
+  }
+  this->compiler = compiler;
+  this->state = STARTING;
+  this->compileThread = std::thread(&ShaderWatcher::compile, this);
+  std::unique_lock<std::mutex> lock(this->compileMutex);
+  this->compileWakeup.wait(lock, [this]() { return this->state != STARTING; });
+  if (this->state == RUNNING) return;
+  // compile inline after all
+  lock.unlock();
+  this->compileThread.join();
+  if (this->compiler.destroy) this->compiler.destroy();
+  this->compiler = Context();
+}
+
+void ShaderWatcher::init() {
+  this->stopping = false;
+  this->state = FAILED;
+  this->parallel = GLEW_KHR_parallel_shader_compile;
+  this->inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (this->inotify < 0 or pipe(this->wakeup) != 0) {
+    std::cout << "ERROR::SHADER_WATCHER::INOTIFY_UNAVAILABLE" << std::endl;
+    if (this->inotify >= 0) close(this->inotify);
+    this->inotify = -1;
+    return;
+  }
+  this->thread = std::thread(&ShaderWatcher::run, this);
+}
+
+ShaderWatcher::~ShaderWatcher() {
+  if (this->inotify >= 0) {
+    char stop = 0;
+    if (write(this->wakeup[1], &stop, 1) != 1)
+      std::cout << "ERROR::SHADER_WATCHER::CANNOT_STOP" << std::endl;
+    this->thread.join();
+    close(this->wakeup[0]);
+    close(this->wakeup[1]);
+    close(this->inotify);
+  }
+  if (this->compileThread.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(this->compileMutex);
+      this->stopping = true;
+    }
+    this->compileWakeup.notify_all();
+    this->compileThread.join();
+  }
+  // the compile thread is gone, rebuilds it never got to hold no objects
+  for (size_t i = 0; i < this->pending.size(); ++i) this->discard(this->pending[i]);
+  if (this->compiler.destroy) this->compiler.destroy();
+}
+
+void ShaderWatcher::compile() {
+  Profiler::threadName("shader compiler");
+  bool attached = this->compiler.attach and this->compiler.attach();
+  if (not attached) std::cout << "ERROR::SHADER_WATCHER::NO_CONTEXT" << std::endl;
+  {
+    std::lock_guard<std::mutex> lock(this->compileMutex);
+    this->state = attached ? RUNNING : FAILED;
+  }
+  this->compileWakeup.notify_all();
+  if (not attached) return;
+
+  for (;;) {
+    Rebuild* rebuild;
+    {
+      std::unique_lock<std::mutex> lock(this->compileMutex);
+      this->compileWakeup.wait(lock, [this]() { return this->stopping or not this->queue.empty(); });
+      if (this->stopping) break;
+      rebuild = this->queue.front();
+      this->queue.pop_front();
+    }
+    PROFILE_ZONE("ShaderWatcher::compile");
+    const GLchar* text = rebuild->vertexText.data();
+    GLint length = rebuild->vertexText.size();
+    rebuild->vertex = compileStage(GL_VERTEX_SHADER, 1, &text, &length);
+    text = rebuild->fragmentText.data();
+    length = rebuild->fragmentText.size();
+    rebuild->fragment = compileStage(GL_FRAGMENT_SHADER, 1, &text, &length);
+    rebuild->program = linkProgram(rebuild->vertex, rebuild->fragment, rebuild->retrievable);
+    rebuild->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    // without the flush the fence may never signal, see ResourceLoader
+    glFlush();
+    rebuild->compiled.store(true, std::memory_order_release);
+  }
+
+  if (this->compiler.detach) this->compiler.detach();
+}
+
+void ShaderWatcher::run() {
+  // inotify_event is variable length, keep the buffer aligned for it
+  alignas(struct inotify_event) char buffer[4096];
+  for (;;) {
+    struct pollfd fds[2] = {
+      { this->inotify, POLLIN, 0 },
+      { this->wakeup[0], POLLIN, 0 }
+    };
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) continue;
+      return;
+    }
+    if (fds[1].revents) return;
+
+    ssize_t length;
+    while ((length = read(this->inotify, buffer, sizeof(buffer))) > 0) {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      for (char* p = buffer; p < buffer + length; ) {
+        struct inotify_event* event = reinterpret_cast<struct inotify_event*>(p);
+        std::map<int, std::string>::iterator dir = this->directories.find(event->wd);
+        if (event->len > 0 and dir != this->directories.end())
+          this->changed.insert(dir->second + "/" + event->name);
+        p += sizeof(struct inotify_event) + event->len;
+      }
+    }
+  }
+}
+
+void ShaderWatcher::watch(Shader& shader) {
+  if (std::find(this->shaders.begin(), this->shaders.end(), &shader) == this->shaders.end())
+    this->shaders.push_back(&shader);
+  if (this->inotify < 0) return;
+
+  const std::vector<std::string>& files = shader.sourceFiles();
+  std::lock_guard<std::mutex> lock(this->mutex);
+  for (size_t i = 0; i < files.size(); ++i) {
+    // watch directories, editors often save by renaming a new file over the
+    // old. Only finished writes count: a file is still empty when created.
+    std::string dir = directory(files[i]);
+    bool known = false;
+    for (std::map<int, std::string>::iterator it = this->directories.begin(); it != this->directories.end(); ++it)
+      known = known or it->second == dir;
+    if (known) continue;
+    int wd = inotify_add_watch(this->inotify, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (wd < 0) {
+      std::cout << "ERROR::SHADER_WATCHER::CANNOT_WATCH " << dir << std::endl;
+      continue;
+    }
+    this->directories[wd] = dir;
+  }
+}
+
+bool ShaderWatcher::update() {
+  std::set<std::string> paths;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    paths.swap(this->changed);
+  }
+  size_t ready = this->pending.size();
+
+  if (not paths.empty()) {
+    for (std::set<std::string>::iterator it = paths.begin(); it != paths.end(); ++it)
+      SourceCache::global().invalidate(*it);
+    for (size_t i = 0; i < this->shaders.size(); ++i) {
+      const std::vector<std::string>& files = this->shaders[i]->sourceFiles();
+      bool affected = false;
+      for (size_t f = 0; f < files.size() and not affected; ++f)
+        affected = paths.count(files[f]) > 0;
+      if (affected) this->start(this->shaders[i]);
+    }
+  }
+
+  // swap in the programs that are done, never wait for the others;
+  // rebuilds started just now are left for the next update
+  unsigned before = this->reloads;
+  for (size_t i = 0; i < ready; ) {
+    Rebuild* rebuild = this->pending[i];
+    if (not this->done(rebuild)) {
+      ++i;
+      continue;
+    }
+    if (rebuild->superseded) this->discard(rebuild);
+    else this->finish(rebuild);
+    this->pending.erase(this->pending.begin() + i);
+    --ready;
+  }
+  return this->reloads != before;
+}
+
+void ShaderWatcher::start(Shader* shader) {
+  ShaderSource vertexSource, fragmentSource;
+  if (not vertexSource.load(shader->vertexPath()) or not fragmentSource.load(shader->fragmentPath())) {
+    // half written file, the next event retries
+    return;
+  }
+
+  // a newer edit supersedes a rebuild still in flight, which may be on
+  // the compile thread, so it is dropped once done
+  for (size_t i = 0; i < this->pending.size(); ++i)
+    if (this->pending[i]->shader == shader) this->pending[i]->superseded = true;
+
+  Rebuild* rebuild = new Rebuild;
+  rebuild->shader = shader;
+  rebuild->vertex = rebuild->fragment = rebuild->program = 0;
+  rebuild->retrievable = ProgramCache::global().enabled();
+  rebuild->fence = 0;
+  rebuild->compiled = false;
+  rebuild->superseded = false;
+  std::vector<const ShaderSource*> stages;
+  stages.push_back(&vertexSource);
+  stages.push_back(&fragmentSource);
+  rebuild->key = ProgramCache::global().key(stages);
+  // the edit may have added includes
+  rebuild->files = vertexSource.files;
+  rebuild->files.insert(rebuild->files.end(), fragmentSource.files.begin(), fragmentSource.files.end());
+  this->pending.push_back(rebuild);
+
+  if (this->compileThread.joinable()) {
+    // the spans may be unmapped by the next edit, the thread gets copies
+    rebuild->vertexText = join(vertexSource);
+    rebuild->fragmentText = join(fragmentSource);
+    {
+      std::lock_guard<std::mutex> lock(this->compileMutex);
+      this->queue.push_back(rebuild);
+    }
+    this->compileWakeup.notify_all();
+    return;
+  }
+
+  // glShaderSource copies the strings, the spans are not used after this
+  PROFILE_ZONE("ShaderWatcher::compile");
+  rebuild->vertex = compileStage(GL_VERTEX_SHADER, vertexSource.count(),
+                                 vertexSource.strings.data(), vertexSource.lengths.data());
+  rebuild->fragment = compileStage(GL_FRAGMENT_SHADER, fragmentSource.count(),
+                                   fragmentSource.strings.data(), fragmentSource.lengths.data());
+  rebuild->program = linkProgram(rebuild->vertex, rebuild->fragment, rebuild->retrievable);
+}
+
+bool ShaderWatcher::done(Rebuild* rebuild) {
+  if (this->compileThread.joinable()) {
+    if (not rebuild->compiled.load(std::memory_order_acquire)) return false;
+    // a zero timeout only asks
+    GLenum status = glClientWaitSync(rebuild->fence, 0, 0);
+    return status == GL_ALREADY_SIGNALED or status == GL_CONDITION_SATISFIED;
+  }
+  GLint done = GL_TRUE;
+  if (this->parallel) glGetProgramiv(rebuild->program, GL_COMPLETION_STATUS_KHR, &done);
+  return done;
+}
+
+void ShaderWatcher::discard(Rebuild* rebuild) {
+  if (rebuild->fence != 0) glDeleteSync(rebuild->fence);
+  glDeleteShader(rebuild->vertex);
+  glDeleteShader(rebuild->fragment);
+  glDeleteProgram(rebuild->program);
+  delete rebuild;
+}
+
+void ShaderWatcher::finish(Rebuild* rebuild) {
+  Shader* shader = rebuild->shader;
+  if (rebuild->fence != 0) glDeleteSync(rebuild->fence);
+  bool compiled = checkCompile(rebuild->vertex, "VERTEX", shader->vertexPath());
+  compiled = checkCompile(rebuild->fragment, "FRAGMENT", shader->fragmentPath()) and compiled;
+  glDeleteShader(rebuild->vertex);
+  glDeleteShader(rebuild->fragment);
+
+  GLint success;
+  GLchar infoLog[512];
+  glGetProgramiv(rebuild->program, GL_LINK_STATUS, &success);
+  if (not compiled or not success) {
+    glGetProgramInfoLog(rebuild->program, 512, NULL, infoLog);
+    std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+    std::cout << "keeping the previous " << shader->vertexPath() << " program" << std::endl;
+    glDeleteProgram(rebuild->program);
+    ++this->failures;
+    delete rebuild;
+    return;
+  }
+
+  ProgramCache::global().store(rebuild->key, rebuild->program);
+  shader->replace(rebuild->program, rebuild->files);
+  this->watch(*shader);
+  ++this->reloads;
+  std::cout << "reloaded " << shader->vertexPath() << " " << shader->fragmentPath() << std::endl;
+  delete rebuild;
+}
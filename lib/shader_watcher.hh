@@ -0,0 +1,119 @@
+#ifndef SHADER_WATCHER_H
+#define SHADER_WATCHER_H
+
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+
+#include <GL/glew.h>
+
+#include "shader.hh"
+#include "shader_source.hh"
+
+struct GLFWwindow;
+
+// Rebuilds Shaders whose source files change on disk (Linux inotify).
+// A background thread only collects file events. update() runs on the GL
+// thread once per frame: it starts rebuilding the affected programs and,
+// on a later frame once they are complete, swaps them into their Shader.
+// Until then, and for good if the new source does not compile, the old
+// program keeps rendering. The Shader objects stay the same, so pointers
+// and uniform handles held by the application remain valid.
+//
+// With KHR_parallel_shader_compile the driver compiles in its own threads.
+// Without it, given a compiler context, a thread of the watcher compiles
+// and links on a context sharing programs with the render context, and
+// update() picks the program up once its fence has signaled. Without
+// either, compile and link run inside update() and that frame takes the
+// whole cost; the swap still waits for the next update().
+//
+//   ShaderWatcher watcher(ShaderWatcher::sharedContext(window));
+//   watcher.watch(shader);
+//   ...
+//   if (watcher.update()) redraw();   // every frame
+class ShaderWatcher {
+  public:
+    // Reloads finished over the lifetime of the watcher
+    unsigned reloads, failures;
+
+    // The compile thread's context, as in ResourceLoader: attach() makes a
+    // context sharing objects with the render context current on the
+    // thread, detach() releases it there, destroy() runs on the thread
+    // destroying the watcher
+    struct Context {
+      std::function<bool()> attach;
+      std::function<void()> detach;
+      std::function<void()> destroy;
+    };
+    // A hidden window sharing window's context, in shader_watcher_glfw.cc
+    static Context sharedContext(GLFWwindow* window);
+
+    ShaderWatcher();
+    // compiler is only used, and otherwise destroyed right away, when the
+    // driver lacks KHR_parallel_shader_compile
+    explicit ShaderWatcher(const Context& compiler);
+    ~ShaderWatcher();
+    // Watch every file shader was built from; shader must outlive the watcher
+    void watch(Shader& shader);
+    // Call at a frame boundary on the thread that owns the GL context,
+    // true if a program was swapped and the frame should be redrawn
+    bool update();
+
+  private:
+    // Only what outlives start(): the sources point into mappings a later
+    // edit unmaps, so the cache key and file list are taken from them there
+    struct Rebuild {
+      Shader* shader;
+      uint64_t key;
+      std::vector<std::string> files;
+      GLuint vertex, fragment, program;
+      bool retrievable;  // for the program cache, asked on the GL thread
+      // compile thread only: copies of the sources, and its fence once
+      // compiled is set
+      std::string vertexText, fragmentText;
+      GLsync fence;
+      std::atomic<bool> compiled;
+      bool superseded;  // a newer edit started another rebuild
+    };
+    enum State { STARTING, RUNNING, FAILED };
+
+    int inotify;
+    int wakeup[2];  // pipe to stop the thread
+    std::thread thread;
+    std::map<int, std::string> directories;  // watch descriptor -> directory
+    std::vector<Shader*> shaders;
+    std::vector<Rebuild*> pending;
+    bool parallel;
+
+    std::mutex mutex;
+    std::set<std::string> changed;  // guarded by mutex
+
+    Context compiler;
+    std::thread compileThread;
+    std::mutex compileMutex;
+    std::condition_variable compileWakeup;
+    std::deque<Rebuild*> queue;     // guarded by compileMutex
+    bool stopping;                  // guarded by compileMutex
+    int state;                      // guarded by compileMutex
+
+    void init();
+    void run();
+    void compile();
+    void start(Shader* shader);
+    bool done(Rebuild* rebuild);
+    void finish(Rebuild* rebuild);
+    void discard(Rebuild* rebuild);
+
+    ShaderWatcher(const ShaderWatcher&);
+    ShaderWatcher& operator=(const ShaderWatcher&);
+};
+
+#endif
@@ -0,0 +1,21 @@
+#include "shader_watcher.hh"
+
+#include <GLFW/glfw3.h>
+
+// Apart from shader_watcher.cc, like resource_loader_glfw.cc. The hidden
+// window takes the hints of the last glfwCreateWindow, so it gets the same
+// context version and profile.
+ShaderWatcher::Context ShaderWatcher::sharedContext(GLFWwindow* window) {
+  glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+  GLFWwindow* hidden = glfwCreateWindow(1, 1, "shader compiler", nullptr, window);
+  glfwWindowHint(GLFW_VISIBLE, GL_TRUE);
+  Context context;
+  context.attach = [hidden]() {
+    if (hidden == nullptr) return false;
+    glfwMakeContextCurrent(hidden);
+    return true;
+  };
+  context.detach = []() { glfwMakeContextCurrent(nullptr); };
+  context.destroy = [hidden]() { if (hidden != nullptr) glfwDestroyWindow(hidden); };
+  return context;
+}
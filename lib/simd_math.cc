@@ -0,0 +1,336 @@
+#include "simd_math.hh"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace math {
+  mat4 rotation(const quat& q) {
+    float x = q.x(), y = q.y(), z = q.z(), w = q.w();
+    return mat4(vec4(1 - 2*(y*y + z*z), 2*(x*y + w*z), 2*(x*z - w*y), 0),
+                vec4(2*(x*y - w*z), 1 - 2*(x*x + z*z), 2*(y*z + w*x), 0),
+                vec4(2*(x*z + w*y), 2*(y*z - w*x), 1 - 2*(x*x + y*y), 0),
+                vec4(0, 0, 0, 1));
+  }
+
+  mat4 perspective(float fovy, float aspect, float zNear, float zFar) {
+    float f = 1.0f/std::tan(.5f*fovy);
+    return mat4(vec4(f/aspect, 0, 0, 0),
+                vec4(0, f, 0, 0),
+                vec4(0, 0, (zFar + zNear)/(zNear - zFar), -1),
+                vec4(0, 0, 2*zFar*zNear/(zNear - zFar), 0));
+  }
+
+  mat4 lookAt(const vec3& eye, const vec3& center, const vec3& up) {
+    vec3 f = normalize(center - eye);
+    vec3 s = normalize(cross(f, up));
+    vec3 u = cross(s, f);
+    return mat4(vec4(s.x(), u.x(), -f.x(), 0),
+                vec4(s.y(), u.y(), -f.y(), 0),
+                vec4(s.z(), u.z(), -f.z(), 0),
+                vec4(-dot(s, eye), -dot(u, eye), dot(f, eye), 1));
+  }
+
+  mat4 transpose(const mat4& m) {
+    mat4 r;
+    float* out = r.data();
+    const float* in = m.data();
+    for (int c = 0; c < 4; ++c)
+      for (int row = 0; row < 4; ++row) out[row*4 + c] = in[c*4 + row];
+    return r;
+  }
+
+  Simd best() {
+#if defined(__SSE2__)
+    // kernels built for x86, whatever the types use
+    static const Simd simd = []() {
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx2") and __builtin_cpu_supports("fma") ? AVX2 : SSE2;
+    }();
+    return simd;
+#else
+    return SCALAR;
+#endif
+  }
+}
+
+namespace {
+  using math::mat4;
+
+  // m is column major, a point's x' = m[0] x + m[4] y + m[8] z + m[12]
+  void transformScalar(const float* m, const float* x, const float* y, const float* z,
+                       float* outX, float* outY, float* outZ, size_t begin, size_t count) {
+    for (size_t i = begin; i < count; ++i) {
+      float px = x[i], py = y[i], pz = z[i];
+      outX[i] = m[0]*px + m[4]*py + m[8]*pz + m[12];
+      outY[i] = m[1]*px + m[5]*py + m[9]*pz + m[13];
+      outZ[i] = m[2]*px + m[6]*py + m[10]*pz + m[14];
+    }
+  }
+
+  // out[i] = a*b[i] for count matrices of 16 floats, out may be b
+  void multiplyScalar(const float* a, const float* b, float* out, size_t count) {
+    for (size_t i = 0; i < count; ++i, b += 16, out += 16) {
+      float r[16];
+      for (int c = 0; c < 4; ++c)
+        for (int row = 0; row < 4; ++row)
+          r[c*4 + row] = a[row]*b[c*4] + a[4 + row]*b[c*4 + 1] + a[8 + row]*b[c*4 + 2] + a[12 + row]*b[c*4 + 3];
+      std::memcpy(out, r, sizeof(r));
+    }
+  }
+
+  void boundsScalar(const float* x, const float* y, const float* z, size_t begin, size_t count, float* lo, float* hi) {
+    for (size_t i = begin; i < count; ++i) {
+      lo[0] = std::min(lo[0], x[i]);
+      lo[1] = std::min(lo[1], y[i]);
+      lo[2] = std::min(lo[2], z[i]);
+      hi[0] = std::max(hi[0], x[i]);
+      hi[1] = std::max(hi[1], y[i]);
+      hi[2] = std::max(hi[2], z[i]);
+    }
+  }
+
+  float farthestScalar(const float* x, const float* y, const float* z, size_t begin, size_t count, const float* c) {
+    float d2 = 0;
+    for (size_t i = begin; i < count; ++i) {
+      float dx = x[i] - c[0], dy = y[i] - c[1], dz = z[i] - c[2];
+      d2 = std::max(d2, dx*dx + dy*dy + dz*dz);
+    }
+    return d2;
+  }
+
+#if defined(__SSE2__)
+  void transformSSE2(const float* m, const float* x, const float* y, const float* z,
+                     float* outX, float* outY, float* outZ, size_t count) {
+    __m128 e[12];
+    for (int c = 0; c < 4; ++c)
+      for (int r = 0; r < 3; ++r) e[c*3 + r] = _mm_set1_ps(m[c*4 + r]);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+      __m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+      for (int r = 0; r < 3; ++r) {
+        __m128 v = _mm_add_ps(_mm_mul_ps(e[r], px), e[9 + r]);
+        v = _mm_add_ps(_mm_mul_ps(e[3 + r], py), v);
+        v = _mm_add_ps(_mm_mul_ps(e[6 + r], pz), v);
+        _mm_storeu_ps((r == 0 ? outX : r == 1 ? outY : outZ) + i, v);
+      }
+    }
+    transformScalar(m, x, y, z, outX, outY, outZ, i, count);
+  }
+
+  void multiplySSE2(const float* a, const float* b, float* out, size_t count) {
+    __m128 a0 = _mm_loadu_ps(a), a1 = _mm_loadu_ps(a + 4), a2 = _mm_loadu_ps(a + 8), a3 = _mm_loadu_ps(a + 12);
+    for (size_t i = 0; i < count; ++i, b += 16, out += 16) {
+      __m128 r[4];
+      for (int c = 0; c < 4; ++c) {
+        __m128 bc = _mm_loadu_ps(b + 4*c);
+        __m128 v = _mm_mul_ps(a0, _mm_shuffle_ps(bc, bc, _MM_SHUFFLE(0, 0, 0, 0)));
+        v = _mm_add_ps(v, _mm_mul_ps(a1, _mm_shuffle_ps(bc, bc, _MM_SHUFFLE(1, 1, 1, 1))));
+        v = _mm_add_ps(v, _mm_mul_ps(a2, _mm_shuffle_ps(bc, bc, _MM_SHUFFLE(2, 2, 2, 2))));
+        r[c] = _mm_add_ps(v, _mm_mul_ps(a3, _mm_shuffle_ps(bc, bc, _MM_SHUFFLE(3, 3, 3, 3))));
+      }
+      for (int c = 0; c < 4; ++c) _mm_storeu_ps(out + 4*c, r[c]);
+    }
+  }
+
+  float horizontalMin(__m128 v) {
+    v = _mm_min_ps(v, _mm_movehl_ps(v, v));
+    return _mm_cvtss_f32(_mm_min_ss(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+  }
+
+  float horizontalMax(__m128 v) {
+    v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+    return _mm_cvtss_f32(_mm_max_ss(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+  }
+
+  void boundsSSE2(const float* x, const float* y, const float* z, size_t count, float* lo, float* hi) {
+    if (count < 4) {
+      boundsScalar(x, y, z, 0, count, lo, hi);
+      return;
+    }
+    __m128 minX = _mm_loadu_ps(x), minY = _mm_loadu_ps(y), minZ = _mm_loadu_ps(z);
+    __m128 maxX = minX, maxY = minY, maxZ = minZ;
+    size_t i = 4;
+    for (; i + 4 <= count; i += 4) {
+      __m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+      minX = _mm_min_ps(minX, px);
+      minY = _mm_min_ps(minY, py);
+      minZ = _mm_min_ps(minZ, pz);
+      maxX = _mm_max_ps(maxX, px);
+      maxY = _mm_max_ps(maxY, py);
+      maxZ = _mm_max_ps(maxZ, pz);
+    }
+    lo[0] = horizontalMin(minX);
+    lo[1] = horizontalMin(minY);
+    lo[2] = horizontalMin(minZ);
+    hi[0] = horizontalMax(maxX);
+    hi[1] = horizontalMax(maxY);
+    hi[2] = horizontalMax(maxZ);
+    boundsScalar(x, y, z, i, count, lo, hi);
+  }
+
+  float farthestSSE2(const float* x, const float* y, const float* z, size_t count, const float* c) {
+    __m128 cx = _mm_set1_ps(c[0]), cy = _mm_set1_ps(c[1]), cz = _mm_set1_ps(c[2]);
+    __m128 d2 = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+      __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + i), cx);
+      __m128 dy = _mm_sub_ps(_mm_loadu_ps(y + i), cy);
+      __m128 dz = _mm_sub_ps(_mm_loadu_ps(z + i), cz);
+      __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+      d2 = _mm_max_ps(d2, d);
+    }
+    return std::max(horizontalMax(d2), farthestScalar(x, y, z, i, count, c));
+  }
+
+  __attribute__((target("avx2,fma")))
+  void transformAVX2(const float* m, const float* x, const float* y, const float* z,
+                     float* outX, float* outY, float* outZ, size_t count) {
+    __m256 e[12];
+    for (int c = 0; c < 4; ++c)
+      for (int r = 0; r < 3; ++r) e[c*3 + r] = _mm256_set1_ps(m[c*4 + r]);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+      __m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+      for (int r = 0; r < 3; ++r) {
+        __m256 v = _mm256_fmadd_ps(e[r], px, e[9 + r]);
+        v = _mm256_fmadd_ps(e[3 + r], py, v);
+        v = _mm256_fmadd_ps(e[6 + r], pz, v);
+        _mm256_storeu_ps((r == 0 ? outX : r == 1 ? outY : outZ) + i, v);
+      }
+    }
+    transformScalar(m, x, y, z, outX, outY, outZ, i, count);
+  }
+
+  // two columns of the result per 256 bit register, each half broadcasting
+  // its own column of b
+  __attribute__((target("avx2,fma")))
+  void multiplyAVX2(const float* a, const float* b, float* out, size_t count) {
+    __m256 a0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a));
+    __m256 a1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 4));
+    __m256 a2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 8));
+    __m256 a3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 12));
+    for (size_t i = 0; i < count; ++i, b += 16, out += 16) {
+      __m256 r[2];
+      for (int h = 0; h < 2; ++h) {
+        __m256 bc = _mm256_loadu_ps(b + 8*h);
+        __m256 v = _mm256_mul_ps(a0, _mm256_permute_ps(bc, _MM_SHUFFLE(0, 0, 0, 0)));
+        v = _mm256_fmadd_ps(a1, _mm256_permute_ps(bc, _MM_SHUFFLE(1, 1, 1, 1)), v);
+        v = _mm256_fmadd_ps(a2, _mm256_permute_ps(bc, _MM_SHUFFLE(2, 2, 2, 2)), v);
+        r[h] = _mm256_fmadd_ps(a3, _mm256_permute_ps(bc, _MM_SHUFFLE(3, 3, 3, 3)), v);
+      }
+      _mm256_storeu_ps(out, r[0]);
+      _mm256_storeu_ps(out + 8, r[1]);
+    }
+  }
+
+  __attribute__((target("avx2,fma")))
+  void boundsAVX2(const float* x, const float* y, const float* z, size_t count, float* lo, float* hi) {
+    if (count < 8) {
+      boundsSSE2(x, y, z, count, lo, hi);
+      return;
+    }
+    __m256 minX = _mm256_loadu_ps(x), minY = _mm256_loadu_ps(y), minZ = _mm256_loadu_ps(z);
+    __m256 maxX = minX, maxY = minY, maxZ = minZ;
+    size_t i = 8;
+    for (; i + 8 <= count; i += 8) {
+      __m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+      minX = _mm256_min_ps(minX, px);
+      minY = _mm256_min_ps(minY, py);
+      minZ = _mm256_min_ps(minZ, pz);
+      maxX = _mm256_max_ps(maxX, px);
+      maxY = _mm256_max_ps(maxY, py);
+      maxZ = _mm256_max_ps(maxZ, pz);
+    }
+    lo[0] = horizontalMin(_mm_min_ps(_mm256_castps256_ps128(minX), _mm256_extractf128_ps(minX, 1)));
+    lo[1] = horizontalMin(_mm_min_ps(_mm256_castps256_ps128(minY), _mm256_extractf128_ps(minY, 1)));
+    lo[2] = horizontalMin(_mm_min_ps(_mm256_castps256_ps128(minZ), _mm256_extractf128_ps(minZ, 1)));
+    hi[0] = horizontalMax(_mm_max_ps(_mm256_castps256_ps128(maxX), _mm256_extractf128_ps(maxX, 1)));
+    hi[1] = horizontalMax(_mm_max_ps(_mm256_castps256_ps128(maxY), _mm256_extractf128_ps(maxY, 1)));
+    hi[2] = horizontalMax(_mm_max_ps(_mm256_castps256_ps128(maxZ), _mm256_extractf128_ps(maxZ, 1)));
+    boundsScalar(x, y, z, i, count, lo, hi);
+  }
+
+  __attribute__((target("avx2,fma")))
+  float farthestAVX2(const float* x, const float* y, const float* z, size_t count, const float* c) {
+    __m256 cx = _mm256_set1_ps(c[0]), cy = _mm256_set1_ps(c[1]), cz = _mm256_set1_ps(c[2]);
+    __m256 d2 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+      __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + i), cx);
+      __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + i), cy);
+      __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(z + i), cz);
+      __m256 d = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+      d2 = _mm256_max_ps(d2, d);
+    }
+    __m128 d = _mm_max_ps(_mm256_castps256_ps128(d2), _mm256_extractf128_ps(d2, 1));
+    return std::max(horizontalMax(d), farthestScalar(x, y, z, i, count, c));
+  }
+#endif
+
+  typedef void (*Multiply)(const float* a, const float* b, float* out, size_t count);
+
+  Multiply multiplier(math::Simd simd) {
+#if defined(__SSE2__)
+    if (simd == math::AVX2) return multiplyAVX2;
+    if (simd == math::SSE2) return multiplySSE2;
+#endif
+    return multiplyScalar;
+  }
+}
+
+namespace math {
+  void transformPoints(const mat4& m, const float* x, const float* y, const float* z,
+                       float* outX, float* outY, float* outZ, size_t count, Simd simd) {
+    simd = std::min(simd, best());
+#if defined(__SSE2__)
+    if (simd == AVX2) return transformAVX2(m.data(), x, y, z, outX, outY, outZ, count);
+    if (simd == SSE2) return transformSSE2(m.data(), x, y, z, outX, outY, outZ, count);
+#endif
+    transformScalar(m.data(), x, y, z, outX, outY, outZ, 0, count);
+  }
+
+  void multiply(const mat4& a, const mat4* b, mat4* out, size_t count, Simd simd) {
+    if (count > 0) multiplier(std::min(simd, best()))(a.data(), b[0].data(), out[0].data(), count);
+  }
+
+  void chain(const mat4* local, const int* parent, mat4* world, size_t count, Simd simd) {
+    Multiply product = multiplier(std::min(simd, best()));
+    for (size_t i = 0; i < count; ++i) {
+      if (parent[i] < 0) world[i] = local[i];
+      else product(world[parent[i]].data(), local[i].data(), world[i].data(), 1);
+    }
+  }
+
+  Box bounds(const float* x, const float* y, const float* z, size_t count, Simd simd) {
+    float lo[3] = { x[0], y[0], z[0] }, hi[3] = { x[0], y[0], z[0] };
+    simd = std::min(simd, best());
+#if defined(__SSE2__)
+    if (simd == AVX2) boundsAVX2(x, y, z, count, lo, hi);
+    else if (simd == SSE2) boundsSSE2(x, y, z, count, lo, hi);
+    else
+#endif
+    boundsScalar(x, y, z, 1, count, lo, hi);
+    Box box = { vec3(lo[0], lo[1], lo[2]), vec3(hi[0], hi[1], hi[2]) };
+    return box;
+  }
+
+  Sphere boundingSphere(const float* x, const float* y, const float* z, size_t count, Simd simd) {
+    Box box = bounds(x, y, z, count, simd);
+    vec3 center = (box.min + box.max)*.5f;
+    float c[3] = { center.x(), center.y(), center.z() };
+    float d2;
+    simd = std::min(simd, best());
+#if defined(__SSE2__)
+    if (simd == AVX2) d2 = farthestAVX2(x, y, z, count, c);
+    else if (simd == SSE2) d2 = farthestSSE2(x, y, z, count, c);
+    else
+#endif
+    d2 = farthestScalar(x, y, z, 0, count, c);
+    Sphere sphere = { center, std::sqrt(d2) };
+    return sphere;
+  }
+}
@@ -0,0 +1,245 @@
+#ifndef SIMD_MATH_H
+#define SIMD_MATH_H
+
+#include <cmath>
+#include <cstddef>
+
+// Vector, matrix and quaternion math for the CPU side of a frame. The
+// types keep four floats in an SSE register on x86 and in a plain array
+// elsewhere, or everywhere with LEARNOPENGL_SCALAR_MATH defined. vec3 is
+// four floats too, the last one zero. mat4 is column major like GLSL and
+// glUniformMatrix4fv, quaternions are x, y, z, w with w the real part.
+//
+//   math::mat4 model = math::translation(math::vec3(0, 1, -5))
+//                    * math::rotation(math::quat::axisAngle(math::vec3(0, 1, 0), angle));
+//   shader.setMatrix4(mvpHandle, (projection*view*model).data());
+//
+// The batched kernels at the end work on many points or matrices at once,
+// points as separate x, y and z arrays, with scalar, SSE2 and AVX2
+// versions picked at run time.
+#if defined(__SSE2__) and not defined(LEARNOPENGL_SCALAR_MATH)
+#define LEARNOPENGL_SSE_MATH
+#include <immintrin.h>
+#endif
+
+namespace math {
+  // Four floats, the register or array under the types
+  struct alignas(16) float4 {
+#ifdef LEARNOPENGL_SSE_MATH
+    __m128 m;
+#else
+    float m[4];
+#endif
+  };
+
+#ifdef LEARNOPENGL_SSE_MATH
+  inline float4 wrap(__m128 m) { float4 r; r.m = m; return r; }
+  inline float4 set(float x, float y, float z, float w) { return wrap(_mm_setr_ps(x, y, z, w)); }
+  inline float4 splat(float s) { return wrap(_mm_set1_ps(s)); }
+  inline float4 add(float4 a, float4 b) { return wrap(_mm_add_ps(a.m, b.m)); }
+  inline float4 sub(float4 a, float4 b) { return wrap(_mm_sub_ps(a.m, b.m)); }
+  inline float4 mul(float4 a, float4 b) { return wrap(_mm_mul_ps(a.m, b.m)); }
+  inline float4 min(float4 a, float4 b) { return wrap(_mm_min_ps(a.m, b.m)); }
+  inline float4 max(float4 a, float4 b) { return wrap(_mm_max_ps(a.m, b.m)); }
+  template <int i> inline float4 broadcast(float4 a) { return wrap(_mm_shuffle_ps(a.m, a.m, _MM_SHUFFLE(i, i, i, i))); }
+  inline float4 yzxw(float4 a) { return wrap(_mm_shuffle_ps(a.m, a.m, _MM_SHUFFLE(3, 0, 2, 1))); }
+  inline float4 zxyw(float4 a) { return wrap(_mm_shuffle_ps(a.m, a.m, _MM_SHUFFLE(3, 1, 0, 2))); }
+  inline float lane(float4 a, int i) {
+    alignas(16) float f[4];
+    _mm_store_ps(f, a.m);
+    return f[i];
+  }
+  inline float sum(float4 a) {
+    __m128 s = _mm_add_ps(a.m, _mm_movehl_ps(a.m, a.m));
+    return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 1, 1, 1))));
+  }
+#else
+  inline float4 set(float x, float y, float z, float w) { float4 r = { { x, y, z, w } }; return r; }
+  inline float4 splat(float s) { return set(s, s, s, s); }
+  inline float4 add(float4 a, float4 b) { return set(a.m[0] + b.m[0], a.m[1] + b.m[1], a.m[2] + b.m[2], a.m[3] + b.m[3]); }
+  inline float4 sub(float4 a, float4 b) { return set(a.m[0] - b.m[0], a.m[1] - b.m[1], a.m[2] - b.m[2], a.m[3] - b.m[3]); }
+  inline float4 mul(float4 a, float4 b) { return set(a.m[0]*b.m[0], a.m[1]*b.m[1], a.m[2]*b.m[2], a.m[3]*b.m[3]); }
+  inline float4 min(float4 a, float4 b) {
+    return set(std::fmin(a.m[0], b.m[0]), std::fmin(a.m[1], b.m[1]), std::fmin(a.m[2], b.m[2]), std::fmin(a.m[3], b.m[3]));
+  }
+  inline float4 max(float4 a, float4 b) {
+    return set(std::fmax(a.m[0], b.m[0]), std::fmax(a.m[1], b.m[1]), std::fmax(a.m[2], b.m[2]), std::fmax(a.m[3], b.m[3]));
+  }
+  template <int i> inline float4 broadcast(float4 a) { return splat(a.m[i]); }
+  inline float4 yzxw(float4 a) { return set(a.m[1], a.m[2], a.m[0], a.m[3]); }
+  inline float4 zxyw(float4 a) { return set(a.m[2], a.m[0], a.m[1], a.m[3]); }
+  inline float lane(float4 a, int i) { return a.m[i]; }
+  inline float sum(float4 a) { return (a.m[0] + a.m[2]) + (a.m[1] + a.m[3]); }
+#endif
+  // a*b + c
+  inline float4 madd(float4 a, float4 b, float4 c) { return add(mul(a, b), c); }
+  // a.yzx*b.zxy - a.zxy*b.yzx, w is 0
+  inline float4 cross(float4 a, float4 b) { return sub(mul(yzxw(a), zxyw(b)), mul(zxyw(a), yzxw(b))); }
+
+  struct vec3 {
+    float4 v;
+    vec3() : v(splat(0.0f)) {}
+    vec3(float x, float y, float z) : v(set(x, y, z, 0.0f)) {}
+    explicit vec3(float4 v) : v(v) {}
+    float x() const { return lane(v, 0); }
+    float y() const { return lane(v, 1); }
+    float z() const { return lane(v, 2); }
+  };
+
+  struct vec4 {
+    float4 v;
+    vec4() : v(splat(0.0f)) {}
+    vec4(float x, float y, float z, float w) : v(set(x, y, z, w)) {}
+    vec4(const vec3& xyz, float w) : v(add(xyz.v, set(0.0f, 0.0f, 0.0f, w))) {}
+    explicit vec4(float4 v) : v(v) {}
+    float x() const { return lane(v, 0); }
+    float y() const { return lane(v, 1); }
+    float z() const { return lane(v, 2); }
+    float w() const { return lane(v, 3); }
+    vec3 xyz() const { return vec3(mul(v, set(1.0f, 1.0f, 1.0f, 0.0f))); }
+  };
+
+  inline vec3 operator+(const vec3& a, const vec3& b) { return vec3(add(a.v, b.v)); }
+  inline vec3 operator-(const vec3& a, const vec3& b) { return vec3(sub(a.v, b.v)); }
+  inline vec3 operator*(const vec3& a, const vec3& b) { return vec3(mul(a.v, b.v)); }
+  inline vec3 operator*(const vec3& a, float s) { return vec3(mul(a.v, splat(s))); }
+  inline vec3 operator*(float s, const vec3& a) { return a*s; }
+  inline vec3 operator-(const vec3& a) { return vec3(sub(splat(0.0f), a.v)); }
+  inline vec3 min(const vec3& a, const vec3& b) { return vec3(min(a.v, b.v)); }
+  inline vec3 max(const vec3& a, const vec3& b) { return vec3(max(a.v, b.v)); }
+  inline float dot(const vec3& a, const vec3& b) { return sum(mul(a.v, b.v)); }
+  inline vec3 cross(const vec3& a, const vec3& b) { return vec3(cross(a.v, b.v)); }
+  inline float length(const vec3& a) { return std::sqrt(dot(a, a)); }
+  inline vec3 normalize(const vec3& a) { return a*(1.0f/length(a)); }
+
+  inline vec4 operator+(const vec4& a, const vec4& b) { return vec4(add(a.v, b.v)); }
+  inline vec4 operator-(const vec4& a, const vec4& b) { return vec4(sub(a.v, b.v)); }
+  inline vec4 operator*(const vec4& a, const vec4& b) { return vec4(mul(a.v, b.v)); }
+  inline vec4 operator*(const vec4& a, float s) { return vec4(mul(a.v, splat(s))); }
+  inline vec4 operator*(float s, const vec4& a) { return a*s; }
+  inline vec4 min(const vec4& a, const vec4& b) { return vec4(min(a.v, b.v)); }
+  inline vec4 max(const vec4& a, const vec4& b) { return vec4(max(a.v, b.v)); }
+  inline float dot(const vec4& a, const vec4& b) { return sum(mul(a.v, b.v)); }
+
+  // Unit quaternions are rotations; q*r rotates by r, then by q
+  struct quat {
+    float4 v;
+    quat() : v(set(0.0f, 0.0f, 0.0f, 1.0f)) {}
+    quat(float x, float y, float z, float w) : v(set(x, y, z, w)) {}
+    explicit quat(float4 v) : v(v) {}
+    // angle in radians, counterclockwise looking down axis
+    static quat axisAngle(const vec3& axis, float angle) {
+      vec3 a = normalize(axis)*std::sin(.5f*angle);
+      return quat(add(a.v, set(0.0f, 0.0f, 0.0f, std::cos(.5f*angle))));
+    }
+    float x() const { return lane(v, 0); }
+    float y() const { return lane(v, 1); }
+    float z() const { return lane(v, 2); }
+    float w() const { return lane(v, 3); }
+  };
+
+  inline quat operator*(const quat& a, const quat& b) {
+    // (a.w b.xyz + b.w a.xyz + a.xyz x b.xyz, a.w b.w - a.xyz . b.xyz), the
+    // first two terms give 2 a.w b.w in w, take a . b back off
+    float4 r = madd(broadcast<3>(a.v), b.v, mul(broadcast<3>(b.v), a.v));
+    r = add(r, cross(a.v, b.v));
+    return quat(sub(r, set(0.0f, 0.0f, 0.0f, sum(mul(a.v, b.v)))));
+  }
+  inline quat conjugate(const quat& q) { return quat(mul(q.v, set(-1.0f, -1.0f, -1.0f, 1.0f))); }
+  inline quat normalize(const quat& q) { return quat(mul(q.v, splat(1.0f/std::sqrt(sum(mul(q.v, q.v)))))); }
+  // v rotated by q
+  inline vec3 rotate(const quat& q, const vec3& v) {
+    float4 t = cross(q.v, v.v);
+    t = add(t, t);
+    return vec3(add(madd(broadcast<3>(q.v), t, v.v), cross(q.v, t)));
+  }
+  // Normalized linear blend along the shorter arc, close to slerp for
+  // the small steps of an animation
+  inline quat nlerp(const quat& a, const quat& b, float t) {
+    float s = sum(mul(a.v, b.v)) < 0.0f ? -t : t;
+    return normalize(quat(add(mul(a.v, splat(1.0f - t)), mul(b.v, splat(s)))));
+  }
+
+  struct mat4 {
+    float4 columns[4];
+    // identity
+    mat4() {
+      this->columns[0] = set(1.0f, 0.0f, 0.0f, 0.0f);
+      this->columns[1] = set(0.0f, 1.0f, 0.0f, 0.0f);
+      this->columns[2] = set(0.0f, 0.0f, 1.0f, 0.0f);
+      this->columns[3] = set(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+    mat4(const vec4& c0, const vec4& c1, const vec4& c2, const vec4& c3) {
+      this->columns[0] = c0.v;
+      this->columns[1] = c1.v;
+      this->columns[2] = c2.v;
+      this->columns[3] = c3.v;
+    }
+    // 16 floats column after column, for glUniformMatrix4fv
+    const float* data() const { return reinterpret_cast<const float*>(this->columns); }
+    float* data() { return reinterpret_cast<float*>(this->columns); }
+    float operator()(int row, int column) const { return lane(this->columns[column], row); }
+  };
+
+  inline float4 transform(const mat4& m, float4 v) {
+    float4 r = mul(m.columns[0], broadcast<0>(v));
+    r = madd(m.columns[1], broadcast<1>(v), r);
+    r = madd(m.columns[2], broadcast<2>(v), r);
+    return madd(m.columns[3], broadcast<3>(v), r);
+  }
+  inline vec4 operator*(const mat4& m, const vec4& v) { return vec4(transform(m, v.v)); }
+  inline mat4 operator*(const mat4& a, const mat4& b) {
+    mat4 r;
+    for (int c = 0; c < 4; ++c) r.columns[c] = transform(a, b.columns[c]);
+    return r;
+  }
+  // the point p, w = 1, through an affine m
+  inline vec3 transformPoint(const mat4& m, const vec3& p) {
+    return vec3(mul(transform(m, add(p.v, set(0.0f, 0.0f, 0.0f, 1.0f))), set(1.0f, 1.0f, 1.0f, 0.0f)));
+  }
+
+  inline mat4 translation(const vec3& t) {
+    mat4 m;
+    m.columns[3] = add(t.v, set(0.0f, 0.0f, 0.0f, 1.0f));
+    return m;
+  }
+  inline mat4 scaling(const vec3& s) {
+    return mat4(vec4(s.x(), 0, 0, 0), vec4(0, s.y(), 0, 0), vec4(0, 0, s.z(), 0), vec4(0, 0, 0, 1));
+  }
+  // q must be a unit quaternion
+  mat4 rotation(const quat& q);
+  // Like gluPerspective, fovy in radians
+  mat4 perspective(float fovy, float aspect, float zNear, float zFar);
+  // Like gluLookAt
+  mat4 lookAt(const vec3& eye, const vec3& center, const vec3& up);
+  mat4 transpose(const mat4& m);
+
+  // Kernel versions, the same as SoftRasterizer's
+  enum Simd { SCALAR, SSE2, AVX2 };
+  // The fastest the CPU runs; kernels given more fall back to it
+  Simd best();
+
+  struct Box {
+    vec3 min, max;
+  };
+  struct Sphere {
+    vec3 center;
+    float radius;
+  };
+
+  // out = m*(x, y, z, 1) for count points of an affine m, the xyz of the
+  // result; in and out arrays may be the same
+  void transformPoints(const mat4& m, const float* x, const float* y, const float* z,
+                       float* outX, float* outY, float* outZ, size_t count, Simd simd = best());
+  // out[i] = a*b[i], say a view-projection times every model matrix
+  void multiply(const mat4& a, const mat4* b, mat4* out, size_t count, Simd simd = best());
+  // Transform hierarchy: world[i] = world[parent[i]]*local[i], local[i]
+  // for a root (parent -1). Parents come before their children.
+  void chain(const mat4* local, const int* parent, mat4* world, size_t count, Simd simd = best());
+  // Smallest axis aligned box around count points, count > 0
+  Box bounds(const float* x, const float* y, const float* z, size_t count, Simd simd = best());
+  // Sphere around the box center through the farthest point, count > 0
+  Sphere boundingSphere(const float* x, const float* y, const float* z, size_t count, Simd simd = best());
+}
+
+#endif
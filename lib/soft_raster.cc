@@ -0,0 +1,563 @@
+#include "soft_raster.hh"
+#include "profiler.hh"
+#include "thread_pool.hh"
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+  // fixed point screen coordinates, 1/16 pixel
+  const int SUBPIXEL_BITS = 4;
+  const int SUBPIXEL = 1 << SUBPIXEL_BITS;
+  // how far past the viewport vertices may land before the clipper cuts
+  // them, in pixels; MAX_SIZE plus this stays inside the fixed point range
+  const GLfloat GUARD_BAND = 4096;
+  // vertices, primitives and tiles handed to a thread at a time
+  const size_t VERTEX_GRAIN = 1024;
+  const size_t PRIMITIVE_GRAIN = 1024;
+  const size_t TILE_GRAIN = 1;
+  // clip polygons have at most 3 + one vertex per plane
+  const int CLIP_PLANES = 7;
+  const int MAX_CLIPPED = 3 + CLIP_PLANES;
+  // the z, 1/w and four color planes
+  const int PLANES = 2 + SoftRasterizer::MAX_VARYINGS;
+
+  int64_t floorDiv(int64_t a, int64_t b) {
+    return a >= 0 ? a/b : -((-a + b - 1)/b);
+  }
+
+  uint32_t packColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a) {
+    GLfloat c[4] = { r, g, b, a };
+    uint32_t packed = 0;
+    for (int i = 0; i < 4; ++i) {
+      GLfloat x = std::min(std::max(c[i], 0.0f), 1.0f);
+      packed |= uint32_t(std::nearbyint(x*255.0f)) << (8*i);
+    }
+    return packed;
+  }
+}
+
+struct SoftRasterizer::Triangle {
+  // edge functions a*x + b*y + c in 1/16 pixels, >= 0 inside, the fill
+  // rule bias is in c
+  int32_t a[3], b[3];
+  int64_t c[3];
+  int minX, minY, maxX, maxY;   // pixels, inclusive
+  double invArea;
+  // value = base + l1*d1 + l2*d2, with l1, l2 the barycentrics of
+  // vertices 1 and 2: screen z, 1/w and varying/w
+  GLfloat base[PLANES], d1[PLANES], d2[PLANES];
+};
+
+struct SoftRasterizer::Bin {
+  GLuint primitive;
+  GLuint triangle;   // in the binning thread's triangles
+};
+
+namespace {
+  typedef SoftRasterizer::Vertex Vertex;
+
+  // Signed distances of v to the clip planes, inside when >= 0: w > 0,
+  // -w <= z <= w and the guard band in x and y
+  void distances(const Vertex& v, GLfloat guardX, GLfloat guardY, GLfloat* d) {
+    const GLfloat* p = v.position;
+    d[0] = p[3] - 1e-5f;
+    d[1] = p[2] + p[3];
+    d[2] = p[3] - p[2];
+    d[3] = guardX*p[3] - p[0];
+    d[4] = guardX*p[3] + p[0];
+    d[5] = guardY*p[3] - p[1];
+    d[6] = guardY*p[3] + p[1];
+  }
+
+  Vertex lerp(const Vertex& a, const Vertex& b, GLfloat t) {
+    Vertex v;
+    for (int i = 0; i < 4; ++i) v.position[i] = a.position[i] + t*(b.position[i] - a.position[i]);
+    for (int i = 0; i < SoftRasterizer::MAX_VARYINGS; ++i)
+      v.varyings[i] = a.varyings[i] + t*(b.varyings[i] - a.varyings[i]);
+    return v;
+  }
+
+  // Sutherland-Hodgman against every plane, returns the vertex count
+  int clip(const Vertex* v[3], GLfloat guardX, GLfloat guardY, Vertex* out) {
+    Vertex buffers[2][MAX_CLIPPED];
+    for (int i = 0; i < 3; ++i) buffers[0][i] = *v[i];
+    int count = 3;
+    Vertex* in = buffers[0];
+    Vertex* next = buffers[1];
+    for (int plane = 0; plane < CLIP_PLANES and count > 0; ++plane) {
+      int kept = 0;
+      for (int i = 0; i < count; ++i) {
+        const Vertex& a = in[i];
+        const Vertex& b = in[(i + 1) % count];
+        GLfloat da[CLIP_PLANES], db[CLIP_PLANES];
+        distances(a, guardX, guardY, da);
+        distances(b, guardX, guardY, db);
+        if (da[plane] >= 0) next[kept++] = a;
+        if ((da[plane] >= 0) != (db[plane] >= 0))
+          next[kept++] = lerp(a, b, da[plane]/(da[plane] - db[plane]));
+      }
+      count = kept;
+      std::swap(in, next);
+    }
+    for (int i = 0; i < count; ++i) out[i] = in[i];
+    return count;
+  }
+
+  // The rows [y0, y1] and columns [x0, x1] of one triangle in one tile.
+  // x0 is a multiple of the lane count, so no store leaves the tile.
+  struct Span {
+    const GLfloat *base, *d1, *d2;   // the triangle's planes
+    int x0, x1, y0, y1;
+    int32_t e[3], ax[3], by[3];   // edges at (x0, y0) and their steps per pixel
+    GLfloat l1, l2, l1x, l2x, l1y, l2y;
+  };
+
+  void shadeScalar(const Span& s, uint32_t* color, GLfloat* depth, int pitch, bool depthTest);
+#if defined(__SSE2__)
+  void shadeSSE2(const Span& s, uint32_t* color, GLfloat* depth, int pitch, bool depthTest);
+  void shadeAVX2(const Span& s, uint32_t* color, GLfloat* depth, int pitch, bool depthTest);
+#endif
+}
+
+SoftRasterizer::SoftRasterizer(int width, int height, unsigned threads)
+  : w(std::min(width, int(MAX_SIZE))), h(std::min(height, int(MAX_SIZE))), depthTest(false),
+    mode(best()), workers(0), pool(nullptr) {
+  if (width > MAX_SIZE or height > MAX_SIZE)
+    std::cout << "ERROR::SOFT_RASTER::TOO_LARGE " << width << "x" << height << std::endl;
+  this->tilesX = (this->w + TILE_SIZE - 1)/TILE_SIZE;
+  this->tilesY = (this->h + TILE_SIZE - 1)/TILE_SIZE;
+  this->pitch = this->tilesX*TILE_SIZE;
+  this->color.assign(size_t(this->pitch)*this->tilesY*TILE_SIZE, 0);
+  this->depth.assign(this->color.size(), 1.0f);
+  this->setThreads(threads);
+  this->endFrame();
+}
+
+SoftRasterizer::~SoftRasterizer() {
+  delete this->pool;
+}
+
+SoftRasterizer::Simd SoftRasterizer::best() {
+#if defined(__SSE2__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return AVX2;
+  return SSE2;
+#else
+  return SCALAR;
+#endif
+}
+
+void SoftRasterizer::setSimd(Simd simd) {
+  this->mode = std::min(simd, best());
+}
+
+void SoftRasterizer::setThreads(unsigned threads) {
+  if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+  if (threads == this->workers) return;
+  delete this->pool;
+  this->workers = threads;
+  this->pool = new ThreadPool(threads);
+  this->triangles.assign(threads, std::vector<Triangle>());
+  this->bins.assign(threads, std::vector<std::vector<Bin> >(this->tilesX*this->tilesY));
+  this->heads.assign(threads, std::vector<size_t>(threads));
+  this->threadCounters.assign(threads, Counters());
+}
+
+void SoftRasterizer::clear(GLfloat r, GLfloat g, GLfloat b, GLfloat a, GLfloat depth) {
+  std::fill(this->color.begin(), this->color.end(), packColor(r, g, b, a));
+  std::fill(this->depth.begin(), this->depth.end(), depth);
+}
+
+void SoftRasterizer::readPixels(unsigned char* rgba) const {
+  for (int y = 0; y < this->h; ++y)
+    std::memcpy(rgba + size_t(y)*this->w*4, &this->color[size_t(y)*this->pitch], this->w*4);
+}
+
+SoftRasterizer::Counters SoftRasterizer::endFrame() {
+  Counters frame = this->counters;
+  std::memset(&this->counters, 0, sizeof(this->counters));
+  return frame;
+}
+
+void SoftRasterizer::draw(const Program& program, const void* vertices, size_t stride, size_t vertexCount,
+                          const GLuint* indices, size_t indexCount) {
+  PROFILE_ZONE("SoftRasterizer::draw");
+  size_t primitives = (indices != nullptr ? indexCount : vertexCount)/3;
+  if (primitives == 0) return;
+  int varyings = std::min(std::max(program.varyings, 0), int(MAX_VARYINGS));
+
+  {
+    PROFILE_ZONE("vertex");
+    this->transformed.resize(vertexCount);
+    const char* bytes = static_cast<const char*>(vertices);
+    this->pool->parallel(vertexCount, VERTEX_GRAIN, [&](size_t i, unsigned) {
+      program.vertex(bytes + i*stride, program.uniforms, this->transformed[i]);
+    });
+  }
+
+  {
+    PROFILE_ZONE("setup");
+    for (unsigned t = 0; t < this->workers; ++t) {
+      this->triangles[t].clear();
+      for (size_t tile = 0; tile < this->bins[t].size(); ++tile) this->bins[t][tile].clear();
+      std::memset(&this->threadCounters[t], 0, sizeof(Counters));
+    }
+    GLfloat guardX = 1.0f + 2.0f*GUARD_BAND/this->w, guardY = 1.0f + 2.0f*GUARD_BAND/this->h;
+    this->pool->parallel(primitives, PRIMITIVE_GRAIN, [&](size_t p, unsigned thread) {
+      const Vertex* v[3];
+      for (int i = 0; i < 3; ++i) {
+        size_t index = indices != nullptr ? indices[p*3 + i] : p*3 + i;
+        if (index >= vertexCount) return;
+        v[i] = &this->transformed[index];
+      }
+      ++this->threadCounters[thread].triangles;
+
+      // trivially outside or inside every plane, else clipped
+      GLfloat d[3][CLIP_PLANES];
+      unsigned outside[3] = { 0, 0, 0 };
+      for (int i = 0; i < 3; ++i) {
+        distances(*v[i], guardX, guardY, d[i]);
+        for (int plane = 0; plane < CLIP_PLANES; ++plane) outside[i] |= (d[i][plane] < 0) << plane;
+      }
+      if (outside[0] & outside[1] & outside[2]) {
+        ++this->threadCounters[thread].culled;
+        return;
+      }
+      if ((outside[0] | outside[1] | outside[2]) == 0) {
+        this->setup(v, p, varyings, thread);
+        return;
+      }
+      ++this->threadCounters[thread].clipped;
+      Vertex polygon[MAX_CLIPPED];
+      int count = clip(v, guardX, guardY, polygon);
+      for (int i = 2; i < count; ++i) {
+        const Vertex* fan[3] = { &polygon[0], &polygon[i - 1], &polygon[i] };
+        this->setup(fan, p, varyings, thread);
+      }
+    });
+  }
+
+  {
+    PROFILE_ZONE("raster");
+    this->pool->parallel(this->tilesX*this->tilesY, TILE_GRAIN, [&](size_t tile, unsigned thread) {
+      this->rasterize(tile, thread);
+    });
+  }
+
+  for (unsigned t = 0; t < this->workers; ++t) {
+    this->counters.triangles += this->threadCounters[t].triangles;
+    this->counters.culled += this->threadCounters[t].culled;
+    this->counters.clipped += this->threadCounters[t].clipped;
+    this->counters.binned += this->threadCounters[t].binned;
+  }
+}
+
+void SoftRasterizer::setup(const Vertex* v[3], GLuint primitive, int varyings, unsigned thread) {
+  GLfloat sx[3], sy[3], z[3], invW[3];
+  int32_t X[3], Y[3];
+  for (int i = 0; i < 3; ++i) {
+    const GLfloat* p = v[i]->position;
+    invW[i] = 1.0f/p[3];
+    sx[i] = (p[0]*invW[i]*0.5f + 0.5f)*this->w;
+    sy[i] = (p[1]*invW[i]*0.5f + 0.5f)*this->h;
+    z[i] = p[2]*invW[i]*0.5f + 0.5f;
+    X[i] = int32_t(std::lround(sx[i]*SUBPIXEL));
+    Y[i] = int32_t(std::lround(sy[i]*SUBPIXEL));
+  }
+  int64_t area = int64_t(X[1] - X[0])*(Y[2] - Y[0]) - int64_t(X[2] - X[0])*(Y[1] - Y[0]);
+  if (area == 0) {
+    ++this->threadCounters[thread].culled;
+    return;
+  }
+  // counter clockwise from here on, no face is culled
+  int order[3] = { 0, 1, 2 };
+  if (area < 0) {
+    std::swap(order[1], order[2]);
+    area = -area;
+  }
+
+  Triangle t;
+  int64_t minX = std::min(X[0], std::min(X[1], X[2])), maxX = std::max(X[0], std::max(X[1], X[2]));
+  int64_t minY = std::min(Y[0], std::min(Y[1], Y[2])), maxY = std::max(Y[0], std::max(Y[1], Y[2]));
+  // pixels whose center x*16 + 8 is inside the bounds
+  t.minX = std::max<int64_t>(0, floorDiv(minX - SUBPIXEL/2 + SUBPIXEL - 1, SUBPIXEL));
+  t.maxX = std::min<int64_t>(this->w - 1, floorDiv(maxX - SUBPIXEL/2, SUBPIXEL));
+  t.minY = std::max<int64_t>(0, floorDiv(minY - SUBPIXEL/2 + SUBPIXEL - 1, SUBPIXEL));
+  t.maxY = std::min<int64_t>(this->h - 1, floorDiv(maxY - SUBPIXEL/2, SUBPIXEL));
+  if (t.minX > t.maxX or t.minY > t.maxY) {
+    ++this->threadCounters[thread].culled;
+    return;
+  }
+
+  // edge i is across from vertex i, from j to k
+  for (int i = 0; i < 3; ++i) {
+    int j = order[(i + 1) % 3], k = order[(i + 2) % 3];
+    int32_t dx = X[k] - X[j], dy = Y[k] - Y[j];
+    t.a[i] = -dy;
+    t.b[i] = dx;
+    t.c[i] = -(int64_t(t.a[i])*X[j] + int64_t(t.b[i])*Y[j]);
+    // top left fill rule: pixels exactly on an edge belong to the
+    // triangle only if the edge is a left or a top one
+    bool topLeft = dy < 0 or (dy == 0 and dx < 0);
+    if (not topLeft) t.c[i] -= 1;
+  }
+  t.invArea = 1.0/double(area);
+
+  GLfloat values[3][PLANES];
+  for (int i = 0; i < 3; ++i) {
+    int o = order[i];
+    values[i][0] = z[o];
+    values[i][1] = invW[o];
+    for (int k = 0; k < MAX_VARYINGS; ++k) {
+      // missing color channels are 0, a missing alpha 1
+      GLfloat value = k < varyings ? v[o]->varyings[k] : (k == 3 ? 1.0f : 0.0f);
+      values[i][2 + k] = value*invW[o];
+    }
+  }
+  for (int p = 0; p < PLANES; ++p) {
+    t.base[p] = values[0][p];
+    t.d1[p] = values[1][p] - values[0][p];
+    t.d2[p] = values[2][p] - values[0][p];
+  }
+
+  this->triangles[thread].push_back(t);
+  this->bin(this->triangles[thread].back(), primitive, thread);
+}
+
+void SoftRasterizer::bin(const Triangle& triangle, GLuint primitive, unsigned thread) {
+  Bin entry = { primitive, GLuint(this->triangles[thread].size() - 1) };
+  int tx0 = triangle.minX/TILE_SIZE, tx1 = triangle.maxX/TILE_SIZE;
+  int ty0 = triangle.minY/TILE_SIZE, ty1 = triangle.maxY/TILE_SIZE;
+  for (int ty = ty0; ty <= ty1; ++ty)
+    for (int tx = tx0; tx <= tx1; ++tx) {
+      this->bins[thread][ty*this->tilesX + tx].push_back(entry);
+      ++this->threadCounters[thread].binned;
+    }
+}
+
+void SoftRasterizer::rasterize(int tile, unsigned thread) {
+  int tileX = (tile % this->tilesX)*TILE_SIZE, tileY = (tile / this->tilesX)*TILE_SIZE;
+  int lanes = this->mode == AVX2 ? 8 : (this->mode == SSE2 ? 4 : 1);
+  std::vector<size_t>& heads = this->heads[thread];
+  std::fill(heads.begin(), heads.end(), 0);
+  for (;;) {
+    // the lowest primitive left over all threads keeps submission order
+    int next = -1;
+    for (unsigned t = 0; t < this->workers; ++t) {
+      const std::vector<Bin>& list = this->bins[t][tile];
+      if (heads[t] < list.size() and
+          (next < 0 or list[heads[t]].primitive < this->bins[next][tile][heads[next]].primitive))
+        next = t;
+    }
+    if (next < 0) return;
+    const Bin& entry = this->bins[next][tile][heads[next]++];
+    const Triangle& t = this->triangles[next][entry.triangle];
+
+    Span s;
+    s.base = t.base;
+    s.d1 = t.d1;
+    s.d2 = t.d2;
+    s.x0 = std::max(t.minX, tileX);
+    s.x1 = std::min(t.maxX, tileX + TILE_SIZE - 1);
+    s.y0 = std::max(t.minY, tileY);
+    s.y1 = std::min(t.maxY, tileY + TILE_SIZE - 1);
+    if (s.x0 > s.x1 or s.y0 > s.y1) continue;
+
+    // edges the whole rectangle is inside of drop out, any it is
+    // entirely outside of skips the triangle. The rectangle starts on a
+    // lane boundary, so the lanes left of the triangle test its edges too.
+    bool outside = false;
+    s.x0 -= (s.x0 - tileX) % lanes;
+    int64_t startX = int64_t(s.x0)*SUBPIXEL + SUBPIXEL/2, px1 = int64_t(s.x1)*SUBPIXEL + SUBPIXEL/2;
+    int64_t py0 = int64_t(s.y0)*SUBPIXEL + SUBPIXEL/2, py1 = int64_t(s.y1)*SUBPIXEL + SUBPIXEL/2;
+    for (int i = 0; i < 3 and not outside; ++i) {
+      int64_t e00 = t.a[i]*startX + t.b[i]*py0 + t.c[i], e10 = t.a[i]*px1 + t.b[i]*py0 + t.c[i];
+      int64_t e01 = t.a[i]*startX + t.b[i]*py1 + t.c[i], e11 = t.a[i]*px1 + t.b[i]*py1 + t.c[i];
+      int64_t low = std::min(std::min(e00, e10), std::min(e01, e11));
+      int64_t high = std::max(std::max(e00, e10), std::max(e01, e11));
+      if (high < 0) outside = true;
+      else if (low >= 0) {
+        s.e[i] = 0;
+        s.ax[i] = s.by[i] = 0;
+      }
+      else {
+        // crosses the tile, so small enough for 32 bits anywhere in it
+        s.e[i] = int32_t(t.a[i]*startX + t.b[i]*py0 + t.c[i]);
+        s.ax[i] = t.a[i]*SUBPIXEL;
+        s.by[i] = t.b[i]*SUBPIXEL;
+      }
+    }
+    if (outside) continue;
+
+    // barycentrics of vertices 1 and 2 are edges 1 and 2 over the area
+    double e1 = double(t.a[1])*startX + double(t.b[1])*py0 + double(t.c[1]);
+    double e2 = double(t.a[2])*startX + double(t.b[2])*py0 + double(t.c[2]);
+    s.l1 = GLfloat(e1*t.invArea);
+    s.l2 = GLfloat(e2*t.invArea);
+    s.l1x = GLfloat(t.a[1]*SUBPIXEL*t.invArea);
+    s.l2x = GLfloat(t.a[2]*SUBPIXEL*t.invArea);
+    s.l1y = GLfloat(t.b[1]*SUBPIXEL*t.invArea);
+    s.l2y = GLfloat(t.b[2]*SUBPIXEL*t.invArea);
+
+#if defined(__SSE2__)
+    if (this->mode == AVX2) shadeAVX2(s, &this->color[0], &this->depth[0], this->pitch, this->depthTest);
+    else if (this->mode == SSE2) shadeSSE2(s, &this->color[0], &this->depth[0], this->pitch, this->depthTest);
+    else
+#endif
+    shadeScalar(s, &this->color[0], &this->depth[0], this->pitch, this->depthTest);
+  }
+}
+
+namespace {
+  void shadeScalar(const Span& s, uint32_t* color, GLfloat* depth, int pitch, bool depthTest) {
+    int32_t row[3] = { s.e[0], s.e[1], s.e[2] };
+    GLfloat l1Row = s.l1, l2Row = s.l2;
+    for (int y = s.y0; y <= s.y1; ++y) {
+      int32_t e[3] = { row[0], row[1], row[2] };
+      GLfloat l1 = l1Row, l2 = l2Row;
+      for (int x = s.x0; x <= s.x1; ++x) {
+        if ((e[0] | e[1] | e[2]) >= 0) {
+          GLfloat v[PLANES];
+          for (int p = 0; p < PLANES; ++p) v[p] = s.base[p] + l1*s.d1[p] + l2*s.d2[p];
+          size_t i = size_t(y)*pitch + x;
+          if (not depthTest or v[0] < depth[i]) {
+            if (depthTest) depth[i] = v[0];
+            GLfloat w = 1.0f/v[1];
+            color[i] = packColor(v[2]*w, v[3]*w, v[4]*w, v[5]*w);
+          }
+        }
+        for (int k = 0; k < 3; ++k) e[k] += s.ax[k];
+        l1 += s.l1x;
+        l2 += s.l2x;
+      }
+      for (int k = 0; k < 3; ++k) row[k] += s.by[k];
+      l1Row += s.l1y;
+      l2Row += s.l2y;
+    }
+  }
+
+#if defined(__SSE2__)
+  void shadeSSE2(const Span& s, uint32_t* color, GLfloat* depth, int pitch, bool depthTest) {
+    const __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+    const __m128 laneF = _mm_setr_ps(0, 1, 2, 3);
+    __m128i ax4[3], row[3];
+    for (int k = 0; k < 3; ++k) {
+      // SSE2 has no 32 bit multiply
+      int32_t a = s.ax[k];
+      ax4[k] = _mm_set1_epi32(4*a);
+      row[k] = _mm_setr_epi32(s.e[k], s.e[k] + a, s.e[k] + 2*a, s.e[k] + 3*a);
+    }
+    const __m128 l1x = _mm_set1_ps(s.l1x), l2x = _mm_set1_ps(s.l2x);
+    const __m128 l1x4 = _mm_set1_ps(4*s.l1x), l2x4 = _mm_set1_ps(4*s.l2x);
+    __m128 l1Row = _mm_add_ps(_mm_set1_ps(s.l1), _mm_mul_ps(laneF, l1x));
+    __m128 l2Row = _mm_add_ps(_mm_set1_ps(s.l2), _mm_mul_ps(laneF, l2x));
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), scale = _mm_set1_ps(255.0f);
+    const __m128i last = _mm_set1_epi32(s.x1);
+
+    for (int y = s.y0; y <= s.y1; ++y) {
+      __m128i e0 = row[0], e1 = row[1], e2 = row[2];
+      __m128 l1 = l1Row, l2 = l2Row;
+      for (int x = s.x0; x <= s.x1; x += 4) {
+        __m128i inside = _mm_or_si128(_mm_or_si128(e0, e1), e2);
+        __m128i mask = _mm_andnot_si128(_mm_or_si128(_mm_srai_epi32(inside, 31),
+                                                     _mm_cmpgt_epi32(_mm_add_epi32(_mm_set1_epi32(x), lane), last)),
+                                        _mm_set1_epi32(-1));
+        if (_mm_movemask_epi8(mask) != 0) {
+          size_t i = size_t(y)*pitch + x;
+          __m128 v[PLANES];
+          for (int p = 0; p < PLANES; ++p)
+            v[p] = _mm_add_ps(_mm_add_ps(_mm_set1_ps(s.base[p]), _mm_mul_ps(l1, _mm_set1_ps(s.d1[p]))),
+                              _mm_mul_ps(l2, _mm_set1_ps(s.d2[p])));
+          if (depthTest) {
+            __m128 old = _mm_loadu_ps(depth + i);
+            mask = _mm_and_si128(mask, _mm_castps_si128(_mm_cmplt_ps(v[0], old)));
+            __m128 maskF = _mm_castsi128_ps(mask);
+            _mm_storeu_ps(depth + i, _mm_or_ps(_mm_and_ps(maskF, v[0]), _mm_andnot_ps(maskF, old)));
+          }
+          __m128 w = _mm_div_ps(one, v[1]);
+          __m128i packed = _mm_setzero_si128();
+          for (int c = 0; c < 4; ++c) {
+            __m128 channel = _mm_min_ps(_mm_max_ps(_mm_mul_ps(v[2 + c], w), zero), one);
+            packed = _mm_or_si128(packed, _mm_slli_epi32(_mm_cvtps_epi32(_mm_mul_ps(channel, scale)), 8*c));
+          }
+          __m128i old = _mm_loadu_si128(reinterpret_cast<const __m128i*>(color + i));
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(color + i),
+                          _mm_or_si128(_mm_and_si128(mask, packed), _mm_andnot_si128(mask, old)));
+        }
+        e0 = _mm_add_epi32(e0, ax4[0]);
+        e1 = _mm_add_epi32(e1, ax4[1]);
+        e2 = _mm_add_epi32(e2, ax4[2]);
+        l1 = _mm_add_ps(l1, l1x4);
+        l2 = _mm_add_ps(l2, l2x4);
+      }
+      for (int k = 0; k < 3; ++k) row[k] = _mm_add_epi32(row[k], _mm_set1_epi32(s.by[k]));
+      l1Row = _mm_add_ps(l1Row, _mm_set1_ps(s.l1y));
+      l2Row = _mm_add_ps(l2Row, _mm_set1_ps(s.l2y));
+    }
+  }
+
+  __attribute__((target("avx2")))
+  void shadeAVX2(const Span& s, uint32_t* color, GLfloat* depth, int pitch, bool depthTest) {
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256 laneF = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i ax8[3], row[3];
+    for (int k = 0; k < 3; ++k) {
+      __m256i a = _mm256_set1_epi32(s.ax[k]);
+      ax8[k] = _mm256_slli_epi32(a, 3);
+      row[k] = _mm256_add_epi32(_mm256_set1_epi32(s.e[k]), _mm256_mullo_epi32(a, lane));
+    }
+    const __m256 l1x8 = _mm256_set1_ps(8*s.l1x), l2x8 = _mm256_set1_ps(8*s.l2x);
+    __m256 l1Row = _mm256_add_ps(_mm256_set1_ps(s.l1), _mm256_mul_ps(laneF, _mm256_set1_ps(s.l1x)));
+    __m256 l2Row = _mm256_add_ps(_mm256_set1_ps(s.l2), _mm256_mul_ps(laneF, _mm256_set1_ps(s.l2x)));
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f), scale = _mm256_set1_ps(255.0f);
+    const __m256i last = _mm256_set1_epi32(s.x1);
+
+    for (int y = s.y0; y <= s.y1; ++y) {
+      __m256i e0 = row[0], e1 = row[1], e2 = row[2];
+      __m256 l1 = l1Row, l2 = l2Row;
+      for (int x = s.x0; x <= s.x1; x += 8) {
+        __m256i inside = _mm256_or_si256(_mm256_or_si256(e0, e1), e2);
+        __m256i outside = _mm256_or_si256(_mm256_srai_epi32(inside, 31),
+                                          _mm256_cmpgt_epi32(_mm256_add_epi32(_mm256_set1_epi32(x), lane), last));
+        if (_mm256_movemask_epi8(outside) != -1) {
+          __m256i mask = _mm256_xor_si256(outside, _mm256_set1_epi32(-1));
+          size_t i = size_t(y)*pitch + x;
+          __m256 v[PLANES];
+          for (int p = 0; p < PLANES; ++p)
+            v[p] = _mm256_add_ps(_mm256_add_ps(_mm256_set1_ps(s.base[p]), _mm256_mul_ps(l1, _mm256_set1_ps(s.d1[p]))),
+                                 _mm256_mul_ps(l2, _mm256_set1_ps(s.d2[p])));
+          if (depthTest) {
+            __m256 old = _mm256_loadu_ps(depth + i);
+            mask = _mm256_and_si256(mask, _mm256_castps_si256(_mm256_cmp_ps(v[0], old, _CMP_LT_OQ)));
+            _mm256_storeu_ps(depth + i, _mm256_blendv_ps(old, v[0], _mm256_castsi256_ps(mask)));
+          }
+          __m256 w = _mm256_div_ps(one, v[1]);
+          __m256i packed = _mm256_setzero_si256();
+          for (int c = 0; c < 4; ++c) {
+            __m256 channel = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(v[2 + c], w), zero), one);
+            packed = _mm256_or_si256(packed, _mm256_slli_epi32(_mm256_cvtps_epi32(_mm256_mul_ps(channel, scale)), 8*c));
+          }
+          __m256i* target = reinterpret_cast<__m256i*>(color + i);
+          _mm256_storeu_si256(target, _mm256_blendv_epi8(_mm256_loadu_si256(target), packed, mask));
+        }
+        e0 = _mm256_add_epi32(e0, ax8[0]);
+        e1 = _mm256_add_epi32(e1, ax8[1]);
+        e2 = _mm256_add_epi32(e2, ax8[2]);
+        l1 = _mm256_add_ps(l1, l1x8);
+        l2 = _mm256_add_ps(l2, l2x8);
+      }
+      for (int k = 0; k < 3; ++k) row[k] = _mm256_add_epi32(row[k], _mm256_set1_epi32(s.by[k]));
+      l1Row = _mm256_add_ps(l1Row, _mm256_set1_ps(s.l1y));
+      l2Row = _mm256_add_ps(l2Row, _mm256_set1_ps(s.l2y));
+    }
+  }
+#endif
+}
@@ -0,0 +1,116 @@
+#ifndef SOFT_RASTER_H
+#define SOFT_RASTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <GL/glew.h>
+
+class ThreadPool;
+
+// CPU renderer for the same triangle lists the samples hand to GL, for
+// hosts without a GPU and as a reference to compare GL output against.
+// A draw runs a vertex function over the vertex array, clips and sets up
+// the triangles, bins them into 64x64 pixel tiles and rasterizes the tiles
+// on a thread pool with SSE2 or AVX2 edge functions. The fragment stage is
+// fixed: the first four varyings, interpolated perspective correct, are
+// the RGBA color, like shaders/shader4.frag. Triangles in a tile are drawn
+// in submission order, so the result matches GL without blending.
+//
+//   void colored(const void* vertex, const void* uniforms, SoftRasterizer::Vertex& out);
+//   SoftRasterizer raster(800, 600);
+//   raster.clear(0.2f, 0.3f, 0.3f, 1.0f);
+//   SoftRasterizer::Program program = { colored, nullptr, 3 };
+//   raster.draw(program, vertices, sizeof(ColoredVertex), 3);
+//   raster.readPixels(rgba);
+class SoftRasterizer {
+  public:
+    enum Simd { SCALAR, SSE2, AVX2 };
+    static const int MAX_VARYINGS = 4;
+    static const int TILE_SIZE = 64;
+    // Largest viewport side, keeps fixed point edge functions in 32 bits
+    static const int MAX_SIZE = 4096;
+
+    // What a vertex function writes, gl_Position and the outputs
+    struct Vertex {
+      GLfloat position[4];
+      GLfloat varyings[MAX_VARYINGS];
+    };
+    // One vertex of the array in, like a vertex shader
+    typedef void (*VertexFunction)(const void* vertex, const void* uniforms, Vertex& out);
+    struct Program {
+      VertexFunction vertex;
+      const void* uniforms;
+      int varyings;   // how many of Vertex::varyings are used
+    };
+
+    // Triangles handed to draw(), dropped by setup, cut by the clipper and
+    // triangle/tile pairs rasterized, reset by endFrame()
+    struct Counters {
+      unsigned long long triangles;
+      unsigned long long culled;
+      unsigned long long clipped;
+      unsigned long long binned;
+    };
+    Counters counters;
+
+    // threads 0 is one per core
+    SoftRasterizer(int width, int height, unsigned threads = 0);
+    ~SoftRasterizer();
+
+    // The fastest the CPU runs
+    static Simd best();
+    void setSimd(Simd simd);
+    Simd simd() const { return this->mode; }
+    void setThreads(unsigned threads);
+    unsigned threads() const { return this->workers; }
+    // GL_LESS against a float depth buffer, off by default like GL
+    void setDepthTest(bool enabled) { this->depthTest = enabled; }
+
+    void clear(GLfloat r, GLfloat g, GLfloat b, GLfloat a, GLfloat depth = 1.0f);
+    // Like glDrawArrays(GL_TRIANGLES, 0, vertexCount) or, with indices,
+    // glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, indices).
+    // vertices is vertexCount elements of stride bytes.
+    void draw(const Program& program, const void* vertices, size_t stride, size_t vertexCount,
+              const GLuint* indices = nullptr, size_t indexCount = 0);
+    // The color buffer as tightly packed RGBA8, bottom row first like
+    // glReadPixels
+    void readPixels(unsigned char* rgba) const;
+    Counters endFrame();
+
+    int width() const { return this->w; }
+    int height() const { return this->h; }
+
+  private:
+    struct Triangle;
+    struct Bin;
+
+    int w, h;
+    int pitch;                  // pixels per row, whole tiles
+    int tilesX, tilesY;
+    std::vector<uint32_t> color;
+    std::vector<GLfloat> depth;
+    bool depthTest;
+    Simd mode;
+    unsigned workers;
+    ThreadPool* pool;
+
+    // per draw, kept to avoid reallocating
+    std::vector<Vertex> transformed;
+    // per thread: set up triangles and, per tile, what covers it
+    std::vector<std::vector<Triangle> > triangles;
+    std::vector<std::vector<std::vector<Bin> > > bins;
+    // per rasterizing thread: next bin of every binning thread's list
+    std::vector<std::vector<size_t> > heads;
+    std::vector<Counters> threadCounters;
+
+    void setup(const Vertex* v[3], GLuint primitive, int varyings, unsigned thread);
+    void bin(const Triangle& triangle, GLuint primitive, unsigned thread);
+    void rasterize(int tile, unsigned thread);
+
+    SoftRasterizer(const SoftRasterizer&);
+    SoftRasterizer& operator=(const SoftRasterizer&);
+};
+
+#endif
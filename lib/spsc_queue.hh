@@ -0,0 +1,71 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bounded queue between exactly one producer thread and one consumer
+// thread, without locks: each side owns one index and publishes it with a
+// release store the other side reads with an acquire load. The indices
+// are a cache line apart so the two threads do not bounce one line.
+// The capacity is rounded up to a power of two.
+//
+//   SpscQueue<Job*> queue(256);
+//   queue.push(job);                  // producer, false when full
+//   Job* job;
+//   while (queue.pop(job)) run(job);  // consumer, false when empty
+template <typename T>
+class SpscQueue {
+  public:
+    explicit SpscQueue(size_t capacity) : head(0), tail(0) {
+      size_t size = 2;
+      while (size < capacity) size *= 2;
+      this->slots.resize(size);
+      this->mask = size - 1;
+    }
+
+    size_t capacity() const { return this->slots.size(); }
+
+    // Producer side
+    bool push(const T& value) {
+      size_t t = this->tail.load(std::memory_order_relaxed);
+      if (t - this->head.load(std::memory_order_acquire) == this->slots.size()) return false;
+      this->slots[t & this->mask] = value;
+      this->tail.store(t + 1, std::memory_order_release);
+      return true;
+    }
+
+    // Consumer side: the oldest element, null when empty. It stays in the
+    // queue until pop().
+    T* front() {
+      size_t h = this->head.load(std::memory_order_relaxed);
+      if (h == this->tail.load(std::memory_order_acquire)) return nullptr;
+      return &this->slots[h & this->mask];
+    }
+
+    bool pop(T& value) {
+      size_t h = this->head.load(std::memory_order_relaxed);
+      if (h == this->tail.load(std::memory_order_acquire)) return false;
+      value = this->slots[h & this->mask];
+      this->head.store(h + 1, std::memory_order_release);
+      return true;
+    }
+
+    // Only a hint while the other side runs
+    bool empty() const {
+      return this->head.load(std::memory_order_acquire) == this->tail.load(std::memory_order_acquire);
+    }
+
+  private:
+    std::vector<T> slots;
+    size_t mask;
+    std::atomic<size_t> head;  // next to pop, written by the consumer
+    char padding[64];
+    std::atomic<size_t> tail;  // next to push, written by the producer
+
+    SpscQueue(const SpscQueue&);
+    SpscQueue& operator=(const SpscQueue&);
+};
+
+#endif
@@ -0,0 +1,120 @@
+#include "state_cache.hh"
+
+#include <cstring>
+
+namespace {
+  // slot of a buffer target in the shadow, -1 if it has none
+  int slot(GLenum target) {
+    switch (target) {
+      case GL_ARRAY_BUFFER: return 0;
+      case GL_ELEMENT_ARRAY_BUFFER: return 1;
+      case GL_UNIFORM_BUFFER: return 2;
+      case GL_COPY_READ_BUFFER: return 3;
+      case GL_COPY_WRITE_BUFFER: return 4;
+      case GL_PIXEL_PACK_BUFFER: return 5;
+      case GL_PIXEL_UNPACK_BUFFER: return 6;
+      case GL_TEXTURE_BUFFER: return 7;
+      case GL_TRANSFORM_FEEDBACK_BUFFER: return 8;
+    }
+    return -1;
+  }
+}
+
+StateCache::StateCache() : enabled(true) {
+  std::memset(&this->counters, 0, sizeof(this->counters));
+  this->invalidate();
+}
+
+StateCache& StateCache::global() {
+  static StateCache cache;
+  return cache;
+}
+
+bool StateCache::changed(bool redundant) {
+  if (redundant and this->enabled) {
+    ++this->counters.skipped;
+    return false;
+  }
+  ++this->counters.issued;
+  return true;
+}
+
+void StateCache::useProgram(GLuint program) {
+  if (not this->changed(this->knownProgram and this->program == program)) return;
+  glUseProgram(program);
+  this->program = program;
+  this->knownProgram = true;
+}
+
+void StateCache::bindVertexArray(GLuint vao) {
+  if (not this->changed(this->knownVao and this->vao == vao)) return;
+  glBindVertexArray(vao);
+  this->vao = vao;
+  this->knownVao = true;
+  this->knownBuffers[slot(GL_ELEMENT_ARRAY_BUFFER)] = false;
+}
+
+void StateCache::bindBuffer(GLenum target, GLuint buffer) {
+  int s = slot(target);
+  if (s < 0) {
+    ++this->counters.issued;
+    glBindBuffer(target, buffer);
+    return;
+  }
+  if (not this->changed(this->knownBuffers[s] and this->buffers[s] == buffer)) return;
+  glBindBuffer(target, buffer);
+  this->buffers[s] = buffer;
+  this->knownBuffers[s] = true;
+}
+
+void StateCache::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+  if (target != GL_UNIFORM_BUFFER or index >= (GLuint) BINDINGS) {
+    ++this->counters.issued;
+    glBindBufferRange(target, index, buffer, offset, size);
+    int s = slot(target);
+    if (s >= 0) this->knownBuffers[s] = false;
+    return;
+  }
+  Range& r = this->uniformRanges[index];
+  if (not this->changed(r.known and r.buffer == buffer and r.offset == offset and r.size == size)) return;
+  glBindBufferRange(target, index, buffer, offset, size);
+  r.buffer = buffer;
+  r.offset = offset;
+  r.size = size;
+  r.known = true;
+  this->buffers[slot(target)] = buffer;
+  this->knownBuffers[slot(target)] = true;
+}
+
+void StateCache::viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+  GLint rect[4] = { x, y, width, height };
+  bool same = this->knownViewport and std::memcmp(this->viewportRect, rect, sizeof(rect)) == 0;
+  if (not this->changed(same)) return;
+  glViewport(x, y, width, height);
+  std::memcpy(this->viewportRect, rect, sizeof(rect));
+  this->knownViewport = true;
+}
+
+void StateCache::clearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a) {
+  GLfloat rgba[4] = { r, g, b, a };
+  bool same = this->knownColor and std::memcmp(this->color, rgba, sizeof(rgba)) == 0;
+  if (not this->changed(same)) return;
+  glClearColor(r, g, b, a);
+  std::memcpy(this->color, rgba, sizeof(rgba));
+  this->knownColor = true;
+}
+
+void StateCache::invalidate() {
+  this->knownProgram = false;
+  this->knownVao = false;
+  this->knownViewport = false;
+  this->knownColor = false;
+  for (int i = 0; i < TARGETS; ++i) this->knownBuffers[i] = false;
+  for (int i = 0; i < BINDINGS; ++i) this->uniformRanges[i].known = false;
+}
+
+StateCache::Counters StateCache::endFrame() {
+  Counters frame = this->counters;
+  std::memset(&this->counters, 0, sizeof(this->counters));
+  return frame;
+}
@@ -0,0 +1,76 @@
+#ifndef STATE_CACHE_H
+#define STATE_CACHE_H
+
+#include <GL/glew.h>
+
+// Shadow of the bind state of the current context: program, vertex array,
+// buffer bindings, viewport and clear color. Calls that would set what is
+// already set never reach the driver, so a render loop can bind what each
+// draw needs without unbinding afterwards.
+// The shadow starts unknown and only learns through its own calls. After
+// changing any of this state behind its back (raw gl calls, deleting a
+// bound vertex array or buffer, switching contexts) call invalidate().
+//
+//   StateCache& state = StateCache::global();
+//   state.useProgram(program);
+//   state.bindVertexArray(VAO);
+//   glDrawArrays(GL_TRIANGLES, 0, 3);
+class StateCache {
+  public:
+    // Calls forwarded to the driver versus dropped as redundant, reset by
+    // endFrame()
+    struct Counters {
+      unsigned issued;
+      unsigned skipped;
+    };
+    Counters counters;
+    // When false every call is forwarded, to measure what the cache saves
+    bool enabled;
+
+    // The cache of the one context the samples use
+    static StateCache& global();
+
+    void useProgram(GLuint program);
+    // Also forgets the element array buffer, which belongs to the VAO
+    void bindVertexArray(GLuint vao);
+    void bindBuffer(GLenum target, GLuint buffer);
+    // Indexed binding, shadowed for the first BINDINGS uniform buffer
+    // binding points. When issued it also moves the generic binding, as GL
+    // does; do not count on the generic binding after this call.
+    void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+    void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+    void clearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a);
+    // Forget everything, the next call of each kind reaches the driver
+    void invalidate();
+    // Returns this frame's counters and resets them
+    Counters endFrame();
+
+  private:
+    // buffer targets with a shadow, others are always forwarded
+    static const int TARGETS = 9;
+    // uniform buffer binding points with a shadow
+    static const int BINDINGS = 16;
+    struct Range {
+      GLuint buffer;
+      GLintptr offset;
+      GLsizeiptr size;
+      bool known;
+    };
+
+    GLuint program;
+    GLuint vao;
+    GLuint buffers[TARGETS];
+    GLint viewportRect[4];
+    GLfloat color[4];
+    bool knownProgram, knownVao, knownViewport, knownColor;
+    bool knownBuffers[TARGETS];
+    Range uniformRanges[BINDINGS];
+
+    StateCache();
+    StateCache(const StateCache&);
+    StateCache& operator=(const StateCache&);
+    // True if the call must reach the driver, counts it either way
+    bool changed(bool redundant);
+};
+
+#endif
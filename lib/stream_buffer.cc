@@ -0,0 +1,143 @@
+#include "stream_buffer.hh"
+#include "state_cache.hh"
+#include "profiler.hh"
+
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+  // glClientWaitSync timeout per try, in nanoseconds
+  const GLuint64 WAIT_TIMEOUT = 1000000;
+  // where the buffer is bound to allocate, map and fill it: binding an
+  // element buffer to GL_ELEMENT_ARRAY_BUFFER would replace the one of
+  // whatever vertex array is bound
+  const GLenum STORAGE = GL_COPY_WRITE_BUFFER;
+  // least alignment of a region, the uniform buffer offset alignment of
+  // most desktop GPUs
+  const GLint REGION_ALIGNMENT = 256;
+}
+
+StreamBuffer::StreamBuffer(GLenum target, GLsizeiptr frameSize, Mode mode)
+  : bindTarget(target), frameSize(frameSize), streamMode(mode), name(0), mapped(nullptr),
+    region(-1), used(0), flushed(0) {
+  std::memset(&this->total, 0, sizeof(this->total));
+  std::memset(&this->frame, 0, sizeof(this->frame));
+  for (int i = 0; i < FRAMES; ++i) this->fences[i] = 0;
+  const char* env = std::getenv("LEARNOPENGL_STREAM");
+  if (env != nullptr and std::strcmp(env, "orphan") == 0) this->streamMode = ORPHAN;
+  if (not GLEW_ARB_buffer_storage) this->streamMode = ORPHAN;
+
+  // regions start aligned for any buffer range, so aligned allocations
+  // fit in every region alike
+  GLint alignment = 0;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  if (alignment < REGION_ALIGNMENT) alignment = REGION_ALIGNMENT;
+  this->frameSize = (frameSize + alignment - 1)/alignment*alignment;
+
+  glGenBuffers(1, &this->name);
+  StateCache::global().bindBuffer(STORAGE, this->name);
+  if (this->streamMode == PERSISTENT) {
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(STORAGE, this->frameSize*FRAMES, nullptr, flags);
+    this->mapped = static_cast<char*>(glMapBufferRange(STORAGE, 0, this->frameSize*FRAMES, flags));
+    if (this->mapped == nullptr) {
+      std::cout << "ERROR::STREAM_BUFFER::MAP_FAILED, orphaning instead" << std::endl;
+      // storage is immutable, start over with a new name
+      glDeleteBuffers(1, &this->name);
+      StateCache::global().invalidate();
+      glGenBuffers(1, &this->name);
+      StateCache::global().bindBuffer(STORAGE, this->name);
+      this->streamMode = ORPHAN;
+    }
+  }
+  if (this->streamMode == ORPHAN) {
+    glBufferData(STORAGE, this->frameSize, nullptr, GL_STREAM_DRAW);
+    this->staging.resize(this->frameSize);
+  }
+}
+
+StreamBuffer::~StreamBuffer() {
+  for (int i = 0; i < FRAMES; ++i)
+    if (this->fences[i] != 0) glDeleteSync(this->fences[i]);
+  if (this->mapped != nullptr) {
+    StateCache::global().bindBuffer(STORAGE, this->name);
+    glUnmapBuffer(STORAGE);
+  }
+  glDeleteBuffers(1, &this->name);
+  StateCache::global().invalidate();
+}
+
+void StreamBuffer::beginFrame() {
+  PROFILE_ZONE("StreamBuffer::beginFrame");
+  this->region = (this->region + 1) % FRAMES;
+  this->used = 0;
+  this->flushed = 0;
+
+  if (this->streamMode == ORPHAN) {
+    // the driver hands out fresh storage if the old one is still in use
+    StateCache::global().bindBuffer(STORAGE, this->name);
+    glBufferData(STORAGE, this->frameSize, nullptr, GL_STREAM_DRAW);
+    return;
+  }
+
+  GLsync fence = this->fences[this->region];
+  if (fence == 0) return;
+  GLenum status = glClientWaitSync(fence, 0, 0);
+  if (status != GL_ALREADY_SIGNALED and status != GL_CONDITION_SATISFIED) {
+    ++this->frame.stalls;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    do {
+      status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, WAIT_TIMEOUT);
+    } while (status == GL_TIMEOUT_EXPIRED);
+    if (status == GL_WAIT_FAILED) std::cout << "ERROR::STREAM_BUFFER::WAIT_FAILED" << std::endl;
+    this->frame.waitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  }
+  glDeleteSync(fence);
+  this->fences[this->region] = 0;
+}
+
+void* StreamBuffer::allocate(GLsizeiptr size, GLsizeiptr alignment, GLintptr& offset) {
+  if (this->region < 0) {
+    std::cout << "ERROR::STREAM_BUFFER::NO_FRAME" << std::endl;
+    return nullptr;
+  }
+  // align the offset into the whole buffer, for alignments larger than
+  // the one regions start on
+  GLsizeiptr base = this->streamMode == PERSISTENT ? this->region*this->frameSize : 0;
+  GLsizeiptr start = base + this->used;
+  if (alignment > 1) start = (start + alignment - 1)/alignment*alignment;
+  start -= base;
+  if (start + size > this->frameSize) {
+    std::cout << "ERROR::STREAM_BUFFER::FRAME_FULL " << size << " bytes" << std::endl;
+    return nullptr;
+  }
+  this->used = start + size;
+  this->frame.bytes += size;
+  if (this->streamMode == ORPHAN) {
+    offset = start;
+    return &this->staging[start];
+  }
+  offset = base + start;
+  return this->mapped + offset;
+}
+
+void StreamBuffer::flush() {
+  if (this->streamMode == PERSISTENT or this->used == this->flushed) return;
+  StateCache::global().bindBuffer(STORAGE, this->name);
+  glBufferSubData(STORAGE, this->flushed, this->used - this->flushed, &this->staging[this->flushed]);
+  this->flushed = this->used;
+}
+
+StreamBuffer::Stats StreamBuffer::endFrame() {
+  this->flush();
+  if (this->streamMode == PERSISTENT and this->region >= 0)
+    this->fences[this->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  Stats last = this->frame;
+  this->total.bytes += last.bytes;
+  this->total.waitMs += last.waitMs;
+  this->total.stalls += last.stalls;
+  std::memset(&this->frame, 0, sizeof(this->frame));
+  return last;
+}
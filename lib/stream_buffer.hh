@@ -0,0 +1,76 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <vector>
+#include <cstddef>
+
+#include <GL/glew.h>
+
+// Ring allocator for data rewritten every frame: vertices, instance data,
+// uniform blocks. The buffer holds FRAMES regions of frameSize bytes,
+// rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT and to 256; each
+// frame writes into the next region while the GPU may still read the
+// previous ones, and a fence per region keeps the CPU from overwriting one
+// the GPU has not finished with.
+// PERSISTENT maps the whole buffer once (ARB_buffer_storage, persistent
+// and coherent), writes land in GPU visible memory directly. Without the
+// extension, or with LEARNOPENGL_STREAM=orphan in the environment, ORPHAN
+// stages the frame on the CPU and each frame orphans a one region buffer.
+//
+//   stream.beginFrame();
+//   GLintptr offset;
+//   GLfloat* v = (GLfloat*) stream.allocate(bytes, 4, offset);
+//   ... fill v ...
+//   stream.flush();      // before drawing from what was written
+//   glDrawArrays(...);   // with attributes at offset
+//   stream.endFrame();
+class StreamBuffer {
+  public:
+    enum Mode { PERSISTENT, ORPHAN };
+    static const int FRAMES = 3;
+
+    struct Stats {
+      size_t bytes;      // allocated
+      double waitMs;     // CPU time blocked on fences
+      unsigned stalls;   // beginFrame() calls that had to wait
+    };
+    // Totals since construction; endFrame() returns the last frame alone
+    Stats total;
+
+    // target is what buffer() gets bound to for drawing. The buffer is
+    // allocated and filled through GL_COPY_WRITE_BUFFER, so an element
+    // buffer leaves the bound vertex array alone.
+    StreamBuffer(GLenum target, GLsizeiptr frameSize, Mode mode = PERSISTENT);
+    ~StreamBuffer();
+
+    // Wait until the GPU is done with the next region and start using it
+    void beginFrame();
+    // size bytes at a multiple of alignment, nullptr if the frame is full.
+    // offset receives where they are in buffer().
+    void* allocate(GLsizeiptr size, GLsizeiptr alignment, GLintptr& offset);
+    // Make the allocations so far visible to GL (a no-op when PERSISTENT)
+    void flush();
+    // Fence the region and return this frame's stats
+    Stats endFrame();
+
+    GLuint buffer() const { return name; }
+    GLenum target() const { return bindTarget; }
+    Mode mode() const { return streamMode; }
+
+  private:
+    GLenum bindTarget;
+    GLsizeiptr frameSize;
+    Mode streamMode;
+    GLuint name;
+    char* mapped;                  // PERSISTENT: the whole mapped buffer
+    std::vector<char> staging;     // ORPHAN: the frame being written
+    GLsync fences[FRAMES];
+    int region;
+    GLsizeiptr used, flushed;
+    Stats frame;
+
+    StreamBuffer(const StreamBuffer&);
+    StreamBuffer& operator=(const StreamBuffer&);
+};
+
+#endif
@@ -0,0 +1,56 @@
+#include "thread_pool.hh"
+
+#include <algorithm>
+#include <atomic>
+
+ThreadPool::ThreadPool(unsigned threads) : job(nullptr), generation(0), busy(0), stop(false) {
+  if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned i = 1; i < threads; ++i) this->threads.push_back(std::thread(&ThreadPool::run, this, i));
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stop = true;
+  }
+  this->start.notify_all();
+  for (size_t i = 0; i < this->threads.size(); ++i) this->threads[i].join();
+}
+
+void ThreadPool::parallel(size_t count, size_t grain, const std::function<void(size_t, unsigned)>& work) {
+  std::atomic<size_t> next(0);
+  std::function<void(unsigned)> job = [&](unsigned thread) {
+    for (size_t begin = next.fetch_add(grain); begin < count; begin = next.fetch_add(grain))
+      for (size_t i = begin; i < std::min(begin + grain, count); ++i) work(i, thread);
+  };
+  if (this->threads.empty()) {
+    job(0);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->job = &job;
+    this->busy = this->threads.size();
+    ++this->generation;
+  }
+  this->start.notify_all();
+  job(0);
+  std::unique_lock<std::mutex> lock(this->mutex);
+  this->finished.wait(lock, [this]() { return this->busy == 0; });
+  this->job = nullptr;
+}
+
+void ThreadPool::run(unsigned thread) {
+  unsigned seen = 0;
+  std::unique_lock<std::mutex> lock(this->mutex);
+  for (;;) {
+    this->start.wait(lock, [&]() { return this->stop or this->generation != seen; });
+    if (this->stop) return;
+    seen = this->generation;
+    const std::function<void(unsigned)>* job = this->job;
+    lock.unlock();
+    (*job)(thread);
+    lock.lock();
+    if (--this->busy == 0) this->finished.notify_one();
+  }
+}
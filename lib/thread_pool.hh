@@ -0,0 +1,44 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <cstddef>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+
+// A fixed set of threads, the calling thread being thread 0. parallel()
+// splits a range into grain sized pieces the threads take in turn and
+// returns once every piece is done.
+//
+//   ThreadPool pool(4);
+//   pool.parallel(objects.size(), 256, [&](size_t i, unsigned thread) {
+//     update(objects[i], scratch[thread]);
+//   });
+class ThreadPool {
+  public:
+    // threads 0 is one per core
+    explicit ThreadPool(unsigned threads = 0);
+    ~ThreadPool();
+
+    unsigned size() const { return this->threads.size() + 1; }
+    // work(item, thread) for every item below count, grain items at a time
+    void parallel(size_t count, size_t grain, const std::function<void(size_t, unsigned)>& work);
+
+  private:
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable start, finished;
+    const std::function<void(unsigned)>* job;
+    unsigned generation;
+    size_t busy;
+    bool stop;
+
+    void run(unsigned thread);
+
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+};
+
+#endif
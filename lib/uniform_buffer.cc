@@ -0,0 +1,54 @@
+#include "uniform_buffer.hh"
+#include "state_cache.hh"
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+UniformBuffer::UniformBuffer(GLsizeiptr capacity)
+  : name(0), capacity(capacity), offsetAlignment(256), used(0), data(capacity),
+    dirtyBegin(capacity), dirtyEnd(0) {
+  GLint alignment = 0;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  if (alignment > 0) this->offsetAlignment = alignment;
+  glGenBuffers(1, &this->name);
+  StateCache::global().bindBuffer(GL_UNIFORM_BUFFER, this->name);
+  glBufferData(GL_UNIFORM_BUFFER, capacity, nullptr, GL_DYNAMIC_DRAW);
+}
+
+UniformBuffer::~UniformBuffer() {
+  glDeleteBuffers(1, &this->name);
+  StateCache::global().invalidate();
+}
+
+GLintptr UniformBuffer::reserve(GLsizeiptr size) {
+  GLintptr offset = (this->used + this->offsetAlignment - 1)/this->offsetAlignment*this->offsetAlignment;
+  if (offset + size > this->capacity) {
+    std::cout << "ERROR::UNIFORM_BUFFER::FULL " << this->capacity << " bytes" << std::endl;
+    return -1;
+  }
+  this->used = offset + size;
+  return offset;
+}
+
+void UniformBuffer::write(GLintptr offset, const void* data, GLsizeiptr size) {
+  if (offset < 0 or offset + size > this->used) {
+    std::cout << "ERROR::UNIFORM_BUFFER::WRITE_OUT_OF_RANGE " << offset << std::endl;
+    return;
+  }
+  std::memcpy(&this->data[offset], data, size);
+  this->dirtyBegin = std::min<GLintptr>(this->dirtyBegin, offset);
+  this->dirtyEnd = std::max<GLintptr>(this->dirtyEnd, offset + size);
+}
+
+void UniformBuffer::upload() {
+  if (this->dirtyBegin >= this->dirtyEnd) return;
+  StateCache::global().bindBuffer(GL_UNIFORM_BUFFER, this->name);
+  glBufferSubData(GL_UNIFORM_BUFFER, this->dirtyBegin, this->dirtyEnd - this->dirtyBegin, &this->data[this->dirtyBegin]);
+  this->dirtyBegin = this->capacity;
+  this->dirtyEnd = 0;
+}
+
+void UniformBuffer::bindRange(GLuint binding, GLintptr offset, GLsizeiptr size) {
+  StateCache::global().bindBufferRange(GL_UNIFORM_BUFFER, binding, this->name, offset, size);
+}
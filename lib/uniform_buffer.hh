@@ -0,0 +1,105 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <vector>
+#include <cstddef>
+
+#include <GL/glew.h>
+
+// std140 mirrors of GLSL types. Their C++ alignment is the std140 base
+// alignment, so a struct of them gets the same offsets as the GLSL block
+// as long as the declarations match. Scalars are plain GLfloat/GLint.
+// Note vec3 is 16 bytes here: a scalar that GLSL packs right after a vec3
+// lands 4 bytes later in C++, which STD140_OFFSET catches.
+namespace std140 {
+  struct alignas(8) vec2 { GLfloat x, y; };
+  struct alignas(16) vec3 { GLfloat x, y, z; };
+  struct alignas(16) vec4 { GLfloat x, y, z, w; };
+  // column major, like glUniformMatrix4fv without transpose
+  struct alignas(16) mat4 { GLfloat m[16]; };
+
+  // Array of N T, every element rounded up to 16 bytes
+  template <typename T, size_t N>
+  struct array {
+    struct alignas(16) Element { T value; };
+    Element elements[N];
+    T& operator[](size_t i) { return elements[i].value; }
+    const T& operator[](size_t i) const { return elements[i].value; }
+  };
+
+  // Blocks fill whole vec4s, so they can be packed back to back
+  template <typename Block>
+  constexpr bool padded() { return sizeof(Block) % 16 == 0; }
+}
+
+// Compile time layout checks, next to the struct that mirrors a block:
+//   struct Object {            // layout (std140) uniform Object {
+//     std140::vec4 color;      //   vec4 color;
+//     std140::vec2 offset;     //   vec2 offset;
+//     GLfloat scale;           //   float scale;
+//   };                         // };
+//   STD140_OFFSET(Object, color, 0);
+//   STD140_OFFSET(Object, offset, 16);
+//   STD140_OFFSET(Object, scale, 24);
+//   STD140_SIZE(Object, 32);
+#define STD140_OFFSET(Block, member, offset) \
+  static_assert(offsetof(Block, member) == (offset), #Block "::" #member " is not at std140 offset " #offset)
+#define STD140_SIZE(Block, size) \
+  static_assert(sizeof(Block) == (size) and std140::padded<Block>(), #Block " is not " #size " bytes of whole vec4s")
+
+// Many uniform blocks packed in one buffer, each at a multiple of
+// GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT so any of them can be bound alone
+// with glBindBufferRange. Blocks are written into a CPU copy; upload()
+// sends everything written since the last upload in one sub-range write.
+//
+//   UniformBuffer objects(1 << 20);
+//   GLintptr first = objects.add(object);
+//   objects.upload();
+//   objects.bind<Object>(0, first);   // Shader::bindBlock("Object", 0)
+class UniformBuffer {
+  public:
+    explicit UniformBuffer(GLsizeiptr capacity);
+    ~UniformBuffer();
+
+    // Room for one more block, returns its offset, -1 when full
+    GLintptr reserve(GLsizeiptr size);
+    // Copy size bytes at offset into the CPU copy
+    void write(GLintptr offset, const void* data, GLsizeiptr size);
+    // One glBufferSubData over everything written since the last upload
+    void upload();
+    void bindRange(GLuint binding, GLintptr offset, GLsizeiptr size);
+
+    template <typename Block>
+    GLintptr add(const Block& block) {
+      GLintptr offset = this->reserve(sizeof(Block));
+      if (offset >= 0) this->write(offset, &block, sizeof(Block));
+      return offset;
+    }
+    template <typename Block>
+    void update(GLintptr offset, const Block& block) {
+      this->write(offset, &block, sizeof(Block));
+    }
+    template <typename Block>
+    void bind(GLuint binding, GLintptr offset) {
+      this->bindRange(binding, offset, sizeof(Block));
+    }
+
+    GLuint buffer() const { return name; }
+    GLsizeiptr alignment() const { return offsetAlignment; }
+    // Bytes handed out by reserve()
+    GLsizeiptr size() const { return used; }
+
+  private:
+    GLuint name;
+    GLsizeiptr capacity;
+    GLsizeiptr offsetAlignment;
+    GLsizeiptr used;
+    std::vector<char> data;
+    // written but not uploaded, empty when begin >= end
+    GLintptr dirtyBegin, dirtyEnd;
+
+    UniformBuffer(const UniformBuffer&);
+    UniformBuffer& operator=(const UniformBuffer&);
+};
+
+#endif
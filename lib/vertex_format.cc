@@ -0,0 +1,92 @@
+#include "vertex_format.hh"
+
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+
+namespace {
+  GLfloat clamp(GLfloat x, GLfloat low, GLfloat high) {
+    return x < low ? low : (x > high ? high : x);
+  }
+
+  // round to nearest, ties to even, like the GPU and C casts do
+  uint32_t roundEven(uint32_t kept, uint32_t dropped, uint32_t half) {
+    if (dropped > half or (dropped == half and (kept & 1))) ++kept;
+    return kept;
+  }
+
+  // two's complement in the low bits bits
+  GLuint field(GLint x, int bits) {
+    return GLuint(x) & ((1u << bits) - 1);
+  }
+}
+
+GLhalf vertex::half(GLfloat f) {
+  uint32_t x;
+  std::memcpy(&x, &f, sizeof(x));
+  uint32_t sign = (x >> 16) & 0x8000;
+  int32_t exponent = int32_t((x >> 23) & 0xff) - 127 + 15;
+  uint32_t mantissa = x & 0x7fffff;
+  // NaN and infinity
+  if (((x >> 23) & 0xff) == 0xff) return GLhalf(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+  if (exponent >= 31) return GLhalf(sign | 0x7c00);
+  if (exponent <= 0) {
+    // subnormal, or too small: zero
+    if (exponent < -10) return GLhalf(sign);
+    mantissa |= 0x800000;
+    int shift = 14 - exponent;
+    return GLhalf(sign | roundEven(mantissa >> shift, mantissa & ((1u << shift) - 1), 1u << (shift - 1)));
+  }
+  // a carry out of the mantissa into the exponent is still right
+  uint32_t rounded = roundEven((uint32_t(exponent) << 10) | (mantissa >> 13), mantissa & 0x1fff, 0x1000);
+  if (rounded >= 0x7c00) return GLhalf(sign | 0x7c00);
+  return GLhalf(sign | rounded);
+}
+
+vertex::half2 vertex::pack(const vec2& v) {
+  half2 h = { half(v.x), half(v.y) };
+  return h;
+}
+
+vertex::half4 vertex::pack(const vec4& v) {
+  half4 h = { half(v.x), half(v.y), half(v.z), half(v.w) };
+  return h;
+}
+
+vertex::ubyte4n vertex::unorm8(GLfloat x, GLfloat y, GLfloat z, GLfloat w) {
+  ubyte4n c = {
+    GLubyte(std::lround(clamp(x, 0, 1)*255.0f)), GLubyte(std::lround(clamp(y, 0, 1)*255.0f)),
+    GLubyte(std::lround(clamp(z, 0, 1)*255.0f)), GLubyte(std::lround(clamp(w, 0, 1)*255.0f))
+  };
+  return c;
+}
+
+vertex::int2_10_10_10n vertex::snorm10(GLfloat x, GLfloat y, GLfloat z, GLfloat w) {
+  int2_10_10_10n p;
+  p.bits = field(std::lround(clamp(x, -1, 1)*511.0f), 10)
+         | field(std::lround(clamp(y, -1, 1)*511.0f), 10) << 10
+         | field(std::lround(clamp(z, -1, 1)*511.0f), 10) << 20
+         | field(std::lround(clamp(w, -1, 1)), 2) << 30;
+  return p;
+}
+
+vertex::uint2_10_10_10n vertex::unorm10(GLfloat x, GLfloat y, GLfloat z, GLfloat w) {
+  uint2_10_10_10n p;
+  p.bits = GLuint(std::lround(clamp(x, 0, 1)*1023.0f))
+         | GLuint(std::lround(clamp(y, 0, 1)*1023.0f)) << 10
+         | GLuint(std::lround(clamp(z, 0, 1)*1023.0f)) << 20
+         | GLuint(std::lround(clamp(w, 0, 1)*3.0f)) << 30;
+  return p;
+}
+
+void setVertexAttributes(const VertexAttribute* attributes, size_t count, GLsizei stride,
+                         size_t offset, GLuint firstLocation) {
+  for (size_t i = 0; i < count; ++i) {
+    const VertexAttribute& a = attributes[i];
+    GLuint location = firstLocation + i;
+    const GLvoid* pointer = (const GLvoid *)(offset + a.offset);
+    if (a.integer) glVertexAttribIPointer(location, a.components, a.type, stride, pointer);
+    else glVertexAttribPointer(location, a.components, a.type, a.normalized, stride, pointer);
+    glEnableVertexAttribArray(location);
+  }
+}
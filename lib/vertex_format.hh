@@ -0,0 +1,134 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <cstddef>
+
+#include <GL/glew.h>
+
+// Attribute types a vertex struct is built from. Each one knows its GL
+// type, component count and whether it is normalized, so the attribute
+// setup can be derived from the struct instead of written by hand.
+namespace vertex {
+  struct vec2 { GLfloat x, y; };
+  struct vec3 { GLfloat x, y, z; };
+  struct vec4 { GLfloat x, y, z, w; };
+  // 16 bit floats, half the size of vec* with 11 bits of precision
+  struct half2 { GLhalf x, y; };
+  struct half4 { GLhalf x, y, z, w; };
+  // 8 bit unsigned normalized, reads as [0, 1] in the shader
+  struct ubyte4n { GLubyte x, y, z, w; };
+  // 10 bit signed normalized xyz and a 2 bit w in one word,
+  // reads as [-1, 1] in the shader
+  struct int2_10_10_10n { GLuint bits; };
+  // 10 bit unsigned normalized xyz and a 2 bit w, reads as [0, 1]
+  struct uint2_10_10_10n { GLuint bits; };
+
+  GLhalf half(GLfloat f);
+  half2 pack(const vec2& v);
+  half4 pack(const vec4& v);
+  // from [0, 1], clamped
+  ubyte4n unorm8(GLfloat x, GLfloat y, GLfloat z, GLfloat w = 1.0f);
+  // from [-1, 1] (w from -1, 0, 1), clamped
+  int2_10_10_10n snorm10(GLfloat x, GLfloat y, GLfloat z, GLfloat w = 1.0f);
+  // from [0, 1], clamped
+  uint2_10_10_10n unorm10(GLfloat x, GLfloat y, GLfloat z, GLfloat w = 1.0f);
+
+  template <typename T> struct Traits;
+  template <GLenum Type, GLint Components, size_t ComponentSize, bool Normalized, bool Integer = false>
+  struct TraitsOf {
+    static const GLenum type = Type;
+    static const GLint components = Components;
+    // what GL reads, packed formats count as one 4 byte unit
+    static const size_t bytes = Components*ComponentSize;
+    static const size_t alignment = ComponentSize;
+    static const bool normalized = Normalized;
+    static const bool integer = Integer;
+  };
+  template <> struct Traits<GLfloat> : TraitsOf<GL_FLOAT, 1, 4, false> {};
+  template <> struct Traits<vec2> : TraitsOf<GL_FLOAT, 2, 4, false> {};
+  template <> struct Traits<vec3> : TraitsOf<GL_FLOAT, 3, 4, false> {};
+  template <> struct Traits<vec4> : TraitsOf<GL_FLOAT, 4, 4, false> {};
+  template <> struct Traits<half2> : TraitsOf<GL_HALF_FLOAT, 2, 2, false> {};
+  template <> struct Traits<half4> : TraitsOf<GL_HALF_FLOAT, 4, 2, false> {};
+  template <> struct Traits<ubyte4n> : TraitsOf<GL_UNSIGNED_BYTE, 4, 1, true> {};
+  template <> struct Traits<int2_10_10_10n> {
+    static const GLenum type = GL_INT_2_10_10_10_REV;
+    static const GLint components = 4;
+    static const size_t bytes = 4;
+    static const size_t alignment = 4;
+    static const bool normalized = true;
+    static const bool integer = false;
+  };
+  template <> struct Traits<uint2_10_10_10n> : Traits<int2_10_10_10n> {
+    static const GLenum type = GL_UNSIGNED_INT_2_10_10_10_REV;
+  };
+  // integer attributes, read by glVertexAttribIPointer into ivec/uvec
+  template <> struct Traits<GLint> : TraitsOf<GL_INT, 1, 4, false, true> {};
+  template <> struct Traits<GLuint> : TraitsOf<GL_UNSIGNED_INT, 1, 4, false, true> {};
+}
+
+// One attribute of a vertex struct, usually made by VERTEX_ATTRIBUTE
+struct VertexAttribute {
+  GLenum type;
+  GLint components;
+  GLboolean normalized;
+  bool integer;
+  size_t offset;
+  size_t bytes;
+  size_t alignment;
+
+  template <typename T>
+  static constexpr VertexAttribute make(size_t offset) {
+    static_assert(sizeof(T) == vertex::Traits<T>::bytes, "attribute type has padding");
+    return VertexAttribute{ vertex::Traits<T>::type, vertex::Traits<T>::components,
+                            GLboolean(vertex::Traits<T>::normalized), vertex::Traits<T>::integer,
+                            offset, vertex::Traits<T>::bytes, vertex::Traits<T>::alignment };
+  }
+};
+
+#define VERTEX_ATTRIBUTE(Vertex, member) \
+  VertexAttribute::make<decltype(Vertex::member)>(offsetof(Vertex, member))
+
+// Attributes at locations 0, 1, ... in declaration order, checked at
+// compile time against the struct:
+//   struct ColoredVertex {
+//     vertex::vec3 position;
+//     vertex::ubyte4n color;
+//   };
+//   VERTEX_FORMAT(ColoredVertex,
+//     VERTEX_ATTRIBUTE(ColoredVertex, position),
+//     VERTEX_ATTRIBUTE(ColoredVertex, color));
+//   ...
+//   setVertexFormat<ColoredVertex>();   // with the VAO and VBO bound
+template <typename Vertex> struct VertexFormat;
+
+namespace vertex {
+  // every attribute aligned to its component size and inside the vertex
+  constexpr bool valid(const VertexAttribute* a, size_t n, size_t stride) {
+    return n == 0 or (a->offset % a->alignment == 0 and a->offset + a->bytes <= stride
+                      and valid(a + 1, n - 1, stride));
+  }
+}
+
+#define VERTEX_FORMAT(Vertex, ...) \
+  template <> struct VertexFormat<Vertex> { \
+    static constexpr VertexAttribute attributes[] = { __VA_ARGS__ }; \
+    static constexpr size_t count = sizeof(attributes)/sizeof(attributes[0]); \
+  }; \
+  constexpr VertexAttribute VertexFormat<Vertex>::attributes[]; \
+  static_assert(vertex::valid(VertexFormat<Vertex>::attributes, VertexFormat<Vertex>::count, sizeof(Vertex)), \
+                #Vertex " has a misaligned attribute"); \
+  static_assert(sizeof(Vertex) % 4 == 0, #Vertex " is not a multiple of 4 bytes")
+
+// Point the attributes of the bound VAO at the bound GL_ARRAY_BUFFER,
+// starting offset bytes in, locations from firstLocation on
+void setVertexAttributes(const VertexAttribute* attributes, size_t count, GLsizei stride,
+                         size_t offset = 0, GLuint firstLocation = 0);
+
+template <typename Vertex>
+void setVertexFormat(size_t offset = 0, GLuint firstLocation = 0) {
+  setVertexAttributes(VertexFormat<Vertex>::attributes, VertexFormat<Vertex>::count, sizeof(Vertex),
+                      offset, firstLocation);
+}
+
+#endif
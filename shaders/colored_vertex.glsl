@@ -0,0 +1,4 @@
+// per vertex position and color inputs of the colored triangle
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 color;
+out vec3 ourColor;
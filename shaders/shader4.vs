@@ -1,7 +1,5 @@
 #version 330 core
-layout (location = 0) in vec3 position;
-layout (location = 1) in vec3 color;
-out vec3 ourColor;
+#include "colored_vertex.glsl"
 
 void main() {
   gl_Position = vec4(position, 1.0);
@@ -1,6 +1,7 @@
 #include <iostream>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include "../lib/state_cache.hh"
 // pass data between shaders
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mode);
@@ -112,19 +113,21 @@ int main() {
   // Step 4: unbind vertex array object
   glBindVertexArray(0);
 
+  // binds only what changed, see state_cache.hh
+  StateCache& state = StateCache::global();
+
   // event loop
   while (!glfwWindowShouldClose(window)) {
     glfwPollEvents();
 
     // rendering
-    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    state.clearColor(0.2f, 0.3f, 0.3f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
     // use shader program
-    glUseProgram(shaderProgram);
-    glBindVertexArray(VAO); // use VAO
+    state.useProgram(shaderProgram);
+    state.bindVertexArray(VAO); // use VAO
     glDrawArrays(GL_TRIANGLES, 0, 3);
-    glBindVertexArray(0);
 
     // refresh
     glfwSwapBuffers(window);
@@ -2,6 +2,7 @@
 #include <cmath>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include "../lib/state_cache.hh"
 // color animation with uniforms
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mode);
@@ -92,6 +93,9 @@ int main() {
   glDeleteShader(vertexShader);
   glDeleteShader(fragmentShader);
 
+  // uniform location only changes on relink, look it up once
+  GLint vertexColorLocation = glGetUniformLocation(shaderProgram, "ourColor");
+
   GLfloat vertices1[] = {
     -.5f, -.5f, .0f,
     .0f, .5f, .0f,
@@ -113,26 +117,27 @@ int main() {
   // Step 4: unbind vertex array object
   glBindVertexArray(0);
 
+  // binds only what changed, see state_cache.hh
+  StateCache& state = StateCache::global();
+
   // event loop
   while (!glfwWindowShouldClose(window)) {
     glfwPollEvents();
 
     // rendering
-    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    state.clearColor(0.2f, 0.3f, 0.3f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
     // use shader program
-    glUseProgram(shaderProgram);
+    state.useProgram(shaderProgram);
 
     // update uniform color
     GLfloat timeValue = glfwGetTime();
     GLfloat greenValue = (sin(timeValue*2)/2) + 0.5;
-    GLint vertexColorLocation = glGetUniformLocation(shaderProgram, "ourColor");
     glUniform4f(vertexColorLocation, 0.0f, greenValue, 0.0f, 1.0f);
 
-    glBindVertexArray(VAO); // use VAO
+    state.bindVertexArray(VAO); // use VAO
     glDrawArrays(GL_TRIANGLES, 0, 3);
-    glBindVertexArray(0);
 
     // refresh
     glfwSwapBuffers(window);
@@ -2,6 +2,7 @@
 #include <cmath>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include "../lib/state_cache.hh"
 // set color per vertice with attributes
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mode);
@@ -93,6 +94,9 @@ int main() {
   glDeleteShader(vertexShader);
   glDeleteShader(fragmentShader);
 
+  // uniform location only changes on relink, look it up once
+  GLint vertexColorLocation = glGetUniformLocation(shaderProgram, "ourColor");
+
   GLfloat vertices1[] = { // {position, color} x 3
     -.5f, -.5f, .0f,  1.0f,  0.0f,  0.0f,
      .0f,  .5f, .0f,  0.0f,  1.0f,  0.0f,
@@ -118,26 +122,27 @@ int main() {
   // Step 4: unbind vertex array object
   glBindVertexArray(0);
 
+  // binds only what changed, see state_cache.hh
+  StateCache& state = StateCache::global();
+
   // event loop
   while (!glfwWindowShouldClose(window)) {
     glfwPollEvents();
 
     // rendering
-    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    state.clearColor(0.2f, 0.3f, 0.3f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
     // use shader program
-    glUseProgram(shaderProgram);
+    state.useProgram(shaderProgram);
 
     // update uniform color
     GLfloat timeValue = glfwGetTime();
     GLfloat greenValue = (sin(timeValue*2)/2) + 0.5;
-    GLint vertexColorLocation = glGetUniformLocation(shaderProgram, "ourColor");
     glUniform4f(vertexColorLocation, 0.0f, greenValue, 0.0f, 1.0f);
 
-    glBindVertexArray(VAO); // use VAO
+    state.bindVertexArray(VAO); // use VAO
     glDrawArrays(GL_TRIANGLES, 0, 3);
-    glBindVertexArray(0);
 
     // refresh
     glfwSwapBuffers(window);
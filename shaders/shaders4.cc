@@ -3,20 +3,47 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include "../lib/shader.hh"
+#include "../lib/program_cache.hh"
+#include "../lib/state_cache.hh"
+#include "../lib/shader_watcher.hh"
+#include "../lib/main_loop.hh"
+#include "../lib/gpu_timer.hh"
+#include "../lib/profiler.hh"
+#include "../lib/vertex_format.hh"
 // use our lib
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mode);
 
+// 16 bytes a vertex instead of 24, the color is 8 bits per channel
+struct ColoredVertex {
+  vertex::vec3 position;
+  vertex::ubyte4n color;
+};
+VERTEX_FORMAT(ColoredVertex,
+  VERTEX_ATTRIBUTE(ColoredVertex, position),
+  VERTEX_ATTRIBUTE(ColoredVertex, color));
+
 int main() {
+  // CPU zones, with -DLEARNOPENGL_PROFILE; F12 or exit writes trace.json.
+  // Startup is zoned too, the trace shows what the first frame waits for
+  Profiler::threadName("main");
+
   // start glfw
-  glfwInit();
+  {
+    PROFILE_ZONE("glfwInit");
+    glfwInit();
+  }
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
   glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
 
   // create window
-  GLFWwindow* window = glfwCreateWindow(800, 600, "Learn OpenGL", nullptr, nullptr);
+  GLFWwindow* window;
+  {
+    PROFILE_ZONE("glfwCreateWindow");
+    window = glfwCreateWindow(800, 600, "Learn OpenGL", nullptr, nullptr);
+  }
   if (window == nullptr) {
     std::cout << "Failed to create GLFW window" << std::endl;
     glfwTerminate();
@@ -28,7 +55,12 @@ int main() {
 
   // start glew
   glewExperimental = GL_TRUE;
-  if (glewInit() != GLEW_OK) {
+  GLenum glew;
+  {
+    PROFILE_ZONE("glewInit");
+    glew = glewInit();
+  }
+  if (glew != GLEW_OK) {
     std::cout << "Failed to initialize GLEW" << std::endl;
     return -1;
   }
@@ -40,55 +72,97 @@ int main() {
 
   Shader ourShader("shaders/shader4.vs", "shaders/shader4.frag");
 
-  GLfloat vertices1[] = { // {position, color} x 3
-    -.5f, -.5f, .0f,  1.0f,  0.0f,  0.0f,
-     .0f,  .5f, .0f,  0.0f,  1.0f,  0.0f,
-     .5f, -.5f, .0f,  0.0f,  0.0f,  1.0f
+  // uniform handles are resolved once, outside the loop
+  GLint vertexColorLocation = ourShader.uniform("ourColor");
+
+  ColoredVertex vertices1[] = {
+    { { -.5f, -.5f, .0f }, vertex::unorm8(1.0f, 0.0f, 0.0f) },
+    { {  .0f,  .5f, .0f }, vertex::unorm8(0.0f, 1.0f, 0.0f) },
+    { {  .5f, -.5f, .0f }, vertex::unorm8(0.0f, 0.0f, 1.0f) }
   };
   // generate VAO, VBO
   GLuint VAO, VBO;
-  glGenVertexArrays(1, &VAO);
-  glGenBuffers(1, &VBO);
-
-  // Step 1: bind vertex array object
-  glBindVertexArray(VAO);
-  // Step 2: copy vertices in a buffer
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices1), vertices1, GL_STATIC_DRAW);
-  // Step 3: set vertex attribute pointers
-  // position
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6*sizeof(GLfloat), (GLvoid *)0 );
-  glEnableVertexAttribArray(0);
-  // color
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6*sizeof(GLfloat), (GLvoid *)(3*sizeof(GLfloat)));
-  glEnableVertexAttribArray(1);
-  // Step 4: unbind vertex array object
-  glBindVertexArray(0);
-
-  // event loop
-  while (!glfwWindowShouldClose(window)) {
-    glfwPollEvents();
+  {
+    PROFILE_ZONE("upload");
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+
+    // Step 1: bind vertex array object
+    glBindVertexArray(VAO);
+    // Step 2: copy vertices in a buffer
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices1), vertices1, GL_STATIC_DRAW);
+    // Step 3: set vertex attribute pointers, position at 0 and color at 1
+    setVertexFormat<ColoredVertex>();
+    // Step 4: unbind vertex array object
+    glBindVertexArray(0);
+  }
 
-    // rendering
-    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+  // uniform and state calls issued/elided over the whole run
+  unsigned issued = 0, elided = 0;
+  unsigned stateIssued = 0, stateSkipped = 0;
 
-    // use shader program
-    ourShader.use();
+  // rebuild the program when its files are edited, compiling on a hidden
+  // window's context when the driver cannot compile in the background
+  ShaderWatcher watcher(ShaderWatcher::sharedContext(window));
+  watcher.watch(ourShader);
 
-    // update uniform color
-    GLfloat timeValue = glfwGetTime();
-    GLfloat greenValue = (sin(timeValue*2)/2) + 0.5;
-    GLint vertexColorLocation = glGetUniformLocation(ourShader.Program, "ourColor");
-    glUniform4f(vertexColorLocation, 0.0f, greenValue, 0.0f, 1.0f);
+  // per draw GPU times, with -DLEARNOPENGL_GPU_TIMING
+  GpuTimer timer;
 
-    glBindVertexArray(VAO); // use VAO
-    glDrawArrays(GL_TRIANGLES, 0, 3);
-    glBindVertexArray(0);
+  // binds only what changed, see state_cache.hh
+  StateCache& state = StateCache::global();
 
-    // refresh
-    glfwSwapBuffers(window);
-  }
+  // redraw only when the program is reloaded or the animated color moves
+  GLfloat greenValue = -1.0f;
+  MainLoop loop(window, MainLoop::IDLE);
+  loop.run([&]() {
+    if (watcher.update()) loop.invalidate();
+
+    // update uniform color
+    GLfloat timeValue = glfwGetTime();
+    GLfloat green = (sin(timeValue*2)/2) + 0.5;
+    if (green != greenValue) {
+      greenValue = green;
+      loop.invalidate();
+    }
+  }, [&]() {
+    timer.beginFrame();
+    // rendering
+    {
+      GPU_ZONE(timer, "clear");
+      state.clearColor(0.2f, 0.3f, 0.3f, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT);
+    }
+
+    {
+      PROFILE_ZONE("uniforms");
+      // use shader program
+      ourShader.use();
+      ourShader.set(vertexColorLocation, 0.0f, greenValue, 0.0f, 1.0f);
+    }
+
+    {
+      PROFILE_ZONE("draw");
+      GPU_ZONE(timer, "triangle");
+      state.bindVertexArray(VAO); // use VAO
+      glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+
+    Shader::UniformCounters counters = Shader::endFrame();
+    issued += counters.issued;
+    elided += counters.elided;
+    StateCache::Counters stateCounters = state.endFrame();
+    stateIssued += stateCounters.issued;
+    stateSkipped += stateCounters.skipped;
+    timer.endFrame();
+  });
+  loop.report(std::cout);
+  timer.report(std::cout);
+  ProgramCache::global().report(std::cout);
+  std::cout << loop.stats.frames << " frames, uniform calls issued " << issued
+            << ", elided " << elided << "; state calls issued " << stateIssued
+            << ", skipped " << stateSkipped << std::endl;
   glfwTerminate();
   return 0;
 }
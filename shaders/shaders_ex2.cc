@@ -3,6 +3,8 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include "../lib/shader.hh"
+#include "../lib/state_cache.hh"
+#include "../lib/shader_watcher.hh"
 // use our lib
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mode);
@@ -40,6 +42,9 @@ int main() {
 
   Shader ourShader("shaders/shader_ex2.vs", "shaders/shader_ex2.frag");
 
+  // uniform handles are resolved once, outside the loop
+  GLint vertexColorLocation = ourShader.uniform("offset");
+
   GLfloat vertices1[] = { // {position, color} x 3
     -.5f, -.5f, .0f,  1.0f,  0.0f,  0.0f,
      .0f,  .5f, .0f,  0.0f,  1.0f,  0.0f,
@@ -65,28 +70,45 @@ int main() {
   // Step 4: unbind vertex array object
   glBindVertexArray(0);
 
+  // uniform calls issued/elided over the whole run
+  unsigned frames = 0, issued = 0, elided = 0;
+
+  // rebuild the program when its files are edited, compiling on a hidden
+  // window's context when the driver cannot compile in the background
+  ShaderWatcher watcher(ShaderWatcher::sharedContext(window));
+  watcher.watch(ourShader);
+
+  // binds only what changed, see state_cache.hh
+  StateCache& state = StateCache::global();
+
   // event loop
   while (!glfwWindowShouldClose(window)) {
     glfwPollEvents();
+    watcher.update();
 
     // rendering
-    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    state.clearColor(0.2f, 0.3f, 0.3f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
     // use shader program
     ourShader.use();
 
     // update uniform color
-    GLint vertexColorLocation = glGetUniformLocation(ourShader.Program, "offset");
-    glUniform1f(vertexColorLocation, 0.5f);
+    ourShader.set(vertexColorLocation, 0.5f);
 
-    glBindVertexArray(VAO); // use VAO
+    state.bindVertexArray(VAO); // use VAO
     glDrawArrays(GL_TRIANGLES, 0, 3);
-    glBindVertexArray(0);
 
     // refresh
     glfwSwapBuffers(window);
+
+    Shader::UniformCounters counters = Shader::endFrame();
+    issued += counters.issued;
+    elided += counters.elided;
+    ++frames;
   }
+  std::cout << frames << " frames, uniform calls issued " << issued
+            << ", elided " << elided << std::endl;
   glfwTerminate();
   return 0;
 }
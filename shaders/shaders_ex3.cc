@@ -3,6 +3,8 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include "../lib/shader.hh"
+#include "../lib/state_cache.hh"
+#include "../lib/shader_watcher.hh"
 // use our lib
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mode);
@@ -61,20 +63,28 @@ int main() {
   // Step 4: unbind vertex array object
   glBindVertexArray(0);
 
+  // rebuild the program when its files are edited, compiling on a hidden
+  // window's context when the driver cannot compile in the background
+  ShaderWatcher watcher(ShaderWatcher::sharedContext(window));
+  watcher.watch(ourShader);
+
+  // binds only what changed, see state_cache.hh
+  StateCache& state = StateCache::global();
+
   // event loop
   while (!glfwWindowShouldClose(window)) {
     glfwPollEvents();
+    watcher.update();
 
     // rendering
-    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    state.clearColor(0.2f, 0.3f, 0.3f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
     // use shader program
     ourShader.use();
 
-    glBindVertexArray(VAO); // use VAO
+    state.bindVertexArray(VAO); // use VAO
     glDrawArrays(GL_TRIANGLES, 0, 3);
-    glBindVertexArray(0);
 
     // refresh
     glfwSwapBuffers(window);